@@ -0,0 +1,150 @@
+#include <QCoreApplication>
+#include <iostream>
+#include "benchmark_game.h"
+#include "localserver.h"
+#include "localserverinterface.h"
+#include "server_room.h"
+#include "server_game.h"
+#include "server_player.h"
+#include "decklist.h"
+#include "get_pb_extension.h"
+#include "pb/commands.pb.h"
+#include "pb/server_message.pb.h"
+#include "pb/session_commands.pb.h"
+#include "pb/room_commands.pb.h"
+#include "pb/command_deck_select.pb.h"
+#include "pb/command_ready_start.pb.h"
+
+BenchmarkGame::BenchmarkGame(int playerCount, int spectatorCount, int deckSize, int clientFeatures)
+	: game(0), gameId(-1)
+{
+	server = new LocalServer;
+
+	for (int i = 0; i < playerCount + spectatorCount; ++i) {
+		LocalServerInterface *session = server->newConnection();
+		sessions.append(session);
+
+		Command_Login login;
+		login.set_user_name(QString(i < playerCount ? "Player %1" : "Spectator %1").arg(i).toStdString());
+		login.set_client_features(clientFeatures);
+		sendSessionCommand(session, login);
+
+		Command_JoinRoom joinRoom;
+		joinRoom.set_room_id(0);
+		sendSessionCommand(session, joinRoom);
+	}
+
+	Command_CreateGame createGame;
+	createGame.set_description("Benchmark");
+	createGame.set_max_players(playerCount);
+	createGame.set_spectators_allowed(true);
+	sendRoomCommand(sessions[0], createGame);
+
+	Server_Room *room = server->getRooms().value(0);
+	if (room->getGames().isEmpty()) {
+		std::cerr << "BenchmarkGame: could not create game" << std::endl;
+		return;
+	}
+	game = room->getGames().values().first();
+	gameId = game->getGameId();
+
+	for (int i = 1; i < sessions.size(); ++i) {
+		Command_JoinGame joinGame;
+		joinGame.set_game_id(gameId);
+		joinGame.set_spectator(i >= playerCount);
+		sendRoomCommand(sessions[i], joinGame);
+	}
+
+	const QString deck = generateDeck(deckSize);
+	for (int i = 0; i < playerCount; ++i) {
+		Command_DeckSelect deckSelect;
+		deckSelect.set_deck(deck.toStdString());
+		sendGameCommand(sessions[i], deckSelect);
+
+		Command_ReadyStart readyStart;
+		readyStart.set_ready(true);
+		sendGameCommand(sessions[i], readyStart);
+	}
+
+	// The game is started through a queued signal.
+	QCoreApplication::processEvents();
+	if (!game->getGameStarted())
+		std::cerr << "BenchmarkGame: game did not start" << std::endl;
+}
+
+BenchmarkGame::~BenchmarkGame()
+{
+	delete server;
+	QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+}
+
+QString BenchmarkGame::cardName(int index)
+{
+	return QString("Benchmark Card %1").arg(index);
+}
+
+QString BenchmarkGame::generateDeck(int size)
+{
+	DeckList deck;
+	deck.setName(QString("Benchmark deck (%1 cards)").arg(size));
+
+	const int copies = 4;
+	for (int i = 0; i * copies < size; ++i)
+		deck.addCard(cardName(i), "main")->setNumber(qMin(copies, size - i * copies));
+	for (int i = 0; i < 5; ++i)
+		deck.addCard(cardName(1000 + i), "side")->setNumber(3);
+
+	return deck.writeToString_Native();
+}
+
+Server_Player *BenchmarkGame::getPlayer(int playerId) const
+{
+	return game ? game->getPlayers().value(playerId) : 0;
+}
+
+void BenchmarkGame::sendSessionCommand(LocalServerInterface *session, const ::google::protobuf::Message &cmd)
+{
+	CommandContainer cont;
+	cont.set_cmd_id(0);
+	SessionCommand *c = cont.add_session_command();
+	setPbExtension(*c, cmd);
+	session->itemFromClient(cont);
+}
+
+void BenchmarkGame::sendRoomCommand(LocalServerInterface *session, const ::google::protobuf::Message &cmd)
+{
+	CommandContainer cont;
+	cont.set_cmd_id(0);
+	cont.set_room_id(0);
+	RoomCommand *c = cont.add_room_command();
+	setPbExtension(*c, cmd);
+	session->itemFromClient(cont);
+}
+
+void BenchmarkGame::sendGameCommand(LocalServerInterface *session, const ::google::protobuf::Message &cmd)
+{
+	CommandContainer cont;
+	cont.set_cmd_id(0);
+	cont.set_game_id(gameId);
+	GameCommand *c = cont.add_game_command();
+	setPbExtension(*c, cmd);
+	session->itemFromClient(cont);
+}
+
+void BenchmarkEventCounter::watch(LocalServerInterface *session)
+{
+	connect(session, SIGNAL(itemToClient(const ServerMessage &)), this, SLOT(processServerMessage(const ServerMessage &)), Qt::DirectConnection);
+}
+
+void BenchmarkEventCounter::processServerMessage(const ServerMessage &item)
+{
+	if ((item.message_type() == ServerMessage::SESSION_EVENT) && (getPbExtension(item.session_event()) == eventType))
+		++count;
+}
+
+int BenchmarkEventCounter::takeCount()
+{
+	const int result = count;
+	count = 0;
+	return result;
+}
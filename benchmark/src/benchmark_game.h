@@ -0,0 +1,59 @@
+#ifndef BENCHMARK_GAME_H
+#define BENCHMARK_GAME_H
+
+#include <QObject>
+#include <QList>
+#include <QString>
+
+class LocalServer;
+class LocalServerInterface;
+class ServerMessage;
+class Server_Game;
+class Server_Player;
+
+namespace google { namespace protobuf { class Message; } }
+
+// A started game on a private LocalServer, set up through the regular
+// command path: every participant logs in, joins room 0 and joins the game,
+// players select a generated deck and declare themselves ready.
+class BenchmarkGame {
+private:
+	LocalServer *server;
+	QList<LocalServerInterface *> sessions;
+	Server_Game *game;
+	int gameId;
+
+	void sendRoomCommand(LocalServerInterface *session, const ::google::protobuf::Message &cmd);
+	void sendGameCommand(LocalServerInterface *session, const ::google::protobuf::Message &cmd);
+public:
+	// clientFeatures are the ServerInfo_User::ProtocolFeature flags every participant announces.
+	BenchmarkGame(int playerCount, int spectatorCount = 0, int deckSize = 60, int clientFeatures = 0);
+	~BenchmarkGame();
+	static QString generateDeck(int size);
+	static QString cardName(int index);
+	static void sendSessionCommand(LocalServerInterface *session, const ::google::protobuf::Message &cmd);
+
+	LocalServer *getServer() const { return server; }
+	const QList<LocalServerInterface *> &getSessions() const { return sessions; }
+
+	Server_Game *getGame() const { return game; }
+	Server_Player *getPlayer(int playerId) const;
+};
+
+// Counts the session events of one type that reach the watched connections.
+class BenchmarkEventCounter : public QObject {
+	Q_OBJECT
+private:
+	int eventType;
+	int count;
+private slots:
+	void processServerMessage(const ServerMessage &item);
+public:
+	// eventType is a SessionEvent::SessionEventType.
+	BenchmarkEventCounter(int _eventType) : eventType(_eventType), count(0) { }
+	void watch(LocalServerInterface *session);
+	// Events counted since the last call.
+	int takeCount();
+};
+
+#endif
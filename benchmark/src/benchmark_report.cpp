@@ -0,0 +1,116 @@
+#include <QIODevice>
+#include <QTextStream>
+#include <QDateTime>
+#include <iostream>
+#include <algorithm>
+#include "benchmark_report.h"
+
+BenchmarkReport::BenchmarkReport(int _repetitions, const QStringList &_filters)
+	: repetitions(_repetitions), filters(_filters)
+{
+}
+
+bool BenchmarkReport::isEnabled(const QString &name) const
+{
+	if (filters.isEmpty())
+		return true;
+	for (int i = 0; i < filters.size(); ++i)
+		if (name.contains(filters[i]))
+			return true;
+	return false;
+}
+
+void BenchmarkReport::addResult(const QString &name, const QVariantMap &params, int operations, const QVector<qint64> &nsecsPerRepetition)
+{
+	Result result;
+	result.name = name;
+	result.params = params;
+	result.operations = operations;
+	for (int i = 0; i < nsecsPerRepetition.size(); ++i)
+		result.nsPerOperation.append((double) nsecsPerRepetition[i] / qMax(1, operations));
+	results.append(result);
+
+	QStringList paramList;
+	QMapIterator<QString, QVariant> paramIterator(params);
+	while (paramIterator.hasNext()) {
+		paramIterator.next();
+		paramList.append(paramIterator.key() + "=" + paramIterator.value().toString());
+	}
+	QVector<double> sorted = result.nsPerOperation;
+	std::sort(sorted.begin(), sorted.end());
+	std::cerr << name.toStdString() << " (" << paramList.join(", ").toStdString() << "): "
+	          << QString::number(sorted.isEmpty() ? 0 : sorted[sorted.size() / 2], 'f', 1).toStdString() << " ns/op" << std::endl;
+}
+
+void BenchmarkReport::addFailure(const QString &name, const QString &message)
+{
+	failures.append(name);
+	std::cerr << name.toStdString() << ": FAILED: " << message.toStdString() << std::endl;
+}
+
+QString BenchmarkReport::jsonString(const QString &str)
+{
+	QString result = "\"";
+	for (int i = 0; i < str.size(); ++i) {
+		const QChar c = str[i];
+		if (c == '"')
+			result += "\\\"";
+		else if (c == '\\')
+			result += "\\\\";
+		else if (c == '\n')
+			result += "\\n";
+		else if (c.unicode() < 0x20)
+			result += QString("\\u%1").arg(c.unicode(), 4, 16, QChar('0'));
+		else
+			result += c;
+	}
+	return result + "\"";
+}
+
+QString BenchmarkReport::jsonValue(const QVariant &value)
+{
+	switch (value.type()) {
+		case QVariant::Bool: return value.toBool() ? "true" : "false";
+		case QVariant::Int:
+		case QVariant::LongLong:
+		case QVariant::UInt:
+		case QVariant::ULongLong: return value.toString();
+		case QVariant::Double: return QString::number(value.toDouble(), 'f', 3);
+		default: return jsonString(value.toString());
+	}
+}
+
+void BenchmarkReport::writeJson(QIODevice *device) const
+{
+	QTextStream out(device);
+	out << "{\n";
+	out << "  \"suite\": \"cockatrice_common\",\n";
+	out << "  \"timestamp\": " << jsonString(QDateTime::currentDateTime().toUTC().toString(Qt::ISODate)) << ",\n";
+	out << "  \"repetitions\": " << repetitions << ",\n";
+	out << "  \"results\": [";
+	for (int i = 0; i < results.size(); ++i) {
+		const Result &result = results[i];
+		QVector<double> sorted = result.nsPerOperation;
+		std::sort(sorted.begin(), sorted.end());
+		double mean = 0;
+		for (int j = 0; j < sorted.size(); ++j)
+			mean += sorted[j];
+		if (!sorted.isEmpty())
+			mean /= sorted.size();
+
+		out << (i ? ",\n" : "\n") << "    {\"name\": " << jsonString(result.name) << ", \"params\": {";
+		QMapIterator<QString, QVariant> paramIterator(result.params);
+		bool first = true;
+		while (paramIterator.hasNext()) {
+			paramIterator.next();
+			out << (first ? "" : ", ") << jsonString(paramIterator.key()) << ": " << jsonValue(paramIterator.value());
+			first = false;
+		}
+		out << "}, \"operations\": " << result.operations;
+		out << ", \"ns_per_op\": {\"min\": " << QString::number(sorted.isEmpty() ? 0 : sorted.first(), 'f', 3)
+		    << ", \"median\": " << QString::number(sorted.isEmpty() ? 0 : sorted[sorted.size() / 2], 'f', 3)
+		    << ", \"mean\": " << QString::number(mean, 'f', 3)
+		    << ", \"max\": " << QString::number(sorted.isEmpty() ? 0 : sorted.last(), 'f', 3) << "}}";
+	}
+	out << "\n  ]\n}\n";
+}
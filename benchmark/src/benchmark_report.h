@@ -0,0 +1,42 @@
+#ifndef BENCHMARK_REPORT_H
+#define BENCHMARK_REPORT_H
+
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+#include <QList>
+
+class QIODevice;
+
+// Collects the timings of all benchmark runs and writes them as JSON.
+// Each result holds the time of every repetition, normalized to nanoseconds
+// per operation, so that later runs can be compared against it.
+class BenchmarkReport {
+private:
+	struct Result {
+		QString name;
+		QVariantMap params;
+		int operations;
+		QVector<double> nsPerOperation;
+	};
+	int repetitions;
+	QStringList filters;
+	QList<Result> results;
+	QStringList failures;
+
+	static QString jsonString(const QString &str);
+	static QString jsonValue(const QVariant &value);
+public:
+	BenchmarkReport(int _repetitions, const QStringList &_filters);
+	int getRepetitions() const { return repetitions; }
+	bool isEnabled(const QString &name) const;
+
+	void addResult(const QString &name, const QVariantMap &params, int operations, const QVector<qint64> &nsecsPerRepetition);
+	// A benchmark that found the code under test misbehaving reports it here instead of a result.
+	void addFailure(const QString &name, const QString &message);
+	bool hasFailures() const { return !failures.isEmpty(); }
+	void writeJson(QIODevice *device) const;
+};
+
+#endif
@@ -0,0 +1,906 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QVariantMap>
+#include "common_benchmarks.h"
+#include "benchmark_report.h"
+#include "benchmark_game.h"
+#include "server_game.h"
+#include "server_player.h"
+#include "server_cardzone.h"
+#include "server_card.h"
+#include "server_object_pool.h"
+#include "server_deck_cache.h"
+#include "server_response_containers.h"
+#include "server_room.h"
+#include "server_user_game_index.h"
+#include "localserver.h"
+#include "localserverinterface.h"
+#include "get_pb_extension.h"
+#include "pb/game_event.pb.h"
+#include "pb/game_event_container.pb.h"
+#include "pb/command_move_card.pb.h"
+#include "pb/command_dump_zone.pb.h"
+#include "pb/response_dump_zone.pb.h"
+#include "pb/event_move_card.pb.h"
+#include "pb/event_game_state_changed.pb.h"
+#include "pb/event_player_properties_changed.pb.h"
+#include "pb/serverinfo_user.pb.h"
+#include "pb/session_commands.pb.h"
+#include "pb/session_event.pb.h"
+#include "pb/game_snapshot.pb.h"
+#include <google/protobuf/descriptor.h>
+#include <iostream>
+
+static const int deckSizes[] = { 60, 100, 250 };
+static const int deckSizeCount = 3;
+
+// Puts fresh cards into a zone the way setupZones() and moveCard() would.
+static QList<Server_Card *> fillZone(Server_Player *player, Server_CardZone *zone, int count)
+{
+	QList<Server_Card *> cards;
+	for (int i = 0; i < count; ++i) {
+		Server_Card *card = new Server_Card(BenchmarkGame::cardName(i / 4), player->newCardId(), 0, 0);
+		if (zone->hasCoords()) {
+			const int y = i % 3;
+			zone->insertCard(card, zone->getFreeGridColumn(-1, y, card->getNameId()), y);
+		} else
+			zone->insertCard(card, -1, 0);
+		cards.append(card);
+	}
+	return cards;
+}
+
+static void benchmarkInsertRemove(BenchmarkReport &report, const QString &zoneName, int count)
+{
+	BenchmarkGame game(1);
+	Server_Player *player = game.getPlayer(0);
+	Server_CardZone *zone = player->getZones().value(zoneName);
+	zone->clear();
+
+	QVector<qint64> insertTimes, removeTimes;
+	for (int rep = 0; rep < report.getRepetitions(); ++rep) {
+		QList<Server_Card *> cards;
+		for (int i = 0; i < count; ++i)
+			cards.append(new Server_Card(BenchmarkGame::cardName(i / 4), player->newCardId(), 0, 0));
+
+		QElapsedTimer timer;
+		timer.start();
+		for (int i = 0; i < count; ++i) {
+			Server_Card *card = cards[i];
+			if (zone->hasCoords()) {
+				const int y = i % 3;
+				zone->insertCard(card, zone->getFreeGridColumn(-1, y, card->getNameId()), y);
+			} else
+				zone->insertCard(card, -1, 0);
+		}
+		insertTimes.append(timer.nsecsElapsed());
+
+		// Remove in a scrambled order so that removal does not always hit the list ends.
+		QList<Server_Card *> removeOrder = cards;
+		for (int i = removeOrder.size() - 1; i > 0; --i)
+			removeOrder.swap(i, qrand() % (i + 1));
+
+		timer.restart();
+		for (int i = 0; i < removeOrder.size(); ++i)
+			zone->removeCard(removeOrder[i]);
+		removeTimes.append(timer.nsecsElapsed());
+
+		qDeleteAll(cards);
+	}
+
+	QVariantMap params;
+	params.insert("zone", zoneName);
+	params.insert("cards", count);
+	report.addResult("cardzone_insert_card", params, count, insertTimes);
+	report.addResult("cardzone_remove_card", params, count, removeTimes);
+}
+
+static void benchmarkGetCard(BenchmarkReport &report, const QString &zoneName, int count)
+{
+	const int lookups = 10000;
+
+	BenchmarkGame game(1);
+	Server_Player *player = game.getPlayer(0);
+	Server_CardZone *zone = player->getZones().value(zoneName);
+	zone->clear();
+	fillZone(player, zone, count);
+
+	// Hidden zones are addressed by position, all others by card id.
+	QVector<int> ids;
+	for (int i = 0; i < lookups; ++i) {
+		const int position = qrand() % count;
+		ids.append(zone->getType() == ServerInfo_Zone::HiddenZone ? position : zone->getCards()[position]->getId());
+	}
+
+	QVector<qint64> times;
+	int found = 0;
+	for (int rep = 0; rep < report.getRepetitions(); ++rep) {
+		QElapsedTimer timer;
+		timer.start();
+		for (int i = 0; i < lookups; ++i) {
+			int position;
+			if (zone->getCard(ids[i], &position))
+				++found;
+		}
+		times.append(timer.nsecsElapsed());
+	}
+
+	QVariantMap params;
+	params.insert("zone", zoneName);
+	params.insert("cards", count);
+	params.insert("found", found == lookups * report.getRepetitions());
+	report.addResult("cardzone_get_card", params, lookups, times);
+}
+
+static void benchmarkGetFreeGridColumn(BenchmarkReport &report, int count)
+{
+	const int lookups = 10000;
+
+	BenchmarkGame game(1);
+	Server_Player *player = game.getPlayer(0);
+	Server_CardZone *zone = player->getZones().value("table");
+	zone->clear();
+	fillZone(player, zone, count);
+
+	QVector<int> names;
+	QVector<int> xs, ys;
+	for (int i = 0; i < lookups; ++i) {
+		names.append(CardNameTable::acquire(BenchmarkGame::cardName(qrand() % (count / 4 + 2))));
+		xs.append(i % 2 ? -1 : qrand() % (count / 3 + 3));
+		ys.append(qrand() % 3);
+	}
+
+	QVector<qint64> times;
+	int sum = 0;
+	for (int rep = 0; rep < report.getRepetitions(); ++rep) {
+		QElapsedTimer timer;
+		timer.start();
+		for (int i = 0; i < lookups; ++i)
+			sum += zone->getFreeGridColumn(xs[i], ys[i], names[i]);
+		times.append(timer.nsecsElapsed());
+	}
+
+	QVariantMap params;
+	params.insert("cards", count);
+	params.insert("checksum", sum);
+	report.addResult("cardzone_get_free_grid_column", params, lookups, times);
+}
+
+static void benchmarkFixFreeSpaces(BenchmarkReport &report, int count)
+{
+	BenchmarkGame game(1);
+	Server_Player *player = game.getPlayer(0);
+	Server_CardZone *zone = player->getZones().value("table");
+
+	QVector<qint64> times;
+	for (int rep = 0; rep < report.getRepetitions(); ++rep) {
+		zone->clear();
+
+		// Full piles of three in every row, then open a gap at the bottom of every other pile.
+		QList<Server_Card *> removed;
+		for (int i = 0; i < count; ++i) {
+			const int x = i / 3;
+			Server_Card *card = new Server_Card(BenchmarkGame::cardName(x / 3), player->newCardId(), 0, 0);
+			zone->insertCard(card, x, i % 3);
+			if (!(x % 3) && !((x / 3) % 2))
+				removed.append(card);
+		}
+		for (int i = 0; i < removed.size(); ++i)
+			zone->removeCard(removed[i]);
+		qDeleteAll(removed);
+
+		GameEventStorage ges;
+		QElapsedTimer timer;
+		timer.start();
+		zone->fixFreeSpaces(ges);
+		times.append(timer.nsecsElapsed());
+	}
+	zone->clear();
+
+	QVariantMap params;
+	params.insert("cards", count);
+	report.addResult("cardzone_fix_free_spaces", params, 1, times);
+}
+
+static void benchmarkShuffle(BenchmarkReport &report, int deckSize)
+{
+	const int shuffles = 100;
+
+	BenchmarkGame game(1, 0, deckSize);
+	Server_CardZone *zone = game.getPlayer(0)->getZones().value("deck");
+
+	QVector<qint64> times;
+	for (int rep = 0; rep < report.getRepetitions(); ++rep) {
+		QElapsedTimer timer;
+		timer.start();
+		for (int i = 0; i < shuffles; ++i)
+			zone->shuffle();
+		times.append(timer.nsecsElapsed());
+	}
+
+	QVariantMap params;
+	params.insert("cards", zone->getCards().size());
+	report.addResult("cardzone_shuffle", params, shuffles, times);
+}
+
+void runCardZoneBenchmarks(BenchmarkReport &report)
+{
+	const char *zoneNames[] = { "deck", "hand", "table" };
+	for (int z = 0; z < 3; ++z)
+		for (int i = 0; i < deckSizeCount; ++i) {
+			if (report.isEnabled("cardzone_insert_card") || report.isEnabled("cardzone_remove_card"))
+				benchmarkInsertRemove(report, zoneNames[z], deckSizes[i]);
+			if (report.isEnabled("cardzone_get_card"))
+				benchmarkGetCard(report, zoneNames[z], deckSizes[i]);
+		}
+	for (int i = 0; i < deckSizeCount; ++i) {
+		if (report.isEnabled("cardzone_get_free_grid_column"))
+			benchmarkGetFreeGridColumn(report, deckSizes[i]);
+		if (report.isEnabled("cardzone_fix_free_spaces"))
+			benchmarkFixFreeSpaces(report, deckSizes[i]);
+		if (report.isEnabled("cardzone_shuffle"))
+			benchmarkShuffle(report, deckSizes[i]);
+	}
+}
+
+static void benchmarkSetupZones(BenchmarkReport &report, int deckSize)
+{
+	BenchmarkGame game(1, 0, deckSize);
+	Server_Player *player = game.getPlayer(0);
+
+	QVector<qint64> times;
+	const int heapAllocationsBefore = Server_ObjectPool::getHeapAllocations();
+	for (int rep = 0; rep < report.getRepetitions(); ++rep) {
+		player->clearZones();
+
+		QElapsedTimer timer;
+		timer.start();
+		player->setupZones();
+		times.append(timer.nsecsElapsed());
+	}
+
+	QVariantMap params;
+	params.insert("deck_size", deckSize);
+	params.insert("object_pool", Server_ObjectPool::isEnabled());
+	params.insert("heap_allocations", (Server_ObjectPool::getHeapAllocations() - heapAllocationsBefore) / report.getRepetitions());
+	report.addResult("player_setup_zones", params, 1, times);
+}
+
+// Fresh zones with the whole library drawn into the hand.
+static void resetHand(Server_Player *player)
+{
+	player->clearZones();
+	player->setupZones();
+
+	GameEventStorage ges;
+	player->drawCards(ges, player->getZones().value("deck")->getCards().size());
+}
+
+static void benchmarkMoveCardSingle(BenchmarkReport &report, int deckSize, const QString &targetZoneName)
+{
+	BenchmarkGame game(2, 0, deckSize);
+	Server_Player *player = game.getPlayer(0);
+
+	QVector<qint64> times;
+	for (int rep = 0; rep < report.getRepetitions(); ++rep) {
+		resetHand(player);
+		Server_CardZone *hand = player->getZones().value("hand");
+		Server_CardZone *target = player->getZones().value(targetZoneName);
+
+		QList<int> ids;
+		for (int i = 0; i < hand->getCards().size(); ++i)
+			ids.append(hand->getCards()[i]->getId());
+
+		QElapsedTimer timer;
+		timer.start();
+		for (int i = 0; i < ids.size(); ++i) {
+			GameEventStorage ges;
+			CardToMove cardToMove;
+			cardToMove.set_card_id(ids[i]);
+			player->moveCard(ges, hand, QList<const CardToMove *>() << &cardToMove, target, target->hasCoords() ? -1 : 0, i % 3);
+		}
+		times.append(timer.nsecsElapsed());
+	}
+
+	QVariantMap params;
+	params.insert("cards", deckSize);
+	params.insert("target_zone", targetZoneName);
+	report.addResult("player_move_card_single", params, deckSize, times);
+}
+
+static void benchmarkMoveCardBulk(BenchmarkReport &report, int deckSize, const QString &targetZoneName, bool batched)
+{
+	BenchmarkGame game(2, 0, deckSize, batched ? ServerInfo_User::FeatureMoveCards : 0);
+	Server_Player *player = game.getPlayer(0);
+
+	QVector<qint64> times;
+	for (int rep = 0; rep < report.getRepetitions(); ++rep) {
+		resetHand(player);
+		Server_CardZone *hand = player->getZones().value("hand");
+		Server_CardZone *target = player->getZones().value(targetZoneName);
+
+		QList<CardToMove> cardsToMove;
+		for (int i = 0; i < hand->getCards().size(); ++i) {
+			CardToMove cardToMove;
+			cardToMove.set_card_id(hand->getCards()[i]->getId());
+			cardsToMove.append(cardToMove);
+		}
+		QList<const CardToMove *> cardList;
+		for (int i = 0; i < cardsToMove.size(); ++i)
+			cardList.append(&cardsToMove[i]);
+
+		GameEventStorage ges;
+		QElapsedTimer timer;
+		timer.start();
+		player->moveCard(ges, hand, cardList, target, 0, 0);
+		times.append(timer.nsecsElapsed());
+	}
+
+	QVariantMap params;
+	params.insert("cards", deckSize);
+	params.insert("target_zone", targetZoneName);
+	params.insert("batched", batched);
+	report.addResult("player_move_card_bulk", params, deckSize, times);
+}
+
+// Deck lookup as done by Command_DeckSelect, with and without a warm cache.
+static void benchmarkDeckCache(BenchmarkReport &report, int deckSize, bool cached)
+{
+	const QString deckString = BenchmarkGame::generateDeck(deckSize);
+	Server_DeckCache cache(cached ? 16 : 0);
+	cache.getDeck(deckString);
+
+	QVector<qint64> times;
+	for (int rep = 0; rep < report.getRepetitions(); ++rep) {
+		QElapsedTimer timer;
+		timer.start();
+		cache.getDeck(deckString);
+		times.append(timer.nsecsElapsed());
+	}
+
+	QVariantMap params;
+	params.insert("deck_size", deckSize);
+	params.insert("cached", cached);
+	report.addResult("player_deck_select", params, 1, times);
+}
+
+// Dump of the whole library as requested by a zone view, pageSize = -1 returns it in one response.
+// Fails if the response does not hold exactly the requested page.
+static void benchmarkDumpZone(BenchmarkReport &report, int deckSize, int pageSize)
+{
+	BenchmarkGame game(1, 0, deckSize);
+	Server_Player *player = game.getPlayer(0);
+	const int zoneSize = player->getZones().value("deck")->getCards().size();
+	const bool paged = (pageSize != -1) && (pageSize < zoneSize);
+
+	Command_DumpZone cmd;
+	cmd.set_player_id(player->getPlayerId());
+	cmd.set_zone_name("deck");
+	cmd.set_number_cards(-1);
+	cmd.set_max_cards(pageSize);
+
+	QVector<qint64> times;
+	int messageBytes = 0;
+	bool pageMatches = true;
+	for (int rep = 0; rep < report.getRepetitions(); ++rep) {
+		ResponseContainer rc(-1);
+		GameEventStorage ges;
+		QElapsedTimer timer;
+		timer.start();
+		if (player->cmdDumpZone(cmd, rc, ges) != Response::RespOk) {
+			pageMatches = false;
+			break;
+		}
+		Response response;
+		response.MutableExtension(Response_DumpZone::ext)->CopyFrom(*rc.getResponseExtension());
+		messageBytes = response.ByteSize();
+		times.append(timer.nsecsElapsed());
+
+		const Response_DumpZone &dump = response.GetExtension(Response_DumpZone::ext);
+		pageMatches = (dump.zone_info().card_count() == zoneSize)
+			&& (dump.zone_info().card_list_size() == (paged ? pageSize : zoneSize))
+			&& (dump.next_start() == (paged ? pageSize : -1));
+		if (!pageMatches)
+			break;
+	}
+
+	QVariantMap params;
+	params.insert("deck_size", deckSize);
+	params.insert("page_size", pageSize);
+	params.insert("message_bytes", messageBytes);
+	if (!pageMatches)
+		report.addFailure("player_dump_zone", QString("wrong page of %1 cards for page size %2").arg(zoneSize).arg(pageSize));
+	else
+		report.addResult("player_dump_zone", params, 1, times);
+}
+
+void runPlayerBenchmarks(BenchmarkReport &report)
+{
+	for (int i = 0; i < deckSizeCount; ++i) {
+		if (report.isEnabled("player_setup_zones"))
+			benchmarkSetupZones(report, deckSizes[i]);
+		if (report.isEnabled("player_deck_select")) {
+			benchmarkDeckCache(report, deckSizes[i], false);
+			benchmarkDeckCache(report, deckSizes[i], true);
+		}
+		if (report.isEnabled("player_move_card_single")) {
+			benchmarkMoveCardSingle(report, deckSizes[i], "table");
+			benchmarkMoveCardSingle(report, deckSizes[i], "grave");
+		}
+		if (report.isEnabled("player_move_card_bulk")) {
+			benchmarkMoveCardBulk(report, deckSizes[i], "table", false);
+			benchmarkMoveCardBulk(report, deckSizes[i], "table", true);
+			benchmarkMoveCardBulk(report, deckSizes[i], "grave", false);
+			benchmarkMoveCardBulk(report, deckSizes[i], "grave", true);
+		}
+		if (report.isEnabled("player_dump_zone")) {
+			benchmarkDumpZone(report, deckSizes[i], -1);
+			benchmarkDumpZone(report, deckSizes[i], 60);
+		}
+	}
+}
+
+static void benchmarkSendToGame(BenchmarkReport &report, int recipients)
+{
+	const int iterations = 1000;
+
+	BenchmarkGame game(2, recipients - 2);
+
+	// What a card moving from hand to table produces.
+	Event_MoveCard eventOthers;
+	eventOthers.set_start_player_id(0);
+	eventOthers.set_start_zone("hand");
+	eventOthers.set_target_player_id(0);
+	eventOthers.set_target_zone("table");
+	eventOthers.set_x(3);
+	eventOthers.set_y(1);
+	eventOthers.set_card_id(12);
+	eventOthers.set_card_name(BenchmarkGame::cardName(3).toStdString());
+	eventOthers.set_new_card_id(12);
+	Event_MoveCard eventPrivate(eventOthers);
+	eventPrivate.set_position(4);
+
+	QVector<qint64> times;
+	for (int rep = 0; rep < report.getRepetitions(); ++rep) {
+		QElapsedTimer timer;
+		timer.start();
+		for (int i = 0; i < iterations; ++i) {
+			GameEventStorage ges;
+			ges.enqueueGameEvent(eventPrivate, 0, GameEventStorageItem::SendToPrivate, 0);
+			ges.enqueueGameEvent(eventOthers, 0, GameEventStorageItem::SendToOthers);
+			ges.sendToGame(game.getGame());
+		}
+		times.append(timer.nsecsElapsed());
+	}
+
+	QVariantMap params;
+	params.insert("recipients", recipients);
+	report.addResult("game_event_storage_send_to_game", params, iterations, times);
+}
+
+static void benchmarkGameStateChangedEvent(BenchmarkReport &report, int playerCount, bool omniscient)
+{
+	const int iterations = 200;
+	const int cardsOnTable = 20;
+
+	BenchmarkGame game(playerCount);
+	Server_Game *g = game.getGame();
+
+	// Give every player a board worth describing.
+	QMapIterator<int, Server_Player *> playerIterator(g->getPlayers());
+	while (playerIterator.hasNext()) {
+		Server_Player *player = playerIterator.next().value();
+		GameEventStorage ges;
+		player->drawCards(ges, 7 + cardsOnTable);
+		Server_CardZone *hand = player->getZones().value("hand");
+		Server_CardZone *table = player->getZones().value("table");
+		for (int i = 0; i < cardsOnTable; ++i) {
+			CardToMove cardToMove;
+			cardToMove.set_card_id(hand->getCards().first()->getId());
+			player->moveCard(ges, hand, QList<const CardToMove *>() << &cardToMove, table, -1, i % 3);
+		}
+	}
+
+	Server_Player *playerWhosAsking = omniscient ? 0 : game.getPlayer(0);
+	QVector<qint64> times;
+	for (int rep = 0; rep < report.getRepetitions(); ++rep) {
+		QElapsedTimer timer;
+		timer.start();
+		for (int i = 0; i < iterations; ++i) {
+			Event_GameStateChanged event;
+			g->createGameStateChangedEvent(&event, playerWhosAsking, omniscient, false);
+		}
+		times.append(timer.nsecsElapsed());
+	}
+
+	QVariantMap params;
+	params.insert("players", playerCount);
+	params.insert("omniscient", omniscient);
+	report.addResult("game_create_game_state_changed_event", params, iterations, times);
+}
+
+// Cards in a player's zone according to the state sent along with a join, -1 if it is not there.
+static int joinedZoneCardCount(const ResponseContainer &rc, int playerId, const std::string &zoneName)
+{
+	const QList<ResponseContainerItem> &items = rc.getPostResponseQueue();
+	if (items.isEmpty() || items.last().message)
+		return -1;
+	// Skip the length prefix added by Server_ProtocolHandler::serializeProtocolItem().
+	const QByteArray &serialized = items.last().serialized;
+	ServerMessage msg;
+	if (!msg.ParseFromArray(serialized.constData() + 4, serialized.size() - 4) || !msg.game_event_container().event_list_size())
+		return -1;
+	const Event_GameStateChanged &state = msg.game_event_container().event_list(0).GetExtension(Event_GameStateChanged::ext);
+	for (int i = 0; i < state.player_list_size(); ++i) {
+		if (state.player_list(i).properties().player_id() != playerId)
+			continue;
+		for (int j = 0; j < state.player_list(i).zone_list_size(); ++j)
+			if (state.player_list(i).zone_list(j).name() == zoneName)
+				return state.player_list(i).zone_list(j).card_count();
+	}
+	return -1;
+}
+
+// A spectator joining a running game, with or without a state change since the previous join.
+// Fails if a card moved after the last join is missing from the state of the next one.
+static void benchmarkSpectatorJoin(BenchmarkReport &report, int playerCount, bool stateChanged)
+{
+	const int iterations = 200;
+	const int cardsOnTable = 20;
+
+	BenchmarkGame game(playerCount, 1);
+	Server_Game *g = game.getGame();
+	for (int i = 0; i < playerCount; ++i) {
+		Server_Player *player = game.getPlayer(i);
+		GameEventStorage ges;
+		player->drawCards(ges, 7 + cardsOnTable);
+		Server_CardZone *hand = player->getZones().value("hand");
+		Server_CardZone *table = player->getZones().value("table");
+		for (int j = 0; j < cardsOnTable; ++j) {
+			CardToMove cardToMove;
+			cardToMove.set_card_id(hand->getCards().first()->getId());
+			player->moveCard(ges, hand, QList<const CardToMove *>() << &cardToMove, table, -1, j % 3);
+		}
+		ges.sendToGame(g);
+	}
+	Server_Player *spectator = game.getPlayer(playerCount);
+
+	// Ping times alone leave the join snapshot valid, see Server_Game::changesGameState().
+	Event_PlayerPropertiesChanged stateChange;
+	stateChange.mutable_player_properties()->set_ready_start(true);
+
+	QVector<qint64> times;
+	for (int rep = 0; rep < report.getRepetitions(); ++rep) {
+		qint64 elapsed = 0;
+		for (int i = 0; i < iterations; ++i) {
+			if (stateChanged)
+				g->sendGameEventContainer(g->prepareGameEvent(stateChange, 0));
+			QElapsedTimer timer;
+			timer.start();
+			ResponseContainer rc(-1);
+			g->createGameJoinedEvent(spectator, rc, true);
+			elapsed += timer.nsecsElapsed();
+		}
+		times.append(elapsed);
+	}
+
+	Server_Player *player = game.getPlayer(0);
+	GameEventStorage ges;
+	CardToMove cardToMove;
+	cardToMove.set_card_id(player->getZones().value("hand")->getCards().first()->getId());
+	player->moveCard(ges, player->getZones().value("hand"), QList<const CardToMove *>() << &cardToMove, player->getZones().value("table"), -1, 0);
+	ges.sendToGame(g);
+	ResponseContainer rc(-1);
+	g->createGameJoinedEvent(spectator, rc, true);
+
+	QVariantMap params;
+	params.insert("players", playerCount);
+	params.insert("state_changed", stateChanged);
+	if (joinedZoneCardCount(rc, player->getPlayerId(), "table") != cardsOnTable + 1)
+		report.addFailure("game_spectator_join", "joining spectator got a stale table");
+	else
+		report.addResult("game_spectator_join", params, iterations, times);
+}
+
+// Two servers in one process stand in for ISL peers: the game is handed back and
+// forth between them like in a migration, including the trip through the wire format
+// and the peer's confirmation. Every participant is logged in on both servers.
+// Fails if the peer does not end up with the game, the players are not told where it
+// went, or a game the peer never confirmed or turned down does not come back.
+static void benchmarkGameMigration(BenchmarkReport &report, int playerCount)
+{
+	const int iterations = 20;
+
+	BenchmarkGame game(playerCount);
+	if (!game.getGame())
+		return;
+	const int gameId = game.getGame()->getGameId();
+	for (int i = 0; i < playerCount; ++i) {
+		GameEventStorage ges;
+		game.getPlayer(i)->drawCards(ges, 7);
+		ges.sendToGame(game.getGame());
+	}
+
+	BenchmarkEventCounter migratedEvents(SessionEvent::GAME_MIGRATED);
+	for (int i = 0; i < game.getSessions().size(); ++i)
+		migratedEvents.watch(game.getSessions()[i]);
+	LocalServer *servers[2] = { game.getServer(), new LocalServer };
+	for (int i = 0; i < playerCount; ++i) {
+		LocalServerInterface *session = servers[1]->newConnection();
+		migratedEvents.watch(session);
+		Command_Login login;
+		login.set_user_name(QString("Player %1").arg(i).toStdString());
+		BenchmarkGame::sendSessionCommand(session, login);
+	}
+
+	QString failure;
+	QVector<qint64> times;
+	for (int rep = 0; (rep < report.getRepetitions()) && failure.isEmpty(); ++rep) {
+		QElapsedTimer timer;
+		timer.start();
+		// An even number of hops brings the game home for the next repetition.
+		for (int i = 0; i < 2 * iterations; ++i) {
+			LocalServer *from = servers[i % 2];
+			LocalServer *to = servers[1 - i % 2];
+			const int toId = 1 - i % 2;
+			GameSnapshot snapshot;
+			if (!from->getRooms().value(0)->migrateGame(gameId, toId, snapshot)) {
+				failure = "could not migrate game";
+				break;
+			}
+			from->addPendingGameMigration(snapshot, toId);
+			const std::string wire = snapshot.SerializeAsString();
+			GameSnapshot received;
+			received.ParseFromString(wire);
+			if (!to->adoptGame(received) || !to->getRooms().value(0)->getGames().contains(gameId)) {
+				failure = "peer did not adopt game";
+				break;
+			}
+			from->gameMigrationResultReceived(gameId, true, toId);
+			if (from->getRooms().value(0)->getGames().contains(gameId) || from->getPendingGameMigrationCount()) {
+				failure = "game stayed on the old server";
+				break;
+			}
+			if (migratedEvents.takeCount() != playerCount) {
+				failure = "players were not told where the game went";
+				break;
+			}
+			QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+		}
+		times.append(timer.nsecsElapsed());
+	}
+
+	// The peer drops the game: it is taken back once the timeout has passed, and
+	// right away when the peer says it could not adopt it.
+	for (int refused = 0; (refused < 2) && failure.isEmpty(); ++refused) {
+		LocalServer *server = servers[0];
+		Server_Room *room = server->getRooms().value(0);
+		GameSnapshot snapshot;
+		if (!room->migrateGame(gameId, 1, snapshot)) {
+			failure = "could not migrate game";
+			break;
+		}
+		server->addPendingGameMigration(snapshot, 1);
+		server->expireGameMigrations(server->getMsecsRunning());
+		if (room->getGames().contains(gameId)) {
+			failure = "game came back before the migration timed out";
+			break;
+		}
+		if (refused)
+			server->gameMigrationResultReceived(gameId, false, 1);
+		else
+			server->expireGameMigrations(server->getMsecsRunning() + Server::gameMigrationTimeout);
+		if (!room->getGames().contains(gameId) || server->getPendingGameMigrationCount())
+			failure = refused ? "refused game did not come back" : "unconfirmed game did not come back after the timeout";
+		else if (migratedEvents.takeCount())
+			failure = "players were sent to a server that does not have the game";
+		QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+	}
+	delete servers[1];
+	QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+
+	QVariantMap params;
+	params.insert("players", playerCount);
+	if (failure.isEmpty())
+		report.addResult("game_migration", params, 2 * iterations, times);
+	else
+		report.addFailure("game_migration", failure);
+}
+
+// Join limit check and "games of user" lookup in a room of gameCount games with four users each.
+// Fails if the looked up user is not found as the creator of one game and a player of one.
+static void benchmarkUserGameIndex(BenchmarkReport &report, int gameCount)
+{
+	Server_UserGameIndex index;
+	for (int i = 0; i < gameCount; ++i) {
+		index.addCreatedGame(QString("user%1").arg(4 * i), i);
+		for (int j = 0; j < 4; ++j)
+			index.addUser(QString("user%1").arg(4 * i + j), i);
+	}
+	const QString userName = QString("user%1").arg(2 * gameCount);
+
+	const int iterations = 1000;
+	QVector<qint64> times;
+	for (int rep = 0; rep < report.getRepetitions(); ++rep) {
+		int found = 0;
+		QElapsedTimer timer;
+		timer.start();
+		for (int i = 0; i < iterations; ++i)
+			found += index.getGamesCreatedByUser(userName) + index.getGamesOfUser(userName).size();
+		times.append(timer.nsecsElapsed());
+		if (found != 2 * iterations) {
+			report.addFailure("room_user_game_index", QString("found %1 games instead of %2").arg(found).arg(2 * iterations));
+			return;
+		}
+	}
+
+	QVariantMap params;
+	params.insert("games", gameCount);
+	report.addResult("room_user_game_index", params, iterations, times);
+}
+
+// Login and logout of a user while many users are connected, of which only some watch the user list.
+// Fails unless exactly the watching users are told about every login and logout.
+static void benchmarkUserListFanout(BenchmarkReport &report, int connections, int subscribers)
+{
+	BenchmarkEventCounter joinedEvents(SessionEvent::USER_JOINED);
+	BenchmarkEventCounter leftEvents(SessionEvent::USER_LEFT);
+	LocalServer *server = new LocalServer;
+	for (int i = 0; i < connections; ++i) {
+		LocalServerInterface *session = server->newConnection();
+		joinedEvents.watch(session);
+		leftEvents.watch(session);
+		Command_Login login;
+		login.set_user_name(QString("user%1").arg(i).toStdString());
+		BenchmarkGame::sendSessionCommand(session, login);
+		if (i < subscribers)
+			BenchmarkGame::sendSessionCommand(session, Command_ListUsers());
+	}
+	joinedEvents.takeCount();
+	leftEvents.takeCount();
+
+	const int iterations = 100;
+	QString failure;
+	QVector<qint64> times;
+	for (int rep = 0; (rep < report.getRepetitions()) && failure.isEmpty(); ++rep) {
+		QElapsedTimer timer;
+		timer.start();
+		for (int i = 0; i < iterations; ++i) {
+			LocalServerInterface *session = server->newConnection();
+			Command_Login login;
+			login.set_user_name("visitor");
+			BenchmarkGame::sendSessionCommand(session, login);
+			session->prepareDestroy();
+		}
+		times.append(timer.nsecsElapsed());
+		QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+
+		const int joined = joinedEvents.takeCount();
+		const int left = leftEvents.takeCount();
+		if ((joined != iterations * subscribers) || (left != iterations * subscribers))
+			failure = QString("%1 joins and %2 leaves seen instead of %3 each").arg(joined).arg(left).arg(iterations * subscribers);
+	}
+
+	QVariantMap params;
+	params.insert("connections", connections);
+	params.insert("subscribers", subscribers);
+	if (failure.isEmpty())
+		report.addResult("server_user_list_fanout", params, iterations, times);
+	else
+		report.addFailure("server_user_list_fanout", failure);
+
+	delete server;
+	QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+}
+
+void runGameBenchmarks(BenchmarkReport &report)
+{
+	const int gameCounts[] = { 100, 1000, 10000 };
+	if (report.isEnabled("room_user_game_index"))
+		for (int i = 0; i < 3; ++i)
+			benchmarkUserGameIndex(report, gameCounts[i]);
+
+	const int connectionCounts[] = { 100, 1000, 10000 };
+	if (report.isEnabled("server_user_list_fanout"))
+		for (int i = 0; i < 3; ++i) {
+			benchmarkUserListFanout(report, connectionCounts[i], 10);
+			benchmarkUserListFanout(report, connectionCounts[i], connectionCounts[i]);
+		}
+
+	const int recipientCounts[] = { 2, 8, 32, 128 };
+	if (report.isEnabled("game_event_storage_send_to_game"))
+		for (int i = 0; i < 4; ++i)
+			benchmarkSendToGame(report, recipientCounts[i]);
+
+	const int playerCounts[] = { 2, 4, 8 };
+	if (report.isEnabled("game_create_game_state_changed_event"))
+		for (int i = 0; i < 3; ++i) {
+			benchmarkGameStateChangedEvent(report, playerCounts[i], false);
+			benchmarkGameStateChangedEvent(report, playerCounts[i], true);
+		}
+	if (report.isEnabled("game_spectator_join"))
+		for (int i = 0; i < 3; ++i) {
+			benchmarkSpectatorJoin(report, playerCounts[i], true);
+			benchmarkSpectatorJoin(report, playerCounts[i], false);
+		}
+	if (report.isEnabled("game_migration"))
+		for (int i = 0; i < 3; ++i)
+			benchmarkGameMigration(report, playerCounts[i]);
+}
+
+static Event_MoveCard protocolBenchmarkEvent()
+{
+	Event_MoveCard event;
+	event.set_start_player_id(0);
+	event.set_start_zone("hand");
+	event.set_target_player_id(0);
+	event.set_target_zone("table");
+	event.set_card_id(12);
+	event.set_card_name(BenchmarkGame::cardName(3).toStdString());
+	return event;
+}
+
+// Dispatch on the extension type of a game event, by reflection or through the generated overload.
+static void benchmarkGetExtension(BenchmarkReport &report, bool generated)
+{
+	const int iterations = 10000;
+
+	GameEvent event;
+	event.MutableExtension(Event_MoveCard::ext)->CopyFrom(protocolBenchmarkEvent());
+	const ::google::protobuf::Message &message = event;
+
+	QVector<qint64> times;
+	for (int rep = 0; rep < report.getRepetitions(); ++rep) {
+		QElapsedTimer timer;
+		timer.start();
+		if (generated)
+			for (int i = 0; i < iterations; ++i)
+				getPbExtension(event);
+		else
+			for (int i = 0; i < iterations; ++i)
+				getPbExtension(message);
+		times.append(timer.nsecsElapsed());
+	}
+
+	QVariantMap params;
+	params.insert("generated", generated);
+	report.addResult("pb_get_extension", params, iterations, times);
+}
+
+// Wrapping of a game event into its container, by reflection or through the generated overload.
+static void benchmarkSetExtension(BenchmarkReport &report, bool generated)
+{
+	const int iterations = 10000;
+
+	const Event_MoveCard moveCard = protocolBenchmarkEvent();
+
+	QVector<qint64> times;
+	for (int rep = 0; rep < report.getRepetitions(); ++rep) {
+		QElapsedTimer timer;
+		timer.start();
+		for (int i = 0; i < iterations; ++i) {
+			GameEvent event;
+			if (generated)
+				setPbExtension(event, moveCard);
+			else
+				event.GetReflection()->MutableMessage(&event, moveCard.GetDescriptor()->FindExtensionByName("ext"))->CopyFrom(moveCard);
+		}
+		times.append(timer.nsecsElapsed());
+	}
+
+	QVariantMap params;
+	params.insert("generated", generated);
+	report.addResult("pb_set_extension", params, iterations, times);
+}
+
+void runProtocolBenchmarks(BenchmarkReport &report)
+{
+	if (report.isEnabled("pb_get_extension")) {
+		benchmarkGetExtension(report, false);
+		benchmarkGetExtension(report, true);
+	}
+	if (report.isEnabled("pb_set_extension")) {
+		benchmarkSetExtension(report, false);
+		benchmarkSetExtension(report, true);
+	}
+}
@@ -0,0 +1,11 @@
+#ifndef COMMON_BENCHMARKS_H
+#define COMMON_BENCHMARKS_H
+
+class BenchmarkReport;
+
+void runCardZoneBenchmarks(BenchmarkReport &report);
+void runPlayerBenchmarks(BenchmarkReport &report);
+void runGameBenchmarks(BenchmarkReport &report);
+void runProtocolBenchmarks(BenchmarkReport &report);
+
+#endif
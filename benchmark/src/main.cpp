@@ -0,0 +1,77 @@
+#include <QCoreApplication>
+#include <QTextCodec>
+#include <QStringList>
+#include <QFile>
+#include <iostream>
+#include "rng_sfmt.h"
+#include "benchmark_report.h"
+#include "common_benchmarks.h"
+#include "server_object_pool.h"
+
+RNG_Abstract *rng;
+
+void myMessageOutput(QtMsgType type, const char *msg)
+{
+	// The server core is chatty about object destruction; only pass on real problems.
+	if (type != QtDebugMsg)
+		std::cerr << msg << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	app.setOrganizationName("Cockatrice");
+	app.setApplicationName("common_benchmark");
+
+	QTextCodec::setCodecForCStrings(QTextCodec::codecForName("UTF-8"));
+	qInstallMsgHandler(myMessageOutput);
+
+	QStringList args = app.arguments();
+	int repetitions = 10;
+	QString outputFile;
+	QStringList filters;
+	for (int i = 1; i < args.size(); ++i) {
+		if ((args[i] == "--repetitions") && (i + 1 < args.size()))
+			repetitions = qMax(1, args[++i].toInt());
+		else if ((args[i] == "--output") && (i + 1 < args.size()))
+			outputFile = args[++i];
+		else if ((args[i] == "--filter") && (i + 1 < args.size()))
+			filters.append(args[++i]);
+		else if (args[i] == "--no-object-pool")
+			Server_ObjectPool::setEnabled(false);
+		else {
+			std::cerr << "Usage: common_benchmark [--repetitions n] [--output file.json] [--filter name]... [--no-object-pool]" << std::endl;
+			return 1;
+		}
+	}
+
+	rng = new RNG_SFMT(0, 1);
+	qsrand(1);
+
+	BenchmarkReport report(repetitions, filters);
+	runCardZoneBenchmarks(report);
+	runPlayerBenchmarks(report);
+	runGameBenchmarks(report);
+	runProtocolBenchmarks(report);
+
+	int retval = 0;
+	if (outputFile.isEmpty()) {
+		QFile out;
+		out.open(stdout, QIODevice::WriteOnly);
+		report.writeJson(&out);
+	} else {
+		QFile out(outputFile);
+		if (out.open(QIODevice::WriteOnly))
+			report.writeJson(&out);
+		else {
+			std::cerr << "Could not open " << outputFile.toStdString() << " for writing." << std::endl;
+			retval = 1;
+		}
+	}
+
+	if (report.hasFailures())
+		retval = 1;
+
+	delete rng;
+	return retval;
+}
@@ -0,0 +1,317 @@
+#include <QElapsedTimer>
+#include "simulation_bot.h"
+#include "simulation_statistics.h"
+#include "localserverinterface.h"
+#include "get_pb_extension.h"
+#include "pb/commands.pb.h"
+#include "pb/server_message.pb.h"
+#include "pb/session_commands.pb.h"
+#include "pb/room_commands.pb.h"
+#include "pb/command_deck_select.pb.h"
+#include "pb/command_ready_start.pb.h"
+#include "pb/command_draw_cards.pb.h"
+#include "pb/command_move_card.pb.h"
+#include "pb/command_set_card_attr.pb.h"
+#include "pb/command_inc_counter.pb.h"
+#include "pb/command_game_say.pb.h"
+#include "pb/command_next_turn.pb.h"
+#include "pb/command_leave_game.pb.h"
+#include "pb/event_game_joined.pb.h"
+#include "pb/event_game_state_changed.pb.h"
+#include "pb/event_draw_cards.pb.h"
+#include "pb/event_move_card.pb.h"
+#include "pb/event_move_cards.pb.h"
+#include "pb/serverinfo_user.pb.h"
+#include "pb/serverinfo_game.pb.h"
+#ifdef Q_OS_UNIX
+#include <time.h>
+#endif
+
+// Relative weights of the actions, the same mix as the servatrice_loadgen defaults.
+static const int actionWeights[SimulationBot::ActionCount] = { 20, 25, 25, 10, 10, 5, 5 };
+
+// Time the current thread spent on a CPU. Wall time in the server core minus this
+// is time spent waiting, which without any I/O in the core means waiting for locks
+// (or for a CPU, if there are more threads than cores).
+static qint64 threadCpuNsecs()
+{
+#ifdef Q_OS_UNIX
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (qint64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+	return -1;
+#endif
+}
+
+SimulationBot::SimulationBot(LocalServerInterface *_session, const QString &_userName, SimulationCounters &_counters, SimulationStatistics *_statistics, QObject *parent)
+	: QObject(parent), session(_session), counters(_counters), statistics(_statistics), userName(_userName), lastResponseCode(Response::RespNothing), roomId(-1), gameId(-1), playerId(-1), gameStarted(false)
+{
+	connect(session, SIGNAL(itemToClient(const ServerMessage &)), this, SLOT(processServerMessage(const ServerMessage &)), Qt::DirectConnection);
+}
+
+SimulationBot::Action SimulationBot::pickAction()
+{
+	int sum = 0;
+	for (int i = 0; i < ActionCount; ++i)
+		sum += actionWeights[i];
+	int value = qrand() % sum;
+	for (int i = 0; i < ActionCount; ++i) {
+		if (value < actionWeights[i])
+			return (Action) i;
+		value -= actionWeights[i];
+	}
+	return ActionDraw;
+}
+
+Response::ResponseCode SimulationBot::sendCommandContainer(CommandContainer &cont)
+{
+	cont.set_cmd_id(0);
+	lastResponseCode = Response::RespNothing;
+
+	const qint64 cpuStart = threadCpuNsecs();
+	QElapsedTimer timer;
+	timer.start();
+	session->itemFromClient(cont);
+	const qint64 nsecs = timer.nsecsElapsed();
+	const qint64 cpuNsecs = threadCpuNsecs() - cpuStart;
+
+	counters.addCommand(nsecs, cpuStart == -1 ? 0 : qMax((qint64) 0, nsecs - cpuNsecs), lastResponseCode != Response::RespOk);
+	return lastResponseCode;
+}
+
+Response::ResponseCode SimulationBot::sendSessionCommand(const ::google::protobuf::Message &cmd)
+{
+	CommandContainer cont;
+	SessionCommand *c = cont.add_session_command();
+	setPbExtension(*c, cmd);
+	return sendCommandContainer(cont);
+}
+
+Response::ResponseCode SimulationBot::sendRoomCommand(const ::google::protobuf::Message &cmd)
+{
+	CommandContainer cont;
+	cont.set_room_id(roomId);
+	RoomCommand *c = cont.add_room_command();
+	setPbExtension(*c, cmd);
+	return sendCommandContainer(cont);
+}
+
+Response::ResponseCode SimulationBot::sendGameCommand(const ::google::protobuf::Message &cmd)
+{
+	CommandContainer cont;
+	cont.set_game_id(gameId);
+	GameCommand *c = cont.add_game_command();
+	setPbExtension(*c, cmd);
+	return sendCommandContainer(cont);
+}
+
+void SimulationBot::processServerMessage(const ServerMessage &item)
+{
+	switch (item.message_type()) {
+		case ServerMessage::RESPONSE:
+			lastResponseCode = item.response().response_code();
+			break;
+		case ServerMessage::SESSION_EVENT: {
+			++counters.events;
+			const SessionEvent &event = item.session_event();
+			if (getPbExtension(event) == SessionEvent::GAME_JOINED) {
+				const Event_GameJoined &joinedEvent = event.GetExtension(Event_GameJoined::ext);
+				gameId = joinedEvent.game_info().game_id();
+				playerId = joinedEvent.player_id();
+				gameStarted = false;
+				handCards.clear();
+				tableCards.clear();
+				tappedCards.clear();
+			}
+			break;
+		}
+		case ServerMessage::GAME_EVENT_CONTAINER:
+			counters.events += item.game_event_container().event_list_size();
+			processGameEventContainer(item.game_event_container());
+			break;
+		case ServerMessage::ROOM_EVENT:
+			// Room events are also sent from other threads, e.g. game list updates.
+			statistics->roomEventReceived();
+			break;
+	}
+}
+
+void SimulationBot::processGameEventContainer(const GameEventContainer &cont)
+{
+	if ((int) cont.game_id() != gameId)
+		return;
+
+	for (int i = 0; i < cont.event_list_size(); ++i) {
+		const GameEvent &event = cont.event_list(i);
+		switch ((GameEvent::GameEventType) getPbExtension(event)) {
+			case GameEvent::GAME_STATE_CHANGED:
+				if (event.GetExtension(Event_GameStateChanged::ext).game_started())
+					gameStarted = true;
+				break;
+			case GameEvent::DRAW_CARDS: {
+				if (event.player_id() != playerId)
+					break;
+				const Event_DrawCards &drawEvent = event.GetExtension(Event_DrawCards::ext);
+				for (int j = 0; j < drawEvent.cards_size(); ++j)
+					handCards.append(drawEvent.cards(j).id());
+				break;
+			}
+			case GameEvent::MOVE_CARD: {
+				if (event.player_id() != playerId)
+					break;
+				const Event_MoveCard &moveEvent = event.GetExtension(Event_MoveCard::ext);
+				if ((moveEvent.start_zone() == "hand") && (moveEvent.target_zone() == "table")) {
+					handCards.removeAll(moveEvent.card_id());
+					tableCards.append(moveEvent.new_card_id());
+				}
+				break;
+			}
+			case GameEvent::MOVE_CARDS: {
+				if (event.player_id() != playerId)
+					break;
+				const Event_MoveCards &moveEvent = event.GetExtension(Event_MoveCards::ext);
+				if ((moveEvent.start_zone() == "hand") && (moveEvent.target_zone() == "table"))
+					for (int j = 0; j < moveEvent.card_id_size(); ++j) {
+						handCards.removeAll(moveEvent.card_id(j));
+						tableCards.append(moveEvent.new_card_id(j));
+					}
+				break;
+			}
+			case GameEvent::GAME_CLOSED:
+			case GameEvent::KICKED:
+				gameId = -1;
+				gameStarted = false;
+				return;
+			default: break;
+		}
+	}
+}
+
+bool SimulationBot::login(int _roomId)
+{
+	Command_Login login;
+	login.set_user_name(userName.toStdString());
+	login.set_client_features(ServerInfo_User::FeatureMoveCards);
+	if (sendSessionCommand(login) != Response::RespOk)
+		return false;
+
+	roomId = _roomId;
+	Command_JoinRoom joinRoom;
+	joinRoom.set_room_id(roomId);
+	return sendSessionCommand(joinRoom) == Response::RespOk;
+}
+
+int SimulationBot::createGame(int maxPlayers, bool spectatorsAllowed)
+{
+	Command_CreateGame cmd;
+	cmd.set_description(QString("Simulated game of %1").arg(userName).toStdString());
+	cmd.set_max_players(maxPlayers);
+	cmd.set_spectators_allowed(spectatorsAllowed);
+	if (sendRoomCommand(cmd) != Response::RespOk)
+		return -1;
+	return gameId;
+}
+
+bool SimulationBot::joinGame(int _gameId, bool spectator)
+{
+	Command_JoinGame cmd;
+	cmd.set_game_id(_gameId);
+	cmd.set_spectator(spectator);
+	return sendRoomCommand(cmd) == Response::RespOk;
+}
+
+void SimulationBot::selectDeck(const QString &deck)
+{
+	Command_DeckSelect deckSelect;
+	deckSelect.set_deck(deck.toStdString());
+	sendGameCommand(deckSelect);
+
+	Command_ReadyStart readyStart;
+	readyStart.set_ready(true);
+	sendGameCommand(readyStart);
+}
+
+void SimulationBot::drawCards(int number)
+{
+	Command_DrawCards cmd;
+	cmd.set_number(number);
+	sendGameCommand(cmd);
+}
+
+void SimulationBot::leaveGame()
+{
+	if (gameId == -1)
+		return;
+	sendGameCommand(Command_LeaveGame());
+	gameId = -1;
+	gameStarted = false;
+}
+
+void SimulationBot::performAction()
+{
+	Action action = pickAction();
+	if ((action == ActionTap) && tableCards.isEmpty())
+		action = ActionMove;
+	if ((action == ActionMove) && handCards.isEmpty())
+		action = ActionDraw;
+
+	switch (action) {
+		case ActionDraw: {
+			drawCards(1);
+			break;
+		}
+		case ActionMove: {
+			Command_MoveCard cmd;
+			cmd.set_start_player_id(playerId);
+			cmd.set_start_zone("hand");
+			cmd.set_target_player_id(playerId);
+			cmd.set_target_zone("table");
+			cmd.set_x(0);
+			cmd.set_y(qrand() % 3);
+			cmd.mutable_cards_to_move()->add_card()->set_card_id(handCards.takeAt(qrand() % handCards.size()));
+			sendGameCommand(cmd);
+			break;
+		}
+		case ActionTap: {
+			const int cardId = tableCards[qrand() % tableCards.size()];
+			const bool tapped = !tappedCards.contains(cardId);
+			if (tapped)
+				tappedCards.insert(cardId);
+			else
+				tappedCards.remove(cardId);
+
+			Command_SetCardAttr cmd;
+			cmd.set_zone("table");
+			cmd.set_card_id(cardId);
+			cmd.set_attribute(AttrTapped);
+			cmd.set_attr_value(tapped ? "1" : "0");
+			sendGameCommand(cmd);
+			break;
+		}
+		case ActionCounter: {
+			Command_IncCounter cmd;
+			cmd.set_counter_id(0);
+			cmd.set_delta(qrand() % 2 ? 1 : -1);
+			sendGameCommand(cmd);
+			break;
+		}
+		case ActionGameChat: {
+			Command_GameSay cmd;
+			cmd.set_message(QString("%1 says hello").arg(userName).toStdString());
+			sendGameCommand(cmd);
+			break;
+		}
+		case ActionRoomChat: {
+			Command_RoomSay cmd;
+			cmd.set_message(QString("%1 is still playing").arg(userName).toStdString());
+			sendRoomCommand(cmd);
+			break;
+		}
+		case ActionNextTurn: {
+			sendGameCommand(Command_NextTurn());
+			break;
+		}
+		default: break;
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef SIMULATION_BOT_H
+#define SIMULATION_BOT_H
+
+#include <QObject>
+#include <QList>
+#include <QSet>
+#include "pb/response.pb.h"
+
+class LocalServerInterface;
+class SimulationCounters;
+class SimulationStatistics;
+class CommandContainer;
+class ServerMessage;
+class GameEventContainer;
+
+namespace google { namespace protobuf { class Message; } }
+
+// A simulated user driving one LocalServerInterface. Commands are processed
+// synchronously by the server core; the time spent there is accounted to the
+// counters of the worker the bot belongs to.
+class SimulationBot : public QObject {
+	Q_OBJECT
+public:
+	enum Action { ActionDraw, ActionMove, ActionTap, ActionCounter, ActionGameChat, ActionRoomChat, ActionNextTurn, ActionCount };
+private slots:
+	void processServerMessage(const ServerMessage &item);
+private:
+	LocalServerInterface *session;
+	SimulationCounters &counters;
+	SimulationStatistics *statistics;
+	QString userName;
+	Response::ResponseCode lastResponseCode;
+
+	int roomId;
+	int gameId;
+	int playerId;
+	bool gameStarted;
+	QList<int> handCards;
+	QList<int> tableCards;
+	QSet<int> tappedCards;
+
+	static Action pickAction();
+	Response::ResponseCode sendCommandContainer(CommandContainer &cont);
+	Response::ResponseCode sendSessionCommand(const ::google::protobuf::Message &cmd);
+	Response::ResponseCode sendRoomCommand(const ::google::protobuf::Message &cmd);
+	Response::ResponseCode sendGameCommand(const ::google::protobuf::Message &cmd);
+	void processGameEventContainer(const GameEventContainer &cont);
+public:
+	SimulationBot(LocalServerInterface *_session, const QString &_userName, SimulationCounters &_counters, SimulationStatistics *_statistics, QObject *parent = 0);
+	int getGameId() const { return gameId; }
+	bool getGameStarted() const { return gameStarted; }
+
+	bool login(int _roomId);
+	int createGame(int maxPlayers, bool spectatorsAllowed);
+	bool joinGame(int _gameId, bool spectator);
+	void selectDeck(const QString &deck);
+	void drawCards(int number);
+	void performAction();
+	void leaveGame();
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include <QCoreApplication>
+#include <QTextCodec>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+#include <QFile>
+#include <iostream>
+#include "rng_sfmt.h"
+#include "localserverinterface.h"
+#include "simulation_server.h"
+#include "simulation_statistics.h"
+#include "simulation_worker.h"
+#include "server_object_pool.h"
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+RNG_Abstract *rng;
+
+void myMessageOutput(QtMsgType type, const char *msg)
+{
+	if (type != QtDebugMsg)
+		std::cerr << msg << std::endl;
+}
+
+// Resident set size of the process in bytes, -1 if unknown.
+static qint64 residentMemory()
+{
+#ifdef Q_OS_LINUX
+	QFile statm("/proc/self/statm");
+	if (!statm.open(QIODevice::ReadOnly))
+		return -1;
+	const QList<QByteArray> fields = statm.readLine().split(' ');
+	if (fields.size() < 2)
+		return -1;
+	return fields[1].toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+	return -1;
+#endif
+}
+
+// Peak resident set size of the process in bytes, -1 if unknown.
+static qint64 peakResidentMemory()
+{
+#ifdef Q_OS_LINUX
+	QFile status("/proc/self/status");
+	if (!status.open(QIODevice::ReadOnly))
+		return -1;
+	while (!status.atEnd()) {
+		const QByteArray line = status.readLine();
+		if (line.startsWith("VmHWM:"))
+			return line.mid(6).trimmed().split(' ').first().toLongLong() * 1024;
+	}
+	return -1;
+#else
+	return -1;
+#endif
+}
+
+static QString formatMemory(qint64 bytes)
+{
+	if (bytes < 0)
+		return "unknown";
+	return QString::number(bytes / 1048576.0, 'f', 1) + " MB";
+}
+
+static bool parseArguments(const QStringList &args, SimulationSettings &settings)
+{
+	for (int i = 1; i < args.size(); ++i) {
+		if (i + 1 >= args.size())
+			return false;
+		const QString &name = args[i];
+		const int value = args[++i].toInt();
+		if (name == "--games")
+			settings.games = qMax(1, value);
+		else if (name == "--players")
+			settings.playersPerGame = qMax(1, value);
+		else if (name == "--spectators")
+			settings.spectatorsPerGame = qMax(0, value);
+		else if (name == "--threads")
+			settings.threads = qMax(1, value);
+		else if (name == "--rooms")
+			settings.rooms = qMax(1, value);
+		else if (name == "--actions")
+			settings.actionsPerGame = qMax(1, value);
+		else if (name == "--rounds")
+			settings.rounds = qMax(0, value);
+		else if (name == "--duration")
+			settings.duration = qMax(0, value);
+		else if (name == "--deck-size")
+			settings.deckSize = qMax(1, value);
+		else if (name == "--report-interval")
+			settings.reportInterval = qMax(0, value);
+		else if (name == "--seed")
+			settings.seed = value;
+		else if (name == "--object-pool")
+			Server_ObjectPool::setEnabled(value != 0);
+		else
+			return false;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	app.setOrganizationName("Cockatrice");
+	app.setApplicationName("common_simulation");
+
+	QTextCodec::setCodecForCStrings(QTextCodec::codecForName("UTF-8"));
+	qInstallMsgHandler(myMessageOutput);
+
+	SimulationSettings settings;
+	if (!parseArguments(app.arguments(), settings)) {
+		std::cerr << "Usage: common_simulation [--games n] [--players n] [--spectators n] [--threads n] [--rooms n] [--actions n] [--rounds n] [--duration seconds] [--deck-size n] [--report-interval seconds] [--seed n] [--object-pool 0|1]" << std::endl;
+		return 1;
+	}
+
+	rng = new RNG_SFMT(0, settings.seed);
+	qsrand(settings.seed);
+
+	const qint64 memBefore = residentMemory();
+	std::cerr << "Simulating " << settings.games << " games of " << settings.playersPerGame << " players and " << settings.spectatorsPerGame << " spectators in "
+	          << settings.rooms << " rooms on " << settings.threads << " threads" << std::endl;
+
+	SimulationStatistics *statistics = new SimulationStatistics(settings.threads);
+	SimulationServer *server = new SimulationServer(settings.rooms);
+
+	QList<QThread *> threads;
+	QList<SimulationWorker *> workers;
+	for (int i = 0; i < settings.threads; ++i) {
+		QThread *thread = new QThread;
+		server->addWorkerThread(thread);
+		threads.append(thread);
+		workers.append(new SimulationWorker(i, settings, statistics));
+	}
+
+	// Sessions have the server as parent and need to be created in its thread.
+	const int usersPerGame = settings.playersPerGame + settings.spectatorsPerGame;
+	for (int i = 0; i < settings.games; ++i) {
+		QList<LocalServerInterface *> sessions;
+		for (int j = 0; j < usersPerGame; ++j)
+			sessions.append(server->newConnection());
+		workers[i % settings.threads]->addTable(sessions, i % settings.rooms);
+	}
+
+	for (int i = 0; i < settings.threads; ++i) {
+		workers[i]->moveToThread(threads[i]);
+		QObject::connect(workers[i], SIGNAL(finished()), statistics, SLOT(workerFinished()));
+		threads[i]->start();
+	}
+	for (int i = 0; i < settings.threads; ++i)
+		QMetaObject::invokeMethod(workers[i], "setup", Qt::BlockingQueuedConnection);
+	const qint64 memAfterSetup = residentMemory();
+
+	QObject::connect(statistics, SIGNAL(allWorkersFinished()), &app, SLOT(quit()));
+	QTimer reportTimer;
+	if (settings.reportInterval > 0) {
+		QObject::connect(&reportTimer, SIGNAL(timeout()), statistics, SLOT(printIntervalReport()));
+		reportTimer.start(settings.reportInterval * 1000);
+	}
+	if (settings.duration > 0)
+		QTimer::singleShot(settings.duration * 1000, &app, SLOT(quit()));
+
+	statistics->restartClock();
+	for (int i = 0; i < settings.threads; ++i)
+		QMetaObject::invokeMethod(workers[i], "start", Qt::QueuedConnection);
+
+	app.exec();
+
+	reportTimer.stop();
+	const qint64 memAtEnd = residentMemory();
+	for (int i = 0; i < settings.threads; ++i)
+		QMetaObject::invokeMethod(workers[i], "stop", Qt::BlockingQueuedConnection);
+
+	statistics->printSummary();
+	std::cerr << "Memory before setup: " << formatMemory(memBefore).toStdString() << ", after setup: " << formatMemory(memAfterSetup).toStdString()
+	          << ", at end: " << formatMemory(memAtEnd).toStdString() << ", peak: " << formatMemory(peakResidentMemory()).toStdString() << std::endl;
+	if ((memBefore >= 0) && (memAfterSetup >= 0))
+		std::cerr << "Memory per game: " << QString::number((memAfterSetup - memBefore) / 1024.0 / settings.games, 'f', 1).toStdString() << " kB" << std::endl;
+	std::cerr << "Heap allocations for cards, zones, counters and arrows: " << Server_ObjectPool::getHeapAllocations()
+	          << " (object pool " << (Server_ObjectPool::isEnabled() ? "on" : "off") << ")" << std::endl;
+
+	for (int i = 0; i < settings.threads; ++i) {
+		threads[i]->quit();
+		threads[i]->wait();
+	}
+	qDeleteAll(workers);
+	delete server;
+	QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+	qDeleteAll(threads);
+	delete statistics;
+	delete rng;
+
+	return 0;
+}
@@ -0,0 +1,15 @@
+#include "simulation_server.h"
+#include "server_room.h"
+
+SimulationServer::SimulationServer(int roomCount, QObject *parent)
+	: LocalServer(parent)
+{
+	// LocalServer provides room 0.
+	for (int i = 1; i < roomCount; ++i)
+		addRoom(new Server_Room(i, QString("Room %1").arg(i), QString(), false, QString(), QStringList(), this));
+}
+
+void SimulationServer::addWorkerThread(QThread *thread)
+{
+	databaseInterfaces.insert(thread, new LocalServer_DatabaseInterface(this));
+}
@@ -0,0 +1,19 @@
+#ifndef SIMULATION_SERVER_H
+#define SIMULATION_SERVER_H
+
+#include "localserver.h"
+
+class QThread;
+
+// A LocalServer with several rooms that accepts commands from more than one
+// thread. The server core looks up its database interface per thread, so every
+// worker thread needs one of its own.
+class SimulationServer : public LocalServer
+{
+	Q_OBJECT
+public:
+	SimulationServer(int roomCount, QObject *parent = 0);
+	void addWorkerThread(QThread *thread);
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include <iostream>
+#include "simulation_statistics.h"
+
+SimulationCounters::SimulationCounters()
+	: serverHistogram(histogramSize), blockedHistogram(histogramSize)
+{
+	clear();
+}
+
+void SimulationCounters::clear()
+{
+	commands = commandErrors = events = 0;
+	serverNsecs = blockedNsecs = 0;
+	gamesStarted = gamesFinished = 0;
+	serverHistogram.fill(0);
+	blockedHistogram.fill(0);
+}
+
+void SimulationCounters::add(const SimulationCounters &other)
+{
+	commands += other.commands;
+	commandErrors += other.commandErrors;
+	events += other.events;
+	serverNsecs += other.serverNsecs;
+	blockedNsecs += other.blockedNsecs;
+	gamesStarted += other.gamesStarted;
+	gamesFinished += other.gamesFinished;
+	for (int i = 0; i < histogramSize; ++i) {
+		serverHistogram[i] += other.serverHistogram[i];
+		blockedHistogram[i] += other.blockedHistogram[i];
+	}
+}
+
+static int histogramBucket(qint64 nsecs)
+{
+	int bucket = 0;
+	while ((nsecs > 1) && (bucket < SimulationCounters::histogramSize - 1)) {
+		nsecs >>= 1;
+		++bucket;
+	}
+	return bucket;
+}
+
+void SimulationCounters::addCommand(qint64 commandNsecs, qint64 commandBlockedNsecs, bool error)
+{
+	++commands;
+	if (error)
+		++commandErrors;
+	serverNsecs += commandNsecs;
+	blockedNsecs += commandBlockedNsecs;
+	++serverHistogram[histogramBucket(commandNsecs)];
+	++blockedHistogram[histogramBucket(commandBlockedNsecs)];
+}
+
+qint64 SimulationCounters::histogramPercentile(const QVector<quint64> &histogram, double p)
+{
+	quint64 count = 0;
+	for (int i = 0; i < histogram.size(); ++i)
+		count += histogram[i];
+	if (!count)
+		return 0;
+
+	// Upper bound of the bucket the percentile falls into.
+	const quint64 rank = (quint64) (count * p);
+	quint64 seen = 0;
+	for (int i = 0; i < histogram.size(); ++i) {
+		seen += histogram[i];
+		if (seen > rank)
+			return (qint64) 1 << (i + 1);
+	}
+	return (qint64) 1 << histogram.size();
+}
+
+SimulationStatistics::SimulationStatistics(int _workers, QObject *parent)
+	: QObject(parent), intervalStart(0), gamesRunning(0), workersRunning(_workers)
+{
+	clock.start();
+}
+
+void SimulationStatistics::merge(SimulationCounters &counters)
+{
+	QMutexLocker locker(&mutex);
+	total.add(counters);
+	interval.add(counters);
+	gamesRunning += counters.gamesStarted - counters.gamesFinished;
+	counters.clear();
+}
+
+void SimulationStatistics::collectRoomEvents()
+{
+	const int events = roomEvents.fetchAndStoreRelaxed(0);
+	total.events += events;
+	interval.events += events;
+}
+
+void SimulationStatistics::restartClock()
+{
+	QMutexLocker locker(&mutex);
+	roomEvents.fetchAndStoreRelaxed(0);
+	total.clear();
+	interval.clear();
+	clock.restart();
+	intervalStart = 0;
+}
+
+void SimulationStatistics::workerFinished()
+{
+	if (--workersRunning == 0)
+		emit allWorkersFinished();
+}
+
+void SimulationStatistics::printCounters(const SimulationCounters &counters, qint64 nsecs)
+{
+	const double seconds = nsecs / 1000000000.0;
+	std::cerr << " commands/s=" << QString::number(counters.commands / seconds, 'f', 1).toStdString()
+	          << " events/s=" << QString::number(counters.events / seconds, 'f', 1).toStdString()
+	          << " cmd_p50=" << QString::number(SimulationCounters::histogramPercentile(counters.serverHistogram, 0.5) / 1000.0, 'f', 1).toStdString() << "us"
+	          << " cmd_p99=" << QString::number(SimulationCounters::histogramPercentile(counters.serverHistogram, 0.99) / 1000.0, 'f', 1).toStdString() << "us"
+	          << " blocked=" << QString::number(counters.serverNsecs ? 100.0 * counters.blockedNsecs / counters.serverNsecs : 0, 'f', 1).toStdString() << "%"
+	          << " blocked_p99=" << QString::number(SimulationCounters::histogramPercentile(counters.blockedHistogram, 0.99) / 1000.0, 'f', 1).toStdString() << "us"
+	          << " errors=" << counters.commandErrors;
+}
+
+void SimulationStatistics::printIntervalReport()
+{
+	QMutexLocker locker(&mutex);
+	collectRoomEvents();
+	const qint64 now = clock.nsecsElapsed();
+
+	std::cerr << "[" << QString::number(now / 1000000000.0, 'f', 1).toStdString() << "s] games=" << gamesRunning;
+	printCounters(interval, now - intervalStart);
+	std::cerr << std::endl;
+
+	interval.clear();
+	intervalStart = now;
+}
+
+void SimulationStatistics::printSummary()
+{
+	QMutexLocker locker(&mutex);
+	collectRoomEvents();
+	const qint64 nsecs = clock.nsecsElapsed();
+
+	std::cerr << "-------------------------" << std::endl;
+	std::cerr << "Duration: " << QString::number(nsecs / 1000000000.0, 'f', 1).toStdString() << "s" << std::endl;
+	std::cerr << "Commands: " << total.commands << ", errors: " << total.commandErrors << ", events: " << total.events << std::endl;
+	std::cerr << "Games started: " << total.gamesStarted << ", finished: " << total.gamesFinished << std::endl;
+	std::cerr << "Throughput:";
+	printCounters(total, nsecs);
+	std::cerr << std::endl;
+	std::cerr << "Time in server core per command: "
+	          << QString::number(total.commands ? total.serverNsecs / 1000.0 / total.commands : 0, 'f', 2).toStdString() << "us, of which blocked: "
+	          << QString::number(total.commands ? total.blockedNsecs / 1000.0 / total.commands : 0, 'f', 2).toStdString() << "us" << std::endl;
+}
@@ -0,0 +1,56 @@
+#ifndef SIMULATION_STATISTICS_H
+#define SIMULATION_STATISTICS_H
+
+#include <QObject>
+#include <QVector>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+// Counters of one simulation worker. Each worker fills its own instance without
+// locking and hands it over to SimulationStatistics from time to time, so that
+// collecting the numbers does not add contention of its own.
+class SimulationCounters {
+public:
+	static const int histogramSize = 48;
+
+	quint64 commands, commandErrors, events;
+	quint64 serverNsecs, blockedNsecs;
+	int gamesStarted, gamesFinished;
+	// log2 buckets of the time spent in the server core per command
+	QVector<quint64> serverHistogram, blockedHistogram;
+
+	SimulationCounters();
+	void clear();
+	void add(const SimulationCounters &other);
+	void addCommand(qint64 commandNsecs, qint64 commandBlockedNsecs, bool error);
+	static qint64 histogramPercentile(const QVector<quint64> &histogram, double p);
+};
+
+class SimulationStatistics : public QObject {
+	Q_OBJECT
+signals:
+	void allWorkersFinished();
+private:
+	mutable QMutex mutex;
+	QElapsedTimer clock;
+	SimulationCounters total, interval;
+	QAtomicInt roomEvents;
+	qint64 intervalStart;
+	int gamesRunning;
+	int workersRunning;
+
+	void collectRoomEvents();
+	static void printCounters(const SimulationCounters &counters, qint64 nsecs);
+public:
+	SimulationStatistics(int _workers, QObject *parent = 0);
+	void merge(SimulationCounters &counters);
+	void roomEventReceived() { roomEvents.fetchAndAddRelaxed(1); }
+	void restartClock();
+public slots:
+	void workerFinished();
+	void printIntervalReport();
+	void printSummary();
+};
+
+#endif
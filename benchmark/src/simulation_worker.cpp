@@ -0,0 +1,141 @@
+#include <QCoreApplication>
+#include <QTimer>
+#include <iostream>
+#include "simulation_worker.h"
+#include "simulation_bot.h"
+#include "benchmark_game.h"
+
+SimulationWorker::SimulationWorker(int _workerIndex, const SimulationSettings &_settings, SimulationStatistics *_statistics)
+	: QObject(), workerIndex(_workerIndex), settings(_settings), statistics(_statistics), tablesDone(0)
+{
+	deck = BenchmarkGame::generateDeck(settings.deckSize);
+
+	stepTimer = new QTimer(this);
+	connect(stepTimer, SIGNAL(timeout()), this, SLOT(step()));
+}
+
+SimulationWorker::~SimulationWorker()
+{
+	qDeleteAll(tables);
+}
+
+void SimulationWorker::addTable(const QList<LocalServerInterface *> &sessions, int roomId)
+{
+	Table *table = new Table;
+	table->roomId = roomId;
+	table->actionsLeft = 0;
+	table->roundsLeft = settings.rounds;
+	table->running = false;
+	table->done = false;
+
+	for (int i = 0; i < sessions.size(); ++i) {
+		SimulationBot *bot = new SimulationBot(sessions[i], QString("bot_%1_%2_%3").arg(workerIndex).arg(tables.size()).arg(i), counters, statistics, this);
+		if (i < settings.playersPerGame)
+			table->players.append(bot);
+		else
+			table->spectators.append(bot);
+	}
+	tables.append(table);
+}
+
+void SimulationWorker::setup()
+{
+	qsrand(settings.seed + workerIndex);
+
+	for (int i = 0; i < tables.size(); ++i) {
+		Table *table = tables[i];
+		for (int j = 0; j < table->players.size(); ++j)
+			table->players[j]->login(table->roomId);
+		for (int j = 0; j < table->spectators.size(); ++j)
+			table->spectators[j]->login(table->roomId);
+		startRound(table);
+	}
+	statistics->merge(counters);
+}
+
+void SimulationWorker::startRound(Table *table)
+{
+	const int gameId = table->players.first()->createGame(table->players.size(), !table->spectators.isEmpty());
+	if (gameId == -1) {
+		std::cerr << "worker " << workerIndex << ": could not create game" << std::endl;
+		table->done = true;
+		++tablesDone;
+		return;
+	}
+	for (int i = 1; i < table->players.size(); ++i)
+		table->players[i]->joinGame(gameId, false);
+	for (int i = 0; i < table->spectators.size(); ++i)
+		table->spectators[i]->joinGame(gameId, true);
+
+	// The game starts from the event loop once everybody is ready, see step().
+	for (int i = 0; i < table->players.size(); ++i)
+		table->players[i]->selectDeck(deck);
+	table->actionsLeft = settings.actionsPerGame;
+}
+
+void SimulationWorker::finishRound(Table *table)
+{
+	for (int i = 0; i < table->spectators.size(); ++i)
+		table->spectators[i]->leaveGame();
+	for (int i = 0; i < table->players.size(); ++i)
+		table->players[i]->leaveGame();
+	table->running = false;
+	++counters.gamesFinished;
+
+	if ((settings.rounds > 0) && (--table->roundsLeft <= 0)) {
+		table->done = true;
+		++tablesDone;
+	} else
+		startRound(table);
+}
+
+void SimulationWorker::start()
+{
+	stepTimer->start(0);
+}
+
+void SimulationWorker::step()
+{
+	for (int i = 0; i < tables.size(); ++i) {
+		Table *table = tables[i];
+		if (table->done)
+			continue;
+		if (!table->running) {
+			if (!table->players.first()->getGameStarted())
+				continue;
+			table->running = true;
+			++counters.gamesStarted;
+			for (int j = 0; j < table->players.size(); ++j)
+				table->players[j]->drawCards(7);
+		}
+
+		table->players[qrand() % table->players.size()]->performAction();
+		if (--table->actionsLeft <= 0)
+			finishRound(table);
+	}
+	statistics->merge(counters);
+
+	if (tablesDone == tables.size()) {
+		stepTimer->stop();
+		emit finished();
+	}
+}
+
+void SimulationWorker::stop()
+{
+	stepTimer->stop();
+
+	for (int i = 0; i < tables.size(); ++i) {
+		Table *table = tables[i];
+		if (table->running)
+			++counters.gamesFinished;
+		table->running = false;
+		for (int j = 0; j < table->spectators.size(); ++j)
+			table->spectators[j]->leaveGame();
+		for (int j = 0; j < table->players.size(); ++j)
+			table->players[j]->leaveGame();
+	}
+	// Closed games delete themselves later; do it now while this thread is still running.
+	QCoreApplication::sendPostedEvents(0, QEvent::DeferredDelete);
+	statistics->merge(counters);
+}
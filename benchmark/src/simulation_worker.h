@@ -0,0 +1,70 @@
+#ifndef SIMULATION_WORKER_H
+#define SIMULATION_WORKER_H
+
+#include <QObject>
+#include <QList>
+#include "simulation_statistics.h"
+
+class QTimer;
+class LocalServerInterface;
+class SimulationBot;
+
+class SimulationSettings {
+public:
+	int games;
+	int playersPerGame;
+	int spectatorsPerGame;
+	int threads;
+	int rooms;
+	int actionsPerGame;
+	// games played by each table before it stops, 0 = until the simulation ends
+	int rounds;
+	int duration;
+	int deckSize;
+	int reportInterval;
+	int seed;
+
+	SimulationSettings()
+		: games(1000), playersPerGame(2), spectatorsPerGame(0), threads(4), rooms(10), actionsPerGame(200), rounds(0), duration(60), deckSize(60), reportInterval(5), seed(1) { }
+};
+
+// Runs a share of the simulated tables in one thread. A table is a group of bots
+// that create a game, play it for a number of random actions, leave it and
+// start over. Every step performs one action on each running table.
+class SimulationWorker : public QObject {
+	Q_OBJECT
+signals:
+	void finished();
+private slots:
+	void step();
+public slots:
+	void setup();
+	void start();
+	void stop();
+private:
+	struct Table {
+		QList<SimulationBot *> players, spectators;
+		int roomId;
+		int actionsLeft;
+		int roundsLeft;
+		bool running;
+		bool done;
+	};
+	int workerIndex;
+	const SimulationSettings &settings;
+	SimulationStatistics *statistics;
+	SimulationCounters counters;
+	QList<Table *> tables;
+	QString deck;
+	QTimer *stepTimer;
+	int tablesDone;
+
+	void startRound(Table *table);
+	void finishRound(Table *table);
+public:
+	SimulationWorker(int _workerIndex, const SimulationSettings &_settings, SimulationStatistics *_statistics);
+	~SimulationWorker();
+	void addTable(const QList<LocalServerInterface *> &sessions, int roomId);
+};
+
+#endif
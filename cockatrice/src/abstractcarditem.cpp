@@ -10,12 +10,13 @@
 #include "cardinfowidget.h"
 #include "abstractcarditem.h"
 #include "settingscache.h"
+#include "card_name_table.h"
 #include "main.h"
 #include "gamescene.h"
 #include <QDebug>
 
 AbstractCardItem::AbstractCardItem(const QString &_name, Player *_owner, int _id, QGraphicsItem *parent)
-    : ArrowTarget(_owner, parent), infoWidget(0), id(_id), name(_name), tapped(false), facedown(false), tapAngle(0), isHovered(false), realZValue(0)
+    : ArrowTarget(_owner, parent), infoWidget(0), id(_id), nameId(CardNameTable::acquire(_name)), name(CardNameTable::getName(nameId)), tapped(false), facedown(false), tapAngle(0), isHovered(false), realZValue(0)
 {
     setCursor(Qt::OpenHandCursor);
     setFlag(ItemIsSelectable);
@@ -29,6 +30,7 @@ AbstractCardItem::AbstractCardItem(const QString &_name, Player *_owner, int _id
 AbstractCardItem::~AbstractCardItem()
 {
     emit deleteCardInfoPopup(name);
+    CardNameTable::release(nameId);
 }
 
 QRectF AbstractCardItem::boundingRect() const
@@ -175,7 +177,10 @@ void AbstractCardItem::setName(const QString &_name)
     
     emit deleteCardInfoPopup(name);
     disconnect(info, 0, this, 0);
-    name = _name;
+    const int oldNameId = nameId;
+    nameId = CardNameTable::acquire(_name);
+    name = CardNameTable::getName(nameId);
+    CardNameTable::release(oldNameId);
     info = db->getCard(name);
     connect(info, SIGNAL(pixmapUpdated()), this, SLOT(pixmapUpdated()));
     update();
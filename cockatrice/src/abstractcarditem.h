@@ -17,6 +17,7 @@ protected:
     CardInfo *info;
     CardInfoWidget *infoWidget;
     int id;
+    int nameId; // reference held in CardNameTable
     QString name;
     bool tapped;
     bool facedown;
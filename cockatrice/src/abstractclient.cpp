@@ -15,8 +15,8 @@
 #include "pb/event_user_left.pb.h"
 #include "pb/event_game_joined.pb.h"
 #include "pb/event_replay_added.pb.h"
+#include "pb/event_game_migrated.pb.h"
 #include "get_pb_extension.h"
-#include <google/protobuf/descriptor.h>
 #include "client_metatypes.h"
 
 AbstractClient::AbstractClient(QObject *parent)
@@ -43,6 +43,7 @@ AbstractClient::AbstractClient(QObject *parent)
     qRegisterMetaType<ServerInfo_User>("ServerInfo_User");
     qRegisterMetaType<QList<ServerInfo_User> >("QList<ServerInfo_User>");
     qRegisterMetaType<Event_ReplayAdded>("Event_ReplayAdded");
+    qRegisterMetaType<Event_GameMigrated>("Event_GameMigrated");
     
     connect(this, SIGNAL(sigQueuePendingCommand(PendingCommand *)), this, SLOT(queuePendingCommand(PendingCommand *)));
 }
@@ -82,6 +83,7 @@ void AbstractClient::processProtocolItem(const ServerMessage &item)
                 case SessionEvent::USER_LEFT: emit userLeftEventReceived(event.GetExtension(Event_UserLeft::ext)); break;
                 case SessionEvent::GAME_JOINED: emit gameJoinedEventReceived(event.GetExtension(Event_GameJoined::ext)); break;
                 case SessionEvent::REPLAY_ADDED: emit replayAddedEventReceived(event.GetExtension(Event_ReplayAdded::ext)); break;
+                case SessionEvent::GAME_MIGRATED: emit gameMigratedEventReceived(event.GetExtension(Event_GameMigrated::ext)); break;
                 default: break;
             }
             break;
@@ -132,7 +134,7 @@ PendingCommand *AbstractClient::prepareSessionCommand(const ::google::protobuf::
 {
     CommandContainer cont;
     SessionCommand *c = cont.add_session_command();
-    c->GetReflection()->MutableMessage(c, cmd.GetDescriptor()->FindExtensionByName("ext"))->CopyFrom(cmd);
+    setPbExtension(*c, cmd);
     return new PendingCommand(cont);
 }
 
@@ -141,7 +143,7 @@ PendingCommand *AbstractClient::prepareRoomCommand(const ::google::protobuf::Mes
     CommandContainer cont;
     RoomCommand *c = cont.add_room_command();
     cont.set_room_id(roomId);
-    c->GetReflection()->MutableMessage(c, cmd.GetDescriptor()->FindExtensionByName("ext"))->CopyFrom(cmd);
+    setPbExtension(*c, cmd);
     return new PendingCommand(cont);
 }
 
@@ -149,7 +151,7 @@ PendingCommand *AbstractClient::prepareModeratorCommand(const ::google::protobuf
 {
     CommandContainer cont;
     ModeratorCommand *c = cont.add_moderator_command();
-    c->GetReflection()->MutableMessage(c, cmd.GetDescriptor()->FindExtensionByName("ext"))->CopyFrom(cmd);
+    setPbExtension(*c, cmd);
     return new PendingCommand(cont);
 }
 
@@ -157,6 +159,6 @@ PendingCommand *AbstractClient::prepareAdminCommand(const ::google::protobuf::Me
 {
     CommandContainer cont;
     AdminCommand *c = cont.add_admin_command();
-    c->GetReflection()->MutableMessage(c, cmd.GetDescriptor()->FindExtensionByName("ext"))->CopyFrom(cmd);
+    setPbExtension(*c, cmd);
     return new PendingCommand(cont);
 }
@@ -24,6 +24,7 @@ class Event_UserMessage;
 class Event_ConnectionClosed;
 class Event_ServerShutdown;
 class Event_ReplayAdded;
+class Event_GameMigrated;
 
 enum ClientStatus {
     StatusDisconnected,
@@ -59,6 +60,7 @@ signals:
     void buddyListReceived(const QList<ServerInfo_User> &buddyList);
     void ignoreListReceived(const QList<ServerInfo_User> &ignoreList);
     void replayAddedEventReceived(const Event_ReplayAdded &event);
+    void gameMigratedEventReceived(const Event_GameMigrated &event);
     
     void sigQueuePendingCommand(PendingCommand *pend);
 private:
@@ -1,5 +1,6 @@
 #include "carddatabase.h"
 #include "settingscache.h"
+#include "card_name_table.h"
 #include <QDir>
 #include <QDirIterator>
 #include <QFile>
@@ -277,7 +278,7 @@ CardInfo::CardInfo(CardDatabase *_db,
                    const SetList &_sets,
                    MuidMap _muIds)
     : db(_db),
-      name(_name),
+      name(CardNameTable::intern(_name)),
       isToken(_isToken),
       sets(_sets),
       manacost(_manacost),
@@ -206,7 +206,7 @@ CardItem *CardZone::getCard(int cardId, const QString &cardName)
     return c;
 }
 
-CardItem *CardZone::takeCard(int position, int cardId, bool /*canResize*/)
+CardItem *CardZone::takeCard(int position, int cardId, bool /*canResize*/, bool reorganize)
 {
     if (position == -1) {
         // position == -1 means either that the zone is indexed by card id
@@ -229,7 +229,8 @@ CardItem *CardZone::takeCard(int position, int cardId, bool /*canResize*/)
 
     c->setId(cardId);
 
-    reorganizeCards();
+    if (reorganize)
+        reorganizeCards();
     emit cardCountChanged();
     return c;
 }
@@ -55,7 +55,7 @@ public:
     // getCard() finds a card by id.
     CardItem *getCard(int cardId, const QString &cardName);
     // takeCard() finds a card by position and removes it from the zone and from all of its views.
-    virtual CardItem *takeCard(int position, int cardId, bool canResize = true);
+    virtual CardItem *takeCard(int position, int cardId, bool canResize = true, bool reorganize = true);
     void removeCard(CardItem *card);
     ZoneViewZone *getView() const { return view; }
     void setView(ZoneViewZone *_view) { view = _view; }
@@ -16,6 +16,7 @@
 #include "pb/room_commands.pb.h"
 #include "pb/serverinfo_game.pb.h"
 #include "pb/response.pb.h"
+#include "pb/response_set_game_filter.pb.h"
 
 GameSelector::GameSelector(AbstractClient *_client, const TabSupervisor *_tabSupervisor, TabRoom *_room, const QMap<int, QString> &_rooms, const QMap<int, GameTypeMap> &_gameTypes, QWidget *parent)
     : QGroupBox(parent), client(_client), tabSupervisor(_tabSupervisor), room(_room)
@@ -99,6 +100,7 @@ void GameSelector::actSetFilter()
     gameListProxyModel->setCreatorNameFilter(dlg.getCreatorNameFilter());
     gameListProxyModel->setGameTypeFilter(dlg.getGameTypeFilter());
     gameListProxyModel->setMaxPlayersFilter(dlg.getMaxPlayersFilterMin(), dlg.getMaxPlayersFilterMax());
+    sendGameFilter();
 }
 
 void GameSelector::actClearFilter()
@@ -106,6 +108,33 @@ void GameSelector::actClearFilter()
     clearFilterButton->setEnabled(false);
     
     gameListProxyModel->resetFilterParameters();
+    sendGameFilter();
+}
+
+// The server only sends the games of a room that match the filter, so it needs to know when it changes.
+void GameSelector::sendGameFilter()
+{
+    if (!room)
+        return;
+    
+    Command_SetGameFilter cmd;
+    gameListProxyModel->getServerFilter(*cmd.mutable_game_filter());
+    
+    PendingCommand *pend = room->prepareRoomCommand(cmd);
+    connect(pend, SIGNAL(finished(Response, CommandContainer, QVariant)), this, SLOT(gameFilterSet(Response)));
+    room->sendRoomCommand(pend);
+}
+
+void GameSelector::gameFilterSet(const Response &response)
+{
+    // Servers without game filters list all games anyway.
+    if (response.response_code() != Response::RespOk)
+        return;
+    
+    const Response_SetGameFilter &resp = response.GetExtension(Response_SetGameFilter::ext);
+    gameListModel->clearGameList();
+    for (int i = 0; i < resp.game_list_size(); ++i)
+        gameListModel->updateGameList(resp.game_list(i));
 }
 
 void GameSelector::actCreate()
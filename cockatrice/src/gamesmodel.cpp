@@ -1,5 +1,6 @@
 #include "gamesmodel.h"
 #include "pb/serverinfo_game.pb.h"
+#include "pb/serverinfo_game_filter.pb.h"
 #include <QStringList>
 
 GamesModel::GamesModel(const QMap<int, QString> &_rooms, const QMap<int, GameTypeMap> &_gameTypes, QObject *parent)
@@ -77,7 +78,11 @@ void GamesModel::updateGameList(const ServerInfo_Game &game)
                 gameList.removeAt(i);
                 endRemoveRows();
             } else {
-                gameList[i].MergeFrom(game);
+                // A complete game info would duplicate the game types when merged.
+                if (game.has_creator_info())
+                    gameList[i].CopyFrom(game);
+                else
+                    gameList[i].MergeFrom(game);
                 emit dataChanged(index(i, 0), index(i, 7));
             }
             return;
@@ -89,10 +94,18 @@ void GamesModel::updateGameList(const ServerInfo_Game &game)
     endInsertRows();
 }
 
+void GamesModel::clearGameList()
+{
+    beginResetModel();
+    gameList.clear();
+    endResetModel();
+}
+
 GamesProxyModel::GamesProxyModel(QObject *parent, ServerInfo_User *_ownUser)
     : QSortFilterProxyModel(parent),
           ownUser(_ownUser),
           unavailableGamesVisible(false),
+          passwordProtectedGamesVisible(false),
           maxPlayersFilterMin(-1),
           maxPlayersFilterMax(-1)
 {
@@ -149,6 +162,17 @@ void GamesProxyModel::resetFilterParameters()
     invalidateFilter();
 }
 
+void GamesProxyModel::getServerFilter(ServerInfo_GameFilter &filter) const
+{
+    filter.set_hide_unavailable(!unavailableGamesVisible);
+    filter.set_hide_password_protected(!passwordProtectedGamesVisible);
+    QSetIterator<int> gameTypeIterator(gameTypeFilter);
+    while (gameTypeIterator.hasNext())
+        filter.add_game_types(gameTypeIterator.next());
+    filter.set_max_players_min(maxPlayersFilterMin);
+    filter.set_max_players_max(maxPlayersFilterMax);
+}
+
 bool GamesProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &/*sourceParent*/) const
 {
     GamesModel *model = qobject_cast<GamesModel *>(sourceModel());
@@ -9,6 +9,7 @@
 #include "pb/serverinfo_game.pb.h"
 
 class ServerInfo_User;
+class ServerInfo_GameFilter;
 
 class GamesModel : public QAbstractTableModel {
     Q_OBJECT
@@ -25,6 +26,7 @@ public:
     
     const ServerInfo_Game &getGame(int row);
     void updateGameList(const ServerInfo_Game &game);
+    void clearGameList();
     const QMap<int, GameTypeMap> &getGameTypes() { return gameTypes; }
 };
 
@@ -54,6 +56,8 @@ public:
     int getMaxPlayersFilterMax() const { return maxPlayersFilterMax; }
     void setMaxPlayersFilter(int _maxPlayersFilterMin, int _maxPlayersFilterMax);
     void resetFilterParameters();
+    // The part of the filter the server can apply, see Command_SetGameFilter.
+    void getServerFilter(ServerInfo_GameFilter &filter) const;
 protected:
     bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const;
 };
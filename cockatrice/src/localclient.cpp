@@ -2,6 +2,7 @@
 #include "localserverinterface.h"
 
 #include "pb/session_commands.pb.h"
+#include "pb/serverinfo_user.pb.h"
 
 LocalClient::LocalClient(LocalServerInterface *_lsi, const QString &_playerName, QObject *parent)
     : AbstractClient(parent), lsi(_lsi)
@@ -10,6 +11,7 @@ LocalClient::LocalClient(LocalServerInterface *_lsi, const QString &_playerName,
     
     Command_Login loginCmd;
     loginCmd.set_user_name(_playerName.toStdString());
+    loginCmd.set_client_features(ServerInfo_User::FeatureMoveCards);
     sendCommand(prepareSessionCommand(loginCmd));
     
     Command_JoinRoom joinCmd;
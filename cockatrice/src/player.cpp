@@ -58,6 +58,7 @@
 #include "pb/event_dump_zone.pb.h"
 #include "pb/event_stop_dump_zone.pb.h"
 #include "pb/event_move_card.pb.h"
+#include "pb/event_move_cards.pb.h"
 #include "pb/event_flip_card.pb.h"
 #include "pb/event_destroy_card.pb.h"
 #include "pb/event_attach_card.pb.h"
@@ -1147,38 +1148,66 @@ void Player::eventStopDumpZone(const Event_StopDumpZone &event)
     emit logStopDumpZone(this, zone);
 }
 
-void Player::eventMoveCard(const Event_MoveCard &event, const GameEventContext &context)
+bool Player::getMoveZones(int startPlayerId, const std::string &startZoneName, int targetPlayerId, bool hasTargetZone, const std::string &targetZoneName, CardZone *&startZone, CardZone *&targetZone)
 {
-    Player *startPlayer = game->getPlayers().value(event.start_player_id());
+    Player *startPlayer = game->getPlayers().value(startPlayerId);
     if (!startPlayer)
-        return;
-    CardZone *startZone = startPlayer->getZones().value(QString::fromStdString(event.start_zone()), 0);
-    Player *targetPlayer = game->getPlayers().value(event.target_player_id());
+        return false;
+    startZone = startPlayer->getZones().value(QString::fromStdString(startZoneName), 0);
+    Player *targetPlayer = game->getPlayers().value(targetPlayerId);
     if (!targetPlayer)
-        return;
-    CardZone *targetZone;
-    if (event.has_target_zone())
-        targetZone = targetPlayer->getZones().value(QString::fromStdString(event.target_zone()), 0);
+        return false;
+    if (hasTargetZone)
+        targetZone = targetPlayer->getZones().value(QString::fromStdString(targetZoneName), 0);
     else
         targetZone = startZone;
-    if (!startZone || !targetZone)
+    return startZone && targetZone;
+}
+
+void Player::eventMoveCard(const Event_MoveCard &event, const GameEventContext &context)
+{
+    CardZone *startZone, *targetZone;
+    if (!getMoveZones(event.start_player_id(), event.start_zone(), event.target_player_id(), event.has_target_zone(), event.target_zone(), startZone, targetZone))
+        return;
+    
+    moveCardItem(context, startZone, targetZone, event.position(), event.card_id(), event.new_card_id(), QString::fromStdString(event.card_name()), event.face_down(), event.x(), event.y(), true);
+}
+
+void Player::eventMoveCards(const Event_MoveCards &event, const GameEventContext &context)
+{
+    CardZone *startZone, *targetZone;
+    if (!getMoveZones(event.start_player_id(), event.start_zone(), event.target_player_id(), event.has_target_zone(), event.target_zone(), startZone, targetZone))
+        return;
+    
+    const int count = event.card_id_size();
+    if ((event.card_name_size() != count) || (event.position_size() != count) || (event.x_size() != count) || (event.y_size() != count) || (event.new_card_id_size() != count) || (event.face_down_size() != count))
         return;
     
-    int position = event.position();
-    int x = event.x();
-    int y = event.y();
+    // The zones are laid out once after all cards have been moved.
+    for (int i = 0; i < count; ++i)
+        moveCardItem(context, startZone, targetZone, event.position(i), event.card_id(i), event.new_card_id(i), QString::fromStdString(event.card_name(i)), event.face_down(i), event.x(i), event.y(i), false);
+    
+    startZone->reorganizeCards();
+    if (startZone != targetZone) {
+        targetZone->reorganizeCards();
+        if (startZone == table)
+            table->resizeToContents();
+    }
+}
 
+void Player::moveCardItem(const GameEventContext &context, CardZone *startZone, CardZone *targetZone, int position, int cardId, int newCardId, const QString &cardName, bool faceDown, int x, int y, bool reorganize)
+{
     int logPosition = position;
     int logX = x;
     if (x == -1)
         x = 0;
-    CardItem *card = startZone->takeCard(position, event.card_id(), startZone != targetZone);
+    CardItem *card = startZone->takeCard(position, cardId, reorganize && (startZone != targetZone), reorganize);
     if (!card)
         return;
     if (startZone != targetZone)
         card->deleteCardInfoPopup();
-    if (event.has_card_name())
-        card->setName(QString::fromStdString(event.card_name()));
+    if (!cardName.isEmpty())
+        card->setName(cardName);
     
     if (card->getAttachedTo() && (startZone != targetZone)) {
         CardItem *parentCard = card->getAttachedTo();
@@ -1188,8 +1217,8 @@ void Player::eventMoveCard(const Event_MoveCard &event, const GameEventContext &
 
     card->deleteDragItem();
 
-    card->setId(event.new_card_id());
-    card->setFaceDown(event.face_down());
+    card->setId(newCardId);
+    card->setFaceDown(faceDown);
     if (startZone != targetZone) {
         card->setBeingPointedAt(false);
         card->setHovered(false);
@@ -1209,7 +1238,7 @@ void Player::eventMoveCard(const Event_MoveCard &event, const GameEventContext &
     else
         emit logMoveCard(this, card, startZone, logPosition, targetZone, logX);
 
-    targetZone->addCard(card, true, x, y);
+    targetZone->addCard(card, reorganize, x, y);
 
     // Look at all arrows from and to the card.
     // If the card was moved to another zone, delete the arrows, otherwise update them.
@@ -1406,6 +1435,7 @@ void Player::processGameEvent(GameEvent::GameEventType type, const GameEvent &ev
         case GameEvent::DUMP_ZONE: eventDumpZone(event.GetExtension(Event_DumpZone::ext)); break;
         case GameEvent::STOP_DUMP_ZONE: eventStopDumpZone(event.GetExtension(Event_StopDumpZone::ext)); break;
         case GameEvent::MOVE_CARD: eventMoveCard(event.GetExtension(Event_MoveCard::ext), context); break;
+        case GameEvent::MOVE_CARDS: eventMoveCards(event.GetExtension(Event_MoveCards::ext), context); break;
         case GameEvent::FLIP_CARD: eventFlipCard(event.GetExtension(Event_FlipCard::ext)); break;
         case GameEvent::DESTROY_CARD: eventDestroyCard(event.GetExtension(Event_DestroyCard::ext)); break;
         case GameEvent::ATTACH_CARD: eventAttachCard(event.GetExtension(Event_AttachCard::ext)); break;
@@ -48,6 +48,7 @@ class Event_DelCounter;
 class Event_DumpZone;
 class Event_StopDumpZone;
 class Event_MoveCard;
+class Event_MoveCards;
 class Event_FlipCard;
 class Event_DestroyCard;
 class Event_AttachCard;
@@ -228,6 +229,9 @@ private:
     void eventDumpZone(const Event_DumpZone &event);
     void eventStopDumpZone(const Event_StopDumpZone &event);
     void eventMoveCard(const Event_MoveCard &event, const GameEventContext &context);
+    void eventMoveCards(const Event_MoveCards &event, const GameEventContext &context);
+    bool getMoveZones(int startPlayerId, const std::string &startZoneName, int targetPlayerId, bool hasTargetZone, const std::string &targetZoneName, CardZone *&startZone, CardZone *&targetZone);
+    void moveCardItem(const GameEventContext &context, CardZone *startZone, CardZone *targetZone, int position, int cardId, int newCardId, const QString &cardName, bool faceDown, int x, int y, bool reorganize);
     void eventFlipCard(const Event_FlipCard &event);
     void eventDestroyCard(const Event_DestroyCard &event);
     void eventAttachCard(const Event_AttachCard &event);
@@ -8,6 +8,7 @@
 #include "pb/response_login.pb.h"
 #include "pb/server_message.pb.h"
 #include "pb/event_server_identification.pb.h"
+#include "pb/serverinfo_user.pb.h"
 
 static const unsigned int protocolVersion = 14;
 
@@ -28,6 +29,7 @@ RemoteClient::RemoteClient(QObject *parent)
     connect(this, SIGNAL(connectionClosedEventReceived(Event_ConnectionClosed)), this, SLOT(processConnectionClosedEvent(Event_ConnectionClosed)));
     connect(this, SIGNAL(sigConnectToServer(QString, unsigned int, QString, QString)), this, SLOT(doConnectToServer(QString, unsigned int, QString, QString)));
     connect(this, SIGNAL(sigDisconnectFromServer()), this, SLOT(doDisconnectFromServer()));
+    connect(this, SIGNAL(sigReconnectToServer(QString, unsigned int)), this, SLOT(doReconnectToServer(QString, unsigned int)));
 }
 
 RemoteClient::~RemoteClient()
@@ -68,6 +70,7 @@ void RemoteClient::processServerIdentificationEvent(const Event_ServerIdentifica
     Command_Login cmdLogin;
     cmdLogin.set_user_name(userName.toStdString());
     cmdLogin.set_password(password.toStdString());
+    cmdLogin.set_client_features(ServerInfo_User::FeatureMoveCards);
     
     PendingCommand *pend = prepareSessionCommand(cmdLogin);
     connect(pend, SIGNAL(finished(Response, CommandContainer, QVariant)), this, SLOT(loginResponse(Response)));
@@ -175,6 +178,11 @@ void RemoteClient::doConnectToServer(const QString &hostname, unsigned int port,
     setStatus(StatusConnecting);
 }
 
+void RemoteClient::doReconnectToServer(const QString &hostname, unsigned int port)
+{
+    doConnectToServer(hostname, port, userName, password);
+}
+
 void RemoteClient::doDisconnectFromServer()
 {
     timer->stop();
@@ -229,3 +237,8 @@ void RemoteClient::disconnectFromServer()
 {
     emit sigDisconnectFromServer();
 }
+
+void RemoteClient::reconnectToServer(const QString &hostname, unsigned int port)
+{
+    emit sigReconnectToServer(hostname, port);
+}
@@ -17,6 +17,7 @@ signals:
     void protocolError();
     void sigConnectToServer(const QString &hostname, unsigned int port, const QString &_userName, const QString &_password);
     void sigDisconnectFromServer();
+    void sigReconnectToServer(const QString &hostname, unsigned int port);
 private slots:
     void slotConnected();
     void readData();
@@ -27,6 +28,7 @@ private slots:
     void loginResponse(const Response &response);
     void doConnectToServer(const QString &hostname, unsigned int port, const QString &_userName, const QString &_password);
     void doDisconnectFromServer();
+    void doReconnectToServer(const QString &hostname, unsigned int port);
 private:
     static const int maxTimeout = 10;
     int timeRunning, lastDataReceived;
@@ -46,6 +48,8 @@ public:
     QString peerName() const { return socket->peerName(); }
     void connectToServer(const QString &hostname, unsigned int port, const QString &_userName, const QString &_password);
     void disconnectFromServer();
+    // Connects with the user name and password of the previous connection.
+    void reconnectToServer(const QString &hostname, unsigned int port);
 };
 
 #endif
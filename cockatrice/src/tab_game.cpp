@@ -32,7 +32,6 @@
 #include "carddatabase.h"
 #include "replay_timeline_widget.h"
 
-#include <google/protobuf/descriptor.h>
 #include "pending_command.h"
 #include "pb/game_replay.pb.h"
 #include "pb/command_concede.pb.h"
@@ -840,7 +839,7 @@ PendingCommand *TabGame::prepareGameCommand(const ::google::protobuf::Message &c
     CommandContainer cont;
     cont.set_game_id(gameInfo.game_id());
     GameCommand *c = cont.add_game_command();
-    c->GetReflection()->MutableMessage(c, cmd.GetDescriptor()->FindExtensionByName("ext"))->CopyFrom(cmd);
+    setPbExtension(*c, cmd);
     return new PendingCommand(cont);
 }
 
@@ -850,7 +849,7 @@ PendingCommand *TabGame::prepareGameCommand(const QList< const ::google::protobu
     cont.set_game_id(gameInfo.game_id());
     for (int i = 0; i < cmdList.size(); ++i) {
         GameCommand *c = cont.add_game_command();
-        c->GetReflection()->MutableMessage(c, cmdList[i]->GetDescriptor()->FindExtensionByName("ext"))->CopyFrom(*cmdList[i]);
+        setPbExtension(*c, *cmdList[i]);
         delete cmdList[i];
     }
     return new PendingCommand(cont);
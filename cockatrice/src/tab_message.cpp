@@ -88,6 +88,8 @@ void TabMessage::messageSent(const Response &response)
 {
     if (response.response_code() == Response::RespInIgnoreList)
         chatView->appendMessage(tr("This user is ignoring you."));
+    else if (response.response_code() == Response::RespChatFlood)
+        chatView->appendMessage(tr("You are sending too many messages. Please wait a couple of seconds."));
 }
 
 void TabMessage::actLeave()
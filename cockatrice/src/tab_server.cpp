@@ -13,6 +13,7 @@
 #include "abstractclient.h"
 #include "userlist.h"
 #include "userinfobox.h"
+#include "gamesmodel.h"
 #include <QDebug>
 
 #include "pending_command.h"
@@ -105,6 +106,9 @@ void RoomSelector::joinRoom(int id, bool setCurrent)
 {
     Command_JoinRoom cmd;
     cmd.set_room_id(id);
+    // Only list the games a new game selector would show, see GameSelector::sendGameFilter().
+    GamesProxyModel gameFilter;
+    gameFilter.getServerFilter(*cmd.mutable_game_filter());
     
     PendingCommand *pend = client->prepareSessionCommand(cmd);
     pend->setExtraData(setCurrent);
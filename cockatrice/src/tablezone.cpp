@@ -213,9 +213,9 @@ void TableZone::toggleTapped()
     player->sendGameCommand(player->prepareGameCommand(cmdList));
 }
 
-CardItem *TableZone::takeCard(int position, int cardId, bool canResize)
+CardItem *TableZone::takeCard(int position, int cardId, bool canResize, bool reorganize)
 {
-    CardItem *result = CardZone::takeCard(position, cardId);
+    CardItem *result = CardZone::takeCard(position, cardId, canResize, reorganize);
     if (canResize)
         resizeToContents();
     return result;
@@ -37,7 +37,7 @@ public:
     QPointF mapFromGrid(QPoint gridPoint) const;
     QPoint mapToGrid(const QPointF &mapPoint) const;
     QPointF closestGridPoint(const QPointF &point);
-    CardItem *takeCard(int position, int cardId, bool canResize = true);
+    CardItem *takeCard(int position, int cardId, bool canResize = true, bool reorganize = true);
     void resizeToContents();
     int getMinimumWidth() const { return currentMinimumWidth; }
     void setWidth(qreal _width);
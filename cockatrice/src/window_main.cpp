@@ -47,6 +47,7 @@
 #include "pb/room_commands.pb.h"
 #include "pb/event_connection_closed.pb.h"
 #include "pb/event_server_shutdown.pb.h"
+#include "pb/event_game_migrated.pb.h"
 
 const QString MainWindow::appName = "Cockatrice";
 
@@ -62,6 +63,13 @@ void MainWindow::updateTabMenu(const QList<QMenu *> &newMenuList)
 void MainWindow::processConnectionClosedEvent(const Event_ConnectionClosed &event)
 {
     client->disconnectFromServer();
+    if ((event.reason() == Event_ConnectionClosed::SERVER_SHUTDOWN) && !migratedGameHost.isEmpty()) {
+        const QString host = migratedGameHost;
+        migratedGameHost.clear();
+        if (QMessageBox::question(this, tr("Connection closed"), tr("The server has been shut down, but your game continues on %1.\nDo you want to connect to %1 to resume it?").arg(migratedGameServerName), QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes)
+            client->reconnectToServer(host, migratedGamePort);
+        return;
+    }
     QString reasonStr;
     switch (event.reason()) {
         case Event_ConnectionClosed::TOO_MANY_CONNECTIONS: reasonStr = tr("There are too many concurrent connections from your address."); break;
@@ -87,11 +95,21 @@ void MainWindow::processServerShutdownEvent(const Event_ServerShutdown &event)
     QMessageBox::information(this, tr("Scheduled server shutdown"), tr("The server is going to be restarted in %n minute(s).\nAll running games will be lost.\nReason for shutdown: %1", "", event.minutes()).arg(QString::fromStdString(event.reason())));
 }
 
+void MainWindow::processGameMigratedEvent(const Event_GameMigrated &event)
+{
+    migratedGameServerName = QString::fromStdString(event.server_name());
+    migratedGameHost = QString::fromStdString(event.host());
+    migratedGamePort = event.port();
+    if (migratedGameServerName.isEmpty())
+        migratedGameServerName = migratedGameHost;
+}
+
 void MainWindow::statusChanged(ClientStatus _status)
 {
     setClientStatusTitle();
     switch (_status) {
         case StatusConnecting:
+            migratedGameHost.clear();
             break;
         case StatusDisconnected:
             tabSupervisor->stop();
@@ -358,13 +376,14 @@ void MainWindow::createMenus()
 }
 
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), localServer(0)
+    : QMainWindow(parent), localServer(0), migratedGamePort(0)
 {
     QPixmapCache::setCacheLimit(200000);
 
     client = new RemoteClient;
     connect(client, SIGNAL(connectionClosedEventReceived(const Event_ConnectionClosed &)), this, SLOT(processConnectionClosedEvent(const Event_ConnectionClosed &)));
     connect(client, SIGNAL(serverShutdownEventReceived(const Event_ServerShutdown &)), this, SLOT(processServerShutdownEvent(const Event_ServerShutdown &)));
+    connect(client, SIGNAL(gameMigratedEventReceived(const Event_GameMigrated &)), this, SLOT(processGameMigratedEvent(const Event_GameMigrated &)));
     connect(client, SIGNAL(loginError(Response::ResponseCode, QString, quint32)), this, SLOT(loginError(Response::ResponseCode, QString, quint32)));
     connect(client, SIGNAL(socketError(const QString &)), this, SLOT(socketError(const QString &)));
     connect(client, SIGNAL(serverTimeout()), this, SLOT(serverTimeout()));
@@ -38,6 +38,7 @@ private slots:
     void statusChanged(ClientStatus _status);
     void processConnectionClosedEvent(const Event_ConnectionClosed &event);
     void processServerShutdownEvent(const Event_ServerShutdown &event);
+    void processGameMigratedEvent(const Event_GameMigrated &event);
     void serverTimeout();
     void loginError(Response::ResponseCode r, QString reasonStr, quint32 endTime);
     void socketError(const QString &errorStr);
@@ -71,6 +72,10 @@ private:
     QThread *clientThread;
     
     LocalServer *localServer;
+    
+    // Where a game of ours went, to follow it when this server shuts down.
+    QString migratedGameServerName, migratedGameHost;
+    unsigned int migratedGamePort;
 public:
     MainWindow(QWidget *parent = 0);
     ~MainWindow();
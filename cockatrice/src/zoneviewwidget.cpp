@@ -138,6 +138,7 @@ ZoneViewWidget::ZoneViewWidget(Player *_player, CardZone *_origZone, int numberC
     
     connect(zone, SIGNAL(optimumRectChanged()), this, SLOT(resizeToZoneContents()));
     connect(zone, SIGNAL(beingDeleted()), this, SLOT(zoneDeleted()));
+    connect(zone, SIGNAL(dumpFailed()), this, SLOT(close()));
     zone->initializeCards(cardList);
 }
 
@@ -178,6 +179,7 @@ void ZoneViewWidget::resizeToZoneContents()
     
     if (layout())
         layout()->invalidate();
+    zone->fetchVisibleCards(QRectF(0, scrollBar->value(), zoneRect.width(), zoneRect.height()));
 }
 
 void ZoneViewWidget::handleWheelEvent(QGraphicsSceneWheelEvent *event)
@@ -189,6 +191,7 @@ void ZoneViewWidget::handleWheelEvent(QGraphicsSceneWheelEvent *event)
 void ZoneViewWidget::handleScrollBarChange(int value)
 {
     zone->setY(-value);
+    zone->fetchVisibleCards(QRectF(0, value, zoneContainer->size().width(), zoneContainer->size().height()));
 }
 
 void ZoneViewWidget::closeEvent(QCloseEvent *event)
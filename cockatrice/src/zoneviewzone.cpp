@@ -11,8 +11,11 @@
 #include "pb/response_dump_zone.pb.h"
 #include "pending_command.h"
 
+// Number of cards fetched per Command_DumpZone when a zone is not known to the client.
+const int ZONE_DUMP_PAGE_SIZE = 60;
+
 ZoneViewZone::ZoneViewZone(Player *_p, CardZone *_origZone, int _numberCards, bool _revealZone, bool _writeableRevealZone, QGraphicsItem *parent)
-    : SelectZone(_p, _origZone->getName(), false, false, true, parent, true), bRect(QRectF()), minRows(0), numberCards(_numberCards), origZone(_origZone), revealZone(_revealZone), writeableRevealZone(_writeableRevealZone), sortByName(false), sortByType(false)
+    : SelectZone(_p, _origZone->getName(), false, false, true, parent, true), bRect(QRectF()), minRows(0), layoutRows(1), numberCards(_numberCards), origZone(_origZone), revealZone(_revealZone), writeableRevealZone(_writeableRevealZone), sortByName(false), sortByType(false)
 {
     if (!(revealZone && !writeableRevealZone))
         origZone->setView(this);
@@ -42,14 +45,7 @@ void ZoneViewZone::initializeCards(const QList<const ServerInfo_Card *> &cardLis
             addCard(new CardItem(player, QString::fromStdString(cardList[i]->name()), cardList[i]->id(), revealZone, this), false, i);
         reorganizeCards();
     } else if (!origZone->contentsKnown()) {
-        Command_DumpZone cmd;
-        cmd.set_player_id(player->getId());
-        cmd.set_zone_name(name.toStdString());
-        cmd.set_number_cards(numberCards);
-        
-        PendingCommand *pend = player->prepareGameCommand(cmd);
-        connect(pend, SIGNAL(finished(Response, CommandContainer, QVariant)), this, SLOT(zoneDumpReceived(const Response &)));
-        player->sendGameCommand(pend);
+        requestCards(0, ZONE_DUMP_PAGE_SIZE);
     } else {
         const CardList &c = origZone->getCards();
         int number = numberCards == -1 ? c.size() : (numberCards < c.size() ? numberCards : c.size());
@@ -61,14 +57,91 @@ void ZoneViewZone::initializeCards(const QList<const ServerInfo_Card *> &cardLis
     }
 }
 
-void ZoneViewZone::zoneDumpReceived(const Response &r)
+void ZoneViewZone::requestCards(int start, int count)
 {
+    Command_DumpZone cmd;
+    cmd.set_player_id(player->getId());
+    cmd.set_zone_name(name.toStdString());
+    cmd.set_number_cards(numberCards);
+    cmd.set_start(start);
+    cmd.set_max_cards(count);
+    
+    PendingCommand *pend = player->prepareGameCommand(cmd);
+    pend->setExtraData(start);
+    connect(pend, SIGNAL(finished(Response, CommandContainer, QVariant)), this, SLOT(zoneDumpReceived(Response, CommandContainer, QVariant)));
+    player->sendGameCommand(pend);
+}
+
+// Requests the placeholders between first and last that have not been requested yet, one command per run.
+void ZoneViewZone::requestCardRange(int first, int last)
+{
+    if (last >= cards.size())
+        last = cards.size() - 1;
+    int runStart = -1;
+    for (int i = qMax(first, 0); i <= last + 1; ++i) {
+        if ((i <= last) && unrequestedCards.remove(cards[i])) {
+            if (runStart == -1)
+                runStart = i;
+        } else if (runStart != -1) {
+            requestCards(runStart, i - runStart);
+            runStart = -1;
+        }
+    }
+}
+
+void ZoneViewZone::fetchVisibleCards(const QRectF &visibleRect)
+{
+    if (unrequestedCards.isEmpty())
+        return;
+    
+    // Sorting needs every name.
+    if (sortByName || sortByType) {
+        requestCardRange(0, cards.size() - 1);
+        return;
+    }
+    
+    // Cards are laid out in columns of layoutRows, see reorganizeCards().
+    const qreal rowHeight = CARD_HEIGHT / 3.0;
+    const int firstRow = qMax(0, (int) ((visibleRect.top() - 5 - CARD_HEIGHT) / rowHeight));
+    const int lastRow = qMin(layoutRows - 1, (int) ((visibleRect.bottom() - 5) / rowHeight));
+    for (int column = 0; column * layoutRows < cards.size(); ++column)
+        requestCardRange(column * layoutRows + firstRow, column * layoutRows + lastRow);
+}
+
+void ZoneViewZone::zoneDumpReceived(const Response &r, const CommandContainer & /*commandContainer*/, const QVariant &extraData)
+{
+    // Without its cards the view would stay empty or keep placeholders for good.
+    if (r.response_code() != Response::RespOk) {
+        emit dumpFailed();
+        return;
+    }
+    
     const Response_DumpZone &resp = r.GetExtension(Response_DumpZone::ext);
+    const int start = extraData.toInt();
     const int respCardListSize = resp.zone_info().card_list_size();
-    for (int i = 0; i < respCardListSize; ++i) {
-        const ServerInfo_Card &cardInfo = resp.zone_info().card_list(i);
-        CardItem *card = new CardItem(player, QString::fromStdString(cardInfo.name()), cardInfo.id(), revealZone, this);
-        addCard(card, false, i);
+    if (start == 0) {
+        for (int i = 0; i < respCardListSize; ++i) {
+            const ServerInfo_Card &cardInfo = resp.zone_info().card_list(i);
+            CardItem *card = new CardItem(player, QString::fromStdString(cardInfo.name()), cardInfo.id(), revealZone, this);
+            addCard(card, false, i);
+        }
+        if (resp.next_start() != -1) {
+            int totalCards = origZone->getCards().size();
+            if ((numberCards != -1) && (numberCards < totalCards))
+                totalCards = numberCards;
+            for (int i = respCardListSize; i < totalCards; ++i) {
+                CardItem *card = new CardItem(player, QString(), i, revealZone, this);
+                addCard(card, false, i);
+                placeholderCards.insert(card);
+                unrequestedCards.insert(card);
+            }
+        }
+    } else {
+        for (int i = 0; (i < respCardListSize) && (start + i < cards.size()); ++i) {
+            CardItem *card = cards[start + i];
+            if (placeholderCards.remove(card))
+                card->setName(QString::fromStdString(resp.zone_info().card_list(i).name()));
+        }
     }
     
     reorganizeCards();
@@ -96,6 +169,7 @@ void ZoneViewZone::reorganizeCards()
     }
     if (cols < 2)
         cols = 2;
+    layoutRows = rows;
     
     qDebug() << "reorganizeCards: rows=" << rows << "cols=" << cols;
 
@@ -119,12 +193,16 @@ void ZoneViewZone::reorganizeCards()
 void ZoneViewZone::setSortByName(int _sortByName)
 {
     sortByName = _sortByName;
+    if (sortByName)
+        requestCardRange(0, cards.size() - 1);
     reorganizeCards();
 }
 
 void ZoneViewZone::setSortByType(int _sortByType)
 {
     sortByType = _sortByType;
+    if (sortByType)
+        requestCardRange(0, cards.size() - 1);
     reorganizeCards();
 }
 
@@ -157,6 +235,8 @@ void ZoneViewZone::removeCard(int position)
         return;
 
     CardItem *card = cards.takeAt(position);
+    placeholderCards.remove(card);
+    unrequestedCards.remove(card);
     card->deleteLater();
     reorganizeCards();
 }
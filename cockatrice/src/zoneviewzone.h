@@ -3,9 +3,11 @@
 
 #include "selectzone.h"
 #include <QGraphicsLayoutItem>
+#include <QSet>
 
 class ZoneViewWidget;
 class Response;
+class CommandContainer;
 class ServerInfo_Card;
 class QGraphicsSceneWheelEvent;
 
@@ -14,11 +16,16 @@ class ZoneViewZone : public SelectZone, public QGraphicsLayoutItem {
     Q_INTERFACES(QGraphicsLayoutItem)
 private:
     QRectF bRect, optimumRect;
-    int minRows, numberCards;
+    int minRows, layoutRows, numberCards;
     void handleDropEvent(const QList<CardDragItem *> &dragItems, CardZone *startZone, const QPoint &dropPoint);
     CardZone *origZone;
     bool revealZone, writeableRevealZone;
     bool sortByName, sortByType;
+    // Large zones are dumped in pages: cards beyond the first page are shown as
+    // placeholders until they are scrolled into view.
+    QSet<CardItem *> placeholderCards, unrequestedCards;
+    void requestCards(int start, int count);
+    void requestCardRange(int first, int last);
 public:
     ZoneViewZone(Player *_p, CardZone *_origZone, int _numberCards = -1, bool _revealZone = false, bool _writeableRevealZone = false, QGraphicsItem *parent = 0);
     ~ZoneViewZone();
@@ -33,13 +40,15 @@ public:
     bool getRevealZone() const { return revealZone; }
     bool getWriteableRevealZone() const { return writeableRevealZone; }
     void setWriteableRevealZone(bool _writeableRevealZone);
+    void fetchVisibleCards(const QRectF &visibleRect);
 public slots:
     void setSortByName(int _sortByName);
     void setSortByType(int _sortByType);
 private slots:
-    void zoneDumpReceived(const Response &r);
+    void zoneDumpReceived(const Response &r, const CommandContainer &commandContainer, const QVariant &extraData);
 signals:
     void beingDeleted();
+    void dumpFailed();
     void optimumRectChanged();
     void wheelEventReceived(QGraphicsSceneWheelEvent *event);
 protected:
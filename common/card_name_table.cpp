@@ -0,0 +1,108 @@
+#include "card_name_table.h"
+#include <QAtomicPointer>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+#include <QDebug>
+
+// Entries live in chunks that are never moved or freed, so getName() can read them
+// without a lock. A chunk is published before any of its ids is handed out.
+static const int cardNameChunkBits = 10;
+static const int cardNameChunkSize = 1 << cardNameChunkBits;
+static const int maxCardNameChunks = 16384;
+
+struct CardNameEntry {
+	QString name;
+	int refCount;
+	CardNameEntry() : refCount(0) { }
+};
+
+static QAtomicPointer<CardNameEntry> cardNameChunks[maxCardNameChunks];
+// Everything below is guarded by cardNameMutex.
+static QMutex cardNameMutex;
+static QHash<QString, int> cardNameIds;
+static QVector<int> freeCardNameIds;
+static int cardNameIdCount = 0;
+
+static inline CardNameEntry &cardNameEntry(int id)
+{
+	CardNameEntry *chunk = cardNameChunks[(id - 1) >> cardNameChunkBits];
+	return chunk[(id - 1) & (cardNameChunkSize - 1)];
+}
+
+int CardNameTable::acquire(const QString &name)
+{
+	if (name.isEmpty())
+		return 0;
+	
+	QMutexLocker locker(&cardNameMutex);
+	int id = cardNameIds.value(name, -1);
+	if (id == -1) {
+		if (!freeCardNameIds.isEmpty()) {
+			id = freeCardNameIds.last();
+			freeCardNameIds.removeLast();
+		} else {
+			if (cardNameIdCount == maxCardNameChunks * cardNameChunkSize) {
+				qDebug() << "CardNameTable: table full";
+				return 0;
+			}
+			id = ++cardNameIdCount;
+			const int chunk = (id - 1) >> cardNameChunkBits;
+			if (!cardNameChunks[chunk])
+				cardNameChunks[chunk].fetchAndStoreRelease(new CardNameEntry[cardNameChunkSize]);
+		}
+		cardNameEntry(id).name = name;
+		cardNameIds.insert(name, id);
+	}
+	++cardNameEntry(id).refCount;
+	return id;
+}
+
+int CardNameTable::addReference(int id)
+{
+	if (id <= 0)
+		return id;
+	
+	QMutexLocker locker(&cardNameMutex);
+	++cardNameEntry(id).refCount;
+	return id;
+}
+
+void CardNameTable::release(int id)
+{
+	if (id <= 0)
+		return;
+	
+	QMutexLocker locker(&cardNameMutex);
+	CardNameEntry &entry = cardNameEntry(id);
+	if (--entry.refCount > 0)
+		return;
+	cardNameIds.remove(entry.name);
+	entry.name = QString();
+	freeCardNameIds.append(id);
+}
+
+int CardNameTable::findId(const QString &name)
+{
+	if (name.isEmpty())
+		return 0;
+	
+	QMutexLocker locker(&cardNameMutex);
+	return cardNameIds.value(name, -1);
+}
+
+QString CardNameTable::getName(int id)
+{
+	if ((id <= 0) || (id > maxCardNameChunks * cardNameChunkSize))
+		return QString();
+	CardNameEntry *chunk = cardNameChunks[(id - 1) >> cardNameChunkBits];
+	if (!chunk)
+		return QString();
+	return chunk[(id - 1) & (cardNameChunkSize - 1)].name;
+}
+
+int CardNameTable::getSize()
+{
+	QMutexLocker locker(&cardNameMutex);
+	return cardNameIds.size();
+}
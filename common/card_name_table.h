@@ -0,0 +1,26 @@
+#ifndef CARD_NAME_TABLE_H
+#define CARD_NAME_TABLE_H
+
+#include <QString>
+
+// Process-wide table of card names. Every name in use is stored once and gets a
+// small id, so cards can be compared by id and share the string. Names are
+// reference counted, the id of a name nobody holds any more is reused.
+// Id 0 is the empty name.
+class CardNameTable {
+public:
+	// Adds a reference to a name and returns its id.
+	static int acquire(const QString &name);
+	// Adds a reference to an id the caller already holds and returns it.
+	static int addReference(int id);
+	static void release(int id);
+	// Returns -1 for names nobody holds.
+	static int findId(const QString &name);
+	// Does not lock. Only call it for ids the caller holds a reference to.
+	static QString getName(int id);
+	// Keeps a reference for good, for names that live as long as the process.
+	static QString intern(const QString &name) { return getName(acquire(name)); }
+	static int getSize();
+};
+
+#endif
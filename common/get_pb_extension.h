@@ -1,12 +1,15 @@
 #ifndef GET_PB_EXTENSION_H
 #define GET_PB_EXTENSION_H
 
+#include "pb/pb_extensions.h"
+
 namespace google {
 	namespace protobuf {
 		class Message;
 	}
 }
 
+// Reflection based fallback for messages without a generated overload in pb_extensions.h.
 int getPbExtension(const ::google::protobuf::Message &message);
 
 #endif
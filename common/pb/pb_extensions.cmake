@@ -0,0 +1,79 @@
+# Generates pb_extensions.h and pb_extensions.cpp with typed accessors for the
+# extensions (the "ext" fields) declared in the .proto files of this directory.
+# Both test the container's extensions one by one through the typed protobuf API
+# (HasExtension() and the message type), so no reflection runs when they succeed.
+#
+# Usage: cmake -DPROTO_DIR=<dir with .proto files> -DOUTPUT_DIR=<dir> -P pb_extensions.cmake
+
+file(GLOB PROTO_FILES RELATIVE "${PROTO_DIR}" "${PROTO_DIR}/*.proto")
+list(SORT PROTO_FILES)
+
+set(NAME "[A-Za-z0-9_]+")
+set(SPACE "[ \t\r\n]*")
+set(CONTAINERS)
+set(HEADERS)
+foreach(PROTO_FILE ${PROTO_FILES})
+    file(READ "${PROTO_DIR}/${PROTO_FILE}" CONTENT)
+    string(REGEX MATCHALL "message${SPACE}${NAME}${SPACE}{${SPACE}extend${SPACE}${NAME}${SPACE}{${SPACE}optional${SPACE}${NAME}${SPACE}ext${SPACE}=" EXTENSIONS "${CONTENT}")
+    if(EXTENSIONS)
+        string(REPLACE ".proto" ".pb.h" HEADER "${PROTO_FILE}")
+        list(APPEND HEADERS ${HEADER})
+    endif(EXTENSIONS)
+    foreach(EXTENSION ${EXTENSIONS})
+        string(REGEX REPLACE "^message${SPACE}(${NAME}).*$" "\\1" MESSAGE "${EXTENSION}")
+        string(REGEX REPLACE "^.*extend${SPACE}(${NAME}).*$" "\\1" CONTAINER "${EXTENSION}")
+        list(APPEND CONTAINERS ${CONTAINER})
+        list(APPEND EXTENSIONS_${CONTAINER} ${MESSAGE})
+    endforeach(EXTENSION)
+endforeach(PROTO_FILE)
+list(REMOVE_DUPLICATES CONTAINERS)
+list(SORT CONTAINERS)
+
+set(GENERATED_NOTE "// Generated by pb_extensions.cmake from the .proto files, do not edit.\n")
+
+# Header
+set(OUT "${GENERATED_NOTE}#ifndef PB_EXTENSIONS_H\n#define PB_EXTENSIONS_H\n\n")
+set(OUT "${OUT}namespace google {\n\tnamespace protobuf {\n\t\tclass Message;\n\t}\n}\n\n")
+foreach(CONTAINER ${CONTAINERS})
+    set(OUT "${OUT}class ${CONTAINER};\n")
+endforeach(CONTAINER)
+set(OUT "${OUT}\n// Field number of the extension set in a container, -1 if there is none.\n")
+foreach(CONTAINER ${CONTAINERS})
+    set(OUT "${OUT}int getPbExtension(const ${CONTAINER} &container);\n")
+endforeach(CONTAINER)
+set(OUT "${OUT}\n// Copies a message into the matching extension of a container. Returns false, and fails in\n// debug builds, if the message is not an extension of the container.\n")
+foreach(CONTAINER ${CONTAINERS})
+    set(OUT "${OUT}bool setPbExtension(${CONTAINER} &container, const ::google::protobuf::Message &extension);\n")
+endforeach(CONTAINER)
+set(OUT "${OUT}\n#endif\n")
+file(WRITE "${OUTPUT_DIR}/pb_extensions.h.tmp" "${OUT}")
+
+# Source
+set(OUT "${GENERATED_NOTE}#include \"pb_extensions.h\"\n")
+foreach(HEADER ${HEADERS})
+    set(OUT "${OUT}#include \"${HEADER}\"\n")
+endforeach(HEADER)
+set(OUT "${OUT}#include <google/protobuf/message.h>\n#include <typeinfo>\n")
+set(OUT "${OUT}\nstatic bool notAnExtension(const ::google::protobuf::Message &container, const ::google::protobuf::Message &extension)\n{\n")
+set(OUT "${OUT}\tGOOGLE_LOG(DFATAL) << extension.GetTypeName() << \" is not an extension of \" << container.GetTypeName();\n")
+set(OUT "${OUT}\treturn false;\n}\n")
+foreach(CONTAINER ${CONTAINERS})
+    set(OUT "${OUT}\nint getPbExtension(const ${CONTAINER} &container)\n{\n")
+    foreach(MESSAGE ${EXTENSIONS_${CONTAINER}})
+        set(OUT "${OUT}\tif (container.HasExtension(${MESSAGE}::ext))\n\t\treturn ${MESSAGE}::kExtFieldNumber;\n")
+    endforeach(MESSAGE)
+    set(OUT "${OUT}\treturn -1;\n}\n")
+
+    set(OUT "${OUT}\nbool setPbExtension(${CONTAINER} &container, const ::google::protobuf::Message &extension)\n{\n")
+    set(OUT "${OUT}\tconst std::type_info &type = typeid(extension);\n")
+    foreach(MESSAGE ${EXTENSIONS_${CONTAINER}})
+        set(OUT "${OUT}\tif (type == typeid(${MESSAGE})) {\n\t\tcontainer.MutableExtension(${MESSAGE}::ext)->CopyFrom(static_cast<const ${MESSAGE} &>(extension));\n\t\treturn true;\n\t}\n")
+    endforeach(MESSAGE)
+    set(OUT "${OUT}\treturn notAnExtension(container, extension);\n}\n")
+endforeach(CONTAINER)
+file(WRITE "${OUTPUT_DIR}/pb_extensions.cpp.tmp" "${OUT}")
+
+# Only touch the outputs if they changed, to avoid needless rebuilds.
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different "${OUTPUT_DIR}/pb_extensions.h.tmp" "${OUTPUT_DIR}/pb_extensions.h")
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different "${OUTPUT_DIR}/pb_extensions.cpp.tmp" "${OUTPUT_DIR}/pb_extensions.cpp")
+file(REMOVE "${OUTPUT_DIR}/pb_extensions.h.tmp" "${OUTPUT_DIR}/pb_extensions.cpp.tmp")
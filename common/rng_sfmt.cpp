@@ -10,11 +10,35 @@
 #define UINT64_MAX (~(uint64_t)0)
 #endif
 
-RNG_SFMT::RNG_SFMT(QObject *parent)
-	: RNG_Abstract(parent)
+RNG_SFMT::RNG_SFMT(QObject *parent, uint32_t _masterSeed)
+	: RNG_Abstract(parent), masterSeed(_masterSeed), nextStreamId(0)
 {
-	// initialize the random number generator with a 32bit integer seed (timestamp)
-	sfmt_init_gen_rand(&sfmt, QDateTime::currentDateTime().toTime_t());
+	// the per-thread generators are seeded from a 32bit integer (timestamp by default)
+	if (!masterSeed)
+		masterSeed = QDateTime::currentDateTime().toTime_t();
+}
+
+RNG_SFMT::ThreadState *RNG_SFMT::getThreadState()
+{
+	ThreadState *state = threadStates.localData();
+	if (!state) {
+		state = new ThreadState;
+		uint32_t key[2] = { masterSeed, (uint32_t) nextStreamId.fetchAndAddRelaxed(1) };
+		sfmt_init_by_array(&state->sfmt, key, 2);
+		state->pos = bufferSize;
+		threadStates.setLocalData(state);
+	}
+	return state;
+}
+
+uint64_t RNG_SFMT::next(ThreadState *state)
+{
+	if (state->pos == bufferSize) {
+		sfmt_fill_array64(&state->sfmt, state->buffer[0].u64, bufferSize);
+		state->pos = 0;
+	}
+	const int pos = state->pos++;
+	return state->buffer[pos / 2].u64[pos % 2];
 }
 
 /**
@@ -57,7 +81,8 @@ unsigned int RNG_SFMT::rand(int min, int max) {
 
 /**
  * Much thought went into this, please read this comment before you modify the code.
- * Let SFMT() be an alias for sfmt_genrand_uint64() aka SFMT's rand() function.
+ * Let SFMT() be an alias for next(), which returns the next number generated by SFMT
+ * for the calling thread.
  *
  * SMFT() returns a uniformly distributed pseudorandom number from 0 to UINT64_MAX.
  * As SFMT() operates on a limited integer range, it is a _discrete_ function.
@@ -121,14 +146,12 @@ unsigned int RNG_SFMT::cdf(unsigned int min, unsigned int max)
 	// If there was no remainder in the previous step, limit is equal to UINT64_MAX.
 	const uint64_t limit = diameter * buckets;
 
+	// The generator state belongs to the calling thread, so no locking is needed.
+	ThreadState *state = getThreadState();
 	uint64_t rand;
-	// To make the random number generation thread-safe, a mutex is created around
-	// the generation. Outside of the loop of course, to avoid lock/unlock overhead.
-	mutex.lock();
 	do {
-		rand = sfmt_genrand_uint64(&sfmt);
+		rand = next(state);
 	} while (rand >= limit);
-	mutex.unlock();
 
 	// Now determine the bucket containing the SFMT() random number and after adding
 	// the lower bound, a random number from [min, max] can be returned.
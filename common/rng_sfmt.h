@@ -2,7 +2,8 @@
 #define RNG_SFMT_H
 
 #include <climits>
-#include <QMutex>
+#include <QAtomicInt>
+#include <QThreadStorage>
 #include "sfmt/SFMT.h"
 #include "rng_abstract.h"
 
@@ -23,19 +24,37 @@
  * These are mapped to values from the interval [min, max] without bias by using Knuth's
  * "Algorithm S (Selection sampling technique)" from "The Art of Computer Programming 3rd
  * Edition Volume 2 / Seminumerical Algorithms".
+ *
+ * Each thread gets its own SFMT state, seeded from the master seed and a stream number,
+ * and takes its numbers from a buffer that is refilled in blocks by sfmt_fill_array64().
  */
 
 class RNG_SFMT : public RNG_Abstract {
 	Q_OBJECT
 private:
-	QMutex mutex;
-	sfmt_t sfmt;
+	// Numbers generated per sfmt_fill_array64() call; even and at least SFMT_N64.
+	static const int bufferSize = 1024;
+	// Every thread has its own generator, so no locking is needed.
+	struct ThreadState {
+		sfmt_t sfmt;
+		w128_t buffer[bufferSize / 2];
+		int pos;
+	};
+	uint32_t masterSeed;
+	QAtomicInt nextStreamId;
+	QThreadStorage<ThreadState *> threadStates;
+	
+	ThreadState *getThreadState();
+	uint64_t next(ThreadState *state);
 	// The discrete cumulative distribution function for the RNG
 	unsigned int cdf(unsigned int min, unsigned int max);
 public:
-	RNG_SFMT(QObject *parent = 0);
+	// A master seed of 0 is replaced by the current time.
+	RNG_SFMT(QObject *parent = 0, uint32_t _masterSeed = 0);
 	unsigned int rand(int min, int max);
+	uint32_t getMasterSeed() const { return masterSeed; }
+	// Number of threads that have used the RNG so far.
+	int getStreamCount() const { return nextStreamId; }
 };
 
 #endif
- 
@@ -30,6 +30,7 @@
 #include "pb/event_user_left.pb.h"
 #include "pb/event_list_rooms.pb.h"
 #include "pb/session_event.pb.h"
+#include "pb/event_game_migrated.pb.h"
 #include "pb/isl_message.pb.h"
 #include <QCoreApplication>
 #include <QThread>
@@ -46,12 +47,20 @@ Server::Server(bool _threaded, QObject *parent)
 	qRegisterMetaType<GameEventContainer>("GameEventContainer");
 	qRegisterMetaType<IslMessage>("IslMessage");
 	qRegisterMetaType<Command_JoinGame>("Command_JoinGame");
+	qRegisterMetaType<GameSnapshot>("GameSnapshot");
 	
 	connect(this, SIGNAL(sigSendIslMessage(IslMessage, int)), this, SLOT(doSendIslMessage(IslMessage, int)), Qt::QueuedConnection);
+	
+	runningTimer.start();
 }
 
 Server::~Server()
 {
+	qDeleteAll(addressRateLimiters);
+	
+	QMapIterator<int, PendingGameMigration> migrationIterator(pendingGameMigrations);
+	while (migrationIterator.hasNext())
+		delete migrationIterator.next().value().snapshot;
 }
 
 void Server::prepareDestroy()
@@ -103,7 +112,33 @@ Server_DatabaseInterface *Server::getDatabaseInterface() const
 	return databaseInterfaces.value(QThread::currentThread());
 }
 
-AuthenticationResult Server::loginUser(Server_ProtocolHandler *session, QString &name, const QString &password, QString &reasonStr, int &secondsLeft)
+const Server_RateLimit &Server::getRateLimit(Server_RateLimiter::Category /*category*/) const
+{
+	static const Server_RateLimit noLimit;
+	return noLimit;
+}
+
+Server_AddressRateLimiter *Server::acquireAddressRateLimiter(const QString &address)
+{
+	QMutexLocker locker(&addressRateLimitersMutex);
+	Server_AddressRateLimiter *limiter = addressRateLimiters.value(address);
+	if (!limiter) {
+		limiter = new Server_AddressRateLimiter;
+		addressRateLimiters.insert(address, limiter);
+	}
+	++limiter->refCount;
+	return limiter;
+}
+
+void Server::releaseAddressRateLimiter(const QString &address)
+{
+	QMutexLocker locker(&addressRateLimitersMutex);
+	Server_AddressRateLimiter *limiter = addressRateLimiters.value(address);
+	if (limiter && (--limiter->refCount == 0))
+		delete addressRateLimiters.take(address);
+}
+
+AuthenticationResult Server::loginUser(Server_ProtocolHandler *session, QString &name, const QString &password, QString &reasonStr, int &secondsLeft, int clientFeatures)
 {
 	if (name.size() > 35)
 		name = name.left(35);
@@ -118,6 +153,7 @@ AuthenticationResult Server::loginUser(Server_ProtocolHandler *session, QString
 	
 	ServerInfo_User data = databaseInterface->getUserData(name, true);
 	data.set_address(session->getAddress().toStdString());
+	data.set_client_features(clientFeatures & getProtocolFeatures());
 	name = QString::fromStdString(data.name()); // Compensate for case indifference
 	
 	databaseInterface->lockSessionTables();
@@ -153,9 +189,7 @@ AuthenticationResult Server::loginUser(Server_ProtocolHandler *session, QString
 	Event_UserJoined event;
 	event.mutable_user_info()->CopyFrom(session->copyUserInfo(false));
 	SessionEvent *se = Server_ProtocolHandler::prepareSessionEvent(event);
-	for (int i = 0; i < clients.size(); ++i)
-		if (clients[i]->getAcceptsUserListChanges())
-			clients[i]->sendProtocolItem(*se);
+	sendUserListEvent(name, *se);
 	delete se;
 	
 	event.mutable_user_info()->CopyFrom(session->copyUserInfo(true, true, true));
@@ -186,6 +220,28 @@ QList<PlayerReference> Server::getPersistentPlayerReferences(const QString &user
 	return persistentPlayers.values(userName);
 }
 
+void Server::addGameHibernation(qint64 nsecs)
+{
+	QMutexLocker locker(&gameHibernationStatisticsMutex);
+	++gameHibernationStatistics.hibernations;
+	gameHibernationStatistics.hibernationNsecs += nsecs;
+}
+
+void Server::addGameRehydration(qint64 nsecs)
+{
+	QMutexLocker locker(&gameHibernationStatisticsMutex);
+	++gameHibernationStatistics.rehydrations;
+	gameHibernationStatistics.rehydrationNsecs += nsecs;
+}
+
+GameHibernationStatistics Server::takeGameHibernationStatistics()
+{
+	QMutexLocker locker(&gameHibernationStatisticsMutex);
+	const GameHibernationStatistics result = gameHibernationStatistics;
+	gameHibernationStatistics = GameHibernationStatistics();
+	return result;
+}
+
 Server_AbstractUserInterface *Server::findUser(const QString &userName) const
 {
 	// Call this only with clientsLock set.
@@ -207,14 +263,15 @@ void Server::removeClient(Server_ProtocolHandler *client)
 {
 	QWriteLocker locker(&clientsLock);
 	clients.removeAt(clients.indexOf(client));
+	userListSubscribersMutex.lock();
+	unsubscribeUserList(client);
+	userListSubscribersMutex.unlock();
 	ServerInfo_User *data = client->getUserInfo();
 	if (data) {
 		Event_UserLeft event;
 		event.set_name(data->name());
 		SessionEvent *se = Server_ProtocolHandler::prepareSessionEvent(event);
-		for (int i = 0; i < clients.size(); ++i)
-			if (clients[i]->getAcceptsUserListChanges())
-				clients[i]->sendProtocolItem(*se);
+		sendUserListEvent(QString::fromStdString(data->name()), *se);
 		sendIsl_SessionEvent(*se);
 		delete se;
 		
@@ -231,11 +288,100 @@ void Server::removeClient(Server_ProtocolHandler *client)
 	qDebug() << "Server::removeClient: removed" << (void *) client << ";" << clients.size() << "clients; " << users.size() << "users left";
 }
 
+void Server::subscribeUserList(Server_ProtocolHandler *client)
+{
+	QMutexLocker locker(&userListSubscribersMutex);
+	unsubscribeUserList(client);
+	userListSubscribers.insert(client);
+}
+
+void Server::subscribeBuddyPresence(Server_ProtocolHandler *client, const QSet<QString> &buddies)
+{
+	QMutexLocker locker(&userListSubscribersMutex);
+	unsubscribeUserList(client);
+	subscribedBuddies.insert(client, buddies);
+	QSetIterator<QString> buddyIterator(buddies);
+	while (buddyIterator.hasNext())
+		buddyPresenceSubscribers[buddyIterator.next()].insert(client);
+}
+
+void Server::addBuddyPresence(Server_ProtocolHandler *client, const QString &buddyName)
+{
+	QMutexLocker locker(&userListSubscribersMutex);
+	QMap<Server_ProtocolHandler *, QSet<QString> >::iterator it = subscribedBuddies.find(client);
+	if (it == subscribedBuddies.end())
+		return;
+	it.value().insert(buddyName);
+	buddyPresenceSubscribers[buddyName].insert(client);
+}
+
+void Server::removeBuddyPresence(Server_ProtocolHandler *client, const QString &buddyName)
+{
+	QMutexLocker locker(&userListSubscribersMutex);
+	QMap<Server_ProtocolHandler *, QSet<QString> >::iterator it = subscribedBuddies.find(client);
+	if (it == subscribedBuddies.end())
+		return;
+	it.value().remove(buddyName);
+	QMap<QString, QSet<Server_ProtocolHandler *> >::iterator subscribersIterator = buddyPresenceSubscribers.find(buddyName);
+	if (subscribersIterator == buddyPresenceSubscribers.end())
+		return;
+	subscribersIterator.value().remove(client);
+	if (subscribersIterator.value().isEmpty())
+		buddyPresenceSubscribers.erase(subscribersIterator);
+}
+
+void Server::unsubscribeUserList(Server_ProtocolHandler *client)
+{
+	// Call this only with userListSubscribersMutex locked.
+	
+	userListSubscribers.remove(client);
+	QSetIterator<QString> buddyIterator(subscribedBuddies.take(client));
+	while (buddyIterator.hasNext()) {
+		QMap<QString, QSet<Server_ProtocolHandler *> >::iterator it = buddyPresenceSubscribers.find(buddyIterator.next());
+		if (it == buddyPresenceSubscribers.end())
+			continue;
+		it.value().remove(client);
+		if (it.value().isEmpty())
+			buddyPresenceSubscribers.erase(it);
+	}
+}
+
+void Server::sendUserListEvent(const QString &userName, const SessionEvent &event)
+{
+	// Call this only with clientsLock set.
+	
+	QMutexLocker locker(&userListSubscribersMutex);
+	QMap<QString, QSet<Server_ProtocolHandler *> >::const_iterator buddySubscribers = buddyPresenceSubscribers.constFind(userName);
+	const bool hasBuddySubscribers = buddySubscribers != buddyPresenceSubscribers.constEnd();
+	if (userListSubscribers.isEmpty() && !hasBuddySubscribers)
+		return;
+	
+	ServerMessage msg;
+	msg.mutable_session_event()->CopyFrom(event);
+	msg.set_message_type(ServerMessage::SESSION_EVENT);
+	const QByteArray buf = Server_ProtocolHandler::serializeProtocolItem(msg);
+	
+	QSetIterator<Server_ProtocolHandler *> subscriberIterator(userListSubscribers);
+	while (subscriberIterator.hasNext())
+		subscriberIterator.next()->sendSerializedProtocolItem(buf);
+	if (hasBuddySubscribers) {
+		QSetIterator<Server_ProtocolHandler *> buddySubscriberIterator(buddySubscribers.value());
+		while (buddySubscriberIterator.hasNext())
+			buddySubscriberIterator.next()->sendSerializedProtocolItem(buf);
+	}
+}
+
 void Server::externalUserJoined(const ServerInfo_User &userInfo)
 {
 	// This function is always called from the main thread via signal/slot.
 	clientsLock.lockForWrite();
 	
+	// After an ISL resync, users may be announced twice.
+	if (externalUsers.contains(QString::fromStdString(userInfo.name()))) {
+		clientsLock.unlock();
+		return;
+	}
+	
 	Server_RemoteUserInterface *newUser = new Server_RemoteUserInterface(this, ServerInfo_User_Container(userInfo));
 	externalUsers.insert(QString::fromStdString(userInfo.name()), newUser);
 	externalUsersBySessionId.insert(userInfo.session_id(), newUser);
@@ -244,9 +390,7 @@ void Server::externalUserJoined(const ServerInfo_User &userInfo)
 	event.mutable_user_info()->CopyFrom(userInfo);
 	
 	SessionEvent *se = Server_ProtocolHandler::prepareSessionEvent(event);
-	for (int i = 0; i < clients.size(); ++i)
-		if (clients[i]->getAcceptsUserListChanges())
-			clients[i]->sendProtocolItem(*se);
+	sendUserListEvent(QString::fromStdString(userInfo.name()), *se);
 	delete se;
 	clientsLock.unlock();
 	
@@ -261,6 +405,10 @@ void Server::externalUserLeft(const QString &userName)
 	
 	clientsLock.lockForWrite();
 	Server_AbstractUserInterface *user = externalUsers.take(userName);
+	if (!user) {
+		clientsLock.unlock();
+		return;
+	}
 	externalUsersBySessionId.remove(user->getUserInfo()->session_id());
 	clientsLock.unlock();
 	
@@ -294,9 +442,7 @@ void Server::externalUserLeft(const QString &userName)
 	
 	SessionEvent *se = Server_ProtocolHandler::prepareSessionEvent(event);
 	clientsLock.lockForRead();
-	for (int i = 0; i < clients.size(); ++i)
-		if (clients[i]->getAcceptsUserListChanges())
-			clients[i]->sendProtocolItem(*se);
+	sendUserListEvent(userName, *se);
 	clientsLock.unlock();
 	delete se;
 }
@@ -353,6 +499,19 @@ void Server::externalRoomGameListChanged(int roomId, const ServerInfo_Game &game
 	room->updateExternalGameList(gameInfo);
 }
 
+void Server::externalRoomGameListReplaced(int serverId, const ServerInfo_Room &roomInfo)
+{
+	// This function is always called from the main thread via signal/slot.
+	QReadLocker locker(&roomsLock);
+	
+	Server_Room *room = rooms.value(roomInfo.room_id());
+	if (!room) {
+		qDebug() << "externalRoomGameListReplaced: room id=" << roomInfo.room_id() << "not found";
+		return;
+	}
+	room->replaceExternalGameList(serverId, roomInfo);
+}
+
 void Server::externalJoinGameCommandReceived(const Command_JoinGame &cmd, int cmdId, int roomId, int serverId, qint64 sessionId)
 {
 	// This function is always called from the main thread via signal/slot.
@@ -467,6 +626,108 @@ void Server::externalResponseReceived(const Response &resp, qint64 sessionId)
 	client->sendProtocolItem(resp);
 }
 
+void Server::externalGameMigrationReceived(const GameSnapshot &snapshot, int serverId)
+{
+	// This function is always called from the main thread via signal/slot.
+	
+	const bool adopted = adoptGame(snapshot);
+	if (!adopted)
+		qDebug() << "externalGameMigrationReceived: game id=" << snapshot.game_info().game_id() << "from server" << serverId << "could not be adopted";
+	
+	// The other server keeps the game until it knows where it went.
+	IslMessage msg;
+	msg.set_message_type(IslMessage::GAME_MIGRATION_RESULT);
+	msg.set_migrated_game_id(snapshot.game_info().game_id());
+	msg.set_migration_adopted(adopted);
+	emit sigSendIslMessage(msg, serverId);
+}
+
+bool Server::adoptGame(const GameSnapshot &snapshot)
+{
+	QReadLocker roomsLocker(&roomsLock);
+	Server_Room *room = rooms.value(snapshot.game_info().room_id());
+	if (!room)
+		return false;
+	
+	// Players may be connected to this server, to a peer or not at all.
+	QReadLocker clientsLocker(&clientsLock);
+	QMap<QString, Server_AbstractUserInterface *> userInterfaces;
+	for (int i = 0; i < snapshot.player_list_size(); ++i) {
+		const QString playerName = QString::fromStdString(snapshot.player_list(i).info().properties().user_info().name());
+		Server_AbstractUserInterface *userInterface = users.value(playerName);
+		if (!userInterface)
+			userInterface = externalUsers.value(playerName);
+		if (userInterface)
+			userInterfaces.insert(playerName, userInterface);
+	}
+	return room->adoptGame(snapshot, userInterfaces);
+}
+
+void Server::addPendingGameMigration(const GameSnapshot &snapshot, int serverId)
+{
+	PendingGameMigration migration;
+	migration.snapshot = new GameSnapshot(snapshot);
+	migration.serverId = serverId;
+	migration.sentAt = getMsecsRunning();
+	pendingGameMigrations.insert(snapshot.game_info().game_id(), migration);
+}
+
+void Server::gameMigrationResultReceived(int gameId, bool adopted, int serverId)
+{
+	// This function is always called from the main thread via signal/slot.
+	
+	if (!pendingGameMigrations.contains(gameId) || (pendingGameMigrations.value(gameId).serverId != serverId)) {
+		qDebug() << "gameMigrationResultReceived: unexpected result for game id=" << gameId << "from server" << serverId;
+		return;
+	}
+	const PendingGameMigration migration = pendingGameMigrations.take(gameId);
+	if (adopted)
+		sendGameMigratedEvent(gameId, serverId, *migration.snapshot);
+	else {
+		qDebug() << "gameMigrationResultReceived: server" << serverId << "did not adopt game id=" << gameId << ", taking it back";
+		adoptGame(*migration.snapshot);
+	}
+	delete migration.snapshot;
+}
+
+void Server::expireGameMigrations()
+{
+	expireGameMigrations(getMsecsRunning());
+}
+
+void Server::expireGameMigrations(qint64 now)
+{
+	QList<int> expiredGameIds;
+	QMapIterator<int, PendingGameMigration> migrationIterator(pendingGameMigrations);
+	while (migrationIterator.hasNext())
+		if (now - migrationIterator.next().value().sentAt >= gameMigrationTimeout)
+			expiredGameIds.append(migrationIterator.key());
+	
+	for (int i = 0; i < expiredGameIds.size(); ++i) {
+		const PendingGameMigration migration = pendingGameMigrations.take(expiredGameIds[i]);
+		qDebug() << "expireGameMigrations: server" << migration.serverId << "did not confirm game id=" << expiredGameIds[i] << "in time, taking it back";
+		adoptGame(*migration.snapshot);
+		delete migration.snapshot;
+	}
+}
+
+void Server::sendGameMigratedEvent(int gameId, int serverId, const GameSnapshot &snapshot)
+{
+	// Players connected here need to know where the game went once this server is gone.
+	Event_GameMigrated event;
+	event.set_game_id(gameId);
+	getGameMigrationTarget(serverId, event);
+	SessionEvent *se = Server_ProtocolHandler::prepareSessionEvent(event);
+	clientsLock.lockForRead();
+	for (int i = 0; i < snapshot.player_list_size(); ++i) {
+		Server_ProtocolHandler *user = users.value(QString::fromStdString(snapshot.player_list(i).info().properties().user_info().name()));
+		if (user)
+			user->sendProtocolItem(*se);
+	}
+	clientsLock.unlock();
+	delete se;
+}
+
 void Server::broadcastRoomUpdate(const ServerInfo_Room &roomInfo, bool sendToIsl)
 {
 	// This function is always called from the main thread via signal/slot.
@@ -515,6 +776,19 @@ int Server::getGamesCount() const
 	return result;
 }
 
+int Server::getHibernatedGamesCount() const
+{
+	int result = 0;
+	QReadLocker locker(&roomsLock);
+	QMapIterator<int, Server_Room *> roomIterator(rooms);
+	while (roomIterator.hasNext()) {
+		Server_Room *room = roomIterator.next().value();
+		QReadLocker roomLocker(&room->gamesLock);
+		result += room->getHibernatedGames().size();
+	}
+	return result;
+}
+
 void Server::sendIsl_Response(const Response &item, int serverId, qint64 sessionId)
 {
 	IslMessage msg;
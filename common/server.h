@@ -5,10 +5,14 @@
 #include <QStringList>
 #include <QMap>
 #include <QMultiMap>
+#include <QSet>
 #include <QMutex>
 #include <QReadWriteLock>
+#include <QElapsedTimer>
 #include "pb/serverinfo_user.pb.h"
 #include "server_player_reference.h"
+#include "server_ratelimiter.h"
+#include "server_deck_cache.h"
 
 class Server_DatabaseInterface;
 class Server_Game;
@@ -26,6 +30,17 @@ class Response;
 class GameEventContainer;
 class CommandContainer;
 class Command_JoinGame;
+class GameSnapshot;
+class Event_GameMigrated;
+
+// Game hibernations and rehydrations since the last status update, see Server::takeGameHibernationStatistics().
+struct GameHibernationStatistics {
+	int hibernations, rehydrations;
+	qint64 hibernationNsecs, rehydrationNsecs;
+	GameHibernationStatistics() : hibernations(0), rehydrations(0), hibernationNsecs(0), rehydrationNsecs(0) { }
+	qint64 getAverageHibernationUsecs() const { return hibernations ? hibernationNsecs / 1000 / hibernations : 0; }
+	qint64 getAverageRehydrationUsecs() const { return rehydrations ? rehydrationNsecs / 1000 / rehydrations : 0; }
+};
 
 enum AuthenticationResult { NotLoggedIn = 0, PasswordRight = 1, UnknownUser = 2, WouldOverwriteOldSession = 3, UserIsBanned = 4, UsernameInvalid = 5 };
 
@@ -43,7 +58,9 @@ public:
 	Server(bool _threaded, QObject *parent = 0);
 	~Server();
 	void setThreaded(bool _threaded) { threaded = _threaded; }
-	AuthenticationResult loginUser(Server_ProtocolHandler *session, QString &name, const QString &password, QString &reason, int &secondsLeft);
+	AuthenticationResult loginUser(Server_ProtocolHandler *session, QString &name, const QString &password, QString &reason, int &secondsLeft, int clientFeatures = 0);
+	// ServerInfo_User::ProtocolFeature flags this server implementation understands.
+	static int getProtocolFeatures() { return ServerInfo_User::FeatureMoveCards; }
 	const QMap<int, Server_Room *> &getRooms() { return rooms; }
 	
 	Server_AbstractUserInterface *findUser(const QString &userName) const;
@@ -51,19 +68,37 @@ public:
 	const QMap<qint64, Server_ProtocolHandler *> &getUsersBySessionId() const { return usersBySessionId; }
 	void addClient(Server_ProtocolHandler *player);
 	void removeClient(Server_ProtocolHandler *player);
+	// Clients subscribed to the user list get Event_UserJoined and Event_UserLeft for every user,
+	// clients subscribed to buddy presence only for their buddies. A client has one subscription at a time.
+	void subscribeUserList(Server_ProtocolHandler *client);
+	void subscribeBuddyPresence(Server_ProtocolHandler *client, const QSet<QString> &buddies);
+	// Keep a buddy presence subscription in line with the buddy list, other subscriptions are not affected.
+	void addBuddyPresence(Server_ProtocolHandler *client, const QString &buddyName);
+	void removeBuddyPresence(Server_ProtocolHandler *client, const QString &buddyName);
 	virtual QString getLoginMessage() const { return QString(); }
 	
 	virtual bool getGameShouldPing() const { return false; }
 	virtual int getMaxGameInactivityTime() const { return 9999999; }
 	virtual int getMaxPlayerInactivityTime() const { return 9999999; }
-	virtual int getMessageCountingInterval() const { return 0; }
-	virtual int getMaxMessageCountPerInterval() const { return 0; }
-	virtual int getMaxMessageSizePerInterval() const { return 0; }
+	virtual const Server_RateLimit &getRateLimit(Server_RateLimiter::Category category) const;
+	virtual int getAddressRateLimitFactor() const { return 0; }
 	virtual int getMaxGamesPerUser() const { return 0; }
 	virtual bool getThreaded() const { return false; }
+	// Seconds all players of a full game must be gone before it is written to disk, 0 disables hibernation.
+	virtual int getGameHibernationTime() const { return 0; }
+	virtual QString getGameHibernationPath() const { return QString(); }
+	// Identifies this server among others sharing the hibernation path.
+	virtual int getServerId() const { return 0; }
+	// Milliseconds over which game list changes of a room are collected into one event, 0 sends each right away.
+	virtual int getGameListUpdateInterval() const { return 0; }
 	
 	Server_DatabaseInterface *getDatabaseInterface() const;
+	Server_DeckCache *getDeckCache() { return &deckCache; }
 	int getNextLocalGameId() { QMutexLocker locker(&nextLocalGameIdMutex); return ++nextLocalGameId; }
+	qint64 getMsecsRunning() const { return runningTimer.elapsed(); }
+	
+	Server_AddressRateLimiter *acquireAddressRateLimiter(const QString &address);
+	void releaseAddressRateLimiter(const QString &address);
 	
 	void sendIsl_Response(const Response &item, int serverId = -1, qint64 sessionId = -1);
 	void sendIsl_SessionEvent(const SessionEvent &item, int serverId = -1, qint64 sessionId = -1);
@@ -79,12 +114,51 @@ public:
 	void addPersistentPlayer(const QString &userName, int roomId, int gameId, int playerId);
 	void removePersistentPlayer(const QString &userName, int roomId, int gameId, int playerId);
 	QList<PlayerReference> getPersistentPlayerReferences(const QString &userName) const;
+	
+	void addGameHibernation(qint64 nsecs);
+	void addGameRehydration(qint64 nsecs);
+	// Hibernations and rehydrations since the last call.
+	GameHibernationStatistics takeGameHibernationStatistics();
+	
+	// Brings a game migrated from another server to life in its room, see Server_Room::adoptGame().
+	bool adoptGame(const GameSnapshot &snapshot);
+	// A migrated game's snapshot is kept until the peer tells whether it adopted the game.
+	// If it did not, or does not answer within gameMigrationTimeout, the game is adopted here again.
+	// Only used from the main thread.
+	static const int gameMigrationTimeout = 10000;
+	void addPendingGameMigration(const GameSnapshot &snapshot, int serverId);
+	int getPendingGameMigrationCount() const { return pendingGameMigrations.size(); }
+	// Takes back the games whose peers did not answer by now, see getMsecsRunning().
+	void expireGameMigrations(qint64 now);
+public slots:
+	void gameMigrationResultReceived(int gameId, bool adopted, int serverId);
+	void expireGameMigrations();
 private:
 	bool threaded;
 	QMultiMap<QString, PlayerReference> persistentPlayers;
 	mutable QReadWriteLock persistentPlayersLock;
 	int nextLocalGameId;
 	QMutex nextLocalGameIdMutex;
+	QElapsedTimer runningTimer;
+	QMap<QString, Server_AddressRateLimiter *> addressRateLimiters;
+	QMutex addressRateLimitersMutex;
+	Server_DeckCache deckCache;
+	QMutex gameHibernationStatisticsMutex;
+	GameHibernationStatistics gameHibernationStatistics;
+	// Guarded by userListSubscribersMutex, which is taken after clientsLock.
+	QSet<Server_ProtocolHandler *> userListSubscribers;
+	QMap<QString, QSet<Server_ProtocolHandler *> > buddyPresenceSubscribers; // by buddy name
+	QMap<Server_ProtocolHandler *, QSet<QString> > subscribedBuddies;
+	QMutex userListSubscribersMutex;
+	void unsubscribeUserList(Server_ProtocolHandler *client);
+	void sendUserListEvent(const QString &userName, const SessionEvent &event);
+	struct PendingGameMigration {
+		GameSnapshot *snapshot;
+		int serverId;
+		qint64 sentAt; // see getMsecsRunning()
+	};
+	QMap<int, PendingGameMigration> pendingGameMigrations; // by game id
+	void sendGameMigratedEvent(int gameId, int serverId, const GameSnapshot &snapshot);
 protected slots:	
 	void externalUserJoined(const ServerInfo_User &userInfo);
 	void externalUserLeft(const QString &userName);
@@ -92,13 +166,17 @@ protected slots:
 	void externalRoomUserLeft(int roomId, const QString &userName);
 	void externalRoomSay(int roomId, const QString &userName, const QString &message);
 	void externalRoomGameListChanged(int roomId, const ServerInfo_Game &gameInfo);
+	void externalRoomGameListReplaced(int serverId, const ServerInfo_Room &roomInfo);
 	void externalJoinGameCommandReceived(const Command_JoinGame &cmd, int cmdId, int roomId, int serverId, qint64 sessionId);
 	void externalGameCommandContainerReceived(const CommandContainer &cont, int playerId, int serverId, qint64 sessionId);
 	void externalGameEventContainerReceived(const GameEventContainer &cont, qint64 sessionId);
 	void externalResponseReceived(const Response &resp, qint64 sessionId);
+	void externalGameMigrationReceived(const GameSnapshot &snapshot, int serverId);
 	
 	virtual void doSendIslMessage(const IslMessage &msg, int serverId) { }
 protected:
+	// Tells players of a migrated game where to find it, the base server knows no peer addresses.
+	virtual void getGameMigrationTarget(int serverId, Event_GameMigrated &event) const { }
 	void prepareDestroy();
 	void setDatabaseInterface(Server_DatabaseInterface *_databaseInterface);
 	QList<Server_ProtocolHandler *> clients;
@@ -111,6 +189,7 @@ protected:
 	
 	int getUsersCount() const;
 	int getGamesCount() const;
+	int getHibernatedGamesCount() const;
 	void addRoom(Server_Room *newRoom);
 };
 
@@ -11,7 +11,7 @@
 #include "server_player.h"
 #include "pb/event_game_joined.pb.h"
 #include "pb/event_game_state_changed.pb.h"
-#include <google/protobuf/descriptor.h>
+#include "get_pb_extension.h"
 
 void Server_AbstractUserInterface::sendProtocolItemByType(ServerMessage::MessageType type, const ::google::protobuf::Message &item)
 {
@@ -23,18 +23,40 @@ void Server_AbstractUserInterface::sendProtocolItemByType(ServerMessage::Message
 	}
 }
 
+void Server_AbstractUserInterface::sendSerializedProtocolItem(const QByteArray &buf)
+{
+	// Interfaces that don't write the wire format themselves get the message back.
+	ServerMessage msg;
+	if (!msg.ParseFromArray(buf.data() + 4, buf.size() - 4))
+		return;
+	switch (msg.message_type()) {
+		case ServerMessage::RESPONSE: sendProtocolItem(msg.response()); break;
+		case ServerMessage::SESSION_EVENT: sendProtocolItem(msg.session_event()); break;
+		case ServerMessage::GAME_EVENT_CONTAINER: sendProtocolItem(msg.game_event_container()); break;
+		case ServerMessage::ROOM_EVENT: sendProtocolItem(msg.room_event()); break;
+	}
+}
+
+void Server_AbstractUserInterface::sendResponseContainerItem(const ResponseContainerItem &item)
+{
+	if (item.message)
+		sendProtocolItemByType(item.type, *item.message);
+	else
+		sendSerializedProtocolItem(item.serialized);
+}
+
 SessionEvent *Server_AbstractUserInterface::prepareSessionEvent(const ::google::protobuf::Message &sessionEvent)
 {
 	SessionEvent *event = new SessionEvent;
-	event->GetReflection()->MutableMessage(event, sessionEvent.GetDescriptor()->FindExtensionByName("ext"))->CopyFrom(sessionEvent);
+	setPbExtension(*event, sessionEvent);
 	return event;
 }
 
 void Server_AbstractUserInterface::sendResponseContainer(const ResponseContainer &responseContainer, Response::ResponseCode responseCode)
 {
-	const QList<QPair<ServerMessage::MessageType, ::google::protobuf::Message *> > &preResponseQueue = responseContainer.getPreResponseQueue();
+	const QList<ResponseContainerItem> &preResponseQueue = responseContainer.getPreResponseQueue();
 	for (int i = 0; i < preResponseQueue.size(); ++i)
-		sendProtocolItemByType(preResponseQueue[i].first, *preResponseQueue[i].second);
+		sendResponseContainerItem(preResponseQueue[i]);
 	
 	if (responseCode != Response::RespNothing) {
 		Response response;
@@ -42,13 +64,13 @@ void Server_AbstractUserInterface::sendResponseContainer(const ResponseContainer
 		response.set_response_code(responseCode);
 		::google::protobuf::Message *responseExtension = responseContainer.getResponseExtension();
 		if (responseExtension)
-			response.GetReflection()->MutableMessage(&response, responseExtension->GetDescriptor()->FindExtensionByName("ext"))->CopyFrom(*responseExtension);
+			setPbExtension(response, *responseExtension);
 		sendProtocolItem(response);
 	}
 	
-	const QList<QPair<ServerMessage::MessageType, ::google::protobuf::Message *> > &postResponseQueue = responseContainer.getPostResponseQueue();
+	const QList<ResponseContainerItem> &postResponseQueue = responseContainer.getPostResponseQueue();
 	for (int i = 0; i < postResponseQueue.size(); ++i)
-		sendProtocolItemByType(postResponseQueue[i].first, *postResponseQueue[i].second);
+		sendResponseContainerItem(postResponseQueue[i]);
 }
 
 void Server_AbstractUserInterface::playerRemovedFromGame(Server_Game *game)
@@ -78,6 +100,7 @@ void Server_AbstractUserInterface::joinPersistentGames(ResponseContainer &rc)
 		Server_Room *room = server->getRooms().value(pr.getRoomId());
 		if (!room)
 			continue;
+		room->rehydrateGame(pr.getGameId());
 		QReadLocker roomGamesLocker(&room->gamesLock);
 		
 		Server_Game *game = room->getGames().value(pr.getGameId());
@@ -4,6 +4,7 @@
 #include <QMutex>
 #include <QMap>
 #include <QPair>
+#include <QByteArray>
 #include "serverinfo_user_container.h"
 #include "pb/server_message.pb.h"
 #include "pb/response.pb.h"
@@ -12,6 +13,7 @@ class SessionEvent;
 class GameEventContainer;
 class RoomEvent;
 class ResponseContainer;
+class ResponseContainerItem;
 
 class Server;
 class Server_Game;
@@ -40,6 +42,9 @@ public:
 	virtual void sendProtocolItem(const GameEventContainer &item) = 0;
 	virtual void sendProtocolItem(const RoomEvent &item) = 0;
 	void sendProtocolItemByType(ServerMessage::MessageType type, const ::google::protobuf::Message &item);
+	// Takes a message in its wire format, see Server_ProtocolHandler::serializeProtocolItem().
+	virtual void sendSerializedProtocolItem(const QByteArray &buf);
+	void sendResponseContainerItem(const ResponseContainerItem &item);
 	
 	static SessionEvent *prepareSessionEvent(const ::google::protobuf::Message &sessionEvent);
 	void sendResponseContainer(const ResponseContainer &responseContainer, Response::ResponseCode responseCode);
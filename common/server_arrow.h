@@ -2,12 +2,13 @@
 #define SERVER_ARROW_H
 
 #include "pb/color.pb.h"
+#include "server_object_pool.h"
 
 class Server_Card;
 class Server_ArrowTarget;
 class ServerInfo_Arrow;
 
-class Server_Arrow {
+class Server_Arrow : public Server_PooledObject {
 private:
 	int id;
 	Server_Card *startCard;
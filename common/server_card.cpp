@@ -23,7 +23,12 @@
 #include "pb/serverinfo_card.pb.h"
 
 Server_Card::Server_Card(QString _name, int _id, int _coord_x, int _coord_y, Server_CardZone *_zone)
-	: zone(_zone), id(_id), coord_x(_coord_x), coord_y(_coord_y), name(_name), tapped(false), attacking(false), facedown(false), color(QString()), power(-1), toughness(-1), annotation(QString()), destroyOnZoneChange(false), doesntUntap(false), parentCard(0)
+	: zone(_zone), id(_id), coord_x(_coord_x), coord_y(_coord_y), nameId(CardNameTable::acquire(_name)), tapped(false), attacking(false), facedown(false), color(QString()), power(-1), toughness(-1), annotation(QString()), destroyOnZoneChange(false), doesntUntap(false), parentCard(0)
+{
+}
+
+Server_Card::Server_Card(int _nameId, int _id, int _coord_x, int _coord_y, Server_CardZone *_zone)
+	: zone(_zone), id(_id), coord_x(_coord_x), coord_y(_coord_y), nameId(_nameId), tapped(false), attacking(false), facedown(false), color(QString()), power(-1), toughness(-1), annotation(QString()), destroyOnZoneChange(false), doesntUntap(false), parentCard(0)
 {
 }
 
@@ -35,6 +40,23 @@ Server_Card::~Server_Card()
 	
 	if (parentCard)
 		parentCard->removeAttachedCard(this);
+	
+	CardNameTable::release(nameId);
+}
+
+void Server_Card::setName(const QString &_name)
+{
+	const int oldNameId = nameId;
+	nameId = CardNameTable::acquire(_name);
+	CardNameTable::release(oldNameId);
+}
+
+void Server_Card::setId(int _id)
+{
+	const int oldId = id;
+	id = _id;
+	if (zone)
+		zone->updateCardId(this, oldId);
 }
 
 void Server_Card::resetState()
@@ -121,7 +143,7 @@ void Server_Card::setParentCard(Server_Card *_parentCard)
 
 void Server_Card::getInfo(ServerInfo_Card *info)
 {
-	QString displayedName = facedown ? QString() : name;
+	QString displayedName = facedown ? QString() : getName();
 	
 	info->set_id(id);
 	info->set_name(displayedName.toStdString());
@@ -21,6 +21,8 @@
 #define SERVER_CARD_H
 
 #include "server_arrowtarget.h"
+#include "card_name_table.h"
+#include "server_object_pool.h"
 #include "pb/card_attributes.pb.h"
 #include <QString>
 #include <QMap>
@@ -28,13 +30,13 @@
 class Server_CardZone;
 class ServerInfo_Card;
 
-class Server_Card : public Server_ArrowTarget {
+class Server_Card : public Server_ArrowTarget, public Server_PooledObject {
 	Q_OBJECT
 private:
 	Server_CardZone *zone;
 	int id;
 	int coord_x, coord_y;
-	QString name;
+	int nameId;
 	QMap<int, int> counters;
 	bool tapped;
 	bool attacking;
@@ -49,6 +51,8 @@ private:
 	QList<Server_Card *> attachedCards;
 public:
 	Server_Card(QString _name, int _id, int _coord_x, int _coord_y, Server_CardZone *_zone = 0);
+	// Takes over a reference to the name, see CardNameTable::acquire().
+	Server_Card(int _nameId, int _id, int _coord_x, int _coord_y, Server_CardZone *_zone = 0);
 	~Server_Card();
 	
 	Server_CardZone *getZone() const { return zone; }
@@ -57,7 +61,8 @@ public:
 	int getId() const { return id; }
 	int getX() const { return coord_x; }
 	int getY() const { return coord_y; }
-	QString getName() const { return name; }
+	QString getName() const { return CardNameTable::getName(nameId); }
+	int getNameId() const { return nameId; }
 	const QMap<int, int> &getCounters() const { return counters; }
 	int getCounter(int id) const { return counters.value(id, 0); }
 	bool getTapped() const { return tapped; }
@@ -71,9 +76,9 @@ public:
 	Server_Card *getParentCard() const { return parentCard; }
 	const QList<Server_Card *> &getAttachedCards() const { return attachedCards; }
 
-	void setId(int _id) { id = _id; }
+	void setId(int _id);
 	void setCoords(int x, int y) { coord_x = x; coord_y = y; }
-	void setName(const QString &_name) { name = _name; }
+	void setName(const QString &_name);
 	void setCounter(int id, int value);
 	void setTapped(bool _tapped) { tapped = _tapped; }
 	void setAttacking(bool _attacking) { attacking = _attacking; }
@@ -25,6 +25,9 @@
 #include <QDebug>
 #include "pb/command_move_card.pb.h"
 
+// Highest column a client can ask for on the table.
+static const int maxGridColumn = 3 * 1024;
+
 Server_CardZone::Server_CardZone(Server_Player *_player, const QString &_name, bool _has_coords, ServerInfo_Zone::ZoneType _type)
     : player(_player),
           name(_name),
@@ -49,63 +52,140 @@ void Server_CardZone::shuffle()
         int j = rng->rand(0, i);
         cards.swap(j,i);
     }
+    updateCardPositions(0);
     playersWithWritePermission.clear();
 }
 
 
-void Server_CardZone::removeCardFromCoordMap(Server_Card *card, int oldX, int oldY)
+void Server_CardZone::GridRow::setPileUsed(int pile, bool used)
+{
+    const int word = pile / 32;
+    if (word >= usedPiles.size()) {
+        if (!used)
+            return;
+        usedPiles.resize(word + 1);
+    }
+    if (used)
+        usedPiles[word] |= 1u << (pile % 32);
+    else
+        usedPiles[word] &= ~(1u << (pile % 32));
+}
+
+int Server_CardZone::GridRow::getFirstFreePile() const
+{
+    for (int word = 0; word < usedPiles.size(); ++word)
+        if (usedPiles[word] != 0xffffffffu)
+            for (int bit = 0; bit < 32; ++bit)
+                if (!(usedPiles[word] & (1u << bit)))
+                    return word * 32 + bit;
+    return usedPiles.size() * 32;
+}
+
+const Server_CardZone::GridRow *Server_CardZone::getGridRow(int y) const
+{
+    QMap<int, GridRow>::const_iterator it = grid.constFind(y);
+    return it == grid.constEnd() ? 0 : &it.value();
+}
+
+Server_Card *Server_CardZone::getCardAt(int x, int y) const
+{
+    const GridRow *row = getGridRow(y);
+    return row ? row->cardAt(x) : 0;
+}
+
+void Server_CardZone::removePileName(GridRow &row, int cardNameId, int pile)
+{
+    QHash<int, QSet<int> >::iterator it = row.pilesByName.find(cardNameId);
+    if (it == row.pilesByName.end())
+        return;
+    it.value().remove(pile);
+    if (it.value().isEmpty())
+        row.pilesByName.erase(it);
+}
+
+void Server_CardZone::removeCardFromGrid(Server_Card *card, int oldX, int oldY)
 {
     if (oldX < 0)
         return;
     
-    const int baseX = (oldX / 3) * 3;
-    QMap<int, Server_Card *> &coordMap = coordinateMap[oldY];
-    
-    if (coordMap.contains(baseX) && coordMap.contains(baseX + 1) && coordMap.contains(baseX + 2))
-        // If the removal of this card has opened up a previously full pile...
-        freePilesMap[oldY].insert(coordMap.value(baseX)->getName(), baseX);
+    QMap<int, GridRow>::iterator rowIt = grid.find(oldY);
+    if ((rowIt == grid.end()) || (rowIt.value().cardAt(oldX) != card))
+        return;
+    GridRow &row = rowIt.value();
     
-    coordMap.remove(oldX);
+    const int pile = oldX / 3;
+    const int baseX = pile * 3;
+    row.columns[oldX] = 0;
+    if (oldX == baseX)
+        removePileName(row, card->getNameId(), pile);
+    if (!row.cardAt(baseX) && !row.cardAt(baseX + 1) && !row.cardAt(baseX + 2))
+        row.setPileUsed(pile, false);
+}
+
+void Server_CardZone::insertCardIntoGrid(Server_Card *card, int x, int y)
+{
+    if (x < 0)
+        return;
     
-    if (!(coordMap.contains(baseX) && coordMap.value(baseX)->getName() == card->getName()) && !(coordMap.contains(baseX + 1) && coordMap.value(baseX + 1)->getName() == card->getName()) && !(coordMap.contains(baseX + 2) && coordMap.value(baseX + 2)->getName() == card->getName()))
-        // If this card was the last one with this name...
-        freePilesMap[oldY].remove(card->getName(), baseX);
+    GridRow &row = grid[y];
+    const int pile = x / 3;
+    if (x >= row.columns.size())
+        row.columns.resize((pile + 1) * 3);
+    if ((x == pile * 3) && row.columns[x])
+        removePileName(row, row.columns[x]->getNameId(), pile);
+    row.columns[x] = card;
+    row.setPileUsed(pile, true);
+    if (x == pile * 3)
+        row.pilesByName[card->getNameId()].insert(pile);
+}
+
+void Server_CardZone::updateCardPositions(int from)
+{
+    if (type == ServerInfo_Zone::HiddenZone)
+        return;
     
-    if (!coordMap.contains(baseX) && !coordMap.contains(baseX + 1) && !coordMap.contains(baseX + 2)) {
-        // If the removal of this card has freed a whole pile, i.e. it was the last card in it...
-        if (baseX < freeSpaceMap[oldY])
-            freeSpaceMap[oldY] = baseX;
-    }
+    for (int i = from; i < cards.size(); ++i)
+        cardPositions.insert(cards[i]->getId(), i);
 }
 
-void Server_CardZone::insertCardIntoCoordMap(Server_Card *card, int x, int y)
+void Server_CardZone::updateCardId(Server_Card *card, int oldId)
 {
-    if (x < 0)
+    if (type == ServerInfo_Zone::HiddenZone)
         return;
     
-    coordinateMap[y].insert(x, card);
-    if (!(x % 3)) {
-        if (!freePilesMap[y].contains(card->getName(), x) && card->getAttachedCards().isEmpty())
-            freePilesMap[y].insert(card->getName(), x);
-        if (freeSpaceMap[y] == x) {
-            int nextFreeX = x;
-            do {
-                nextFreeX += 3;
-            } while (coordinateMap[y].contains(nextFreeX) || coordinateMap[y].contains(nextFreeX + 1) || coordinateMap[y].contains(nextFreeX + 2));
-            freeSpaceMap[y] = nextFreeX;
+    cardPositions.insert(card->getId(), cardPositions.take(oldId));
+}
+
+Server_Card *Server_CardZone::takeCardAt(int index)
+{
+    Server_Card *card = cards[index];
+    if (type != ServerInfo_Zone::HiddenZone) {
+        cardPositions.remove(card->getId());
+        if (has_coords && (index != cards.size() - 1)) {
+            // Cards on the table are placed by their coordinates, so their order
+            // does not matter and the last card can fill the gap.
+            cards[index] = cards.takeLast();
+            cardPositions.insert(cards[index]->getId(), index);
+            return card;
         }
-    } else if (!((x - 2) % 3)) {
-        const int baseX = (x / 3) * 3;
-        freePilesMap[y].remove(coordinateMap[y].value(baseX)->getName(), baseX);
     }
+    cards.removeAt(index);
+    updateCardPositions(index);
+    return card;
 }
 
 int Server_CardZone::removeCard(Server_Card *card)
 {
-    int index = cards.indexOf(card);
-    cards.removeAt(index);
+    int index;
+    if (type == ServerInfo_Zone::HiddenZone)
+        index = cards.indexOf(card);
+    else
+        index = cardPositions.value(card->getId(), -1);
+    if (index == -1)
+        return -1;
+    takeCardAt(index);
     if (has_coords)
-        removeCardFromCoordMap(card, card->getX(), card->getY());
+        removeCardFromGrid(card, card->getX(), card->getY());
     card->setZone(0);
     
     return index;
@@ -114,19 +194,17 @@ int Server_CardZone::removeCard(Server_Card *card)
 Server_Card *Server_CardZone::getCard(int id, int *position, bool remove)
 {
     if (type != ServerInfo_Zone::HiddenZone) {
-        for (int i = 0; i < cards.size(); ++i) {
-            Server_Card *tmp = cards[i];
-            if (tmp->getId() == id) {
-                if (position)
-                    *position = i;
-                if (remove) {
-                    cards.removeAt(i);
-                    tmp->setZone(0);
-                }
-                return tmp;
-            }
+        const int i = cardPositions.value(id, -1);
+        if (i == -1)
+            return NULL;
+        Server_Card *tmp = cards[i];
+        if (position)
+            *position = i;
+        if (remove) {
+            takeCardAt(i);
+            tmp->setZone(0);
         }
-        return NULL;
+        return tmp;
     } else {
         if ((id >= cards.size()) || (id < 0))
             return NULL;
@@ -134,22 +212,42 @@ Server_Card *Server_CardZone::getCard(int id, int *position, bool remove)
         if (position)
             *position = id;
         if (remove) {
-            cards.removeAt(id);
+            takeCardAt(id);
             tmp->setZone(0);
         }
         return tmp;
     }
 }
 
-int Server_CardZone::getFreeGridColumn(int x, int y, const QString &cardName) const
+bool Server_CardZone::isFreeGridPosition(int x, int y) const
+{
+    return (x >= 0) && (x <= maxGridColumn) && !getCardAt(x, y);
+}
+
+int Server_CardZone::getFreeGridColumn(int x, int y, int cardNameId) const
 {
-    const QMap<int, Server_Card *> &coordMap = coordinateMap.value(y);
+    // Coordinates come from the client; keep the rows at a sane size.
+    if (x > maxGridColumn)
+        x = maxGridColumn;
+    
+    const GridRow *row = getGridRow(y);
+    if (!row)
+        return x >= 0 ? (x / 3) * 3 : 0;
+    
     if (x == -1) {
-        if (freePilesMap[y].contains(cardName)) {
-            x = (freePilesMap[y].value(cardName) / 3) * 3;
-            if (!coordMap.contains(x))
-                return x;
-            else if (!coordMap.contains(x + 1))
+        // Put the card onto the leftmost pile of cards with the same name that has room left.
+        int freePile = -1;
+        QSetIterator<int> pileIterator(row->pilesByName.value(cardNameId));
+        while (pileIterator.hasNext()) {
+            const int pile = pileIterator.next();
+            if ((freePile != -1) && (pile > freePile))
+                continue;
+            if (row->cardAt(pile * 3)->getAttachedCards().isEmpty() && !(row->cardAt(pile * 3 + 1) && row->cardAt(pile * 3 + 2)))
+                freePile = pile;
+        }
+        if (freePile != -1) {
+            x = freePile * 3;
+            if (!row->cardAt(x + 1))
                 return x + 1;
             else
                 return x + 2;
@@ -157,27 +255,27 @@ int Server_CardZone::getFreeGridColumn(int x, int y, const QString &cardName) co
     } else if (x >= 0) {
         int resultX = 0;
         x = (x / 3) * 3;
-        if (!coordMap.contains(x))
+        if (!row->cardAt(x))
             resultX = x;
-        else if (!coordMap.value(x)->getAttachedCards().isEmpty()) {
+        else if (!row->cardAt(x)->getAttachedCards().isEmpty()) {
             resultX = x;
             x = -1;
-        } else if (!coordMap.contains(x + 1))
+        } else if (!row->cardAt(x + 1))
             resultX = x + 1;
-        else if (!coordMap.contains(x + 2))
+        else if (!row->cardAt(x + 2))
             resultX = x + 2;
         else {
             resultX = x;
             x = -1;
         }
         if (x < 0)
-            while (coordMap.contains(resultX))
+            while (row->cardAt(resultX))
                 resultX += 3;
 
         return resultX;
     }
     
-    return freeSpaceMap[y];
+    return row->getFirstFreePile() * 3;
 }
 
 bool Server_CardZone::isColumnStacked(int x, int y) const
@@ -185,7 +283,7 @@ bool Server_CardZone::isColumnStacked(int x, int y) const
     if (!has_coords)
         return false;
     
-    return coordinateMap[y].contains((x / 3) * 3 + 1);
+    return getCardAt((x / 3) * 3 + 1, y);
 }
 
 bool Server_CardZone::isColumnEmpty(int x, int y) const
@@ -193,15 +291,14 @@ bool Server_CardZone::isColumnEmpty(int x, int y) const
     if (!has_coords)
         return true;
     
-    return !coordinateMap[y].contains((x / 3) * 3);
+    return !getCardAt((x / 3) * 3, y);
 }
 
 void Server_CardZone::moveCardInRow(GameEventStorage &ges, Server_Card *card, int x, int y)
 {
-    CardToMove *cardToMove = new CardToMove;
-    cardToMove->set_card_id(card->getId());
-    player->moveCard(ges, this, QList<const CardToMove *>() << cardToMove, this, x, y, false, false);
-    delete cardToMove;
+    CardToMove cardToMove;
+    cardToMove.set_card_id(card->getId());
+    player->moveCard(ges, this, QList<const CardToMove *>() << &cardToMove, this, x, y, false, false);
 }
 
 void Server_CardZone::fixFreeSpaces(GameEventStorage &ges)
@@ -219,17 +316,17 @@ void Server_CardZone::fixFreeSpaces(GameEventStorage &ges)
         int baseX = foo.first;
         int y = foo.second;
         
-        if (!coordinateMap[y].contains(baseX)) {
-            if (coordinateMap[y].contains(baseX + 1))
-                moveCardInRow(ges, coordinateMap[y].value(baseX + 1), baseX, y);
-            else if (coordinateMap[y].contains(baseX + 2)) {
-                moveCardInRow(ges, coordinateMap[y].value(baseX + 2), baseX, y);
+        if (!getCardAt(baseX, y)) {
+            if (getCardAt(baseX + 1, y))
+                moveCardInRow(ges, getCardAt(baseX + 1, y), baseX, y);
+            else if (getCardAt(baseX + 2, y)) {
+                moveCardInRow(ges, getCardAt(baseX + 2, y), baseX, y);
                 continue;
             } else
                 continue;
         }
-        if (!coordinateMap[y].contains(baseX + 1) && coordinateMap[y].contains(baseX + 2))
-            moveCardInRow(ges, coordinateMap[y].value(baseX + 2), baseX + 1, y);
+        if (!getCardAt(baseX + 1, y) && getCardAt(baseX + 2, y))
+            moveCardInRow(ges, getCardAt(baseX + 2, y), baseX + 1, y);
     }
 }
 
@@ -239,8 +336,8 @@ void Server_CardZone::updateCardCoordinates(Server_Card *card, int oldX, int old
         return;
     
     if (oldX != -1)
-        removeCardFromCoordMap(card, oldX, oldY);
-    insertCardIntoCoordMap(card, card->getX(), card->getY());
+        removeCardFromGrid(card, oldX, oldY);
+    insertCardIntoGrid(card, card->getX(), card->getY());
 }
 
 void Server_CardZone::insertCard(Server_Card *card, int x, int y)
@@ -248,13 +345,17 @@ void Server_CardZone::insertCard(Server_Card *card, int x, int y)
     if (hasCoords()) {
         card->setCoords(x, y);
         cards.append(card);
-        insertCardIntoCoordMap(card, x, y);
+        updateCardPositions(cards.size() - 1);
+        insertCardIntoGrid(card, x, y);
     } else {
         card->setCoords(0, 0);
-        if (x == -1)
+        if (x == -1) {
             cards.append(card);
-        else
+            updateCardPositions(cards.size() - 1);
+        } else {
             cards.insert(x, card);
+            updateCardPositions(x);
+        }
     }
     card->setZone(this);
 }
@@ -264,9 +365,8 @@ void Server_CardZone::clear()
     for (int i = 0; i < cards.size(); i++)
         delete cards.at(i);
     cards.clear();
-    coordinateMap.clear();
-    freePilesMap.clear();
-    freeSpaceMap.clear();
+    cardPositions.clear();
+    grid.clear();
     playersWithWritePermission.clear();
 }
 
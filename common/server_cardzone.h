@@ -23,15 +23,18 @@
 #include <QList>
 #include <QString>
 #include <QMap>
+#include <QHash>
 #include <QSet>
+#include <QVector>
 #include "pb/serverinfo_zone.pb.h"
+#include "server_object_pool.h"
 
 class Server_Card;
 class Server_Player;
 class Server_Game;
 class GameEventStorage;
 
-class Server_CardZone {
+class Server_CardZone : public Server_PooledObject {
 private:
 	Server_Player *player;
 	QString name;
@@ -41,11 +44,26 @@ private:
 	QSet<int> playersWithWritePermission;
 	bool alwaysRevealTopCard;
 	QList<Server_Card *> cards;
-	QMap<int, QMap<int, Server_Card *> > coordinateMap; // y -> (x -> card)
-	QMap<int, QMultiMap<QString, int> > freePilesMap; // y -> (cardName -> x)
-	QMap<int, int> freeSpaceMap; // y -> x
-	void removeCardFromCoordMap(Server_Card *card, int oldX, int oldY);
-	void insertCardIntoCoordMap(Server_Card *card, int x, int y);
+	QHash<int, int> cardPositions; // card id -> index in cards, not kept for hidden zones
+	
+	// A row of the table, made of piles of three columns each.
+	class GridRow {
+	public:
+		QVector<Server_Card *> columns; // x -> card
+		QVector<quint32> usedPiles; // bitmap of piles with at least one card
+		QHash<int, QSet<int> > pilesByName; // card name id (see CardNameTable) -> piles with a card of that name in the first column
+		Server_Card *cardAt(int x) const { return ((x >= 0) && (x < columns.size())) ? columns[x] : 0; }
+		void setPileUsed(int pile, bool used);
+		int getFirstFreePile() const;
+	};
+	QMap<int, GridRow> grid; // y -> row
+	const GridRow *getGridRow(int y) const;
+	static void removePileName(GridRow &row, int cardNameId, int pile);
+	Server_Card *getCardAt(int x, int y) const;
+	void removeCardFromGrid(Server_Card *card, int oldX, int oldY);
+	void insertCardIntoGrid(Server_Card *card, int x, int y);
+	void updateCardPositions(int from);
+	Server_Card *takeCardAt(int index);
 public:
 	Server_CardZone(Server_Player *_player, const QString &_name, bool _has_coords, ServerInfo_Zone::ZoneType _type);
 	~Server_CardZone();
@@ -53,6 +71,7 @@ public:
 	const QList<Server_Card *> &getCards() const { return cards; }
 	int removeCard(Server_Card *card);
 	Server_Card *getCard(int id, int *position = NULL, bool remove = false);
+	void updateCardId(Server_Card *card, int oldId);
 
 	int getCardsBeingLookedAt() const { return cardsBeingLookedAt; }
 	void setCardsBeingLookedAt(int _cardsBeingLookedAt) { cardsBeingLookedAt = _cardsBeingLookedAt; }
@@ -62,7 +81,8 @@ public:
 	Server_Player *getPlayer() const { return player; }
 	void getInfo(ServerInfo_Zone *info, Server_Player *playerWhosAsking, bool omniscient);
 	
-	int getFreeGridColumn(int x, int y, const QString &cardName) const;
+	int getFreeGridColumn(int x, int y, int cardNameId) const;
+	bool isFreeGridPosition(int x, int y) const;
 	bool isColumnEmpty(int x, int y) const;
 	bool isColumnStacked(int x, int y) const;
 	void fixFreeSpaces(GameEventStorage &ges);
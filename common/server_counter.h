@@ -22,10 +22,11 @@
 
 #include <QString>
 #include "pb/color.pb.h"
+#include "server_object_pool.h"
 
 class ServerInfo_Counter;
 
-class Server_Counter {
+class Server_Counter : public Server_PooledObject {
 protected:
 	int id;
 	QString name;
@@ -20,6 +20,8 @@ public:
 	virtual ServerInfo_User getUserData(const QString &name, bool withId = false) = 0;
 	virtual void storeGameInformation(const QString &roomName, const QStringList &roomGameTypes, const ServerInfo_Game &gameInfo, const QSet<QString> &allPlayersEver, const QSet<QString> &allSpectatorsEver, const QList<GameReplay *> &replayList) { }
 	virtual DeckList *getDeckFromDatabase(int deckId, int userId) { return 0; }
+	// Native deck string of a stored deck; a null string if unsupported.
+	virtual QString getDeckContentFromDatabase(int deckId, int userId) { return QString(); }
 	
 	virtual qint64 startSession(const QString &userName, const QString &address) { return 0; }
 public slots:
@@ -0,0 +1,151 @@
+#include "server_deck_cache.h"
+#include "decklist.h"
+#include "card_name_table.h"
+#include <QCryptographicHash>
+#include <QMutexLocker>
+
+Server_ParsedDeck::Server_ParsedDeck(DeckList &deck)
+	: nativeString(deck.writeToString_Native()), deckHash(deck.getDeckHash()), sideboardSize(0), sideboardPlan(deck.getCurrentSideboardPlan())
+{
+	InnerDecklistNode *listRoot = deck.getRoot();
+	for (int i = 0; i < listRoot->size(); ++i) {
+		InnerDecklistNode *currentZone = dynamic_cast<InnerDecklistNode *>(listRoot->at(i));
+		QVector<CardCount> *cards;
+		if (currentZone->getName() == "main")
+			cards = &mainCards;
+		else if (currentZone->getName() == "side")
+			cards = &sideCards;
+		else
+			continue;
+		
+		for (int j = 0; j < currentZone->size(); ++j) {
+			DecklistCardNode *currentCard = dynamic_cast<DecklistCardNode *>(currentZone->at(j));
+			if (!currentCard || (currentCard->getNumber() <= 0))
+				continue;
+			CardCount entry;
+			entry.nameId = CardNameTable::acquire(currentCard->getName());
+			entry.count = currentCard->getNumber();
+			cards->append(entry);
+		}
+	}
+	for (int i = 0; i < sideCards.size(); ++i)
+		sideboardSize += sideCards[i].count;
+}
+
+Server_ParsedDeck::~Server_ParsedDeck()
+{
+	for (int i = 0; i < mainCards.size(); ++i)
+		CardNameTable::release(mainCards[i].nameId);
+	for (int i = 0; i < sideCards.size(); ++i)
+		CardNameTable::release(sideCards[i].nameId);
+}
+
+int Server_ParsedDeck::getMemoryUsage() const
+{
+	return sizeof(*this)
+		+ (nativeString.size() + deckHash.size()) * sizeof(QChar)
+		+ (mainCards.size() + sideCards.size()) * sizeof(CardCount)
+		+ sideboardPlan.size() * (sizeof(MoveCard_ToZone) + 64);
+}
+
+QString Server_ParsedDeck::writeToString_Native(const QList<MoveCard_ToZone> &plan) const
+{
+	DeckList deck(nativeString);
+	deck.setCurrentSideboardPlan(plan);
+	return deck.writeToString_Native();
+}
+
+Server_DeckCache::Server_DeckCache(int _capacity, qint64 _maxMemoryUsage)
+	: capacity(_capacity), maxMemoryUsage(_maxMemoryUsage), memoryUsage(0), hits(0), misses(0)
+{
+}
+
+QSharedPointer<const Server_ParsedDeck> Server_DeckCache::getDeck(const QString &nativeString)
+{
+	const QByteArray key = QCryptographicHash::hash(nativeString.toUtf8(), QCryptographicHash::Sha1);
+	
+	mutex.lock();
+	QHash<QByteArray, Entry>::iterator it = entries.find(key);
+	if (it != entries.end()) {
+		++hits;
+		usageList.erase(it->usage);
+		it->usage = usageList.insert(usageList.begin(), key);
+		QSharedPointer<const Server_ParsedDeck> result = it->deck;
+		mutex.unlock();
+		return result;
+	}
+	++misses;
+	mutex.unlock();
+	
+	// Parse without holding the lock; if another thread was faster, use its copy.
+	DeckList deckList(nativeString);
+	QSharedPointer<const Server_ParsedDeck> result(new Server_ParsedDeck(deckList));
+	
+	const int deckMemoryUsage = result->getMemoryUsage();
+	QMutexLocker locker(&mutex);
+	if ((capacity <= 0) || (deckMemoryUsage > maxMemoryUsage))
+		return result;
+	it = entries.find(key);
+	if (it != entries.end())
+		return it->deck;
+	Entry entry;
+	entry.deck = result;
+	entry.usage = usageList.insert(usageList.begin(), key);
+	entry.memoryUsage = deckMemoryUsage;
+	entries.insert(key, entry);
+	memoryUsage += deckMemoryUsage;
+	evict();
+	return result;
+}
+
+void Server_DeckCache::evict()
+{
+	while ((entries.size() > capacity) || (memoryUsage > maxMemoryUsage)) {
+		memoryUsage -= entries.take(usageList.last()).memoryUsage;
+		usageList.removeLast();
+	}
+}
+
+void Server_DeckCache::setCapacity(int _capacity)
+{
+	QMutexLocker locker(&mutex);
+	capacity = qMax(0, _capacity);
+	evict();
+}
+
+int Server_DeckCache::getCapacity()
+{
+	QMutexLocker locker(&mutex);
+	return capacity;
+}
+
+void Server_DeckCache::setMaxMemoryUsage(qint64 _maxMemoryUsage)
+{
+	QMutexLocker locker(&mutex);
+	maxMemoryUsage = qMax((qint64) 0, _maxMemoryUsage);
+	evict();
+}
+
+qint64 Server_DeckCache::getMemoryUsage()
+{
+	QMutexLocker locker(&mutex);
+	return memoryUsage;
+}
+
+int Server_DeckCache::getSize()
+{
+	QMutexLocker locker(&mutex);
+	return entries.size();
+}
+
+qint64 Server_DeckCache::getHits()
+{
+	QMutexLocker locker(&mutex);
+	return hits;
+}
+
+qint64 Server_DeckCache::getMisses()
+{
+	QMutexLocker locker(&mutex);
+	return misses;
+}
@@ -0,0 +1,81 @@
+#ifndef SERVER_DECK_CACHE_H
+#define SERVER_DECK_CACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QLinkedList>
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include "pb/move_card_to_zone.pb.h"
+
+class DeckList;
+
+// Compact, immutable form of a deck list as the server needs it for a game.
+// Instances are shared between players, games and threads.
+class Server_ParsedDeck {
+	Q_DISABLE_COPY(Server_ParsedDeck)
+public:
+	struct CardCount {
+		int nameId; // holds a reference, see CardNameTable
+		int count;
+	};
+private:
+	QString nativeString;
+	QString deckHash;
+	QVector<CardCount> mainCards, sideCards;
+	int sideboardSize;
+	QList<MoveCard_ToZone> sideboardPlan;
+public:
+	Server_ParsedDeck(DeckList &deck);
+	~Server_ParsedDeck();
+	const QString &getNativeString() const { return nativeString; }
+	const QString &getDeckHash() const { return deckHash; }
+	const QVector<CardCount> &getMainCards() const { return mainCards; }
+	const QVector<CardCount> &getSideCards() const { return sideCards; }
+	int getSideboardSize() const { return sideboardSize; }
+	const QList<MoveCard_ToZone> &getSideboardPlan() const { return sideboardPlan; }
+	// Approximate memory held by the deck, in bytes.
+	int getMemoryUsage() const;
+	// Native deck string with a different sideboard plan.
+	QString writeToString_Native(const QList<MoveCard_ToZone> &plan) const;
+};
+
+// LRU cache of parsed decks, keyed by a digest of the native deck string.
+// It is bounded both by the number of decks and by the memory they use,
+// since deck lists come from the clients and can be of any size.
+class Server_DeckCache {
+private:
+	typedef QLinkedList<QByteArray> UsageList;
+	struct Entry {
+		QSharedPointer<const Server_ParsedDeck> deck;
+		UsageList::iterator usage;
+		int memoryUsage;
+	};
+	
+	QMutex mutex;
+	int capacity;
+	qint64 maxMemoryUsage, memoryUsage;
+	QHash<QByteArray, Entry> entries;
+	UsageList usageList; // most recently used first
+	qint64 hits, misses;
+	
+	void evict();
+public:
+	Server_DeckCache(int _capacity = 1000, qint64 _maxMemoryUsage = 64 * 1048576);
+	// Returns the parsed deck for a native deck string, parsing it on a miss.
+	QSharedPointer<const Server_ParsedDeck> getDeck(const QString &nativeString);
+	// A capacity of 0 disables caching.
+	void setCapacity(int _capacity);
+	int getCapacity();
+	// In bytes. Decks larger than this are never cached.
+	void setMaxMemoryUsage(qint64 _maxMemoryUsage);
+	int getSize();
+	qint64 getMemoryUsage();
+	qint64 getHits();
+	qint64 getMisses();
+};
+
+#endif
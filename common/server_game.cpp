@@ -25,6 +25,7 @@
 #include "server_arrow.h"
 #include "server_card.h"
 #include "server_cardzone.h"
+#include "server_object_pool.h"
 #include "server_database_interface.h"
 #include "decklist.h"
 #include "pb/context_connection_state_changed.pb.h"
@@ -42,11 +43,38 @@
 #include "pb/event_set_active_phase.pb.h"
 #include "pb/serverinfo_playerping.pb.h"
 #include "pb/game_replay.pb.h"
+#include "pb/game_snapshot.pb.h"
 #include "pb/event_replay_added.pb.h"
-#include <google/protobuf/descriptor.h>
+#include "get_pb_extension.h"
 #include <QTimer>
 #include <QDebug>
 
+// Serialized parts of a message can be put together without parsing them again:
+// protobuf accepts the fields of a message in any order.
+static void appendVarint(QByteArray &data, quint32 value)
+{
+	while (value >= 0x80) {
+		data.append((char) ((value & 0x7f) | 0x80));
+		value >>= 7;
+	}
+	data.append((char) value);
+}
+
+static void appendSerializedField(QByteArray &data, int fieldNumber, const QByteArray &value)
+{
+	appendVarint(data, (fieldNumber << 3) | 2); // length delimited
+	appendVarint(data, value.size());
+	data.append(value);
+}
+
+static QByteArray serializeMessage(const ::google::protobuf::Message &message)
+{
+	QByteArray data;
+	data.resize(message.ByteSize());
+	message.SerializeToArray(data.data(), data.size());
+	return data;
+}
+
 Server_Game::Server_Game(const ServerInfo_User &_creatorInfo, int _gameId, const QString &_description, const QString &_password, int _maxPlayers, const QList<int> &_gameTypes, bool _onlyBuddies, bool _onlyRegistered, bool _spectatorsAllowed, bool _spectatorsNeedPassword, bool _spectatorsCanTalk, bool _spectatorsSeeEverything, Server_Room *_room)
 	: QObject(),
           room(_room),
@@ -73,15 +101,81 @@ Server_Game::Server_Game(const ServerInfo_User &_creatorInfo, int _gameId, const
           secondsElapsed(0),
           firstGameStarted(false),
           startTime(QDateTime::currentDateTime()),
+          stateVersion(1),
+          hibernated(false),
+          migrated(false),
+          hibernationRequested(false),
           gameMutex(QMutex::Recursive)
 {
+	initialize();
+	
 	currentReplay = new GameReplay;
 	currentReplay->set_replay_id(room->getServer()->getDatabaseInterface()->getNextReplayId());
+	getInfo(*currentReplay->mutable_game_info());
+}
+
+Server_Game::Server_Game(const GameSnapshot &snapshot, Server_Room *_room)
+	: QObject(),
+          room(_room),
+          nextPlayerId(snapshot.next_player_id()),
+          hostId(snapshot.host_id()),
+          creatorInfo(new ServerInfo_User(snapshot.game_info().creator_info())),
+          gameStarted(snapshot.game_info().started()),
+          gameClosed(false),
+          gameId(snapshot.game_info().game_id()),
+          description(QString::fromStdString(snapshot.game_info().description())),
+          password(QString::fromStdString(snapshot.password())),
+          maxPlayers(snapshot.game_info().max_players()),
+          activePlayer(snapshot.active_player()),
+          activePhase(snapshot.active_phase()),
+          onlyBuddies(snapshot.game_info().only_buddies()),
+          onlyRegistered(snapshot.game_info().only_registered()),
+          spectatorsAllowed(snapshot.game_info().spectators_allowed()),
+          spectatorsNeedPassword(snapshot.game_info().spectators_need_password()),
+          spectatorsCanTalk(snapshot.game_info().spectators_can_chat()),
+          spectatorsSeeEverything(snapshot.game_info().spectators_omniscient()),
+          inactivityCounter(snapshot.inactivity_counter()),
+          startTimeOfThisGame(snapshot.start_time_of_this_game()),
+          secondsElapsed(snapshot.seconds_elapsed()),
+          firstGameStarted(snapshot.first_game_started()),
+          startTime(QDateTime::fromTime_t(snapshot.game_info().start_time())),
+          currentReplay(new GameReplay(snapshot.current_replay())),
+          stateVersion(1),
+          hibernated(false),
+          migrated(false),
+          hibernationRequested(false),
+          gameMutex(QMutex::Recursive)
+{
+	for (int i = 0; i < snapshot.game_info().game_types_size(); ++i)
+		gameTypes.append(snapshot.game_info().game_types(i));
+	for (int i = 0; i < snapshot.all_players_ever_size(); ++i)
+		allPlayersEver.insert(QString::fromStdString(snapshot.all_players_ever(i)));
+	for (int i = 0; i < snapshot.all_spectators_ever_size(); ++i)
+		allSpectatorsEver.insert(QString::fromStdString(snapshot.all_spectators_ever(i)));
+	for (int i = 0; i < snapshot.replay_list_size(); ++i)
+		replayList.append(new GameReplay(snapshot.replay_list(i)));
+	
+	initialize();
+	
+	for (int i = 0; i < snapshot.player_list_size(); ++i) {
+		const ServerInfo_PlayerProperties &properties = snapshot.player_list(i).info().properties();
+		Server_Player *player = new Server_Player(this, properties.player_id(), properties.user_info(), properties.spectator(), 0);
+		player->restoreSnapshot(snapshot.player_list(i));
+		players.insert(player->getPlayerId(), player);
+	}
+	// Attachments and arrows may point to cards of other players.
+	for (int i = 0; i < snapshot.player_list_size(); ++i)
+		players.value(snapshot.player_list(i).info().properties().player_id())->restoreSnapshotLinks(snapshot.player_list(i));
+}
+
+void Server_Game::initialize()
+{
+	objectPool = Server_ObjectPool::isEnabled() ? new Server_ObjectPool : 0;
+	for (int i = 0; i < 2; ++i)
+		stateSnapshotVersions[i] = 0;
 	
 	connect(this, SIGNAL(sigStartGameIfReady()), this, SLOT(doStartGameIfReady()), Qt::QueuedConnection);
 	
-	getInfo(*currentReplay->mutable_game_info());
-
 	if (room->getServer()->getGameShouldPing()) {
 		pingClock = new QTimer(this);
 		connect(pingClock, SIGNAL(timeout()), this, SLOT(pingClockTimeout()));
@@ -94,29 +188,43 @@ Server_Game::~Server_Game()
 	room->gamesLock.lockForWrite();
 	gameMutex.lock();
 	
-	gameClosed = true;
-	sendGameEventContainer(prepareGameEvent(Event_GameClosed(), -1));
+	// A hibernated or migrated game lives on in its snapshot: it is not announced as closed,
+	// its replays are not stored yet and the room has already taken it off the list.
+	// Users of a migrated game keep playing it on the other server.
+	const bool livesOn = hibernated || migrated;
+	if (!livesOn) {
+		gameClosed = true;
+		sendGameEventContainer(prepareGameEvent(Event_GameClosed(), -1));
+	}
 	
 	QMapIterator<int, Server_Player *> playerIterator(players);
 	while (playerIterator.hasNext())
-		playerIterator.next().value()->prepareDestroy();
+		playerIterator.next().value()->prepareDestroy(!migrated);
 	players.clear();
 	
-	room->removeGame(this);
+	if (!livesOn)
+		room->removeGame(this);
 	delete creatorInfo;
 	creatorInfo = 0;
 	
 	gameMutex.unlock();
 	room->gamesLock.unlock();
 	
-	currentReplay->set_duration_seconds(secondsElapsed - startTimeOfThisGame);
-	replayList.append(currentReplay);
-	storeGameInformation();
+	if (livesOn)
+		delete currentReplay;
+	else {
+		currentReplay->set_duration_seconds(secondsElapsed - startTimeOfThisGame);
+		replayList.append(currentReplay);
+		storeGameInformation();
+	}
 	
 	for (int i = 0; i < replayList.size(); ++i)
 		delete replayList[i];
 	
-	qDebug() << "Server_Game destructor: gameId=" << gameId;
+	if (objectPool)
+		objectPool->detach();
+	
+	qDebug() << "Server_Game destructor: gameId=" << gameId << (hibernated ? "(hibernated)" : (migrated ? "(migrated)" : ""));
 }
 
 void Server_Game::storeGameInformation()
@@ -204,13 +312,72 @@ void Server_Game::pingClockTimeout()
 	ges.sendToGame(this);
 	
 	const int maxTime = room->getServer()->getMaxGameInactivityTime();
+	const int hibernationTime = room->getServer()->getGameHibernationTime();
 	if (allPlayersInactive) {
 		if (((++inactivityCounter >= maxTime) && (maxTime > 0)) || (playerCount < maxPlayers))
 			deleteLater();
+		else if ((hibernationTime > 0) && (inactivityCounter >= hibernationTime) && !hibernationRequested && getCanHibernate()) {
+			// The room needs gamesLock, which must not be taken while gameMutex is held.
+			hibernationRequested = true;
+			QMetaObject::invokeMethod(this, "hibernate", Qt::QueuedConnection);
+		}
 	} else
 		inactivityCounter = 0;
 }
 
+void Server_Game::hibernate()
+{
+	if (!room->hibernateGame(this))
+		hibernationRequested = false;
+}
+
+bool Server_Game::getCanHibernate() const
+{
+	QMutexLocker locker(&gameMutex);
+	
+	if (gameClosed || players.isEmpty())
+		return false;
+	QMapIterator<int, Server_Player *> playerIterator(players);
+	while (playerIterator.hasNext()) {
+		Server_Player *player = playerIterator.next().value();
+		if (player->getSpectator())
+			return false;
+		QMutexLocker playerLocker(&player->playerMutex);
+		if (player->getUserInterface())
+			return false;
+	}
+	return true;
+}
+
+void Server_Game::getSnapshot(GameSnapshot &snapshot)
+{
+	QMutexLocker locker(&gameMutex);
+	
+	getInfo(*snapshot.mutable_game_info());
+	snapshot.set_password(password.toStdString());
+	snapshot.set_host_id(hostId);
+	snapshot.set_next_player_id(nextPlayerId);
+	snapshot.set_active_player(activePlayer);
+	snapshot.set_active_phase(activePhase);
+	snapshot.set_seconds_elapsed(secondsElapsed);
+	snapshot.set_start_time_of_this_game(startTimeOfThisGame);
+	snapshot.set_first_game_started(firstGameStarted);
+	snapshot.set_inactivity_counter(inactivityCounter);
+	QSetIterator<QString> playersEverIterator(allPlayersEver);
+	while (playersEverIterator.hasNext())
+		snapshot.add_all_players_ever(playersEverIterator.next().toStdString());
+	QSetIterator<QString> spectatorsEverIterator(allSpectatorsEver);
+	while (spectatorsEverIterator.hasNext())
+		snapshot.add_all_spectators_ever(spectatorsEverIterator.next().toStdString());
+	for (int i = 0; i < replayList.size(); ++i)
+		snapshot.add_replay_list()->CopyFrom(*replayList[i]);
+	snapshot.mutable_current_replay()->CopyFrom(*currentReplay);
+	
+	QMapIterator<int, Server_Player *> playerIterator(players);
+	while (playerIterator.hasNext())
+		playerIterator.next().value()->getSnapshot(*snapshot.add_player_list());
+}
+
 int Server_Game::getPlayerCount() const
 {
 	QMutexLocker locker(&gameMutex);
@@ -252,6 +419,8 @@ void Server_Game::createGameStateChangedEvent(Event_GameStateChanged *event, Ser
 
 void Server_Game::sendGameStateToPlayers()
 {
+	++stateVersion;
+	
 	// game state information for replay and omniscient spectators
 	Event_GameStateChanged omniscientEvent;
 	createGameStateChangedEvent(&omniscientEvent, 0, true, false);
@@ -259,8 +428,7 @@ void Server_Game::sendGameStateToPlayers()
 	GameEventContainer *replayCont = prepareGameEvent(omniscientEvent, -1);
 	replayCont->set_seconds_elapsed(secondsElapsed - startTimeOfThisGame);
 	replayCont->clear_game_id();
-	currentReplay->add_event_list()->CopyFrom(*replayCont);
-	delete replayCont;
+	currentReplay->mutable_event_list()->AddAllocated(replayCont);
 	
 	// If spectators are not omniscient, we need an additional createGameStateChangedEvent call, otherwise we can use the data we used for the replay.
 	// All spectators are equal, so we don't need to make a createGameStateChangedEvent call for each one.
@@ -331,8 +499,7 @@ void Server_Game::doStartGameIfReady()
 		GameEventContainer *replayCont = prepareGameEvent(omniscientEvent, -1);
 		replayCont->set_seconds_elapsed(0);
 		replayCont->clear_game_id();
-		currentReplay->add_event_list()->CopyFrom(*replayCont);
-		delete replayCont;
+		currentReplay->mutable_event_list()->AddAllocated(replayCont);
 		
 		startTimeOfThisGame = secondsElapsed;
 	} else
@@ -432,6 +599,15 @@ bool Server_Game::containsUser(const QString &userName) const
 	return false;
 }
 
+bool Server_Game::getParticipantsSupportFeature(int feature) const
+{
+	QMapIterator<int, Server_Player *> playerIterator(players);
+	while (playerIterator.hasNext())
+		if (!(playerIterator.next().value()->getUserInfo()->client_features() & feature))
+			return false;
+	return true;
+}
+
 void Server_Game::addPlayer(Server_AbstractUserInterface *userInterface, ResponseContainer &rc, bool spectator, bool broadcastUpdate)
 {
 	QMutexLocker locker(&gameMutex);
@@ -449,6 +625,8 @@ void Server_Game::addPlayer(Server_AbstractUserInterface *userInterface, Respons
 	else
 		allPlayersEver.insert(playerName);
 	players.insert(newPlayer->getPlayerId(), newPlayer);
+	room->getUserGameIndex().addUser(playerName, gameId);
+	++stateVersion;
 	if (newPlayer->getUserInfo()->name() == creatorInfo->name()) {
 		hostId = newPlayer->getPlayerId();
 		sendGameEventContainer(prepareGameEvent(Event_GameHostChanged(), hostId));
@@ -473,8 +651,11 @@ void Server_Game::addPlayer(Server_AbstractUserInterface *userInterface, Respons
 
 void Server_Game::removePlayer(Server_Player *player)
 {
-	room->getServer()->removePersistentPlayer(QString::fromStdString(player->getUserInfo()->name()), room->getId(), gameId, player->getPlayerId());
+	const QString playerName = QString::fromStdString(player->getUserInfo()->name());
+	room->getServer()->removePersistentPlayer(playerName, room->getId(), gameId, player->getPlayerId());
+	room->getUserGameIndex().removeUser(playerName, gameId);
 	players.remove(player->getPlayerId());
+	++stateVersion;
 	
 	GameEventStorage ges;
 	removeArrowsRelatedToPlayer(ges, player);
@@ -664,23 +845,106 @@ void Server_Game::createGameJoinedEvent(Server_Player *player, ResponseContainer
 	}
 	rc.enqueuePostResponseItem(ServerMessage::SESSION_EVENT, Server_AbstractUserInterface::prepareSessionEvent(event1));
 	
+	// Spectators see the same as an outsider, players only differ in their own entry.
+	// The event is put together from the serialized entries of the snapshot.
+	const bool omniscient = player->getSpectator() && spectatorsSeeEverything;
+	const QList<StateSnapshotEntry> &snapshot = getStateSnapshot(omniscient);
+	
 	Event_GameStateChanged event2;
 	event2.set_seconds_elapsed(secondsElapsed);
 	event2.set_game_started(gameStarted);
 	event2.set_active_player_id(activePlayer);
 	event2.set_active_phase(activePhase);
+	QByteArray stateChanged = serializeMessage(event2);
+	
+	// Ping times change without invalidating the snapshot, so changed ones follow the state.
+	GameEventContainer pingUpdates;
+	for (int i = 0; i < snapshot.size(); ++i) {
+		if (!player->getSpectator() && (snapshot[i].playerId == player->getPlayerId())) {
+			ServerInfo_Player playerInfo;
+			player->getInfo(&playerInfo, player, false, true);
+			appendSerializedField(stateChanged, Event_GameStateChanged::kPlayerListFieldNumber, serializeMessage(playerInfo));
+			continue;
+		}
+		stateChanged.append(snapshot[i].serialized);
+		
+		Server_Player *otherPlayer = players.value(snapshot[i].playerId);
+		if (otherPlayer && (otherPlayer->getPingTime() != snapshot[i].pingTime)) {
+			Event_PlayerPropertiesChanged pingEvent;
+			pingEvent.mutable_player_properties()->set_ping_seconds(otherPlayer->getPingTime());
+			GameEvent *event = pingUpdates.add_event_list();
+			event->set_player_id(snapshot[i].playerId);
+			setPbExtension(*event, pingEvent);
+		}
+	}
 	
-	QMapIterator<int, Server_Player *> playerIterator(players);
-	while (playerIterator.hasNext())
-		playerIterator.next().value()->getInfo(event2.add_player_list(), player, player->getSpectator() && spectatorsSeeEverything, true);
+	QByteArray gameEvent;
+	appendSerializedField(gameEvent, Event_GameStateChanged::kExtFieldNumber, stateChanged);
+	GameEventContainer cont;
+	cont.set_game_id(gameId);
+	QByteArray contData = serializeMessage(cont);
+	appendSerializedField(contData, GameEventContainer::kEventListFieldNumber, gameEvent);
+	contData.append(serializeMessage(pingUpdates));
+	ServerMessage msg;
+	msg.set_message_type(ServerMessage::GAME_EVENT_CONTAINER);
+	QByteArray msgData = serializeMessage(msg);
+	appendSerializedField(msgData, ServerMessage::kGameEventContainerFieldNumber, contData);
+	
+	rc.enqueuePostResponseItem(Server_ProtocolHandler::serializeProtocolItem(msgData));
+}
+
+const QList<Server_Game::StateSnapshotEntry> &Server_Game::getStateSnapshot(bool omniscient)
+{
+	QList<StateSnapshotEntry> &snapshot = stateSnapshots[omniscient];
+	if (stateSnapshotVersions[omniscient] != stateVersion) {
+		snapshot.clear();
+		QMapIterator<int, Server_Player *> playerIterator(players);
+		while (playerIterator.hasNext()) {
+			Server_Player *player = playerIterator.next().value();
+			ServerInfo_Player playerInfo;
+			player->getInfo(&playerInfo, 0, omniscient, true);
+			
+			StateSnapshotEntry entry;
+			entry.playerId = player->getPlayerId();
+			entry.pingTime = player->getPingTime();
+			appendSerializedField(entry.serialized, Event_GameStateChanged::kPlayerListFieldNumber, serializeMessage(playerInfo));
+			snapshot.append(entry);
+		}
+		stateSnapshotVersions[omniscient] = stateVersion;
+	}
+	return snapshot;
+}
 
-	rc.enqueuePostResponseItem(ServerMessage::GAME_EVENT_CONTAINER, prepareGameEvent(event2, -1));
+bool Server_Game::changesGameState(const GameEventContainer &cont)
+{
+	// Chat, dice, reveals and ping times leave the join snapshots as they are.
+	for (int i = 0; i < cont.event_list_size(); ++i) {
+		const GameEvent &event = cont.event_list(i);
+		switch (getPbExtension(event)) {
+			case GameEvent::GAME_SAY:
+			case GameEvent::ROLL_DIE:
+			case GameEvent::REVEAL_CARDS:
+				break;
+			case GameEvent::PLAYER_PROPERTIES_CHANGED: {
+				ServerInfo_PlayerProperties properties(event.GetExtension(Event_PlayerPropertiesChanged::ext).player_properties());
+				properties.clear_ping_seconds();
+				if (properties.ByteSize())
+					return true;
+				break;
+			}
+			default:
+				return true;
+		}
+	}
+	return false;
 }
 
 void Server_Game::sendGameEventContainer(GameEventContainer *cont, GameEventStorageItem::EventRecipients recipients, int privatePlayerId)
 {
 	QMutexLocker locker(&gameMutex);
 	
+	if (changesGameState(*cont))
+		++stateVersion;
 	cont->set_game_id(gameId);
 	QMapIterator<int, Server_Player *> playerIterator(players);
 	while (playerIterator.hasNext()) {
@@ -692,10 +956,9 @@ void Server_Game::sendGameEventContainer(GameEventContainer *cont, GameEventStor
 	if (recipients.testFlag(GameEventStorageItem::SendToPrivate)) {
 		cont->set_seconds_elapsed(secondsElapsed - startTimeOfThisGame);
 		cont->clear_game_id();
-		currentReplay->add_event_list()->CopyFrom(*cont);
-	}
-	
-	delete cont;
+		currentReplay->mutable_event_list()->AddAllocated(cont);
+	} else
+		delete cont;
 }
 
 GameEventContainer *Server_Game::prepareGameEvent(const ::google::protobuf::Message &gameEvent, int playerId, GameEventContext *context)
@@ -707,7 +970,7 @@ GameEventContainer *Server_Game::prepareGameEvent(const ::google::protobuf::Mess
 	GameEvent *event = cont->add_event_list();
 	if (playerId != -1)
 		event->set_player_id(playerId);
-	event->GetReflection()->MutableMessage(event, gameEvent.GetDescriptor()->FindExtensionByName("ext"))->CopyFrom(gameEvent);
+	setPbExtension(*event, gameEvent);
 	return cont;
 }
 
@@ -40,6 +40,8 @@ class ServerInfo_Player;
 class ServerInfo_Game;
 class Server_AbstractUserInterface;
 class Event_GameStateChanged;
+class Server_ObjectPool;
+class GameSnapshot;
 
 class Server_Game : public QObject {
 	Q_OBJECT
@@ -70,8 +72,28 @@ private:
 	QTimer *pingClock;
 	QList<GameReplay *> replayList;
 	GameReplay *currentReplay;
+	Server_ObjectPool *objectPool;
+	// Bumped on every change of the game state, invalidates the join snapshots.
+	quint64 stateVersion;
+	// Player list entries as seen by spectators, indexed by omniscience. They are kept
+	// serialized, so joins only copy bytes until the state changes.
+	class StateSnapshotEntry {
+	public:
+		int playerId;
+		int pingTime;
+		QByteArray serialized; // a player_list field of Event_GameStateChanged
+	};
+	QList<StateSnapshotEntry> stateSnapshots[2];
+	quint64 stateSnapshotVersions[2];
+	// Set when the game was written to disk or handed to another server
+	// and is deleted without being closed.
+	bool hibernated;
+	bool migrated;
+	bool hibernationRequested;
 	
-	void createGameStateChangedEvent(Event_GameStateChanged *event, Server_Player *playerWhosAsking, bool omniscient, bool withUserInfo);
+	void initialize();
+	const QList<StateSnapshotEntry> &getStateSnapshot(bool omniscient);
+	static bool changesGameState(const GameEventContainer &cont);
 	void sendGameStateToPlayers();
 	void storeGameInformation();
 signals:
@@ -80,15 +102,19 @@ signals:
 private slots:
 	void pingClockTimeout();
 	void doStartGameIfReady();
+	void hibernate();
 public:
 	mutable QMutex gameMutex;
 	Server_Game(const ServerInfo_User &_creatorInfo, int _gameId, const QString &_description, const QString &_password, int _maxPlayers, const QList<int> &_gameTypes, bool _onlyBuddies, bool _onlyRegistered, bool _spectatorsAllowed, bool _spectatorsNeedPassword, bool _spectatorsCanTalk, bool _spectatorsSeeEverything, Server_Room *parent);
+	// Rehydrates a hibernated or migrated game, see Server_Room::rehydrateGame() and Server_Room::adoptGame().
+	Server_Game(const GameSnapshot &snapshot, Server_Room *_room);
 	~Server_Game();
 	Server_Room *getRoom() const { return room; }
 	void getInfo(ServerInfo_Game &result) const;
 	int getHostId() const { return hostId; }
 	ServerInfo_User *getCreatorInfo() const { return creatorInfo; }
 	bool getGameStarted() const { return gameStarted; }
+	bool getGameClosed() const { return gameClosed; }
 	int getPlayerCount() const;
 	int getSpectatorCount() const;
 	const QMap<int, Server_Player *> &getPlayers() const { return players; }
@@ -102,6 +128,8 @@ public:
 	bool getSpectatorsSeeEverything() const { return spectatorsSeeEverything; }
 	Response::ResponseCode checkJoin(ServerInfo_User *user, const QString &_password, bool spectator, bool overrideRestrictions);
 	bool containsUser(const QString &userName) const;
+	// Whether all players and spectators announced a ServerInfo_User::ProtocolFeature.
+	bool getParticipantsSupportFeature(int feature) const;
 	void addPlayer(Server_AbstractUserInterface *userInterface, ResponseContainer &rc, bool spectator, bool broadcastUpdate = true);
 	void removePlayer(Server_Player *player);
 	void removeArrowsRelatedToPlayer(GameEventStorage &ges, Server_Player *player);
@@ -115,7 +143,15 @@ public:
 	void setActivePhase(int _activePhase);
 	void nextTurn();
 	int getSecondsElapsed() const { return secondsElapsed; }
+	Server_ObjectPool *getObjectPool() const { return objectPool; }
+	
+	// A game can hibernate when only disconnected players and no spectators are left.
+	bool getCanHibernate() const;
+	void getSnapshot(GameSnapshot &snapshot);
+	void setHibernated() { hibernated = true; }
+	void setMigrated() { migrated = true; }
 
+	void createGameStateChangedEvent(Event_GameStateChanged *event, Server_Player *playerWhosAsking, bool omniscient, bool withUserInfo);
 	void createGameJoinedEvent(Server_Player *player, ResponseContainer &rc, bool resuming);
 	
 	GameEventContainer *prepareGameEvent(const ::google::protobuf::Message &gameEvent, int playerId, GameEventContext *context = 0);
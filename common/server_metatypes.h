@@ -11,6 +11,7 @@
 #include "pb/game_event_container.pb.h"
 #include "pb/isl_message.pb.h"
 #include "pb/room_commands.pb.h"
+#include "pb/game_snapshot.pb.h"
 
 Q_DECLARE_METATYPE(ServerInfo_User)
 Q_DECLARE_METATYPE(ServerInfo_Room)
@@ -20,5 +21,6 @@ Q_DECLARE_METATYPE(Response)
 Q_DECLARE_METATYPE(GameEventContainer)
 Q_DECLARE_METATYPE(IslMessage)
 Q_DECLARE_METATYPE(Command_JoinGame)
+Q_DECLARE_METATYPE(GameSnapshot)
 
 #endif
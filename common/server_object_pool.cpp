@@ -0,0 +1,124 @@
+#include "server_object_pool.h"
+#include <new>
+
+bool Server_ObjectPool::enabled = true;
+QAtomicInt Server_ObjectPool::heapAllocations;
+
+// Every block starts with the pool it came from and its size, so that
+// operator delete can give it back without knowing the game.
+namespace {
+struct BlockHeader {
+	Server_ObjectPool *pool;
+	size_t size;
+};
+const size_t blockAlignment = 16;
+const size_t headerSize = ((sizeof(BlockHeader) + blockAlignment - 1) / blockAlignment) * blockAlignment;
+}
+
+Server_ObjectPool::Server_ObjectPool()
+	: currentChunk(-1), chunkPos(0), chunkEnd(0), liveBlocks(0), detached(false)
+{
+}
+
+Server_ObjectPool::~Server_ObjectPool()
+{
+	for (int i = 0; i < chunks.size(); ++i)
+		::operator delete(chunks[i]);
+}
+
+void *Server_ObjectPool::allocate(size_t size)
+{
+	size = ((size + blockAlignment - 1) / blockAlignment) * blockAlignment;
+	
+	++liveBlocks;
+	
+	QMap<size_t, void *>::iterator freeList = freeLists.find(size);
+	if ((freeList != freeLists.end()) && freeList.value()) {
+		void *block = freeList.value();
+		freeList.value() = *reinterpret_cast<void **>(block);
+		return block;
+	}
+	
+	if (chunkEnd - chunkPos < (ptrdiff_t) size) {
+		// Chunks kept by reset() come first; ones too small for this block are skipped.
+		++currentChunk;
+		while ((currentChunk < chunks.size()) && (chunkSizes[currentChunk] < size))
+			++currentChunk;
+		if (currentChunk == chunks.size()) {
+			const size_t newChunkSize = qMax((size_t) chunkSize, size);
+			chunks.append(static_cast<char *>(::operator new(newChunkSize)));
+			chunkSizes.append(newChunkSize);
+			countHeapAllocation();
+		}
+		chunkPos = chunks[currentChunk];
+		chunkEnd = chunkPos + chunkSizes[currentChunk];
+	}
+	void *block = chunkPos;
+	chunkPos += size;
+	return block;
+}
+
+void Server_ObjectPool::release(void *block, size_t size)
+{
+	size = ((size + blockAlignment - 1) / blockAlignment) * blockAlignment;
+	
+	void *&freeList = freeLists[size];
+	*reinterpret_cast<void **>(block) = freeList;
+	freeList = block;
+	if ((--liveBlocks == 0) && detached)
+		delete this;
+}
+
+void Server_ObjectPool::reset()
+{
+	if (liveBlocks || chunks.isEmpty())
+		return;
+	
+	freeLists.clear();
+	currentChunk = 0;
+	chunkPos = chunks[0];
+	chunkEnd = chunkPos + chunkSizes[0];
+}
+
+void Server_ObjectPool::detach()
+{
+	detached = true;
+	if (!liveBlocks)
+		delete this;
+}
+
+void *Server_PooledObject::operator new(size_t size)
+{
+	return operator new(size, 0);
+}
+
+void *Server_PooledObject::operator new(size_t size, Server_ObjectPool *pool)
+{
+	BlockHeader *header;
+	if (pool)
+		header = static_cast<BlockHeader *>(pool->allocate(size + headerSize));
+	else {
+		header = static_cast<BlockHeader *>(::operator new(size + headerSize));
+		Server_ObjectPool::countHeapAllocation();
+	}
+	header->pool = pool;
+	header->size = size + headerSize;
+	return reinterpret_cast<char *>(header) + headerSize;
+}
+
+void Server_PooledObject::operator delete(void *p)
+{
+	if (!p)
+		return;
+	
+	BlockHeader *header = reinterpret_cast<BlockHeader *>(static_cast<char *>(p) - headerSize);
+	if (header->pool)
+		header->pool->release(header, header->size);
+	else
+		::operator delete(header);
+}
+
+void Server_PooledObject::operator delete(void *p, Server_ObjectPool * /*pool*/)
+{
+	operator delete(p);
+}
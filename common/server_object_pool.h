@@ -0,0 +1,61 @@
+#ifndef SERVER_OBJECT_POOL_H
+#define SERVER_OBJECT_POOL_H
+
+#include <QList>
+#include <QMap>
+#include <QAtomicInt>
+#include <cstddef>
+
+// Memory for the objects of one game: cards, zones, counters and arrows.
+// Blocks are carved from large chunks; deleted objects go to a free list per
+// block size and are reused, e.g. by the cards of the next game of a match.
+// Once all players' zones are cleared, the pool starts over at the first
+// chunk. The chunks are returned when the game is gone.
+class Server_ObjectPool {
+private:
+	static const int chunkSize = 16384;
+	static bool enabled;
+	static QAtomicInt heapAllocations;
+	
+	// Not locked: blocks are allocated and released with the game's gameMutex held,
+	// or while the game is being set up or destroyed and no other thread can reach it.
+	// Pooled objects must therefore not be deleted through deleteLater().
+	QList<char *> chunks;
+	QList<size_t> chunkSizes;
+	int currentChunk; // chunk that chunkPos points into
+	char *chunkPos, *chunkEnd;
+	QMap<size_t, void *> freeLists; // block size -> first free block
+	int liveBlocks;
+	bool detached;
+	
+	~Server_ObjectPool();
+public:
+	Server_ObjectPool();
+	void *allocate(size_t size);
+	void release(void *block, size_t size);
+	// Forgets all free blocks and reuses the chunks from the start, but only
+	// once every object has been deleted.
+	void reset();
+	// Called by the owner instead of delete.
+	void detach();
+	int getChunkCount() const { return chunks.size(); }
+	
+	// Games created while the pool is disabled allocate from the heap.
+	static void setEnabled(bool _enabled) { enabled = _enabled; }
+	static bool isEnabled() { return enabled; }
+	// Number of heap allocations made for pooled classes, chunks included.
+	static int getHeapAllocations() { return heapAllocations; }
+	static void countHeapAllocation() { heapAllocations.fetchAndAddRelaxed(1); }
+};
+
+// Base class for objects that can live in a Server_ObjectPool:
+// new (pool) Server_Card(...). A null pool uses the heap.
+class Server_PooledObject {
+public:
+	static void *operator new(size_t size);
+	static void *operator new(size_t size, Server_ObjectPool *pool);
+	static void operator delete(void *p);
+	static void operator delete(void *p, Server_ObjectPool *pool);
+};
+
+#endif
@@ -8,12 +8,13 @@
 #include "server_room.h"
 #include "server_abstractuserinterface.h"
 #include "server_database_interface.h"
-#include "decklist.h"
+#include "server_deck_cache.h"
 #include "color.h"
 #include "rng_abstract.h"
 #include "get_pb_extension.h"
 
 #include "pb/response.pb.h"
+#include "pb/game_snapshot.pb.h"
 #include "pb/response_deck_download.pb.h"
 #include "pb/response_dump_zone.pb.h"
 #include "pb/command_attach_card.pb.h"
@@ -63,6 +64,7 @@
 #include "pb/event_flip_card.pb.h"
 #include "pb/event_game_say.pb.h"
 #include "pb/event_move_card.pb.h"
+#include "pb/event_move_cards.pb.h"
 #include "pb/event_player_properties_changed.pb.h"
 #include "pb/event_set_card_attr.pb.h"
 #include "pb/event_shuffle.pb.h"
@@ -84,7 +86,7 @@
 #include <QDebug>
 
 Server_Player::Server_Player(Server_Game *_game, int _playerId, const ServerInfo_User &_userInfo, bool _spectator, Server_AbstractUserInterface *_userInterface)
-	: ServerInfo_User_Container(_userInfo), game(_game), userInterface(_userInterface), deck(0), pingTime(0), playerId(_playerId), spectator(_spectator), nextCardId(0), readyStart(false), conceded(false), sideboardLocked(true)
+	: ServerInfo_User_Container(_userInfo), game(_game), userInterface(_userInterface), sideboardPlanChanged(false), pingTime(0), playerId(_playerId), spectator(_spectator), nextCardId(0), readyStart(false), conceded(false), sideboardLocked(true)
 {
 }
 
@@ -92,12 +94,12 @@ Server_Player::~Server_Player()
 {
 }
 
-void Server_Player::prepareDestroy()
+void Server_Player::prepareDestroy(bool removeFromUserInterface)
 {
-	delete deck;
+	deck.clear();
 	
 	playerMutex.lock();
-	if (userInterface)
+	if (userInterface && removeFromUserInterface)
 		userInterface->playerRemovedFromGame(game);
 	playerMutex.unlock();
 	
@@ -141,52 +143,41 @@ void Server_Player::setupZones()
 	// ------------------------------------------------------------------
 
 	// Create zones
-	Server_CardZone *deckZone = new Server_CardZone(this, "deck", false, ServerInfo_Zone::HiddenZone);
+	Server_ObjectPool *pool = game->getObjectPool();
+	Server_CardZone *deckZone = new (pool) Server_CardZone(this, "deck", false, ServerInfo_Zone::HiddenZone);
 	addZone(deckZone);
-	Server_CardZone *sbZone = new Server_CardZone(this, "sb", false, ServerInfo_Zone::HiddenZone);
+	Server_CardZone *sbZone = new (pool) Server_CardZone(this, "sb", false, ServerInfo_Zone::HiddenZone);
 	addZone(sbZone);
-	addZone(new Server_CardZone(this, "table", true, ServerInfo_Zone::PublicZone));
-	addZone(new Server_CardZone(this, "hand", false, ServerInfo_Zone::PrivateZone));
-	addZone(new Server_CardZone(this, "stack", false, ServerInfo_Zone::PublicZone));
-	addZone(new Server_CardZone(this, "grave", false, ServerInfo_Zone::PublicZone));
-	addZone(new Server_CardZone(this, "rfg", false, ServerInfo_Zone::PublicZone));
-
-	addCounter(new Server_Counter(0, "life", makeColor(255, 255, 255), 25, 20));
-	addCounter(new Server_Counter(1, "w", makeColor(255, 255, 150), 20, 0));
-	addCounter(new Server_Counter(2, "u", makeColor(150, 150, 255), 20, 0));
-	addCounter(new Server_Counter(3, "b", makeColor(150, 150, 150), 20, 0));
-	addCounter(new Server_Counter(4, "r", makeColor(250, 150, 150), 20, 0));
-	addCounter(new Server_Counter(5, "g", makeColor(150, 255, 150), 20, 0));
-	addCounter(new Server_Counter(6, "x", makeColor(255, 255, 255), 20, 0));
-	addCounter(new Server_Counter(7, "storm", makeColor(255, 255, 255), 20, 0));
+	addZone(new (pool) Server_CardZone(this, "table", true, ServerInfo_Zone::PublicZone));
+	addZone(new (pool) Server_CardZone(this, "hand", false, ServerInfo_Zone::PrivateZone));
+	addZone(new (pool) Server_CardZone(this, "stack", false, ServerInfo_Zone::PublicZone));
+	addZone(new (pool) Server_CardZone(this, "grave", false, ServerInfo_Zone::PublicZone));
+	addZone(new (pool) Server_CardZone(this, "rfg", false, ServerInfo_Zone::PublicZone));
+
+	addCounter(new (pool) Server_Counter(0, "life", makeColor(255, 255, 255), 25, 20));
+	addCounter(new (pool) Server_Counter(1, "w", makeColor(255, 255, 150), 20, 0));
+	addCounter(new (pool) Server_Counter(2, "u", makeColor(150, 150, 255), 20, 0));
+	addCounter(new (pool) Server_Counter(3, "b", makeColor(150, 150, 150), 20, 0));
+	addCounter(new (pool) Server_Counter(4, "r", makeColor(250, 150, 150), 20, 0));
+	addCounter(new (pool) Server_Counter(5, "g", makeColor(150, 255, 150), 20, 0));
+	addCounter(new (pool) Server_Counter(6, "x", makeColor(255, 255, 255), 20, 0));
+	addCounter(new (pool) Server_Counter(7, "storm", makeColor(255, 255, 255), 20, 0));
 
 	initialCards = 7;
 
 	// ------------------------------------------------------------------
 
-	// Assign card ids and create deck from decklist
-	InnerDecklistNode *listRoot = deck->getRoot();
+	// Assign card ids and create deck from the parsed deck list
 	nextCardId = 0;
-	for (int i = 0; i < listRoot->size(); ++i) {
-		InnerDecklistNode *currentZone = dynamic_cast<InnerDecklistNode *>(listRoot->at(i));
-		Server_CardZone *z;
-		if (currentZone->getName() == "main")
-			z = deckZone;
-		else if (currentZone->getName() == "side")
-			z = sbZone;
-		else
-			continue;
-		
-		for (int j = 0; j < currentZone->size(); ++j) {
-			DecklistCardNode *currentCard = dynamic_cast<DecklistCardNode *>(currentZone->at(j));
-			if (!currentCard)
-				continue;
-			for (int k = 0; k < currentCard->getNumber(); ++k)
-				z->insertCard(new Server_Card(currentCard->getName(), nextCardId++, 0, 0, z), -1, 0);
-		}
-	}
+	const QVector<Server_ParsedDeck::CardCount> &mainCards = deck->getMainCards();
+	for (int i = 0; i < mainCards.size(); ++i)
+		for (int k = 0; k < mainCards[i].count; ++k)
+			deckZone->insertCard(new (pool) Server_Card(CardNameTable::addReference(mainCards[i].nameId), nextCardId++, 0, 0, deckZone), -1, 0);
+	const QVector<Server_ParsedDeck::CardCount> &sideCards = deck->getSideCards();
+	for (int i = 0; i < sideCards.size(); ++i)
+		for (int k = 0; k < sideCards[i].count; ++k)
+			sbZone->insertCard(new (pool) Server_Card(CardNameTable::addReference(sideCards[i].nameId), nextCardId++, 0, 0, sbZone), -1, 0);
 	
-	const QList<MoveCard_ToZone> &sideboardPlan = deck->getCurrentSideboardPlan();
 	for (int i = 0; i < sideboardPlan.size(); ++i) {
 		const MoveCard_ToZone &m = sideboardPlan[i];
 		const QString startZone = QString::fromStdString(m.start_zone());
@@ -206,8 +197,9 @@ void Server_Player::setupZones()
 		else
 			continue;
 		
+		const int cardNameId = CardNameTable::findId(QString::fromStdString(m.card_name()));
 		for (int j = 0; j < start->getCards().size(); ++j)
-			if (start->getCards()[j]->getName() == QString::fromStdString(m.card_name())) {
+			if (start->getCards()[j]->getNameId() == cardNameId) {
 				Server_Card *card = start->getCard(j, NULL, true);
 				target->insertCard(card, -1, 0);
 				break;
@@ -235,6 +227,10 @@ void Server_Player::clearZones()
 	arrows.clear();
 
 	lastDrawList.clear();
+	
+	// After the last player's zones are gone, the next game starts with a fresh pool.
+	if (game->getObjectPool())
+		game->getObjectPool()->reset();
 }
 
 void Server_Player::getProperties(ServerInfo_PlayerProperties &result, bool withUserInfo)
@@ -253,6 +249,153 @@ void Server_Player::getProperties(ServerInfo_PlayerProperties &result, bool with
 	result.set_ping_seconds(pingTime);
 }
 
+void Server_Player::getSnapshot(GameSnapshot_Player &result)
+{
+	ServerInfo_Player *info = result.mutable_info();
+	getProperties(*info->mutable_properties(), true);
+	if (deck)
+		info->set_deck_list(deck->getNativeString().toStdString());
+	
+	QMapIterator<int, Server_Arrow *> arrowIterator(arrows);
+	while (arrowIterator.hasNext())
+		arrowIterator.next().value()->getInfo(info->add_arrow_list());
+	
+	QMapIterator<int, Server_Counter *> counterIterator(counters);
+	while (counterIterator.hasNext())
+		counterIterator.next().value()->getInfo(info->add_counter_list());
+	
+	QMapIterator<QString, Server_CardZone *> zoneIterator(zones);
+	while (zoneIterator.hasNext()) {
+		Server_CardZone *zone = zoneIterator.next().value();
+		ServerInfo_Zone *zoneInfo = info->add_zone_list();
+		zoneInfo->set_name(zone->getName().toStdString());
+		zoneInfo->set_type(zone->getType());
+		zoneInfo->set_with_coords(zone->hasCoords());
+		zoneInfo->set_card_count(zone->getCards().size());
+		zoneInfo->set_always_reveal_top_card(zone->getAlwaysRevealTopCard());
+		const QList<Server_Card *> &cards = zone->getCards();
+		for (int i = 0; i < cards.size(); ++i) {
+			ServerInfo_Card *cardInfo = zoneInfo->add_card_list();
+			cards[i]->getInfo(cardInfo);
+			cardInfo->set_name(cards[i]->getName().toStdString());
+		}
+		
+		GameSnapshot_Zone *zoneSnapshot = result.add_zone_list();
+		zoneSnapshot->set_name(zone->getName().toStdString());
+		QSetIterator<int> permissionIterator(zone->getPlayersWithWritePermission());
+		while (permissionIterator.hasNext())
+			zoneSnapshot->add_players_with_write_permission(permissionIterator.next());
+	}
+	
+	for (int i = 0; i < sideboardPlan.size(); ++i)
+		result.add_sideboard_plan()->CopyFrom(sideboardPlan[i]);
+	result.set_sideboard_plan_changed(sideboardPlanChanged);
+	result.set_initial_cards(initialCards);
+	result.set_next_card_id(nextCardId);
+	for (int i = 0; i < lastDrawList.size(); ++i)
+		result.add_last_draw_list(lastDrawList[i]);
+}
+
+void Server_Player::restoreSnapshot(const GameSnapshot_Player &snapshot)
+{
+	const ServerInfo_Player &info = snapshot.info();
+	const ServerInfo_PlayerProperties &properties = info.properties();
+	conceded = properties.conceded();
+	readyStart = properties.ready_start();
+	sideboardLocked = properties.sideboard_locked();
+	pingTime = -1;
+	if (info.has_deck_list())
+		deck = game->getRoom()->getServer()->getDeckCache()->getDeck(QString::fromStdString(info.deck_list()));
+	
+	Server_ObjectPool *pool = game->getObjectPool();
+	for (int i = 0; i < info.counter_list_size(); ++i) {
+		const ServerInfo_Counter &counterInfo = info.counter_list(i);
+		addCounter(new (pool) Server_Counter(counterInfo.id(), QString::fromStdString(counterInfo.name()), counterInfo.counter_color(), counterInfo.radius(), counterInfo.count()));
+	}
+	
+	for (int i = 0; i < info.zone_list_size(); ++i) {
+		const ServerInfo_Zone &zoneInfo = info.zone_list(i);
+		Server_CardZone *zone = new (pool) Server_CardZone(this, QString::fromStdString(zoneInfo.name()), zoneInfo.with_coords(), zoneInfo.type());
+		zone->setAlwaysRevealTopCard(zoneInfo.always_reveal_top_card());
+		for (int j = 0; j < zoneInfo.card_list_size(); ++j) {
+			const ServerInfo_Card &cardInfo = zoneInfo.card_list(j);
+			Server_Card *card = new (pool) Server_Card(QString::fromStdString(cardInfo.name()), cardInfo.id(), cardInfo.x(), cardInfo.y(), zone);
+			card->setFaceDown(cardInfo.face_down());
+			card->setTapped(cardInfo.tapped());
+			card->setAttacking(cardInfo.attacking());
+			card->setColor(QString::fromStdString(cardInfo.color()));
+			if (cardInfo.has_pt())
+				card->setPT(QString::fromStdString(cardInfo.pt()));
+			card->setAnnotation(QString::fromStdString(cardInfo.annotation()));
+			card->setDestroyOnZoneChange(cardInfo.destroy_on_zone_change());
+			card->setDoesntUntap(cardInfo.doesnt_untap());
+			for (int k = 0; k < cardInfo.counter_list_size(); ++k)
+				card->setCounter(cardInfo.counter_list(k).id(), cardInfo.counter_list(k).value());
+			int x = -1;
+			if (zone->hasCoords()) {
+				// The snapshot may come from a peer; don't trust its coordinates more than a client's.
+				x = cardInfo.x();
+				if (!zone->isFreeGridPosition(x, cardInfo.y()))
+					x = zone->getFreeGridColumn(-1, cardInfo.y(), card->getNameId());
+			}
+			zone->insertCard(card, x, cardInfo.y());
+		}
+		addZone(zone);
+	}
+	for (int i = 0; i < snapshot.zone_list_size(); ++i) {
+		const GameSnapshot_Zone &zoneSnapshot = snapshot.zone_list(i);
+		Server_CardZone *zone = zones.value(QString::fromStdString(zoneSnapshot.name()));
+		if (zone)
+			for (int j = 0; j < zoneSnapshot.players_with_write_permission_size(); ++j)
+				zone->addWritePermission(zoneSnapshot.players_with_write_permission(j));
+	}
+	
+	sideboardPlan.clear();
+	for (int i = 0; i < snapshot.sideboard_plan_size(); ++i)
+		sideboardPlan.append(snapshot.sideboard_plan(i));
+	sideboardPlanChanged = snapshot.sideboard_plan_changed();
+	initialCards = snapshot.initial_cards();
+	nextCardId = snapshot.next_card_id();
+	lastDrawList.clear();
+	for (int i = 0; i < snapshot.last_draw_list_size(); ++i)
+		lastDrawList.append(snapshot.last_draw_list(i));
+}
+
+void Server_Player::restoreSnapshotLinks(const GameSnapshot_Player &snapshot)
+{
+	const ServerInfo_Player &info = snapshot.info();
+	for (int i = 0; i < info.zone_list_size(); ++i) {
+		const ServerInfo_Zone &zoneInfo = info.zone_list(i);
+		Server_CardZone *zone = zones.value(QString::fromStdString(zoneInfo.name()));
+		for (int j = 0; j < zoneInfo.card_list_size(); ++j) {
+			const ServerInfo_Card &cardInfo = zoneInfo.card_list(j);
+			if (cardInfo.attach_player_id() == -1)
+				continue;
+			Server_Player *parentPlayer = game->getPlayers().value(cardInfo.attach_player_id());
+			Server_CardZone *parentZone = parentPlayer ? parentPlayer->getZones().value(QString::fromStdString(cardInfo.attach_zone())) : 0;
+			Server_Card *parentCard = parentZone ? parentZone->getCard(cardInfo.attach_card_id()) : 0;
+			Server_Card *card = zone->getCard(cardInfo.id());
+			if (card && parentCard)
+				card->setParentCard(parentCard);
+		}
+	}
+	
+	for (int i = 0; i < info.arrow_list_size(); ++i) {
+		const ServerInfo_Arrow &arrowInfo = info.arrow_list(i);
+		Server_Player *startPlayer = game->getPlayers().value(arrowInfo.start_player_id());
+		Server_Player *targetPlayer = game->getPlayers().value(arrowInfo.target_player_id());
+		Server_CardZone *startZone = startPlayer ? startPlayer->getZones().value(QString::fromStdString(arrowInfo.start_zone())) : 0;
+		Server_Card *startCard = startZone ? startZone->getCard(arrowInfo.start_card_id()) : 0;
+		Server_ArrowTarget *targetItem = targetPlayer;
+		if (targetPlayer && arrowInfo.has_target_zone()) {
+			Server_CardZone *targetZone = targetPlayer->getZones().value(QString::fromStdString(arrowInfo.target_zone()));
+			targetItem = targetZone ? targetZone->getCard(arrowInfo.target_card_id()) : 0;
+		}
+		if (startCard && targetItem)
+			addArrow(new (game->getObjectPool()) Server_Arrow(arrowInfo.id(), startCard, targetItem, arrowInfo.arrow_color()));
+	}
+}
+
 void Server_Player::addZone(Server_CardZone *zone)
 {
 	zones.insert(zone->getName(), zone);
@@ -335,6 +478,40 @@ public:
 	}
 };
 
+static void appendToMoveCardsEvent(Event_MoveCards &batch, const Event_MoveCard &event)
+{
+	batch.add_card_id(event.card_id());
+	batch.add_card_name(event.card_name());
+	batch.add_position(event.position());
+	batch.add_x(event.x());
+	batch.add_y(event.y());
+	batch.add_new_card_id(event.new_card_id());
+	batch.add_face_down(event.face_down());
+}
+
+void Server_Player::setMovedCardAttributes(GameEventStorage &ges, Server_Card *card, const CardToMove *properties)
+{
+	const QString zoneName = card->getZone()->getName();
+	if (properties->tapped())
+		setCardAttrHelper(ges, zoneName, card->getId(), AttrTapped, "1");
+	QString ptString = QString::fromStdString(properties->pt());
+	if (!ptString.isEmpty() && !card->getFaceDown())
+		setCardAttrHelper(ges, zoneName, card->getId(), AttrPT, ptString);
+}
+
+void Server_Player::revealTopCard(GameEventStorage &ges, Server_CardZone *zone)
+{
+	if (zone->getCards().isEmpty())
+		return;
+	
+	Event_RevealCards revealEvent;
+	revealEvent.set_zone_name(zone->getName().toStdString());
+	revealEvent.set_card_id(0);
+	zone->getCards().first()->getInfo(revealEvent.add_cards());
+	
+	ges.enqueueGameEvent(revealEvent, playerId);
+}
+
 Response::ResponseCode Server_Player::moveCard(GameEventStorage &ges, Server_CardZone *startzone, const QList<const CardToMove *> &_cards, Server_CardZone *targetzone, int x, int y, bool fixFreeSpaces, bool undoingDraw)
 {
 	// Disallow controller change to other zones than the table.
@@ -372,6 +549,22 @@ Response::ResponseCode Server_Player::moveCard(GameEventStorage &ges, Server_Car
 	MoveCardCompareFunctor cmp(startzone == targetzone ? -1 : x);
 	qSort(cardsToMove.begin(), cardsToMove.end(), cmp);
 	
+	// Clients that support it get one event for the whole move. Events that refer to
+	// the new state of the cards have to follow it, so they are sent afterwards.
+	const bool batchEvents = (cardsToMove.size() > 1) && game->getParticipantsSupportFeature(ServerInfo_User::FeatureMoveCards);
+	Event_MoveCards batchOthers, batchPrivate;
+	QList<QPair<Server_Card *, const CardToMove *> > movedCardProperties;
+	QList<Server_Card *> destroyedCards;
+	bool revealStartTop = false, revealTargetTop = false;
+	if (batchEvents) {
+		batchOthers.set_start_player_id(startzone->getPlayer()->getPlayerId());
+		batchOthers.set_start_zone(startzone->getName().toStdString());
+		batchOthers.set_target_player_id(targetzone->getPlayer()->getPlayerId());
+		if (startzone != targetzone)
+			batchOthers.set_target_zone(targetzone->getName().toStdString());
+		batchPrivate.CopyFrom(batchOthers);
+	}
+	
 	bool secondHalf = false;
 	int xIndex = -1;
 	for (int cardIndex = 0; cardIndex < cardsToMove.size(); ++cardIndex) {
@@ -383,6 +576,8 @@ Response::ResponseCode Server_Player::moveCard(GameEventStorage &ges, Server_Car
 		
 		int originalPosition = cardsToMove[cardIndex].second;
 		int position = startzone->removeCard(card);
+		if (position == -1)
+			continue;
 		if (startzone->getName() == "hand") {
 			if (undoingDraw)
 				lastDrawList.removeAt(lastDrawList.indexOf(card->getId()));
@@ -437,14 +632,19 @@ Response::ResponseCode Server_Player::moveCard(GameEventStorage &ges, Server_Car
 			event.set_card_id(card->getId());
 			ges.enqueueGameEvent(event, playerId);
 			
-			card->deleteLater();
+			// Deleted below, with the game mutex still held; see Server_ObjectPool.
+			destroyedCards.append(card);
 		} else {
 			if (!targetzone->hasCoords()) {
 				y = 0;
 				card->resetState();
 			} else
-				newX = targetzone->getFreeGridColumn(newX, y, card->getName());
+				newX = targetzone->getFreeGridColumn(newX, y, card->getNameId());
 		
+			// The new id has to be known before the card is indexed by the target zone.
+			int oldCardId = card->getId();
+			if ((faceDown && (startzone != targetzone)) || (targetzone->getPlayer() != startzone->getPlayer()))
+				card->setId(targetzone->getPlayer()->newCardId());
 			targetzone->insertCard(card, newX, y);
 		
 			bool targetBeingLookedAt = (targetzone->getType() != ServerInfo_Zone::HiddenZone) || (targetzone->getCardsBeingLookedAt() > newX) || (targetzone->getCardsBeingLookedAt() == -1);
@@ -461,9 +661,6 @@ Response::ResponseCode Server_Player::moveCard(GameEventStorage &ges, Server_Car
 			if (!(sourceHiddenToOthers && targetHiddenToOthers))
 				publicCardName = card->getName();
 		
-			int oldCardId = card->getId();
-			if ((faceDown && (startzone != targetzone)) || (targetzone->getPlayer() != startzone->getPlayer()))
-				card->setId(targetzone->getPlayer()->newCardId());
 			card->setFaceDown(faceDown);
 		
 			// The player does not get to see which card he moved if it moves between two parts of hidden zones which
@@ -518,32 +715,39 @@ Response::ResponseCode Server_Player::moveCard(GameEventStorage &ges, Server_Car
 				eventOthers.set_new_card_id(card->getId());
 			}
 			
-			ges.enqueueGameEvent(eventPrivate, playerId, GameEventStorageItem::SendToPrivate, playerId);
-			ges.enqueueGameEvent(eventOthers, playerId, GameEventStorageItem::SendToOthers);
-			
-			if (thisCardProperties->tapped())
-				setCardAttrHelper(ges, targetzone->getName(), card->getId(), AttrTapped, "1");
-			QString ptString = QString::fromStdString(thisCardProperties->pt());
-			if (!ptString.isEmpty() && !faceDown)
-				setCardAttrHelper(ges, targetzone->getName(), card->getId(), AttrPT, ptString);
+			if (batchEvents) {
+				appendToMoveCardsEvent(batchPrivate, eventPrivate);
+				appendToMoveCardsEvent(batchOthers, eventOthers);
+				movedCardProperties.append(QPair<Server_Card *, const CardToMove *>(card, thisCardProperties));
+			} else {
+				ges.enqueueGameEvent(eventPrivate, playerId, GameEventStorageItem::SendToPrivate, playerId);
+				ges.enqueueGameEvent(eventOthers, playerId, GameEventStorageItem::SendToOthers);
+				setMovedCardAttributes(ges, card, thisCardProperties);
+			}
 		}
-		if (startzone->getAlwaysRevealTopCard() && !startzone->getCards().isEmpty() && (originalPosition == 0)) {
-			Event_RevealCards revealEvent;
-			revealEvent.set_zone_name(startzone->getName().toStdString());
-			revealEvent.set_card_id(0);
-			startzone->getCards().first()->getInfo(revealEvent.add_cards());
-			
-			ges.enqueueGameEvent(revealEvent, playerId);
+		if (startzone->getAlwaysRevealTopCard() && (originalPosition == 0)) {
+			if (batchEvents)
+				revealStartTop = true;
+			else
+				revealTopCard(ges, startzone);
 		}
-		if (targetzone->getAlwaysRevealTopCard() && !targetzone->getCards().isEmpty() && (newX == 0)) {
-			Event_RevealCards revealEvent;
-			revealEvent.set_zone_name(targetzone->getName().toStdString());
-			revealEvent.set_card_id(0);
-			targetzone->getCards().first()->getInfo(revealEvent.add_cards());
-			
-			ges.enqueueGameEvent(revealEvent, playerId);
+		if (targetzone->getAlwaysRevealTopCard() && (newX == 0)) {
+			if (batchEvents)
+				revealTargetTop = true;
+			else
+				revealTopCard(ges, targetzone);
 		}
 	}
+	if (batchPrivate.card_id_size() > 0) {
+		ges.enqueueGameEvent(batchPrivate, playerId, GameEventStorageItem::SendToPrivate, playerId);
+		ges.enqueueGameEvent(batchOthers, playerId, GameEventStorageItem::SendToOthers);
+		for (int i = 0; i < movedCardProperties.size(); ++i)
+			setMovedCardAttributes(ges, movedCardProperties[i].first, movedCardProperties[i].second);
+	}
+	if (revealStartTop)
+		revealTopCard(ges, startzone);
+	if (revealTargetTop)
+		revealTopCard(ges, targetzone);
 	if (undoingDraw)
 		ges.setGameEventContext(Context_UndoDraw());
 	else
@@ -551,6 +755,7 @@ Response::ResponseCode Server_Player::moveCard(GameEventStorage &ges, Server_Car
 	
 	if (startzone->hasCoords() && fixFreeSpaces)
 		startzone->fixFreeSpaces(ges);
+	qDeleteAll(destroyedCards);
 	
 	return Response::RespOk;
 }
@@ -633,21 +838,21 @@ Response::ResponseCode Server_Player::cmdDeckSelect(const Command_DeckSelect &cm
 	if (spectator)
 		return Response::RespFunctionNotAllowed;
 	
-	DeckList *newDeck;
+	QString deckString;
 	if (cmd.has_deck_id()) {
 		try {
-			newDeck = game->getRoom()->getServer()->getDatabaseInterface()->getDeckFromDatabase(cmd.deck_id(), userInfo->id());
+			deckString = game->getRoom()->getServer()->getDatabaseInterface()->getDeckContentFromDatabase(cmd.deck_id(), userInfo->id());
 		} catch(Response::ResponseCode r) {
 			return r;
 		}
+		if (deckString.isNull())
+			return Response::RespInternalError;
 	} else
-		newDeck = new DeckList(QString::fromStdString(cmd.deck()));
-	
-	if (!newDeck)
-		return Response::RespInternalError;
+		deckString = QString::fromStdString(cmd.deck());
 	
-	delete deck;
-	deck = newDeck;
+	deck = game->getRoom()->getServer()->getDeckCache()->getDeck(deckString);
+	sideboardPlan = deck->getSideboardPlan();
+	sideboardPlanChanged = false;
 	sideboardLocked = true;
 	
 	Event_PlayerPropertiesChanged event;
@@ -661,7 +866,7 @@ Response::ResponseCode Server_Player::cmdDeckSelect(const Command_DeckSelect &cm
 	ges.setGameEventContext(context);
 	
 	Response_DeckDownload *re = new Response_DeckDownload;
-	re->set_deck(deck->writeToString_Native().toStdString());
+	re->set_deck(deck->getNativeString().toStdString());
 	
 	rc.setResponseExtension(re);
 	return Response::RespOk;
@@ -678,10 +883,10 @@ Response::ResponseCode Server_Player::cmdSetSideboardPlan(const Command_SetSideb
 	if (sideboardLocked)
 		return Response::RespContextError;
 	
-	QList<MoveCard_ToZone> sideboardPlan;
+	sideboardPlan.clear();
 	for (int i = 0; i < cmd.move_list_size(); ++i)
 		sideboardPlan.append(cmd.move_list(i));
-	deck->setCurrentSideboardPlan(sideboardPlan);
+	sideboardPlanChanged = true;
 	
 	return Response::RespOk;
 }
@@ -698,8 +903,10 @@ Response::ResponseCode Server_Player::cmdSetSideboardLock(const Command_SetSideb
 		return Response::RespContextError;
 	
 	sideboardLocked = cmd.locked();
-	if (sideboardLocked)
-		deck->setCurrentSideboardPlan(QList<MoveCard_ToZone>());
+	if (sideboardLocked) {
+		sideboardPlan.clear();
+		sideboardPlanChanged = true;
+	}
 	
 	Event_PlayerPropertiesChanged event;
 	event.mutable_player_properties()->set_sideboard_locked(sideboardLocked);
@@ -1041,7 +1248,7 @@ Response::ResponseCode Server_Player::cmdAttachCard(const Command_AttachCard &cm
 		if (targetzone->isColumnStacked(targetCard->getX(), targetCard->getY())) {
 			CardToMove *cardToMove = new CardToMove;
 			cardToMove->set_card_id(targetCard->getId());
-			targetPlayer->moveCard(ges, targetzone, QList<const CardToMove *>() << cardToMove, targetzone, targetzone->getFreeGridColumn(-2, targetCard->getY(), targetCard->getName()), targetCard->getY(), targetCard->getFaceDown());
+			targetPlayer->moveCard(ges, targetzone, QList<const CardToMove *>() << cardToMove, targetzone, targetzone->getFreeGridColumn(-2, targetCard->getY(), targetCard->getNameId()), targetCard->getY(), targetCard->getFaceDown());
 			delete cardToMove;
 		}
 		
@@ -1078,13 +1285,13 @@ Response::ResponseCode Server_Player::cmdCreateToken(const Command_CreateToken &
 	int x = cmd.x();
 	int y = cmd.y();
 	if (zone->hasCoords())
-		x = zone->getFreeGridColumn(x, y, cardName);
+		x = zone->getFreeGridColumn(x, y, CardNameTable::findId(cardName));
 	if (x < 0)
 		x = 0;
 	if (y < 0)
 		y = 0;
 
-	Server_Card *card = new Server_Card(cardName, newCardId(), x, y);
+	Server_Card *card = new (game->getObjectPool()) Server_Card(cardName, newCardId(), x, y);
 	card->moveToThread(thread());
 	card->setPT(QString::fromStdString(cmd.pt()));
 	card->setColor(QString::fromStdString(cmd.color()));
@@ -1157,7 +1364,7 @@ Response::ResponseCode Server_Player::cmdCreateArrow(const Command_CreateArrow &
 			return Response::RespContextError;
 	}
 	
-	Server_Arrow *arrow = new Server_Arrow(newArrowId(), startCard, targetItem, cmd.arrow_color());
+	Server_Arrow *arrow = new (game->getObjectPool()) Server_Arrow(newArrowId(), startCard, targetItem, cmd.arrow_color());
 	addArrow(arrow);
 	
 	Event_CreateArrow event;
@@ -1309,7 +1516,7 @@ Response::ResponseCode Server_Player::cmdCreateCounter(const Command_CreateCount
 	if (conceded)
 		return Response::RespContextError;
 	
-	Server_Counter *c = new Server_Counter(newCounterId(), QString::fromStdString(cmd.counter_name()), cmd.counter_color(), cmd.radius(), cmd.value());
+	Server_Counter *c = new (game->getObjectPool()) Server_Counter(newCounterId(), QString::fromStdString(cmd.counter_name()), cmd.counter_color(), cmd.radius(), cmd.value());
 	addCounter(c);
 	
 	Event_CreateCounter event;
@@ -1419,14 +1626,30 @@ Response::ResponseCode Server_Player::cmdDumpZone(const Command_DumpZone &cmd, R
 	int numberCards = cmd.number_cards();
 	const QList<Server_Card *> &cards = zone->getCards();
 	
+	const int start = cmd.start();
+	if (start < 0)
+		return Response::RespContextError;
+	const int rangeEnd = ((numberCards == -1) || (numberCards > cards.size())) ? cards.size() : numberCards;
+	const int end = ((cmd.max_cards() < 0) || (rangeEnd - start <= cmd.max_cards())) ? rangeEnd : start + cmd.max_cards();
+	
+	// Later pages of a hidden zone may only be fetched from the cards that are being looked at.
+	// Another view of the zone may have changed how many those are since the first page.
+	if ((start > 0) && (zone->getType() == ServerInfo_Zone::HiddenZone)) {
+		const int cardsBeingLookedAt = zone->getCardsBeingLookedAt();
+		if ((cardsBeingLookedAt == 0) || ((cardsBeingLookedAt != -1) && (end > cardsBeingLookedAt)))
+			return Response::RespContextError;
+	}
+	
 	Response_DumpZone *re = new Response_DumpZone;
 	ServerInfo_Zone *zoneInfo = re->mutable_zone_info();
 	zoneInfo->set_name(zone->getName().toStdString());
 	zoneInfo->set_type(zone->getType());
 	zoneInfo->set_with_coords(zone->hasCoords());
 	zoneInfo->set_card_count(numberCards < cards.size() ? cards.size() : numberCards);
+	if (end < rangeEnd)
+		re->set_next_start(end);
 	
-	for (int i = 0; (i < cards.size()) && (i < numberCards || numberCards == -1); ++i) {
+	for (int i = start; i < end; ++i) {
 		Server_Card *card = cards[i];
 		QString displayedName = card->getFaceDown() ? QString() : card->getName();
 		ServerInfo_Card *cardInfo = zoneInfo->add_card_list();
@@ -1461,7 +1684,7 @@ Response::ResponseCode Server_Player::cmdDumpZone(const Command_DumpZone &cmd, R
 			}
 		}
 	}
-	if (zone->getType() == ServerInfo_Zone::HiddenZone) {
+	if ((zone->getType() == ServerInfo_Zone::HiddenZone) && (start == 0)) {
 		zone->setCardsBeingLookedAt(numberCards);
 		
 		Event_DumpZone event;
@@ -1675,6 +1898,9 @@ void Server_Player::setUserInterface(Server_AbstractUserInterface *_userInterfac
 {
 	playerMutex.lock();
 	userInterface = _userInterface;
+	// A rejoining user may be using a different client.
+	if (_userInterface)
+		userInfo->set_client_features(_userInterface->getUserInfo()->client_features());
 	playerMutex.unlock();
 	
 	pingTime = _userInterface ? 0 : -1;
@@ -1701,7 +1927,7 @@ void Server_Player::getInfo(ServerInfo_Player *info, Server_Player *playerWhosAs
 	getProperties(*info->mutable_properties(), withUserInfo);
 	if (playerWhosAsking == this)
 		if (deck)
-			info->set_deck_list(deck->writeToString_Native().toStdString());
+			info->set_deck_list((sideboardPlanChanged ? deck->writeToString_Native(sideboardPlan) : deck->getNativeString()).toStdString());
 	
 	QMapIterator<int, Server_Arrow *> arrowIterator(arrows);
 	while (arrowIterator.hasNext())
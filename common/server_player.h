@@ -7,11 +7,13 @@
 #include <QList>
 #include <QMap>
 #include <QMutex>
+#include <QSharedPointer>
 
 #include "pb/response.pb.h"
 #include "pb/card_attributes.pb.h"
+#include "pb/move_card_to_zone.pb.h"
 
-class DeckList;
+class Server_ParsedDeck;
 class Server_Game;
 class Server_CardZone;
 class Server_Counter;
@@ -21,6 +23,7 @@ class Server_AbstractUserInterface;
 class ServerInfo_User;
 class ServerInfo_Player;
 class ServerInfo_PlayerProperties;
+class GameSnapshot_Player;
 class CommandContainer;
 class CardToMove;
 class GameEventContainer;
@@ -67,7 +70,9 @@ private:
 	class MoveCardCompareFunctor;
 	Server_Game *game;
 	Server_AbstractUserInterface *userInterface;
-	DeckList *deck;
+	QSharedPointer<const Server_ParsedDeck> deck;
+	QList<MoveCard_ToZone> sideboardPlan;
+	bool sideboardPlanChanged;
 	QMap<QString, Server_CardZone *> zones;
 	QMap<int, Server_Counter *> counters;
 	QMap<int, Server_Arrow *> arrows;
@@ -84,7 +89,8 @@ public:
 	mutable QMutex playerMutex;
 	Server_Player(Server_Game *_game, int _playerId, const ServerInfo_User &_userInfo, bool _spectator, Server_AbstractUserInterface *_handler);
 	~Server_Player();
-	void prepareDestroy();
+	// Without removeFromUserInterface the user stays in the game, e.g. when it moves to another server.
+	void prepareDestroy(bool removeFromUserInterface = true);
 	Server_AbstractUserInterface *getUserInterface() const { return userInterface; }
 	void setUserInterface(Server_AbstractUserInterface *_userInterface);
 	void disconnectClient();
@@ -96,7 +102,7 @@ public:
 	bool getSpectator() const { return spectator; }
 	bool getConceded() const { return conceded; }
 	void setConceded(bool _conceded) { conceded = _conceded; }
-	DeckList *getDeck() const { return deck; }
+	QSharedPointer<const Server_ParsedDeck> getDeck() const { return deck; }
 	Server_Game *getGame() const { return game; }
 	const QMap<QString, Server_CardZone *> &getZones() const { return zones; }
 	const QMap<int, Server_Counter *> &getCounters() const { return counters; }
@@ -106,6 +112,12 @@ public:
 	void setPingTime(int _pingTime) { pingTime = _pingTime; }
 	void getProperties(ServerInfo_PlayerProperties &result, bool withUserInfo);
 	
+	// Hibernation: restoreSnapshot() recreates zones, cards and counters,
+	// restoreSnapshotLinks() the attachments and arrows once all players exist.
+	void getSnapshot(GameSnapshot_Player &result);
+	void restoreSnapshot(const GameSnapshot_Player &snapshot);
+	void restoreSnapshotLinks(const GameSnapshot_Player &snapshot);
+	
 	int newCardId();
 	int newCounterId() const;
 	int newArrowId() const;
@@ -122,6 +134,8 @@ public:
 	Response::ResponseCode moveCard(GameEventStorage &ges, Server_CardZone *startzone, const QList<const CardToMove *> &_cards, Server_CardZone *targetzone, int x, int y, bool fixFreeSpaces = true, bool undoingDraw = false);
 	void unattachCard(GameEventStorage &ges, Server_Card *card);
 	Response::ResponseCode setCardAttrHelper(GameEventStorage &ges, const QString &zone, int cardId, CardAttribute attribute, const QString &attrValue);
+	void setMovedCardAttributes(GameEventStorage &ges, Server_Card *card, const CardToMove *properties);
+	void revealTopCard(GameEventStorage &ges, Server_CardZone *zone);
 
 	Response::ResponseCode cmdLeaveGame(const Command_LeaveGame &cmd, ResponseContainer &rc, GameEventStorage &ges);
 	Response::ResponseCode cmdKickFromGame(const Command_KickFromGame &cmd, ResponseContainer &rc, GameEventStorage &ges);
@@ -1,5 +1,6 @@
 #include <QDebug>
 #include <QDateTime>
+#include <QSet>
 #include "server_protocolhandler.h"
 #include "server_database_interface.h"
 #include "server_room.h"
@@ -13,6 +14,7 @@
 #include "pb/response_get_games_of_user.pb.h"
 #include "pb/response_get_user_info.pb.h"
 #include "pb/response_join_room.pb.h"
+#include "pb/response_set_game_filter.pb.h"
 #include "pb/event_list_rooms.pb.h"
 #include "pb/event_server_message.pb.h"
 #include "pb/event_user_message.pb.h"
@@ -26,8 +28,8 @@ Server_ProtocolHandler::Server_ProtocolHandler(Server *_server, Server_DatabaseI
 	  deleted(false),
 	  databaseInterface(_databaseInterface),
 	  authState(NotLoggedIn),
-	  acceptsUserListChanges(false),
 	  acceptsRoomListChanges(false),
+	  addressRateLimiter(0),
 	  timeRunning(0),
 	  lastDataReceived(0)
 {
@@ -82,6 +84,8 @@ void Server_ProtocolHandler::prepareDestroy()
 	server->roomsLock.unlock();
 	
 	server->removeClient(this);
+	if (addressRateLimiter)
+		server->releaseAddressRateLimiter(addressRateLimiterAddress);
 	
 	deleteLater();
 }
@@ -122,6 +126,124 @@ void Server_ProtocolHandler::sendProtocolItem(const RoomEvent &item)
 	transmitProtocolItem(msg);
 }
 
+QByteArray Server_ProtocolHandler::serializeProtocolItem(const ServerMessage &item)
+{
+	QByteArray buf;
+	unsigned int size = item.ByteSize();
+	buf.resize(size + 4);
+	item.SerializeToArray(buf.data() + 4, size);
+	buf.data()[3] = (unsigned char) size;
+	buf.data()[2] = (unsigned char) (size >> 8);
+	buf.data()[1] = (unsigned char) (size >> 16);
+	buf.data()[0] = (unsigned char) (size >> 24);
+	return buf;
+}
+
+QByteArray Server_ProtocolHandler::serializeProtocolItem(const QByteArray &serializedItem)
+{
+	const unsigned int size = serializedItem.size();
+	QByteArray buf;
+	buf.reserve(size + 4);
+	buf.append((char) (size >> 24));
+	buf.append((char) (size >> 16));
+	buf.append((char) (size >> 8));
+	buf.append((char) size);
+	buf.append(serializedItem);
+	return buf;
+}
+
+void Server_ProtocolHandler::transmitSerializedProtocolItem(const QByteArray &buf)
+{
+	ServerMessage msg;
+	if (msg.ParseFromArray(buf.data() + 4, buf.size() - 4))
+		transmitProtocolItem(msg);
+}
+
+// Takes the costs of a whole command container from the connection and the address budgets,
+// or nothing at all. Returns the first category over its limit, CategoryCount if none is.
+Server_RateLimiter::Category Server_ProtocolHandler::consumeRateLimits(const double *costs, qint64 now)
+{
+	Server_RateLimit limits[Server_RateLimiter::CategoryCount];
+	bool active = false;
+	for (int i = 0; i < Server_RateLimiter::CategoryCount; ++i) {
+		limits[i] = server->getRateLimit((Server_RateLimiter::Category) i);
+		if ((costs[i] > 0) && limits[i].isActive())
+			active = true;
+	}
+	if (!active)
+		return Server_RateLimiter::CategoryCount;
+	
+	Server_RateLimiter::Category exceeded = rateLimiter.check(costs, limits, now);
+	if (exceeded != Server_RateLimiter::CategoryCount)
+		return exceeded;
+	
+	const int addressFactor = server->getAddressRateLimitFactor();
+	if (addressFactor > 0) {
+		if (!addressRateLimiter) {
+			addressRateLimiterAddress = getAddress();
+			addressRateLimiter = server->acquireAddressRateLimiter(addressRateLimiterAddress);
+		}
+		Server_RateLimit addressLimits[Server_RateLimiter::CategoryCount];
+		for (int i = 0; i < Server_RateLimiter::CategoryCount; ++i)
+			addressLimits[i] = Server_RateLimit(limits[i].rate * addressFactor, limits[i].burst * addressFactor);
+		exceeded = addressRateLimiter->consume(costs, addressLimits, now);
+		if (exceeded != Server_RateLimiter::CategoryCount)
+			return exceeded;
+	}
+	
+	rateLimiter.take(costs, limits);
+	return Server_RateLimiter::CategoryCount;
+}
+
+// Runs before any command handler, so that flooding clients are turned away
+// without taking any locks or touching the database.
+Response::ResponseCode Server_ProtocolHandler::checkRateLimits(const CommandContainer &cont)
+{
+	double costs[Server_RateLimiter::CategoryCount];
+	for (int i = 0; i < Server_RateLimiter::CategoryCount; ++i)
+		costs[i] = 0;
+	
+	if (cont.game_command_size())
+		costs[Server_RateLimiter::GameCommands] = cont.game_command_size();
+	else if (cont.room_command_size()) {
+		for (int i = cont.room_command_size() - 1; i >= 0; --i) {
+			const RoomCommand &rc = cont.room_command(i);
+			if (getPbExtension(rc) != RoomCommand::ROOM_SAY)
+				continue;
+			costs[Server_RateLimiter::RoomChat] += 1;
+			costs[Server_RateLimiter::RoomChatSize] += rc.GetExtension(Command_RoomSay::ext).message().size();
+		}
+	} else if (cont.session_command_size()) {
+		for (int i = cont.session_command_size() - 1; i >= 0; --i) {
+			switch ((SessionCommand::SessionCommandType) getPbExtension(cont.session_command(i))) {
+				case SessionCommand::MESSAGE:
+					costs[Server_RateLimiter::PrivateMessages] += 1;
+					break;
+				case SessionCommand::DECK_LIST:
+				case SessionCommand::DECK_NEW_DIR:
+				case SessionCommand::DECK_DEL_DIR:
+				case SessionCommand::DECK_DEL:
+				case SessionCommand::DECK_DOWNLOAD:
+				case SessionCommand::DECK_UPLOAD:
+					costs[Server_RateLimiter::DeckStorage] += 1;
+					break;
+				case SessionCommand::REPLAY_DOWNLOAD:
+					costs[Server_RateLimiter::ReplayDownloads] += 1;
+					break;
+				default: break;
+			}
+		}
+	}
+	
+	switch (consumeRateLimits(costs, server->getMsecsRunning())) {
+		case Server_RateLimiter::CategoryCount: return Response::RespOk;
+		case Server_RateLimiter::RoomChat:
+		case Server_RateLimiter::RoomChatSize:
+		case Server_RateLimiter::PrivateMessages: return Response::RespChatFlood;
+		default: return Response::RespRateLimited;
+	}
+}
+
 Response::ResponseCode Server_ProtocolHandler::processSessionCommandContainer(const CommandContainer &cont, ResponseContainer &rc)
 {
 	Response::ResponseCode finalResponseCode = Response::RespOk;
@@ -175,6 +297,7 @@ Response::ResponseCode Server_ProtocolHandler::processRoomCommandContainer(const
 			case RoomCommand::ROOM_SAY: resp = cmdRoomSay(sc.GetExtension(Command_RoomSay::ext), room, rc); break;
 			case RoomCommand::CREATE_GAME: resp = cmdCreateGame(sc.GetExtension(Command_CreateGame::ext), room, rc); break;
 			case RoomCommand::JOIN_GAME: resp = cmdJoinGame(sc.GetExtension(Command_JoinGame::ext), room, rc); break;
+			case RoomCommand::SET_GAME_FILTER: resp = cmdSetGameFilter(sc.GetExtension(Command_SetGameFilter::ext), room, rc); break;
 		}
 		if (resp != Response::RespOk)
 			finalResponseCode = resp;
@@ -284,7 +407,11 @@ void Server_ProtocolHandler::processCommandContainer(const CommandContainer &con
 	lastDataReceived = timeRunning;
 	
 	ResponseContainer responseContainer(cont.has_cmd_id() ? cont.cmd_id() : -1);
-	Response::ResponseCode finalResponseCode;
+	Response::ResponseCode finalResponseCode = checkRateLimits(cont);
+	if (finalResponseCode != Response::RespOk) {
+		sendResponseContainer(responseContainer, finalResponseCode);
+		return;
+	}
 	
 	if (cont.game_command_size())
 		finalResponseCode = processGameCommandContainer(cont, responseContainer);
@@ -305,16 +432,6 @@ void Server_ProtocolHandler::processCommandContainer(const CommandContainer &con
 
 void Server_ProtocolHandler::pingClockTimeout()
 {
-	int interval = server->getMessageCountingInterval();
-	if (interval > 0) {
-		messageSizeOverTime.prepend(0);
-		if (messageSizeOverTime.size() > server->getMessageCountingInterval())
-			messageSizeOverTime.removeLast();
-		messageCountOverTime.prepend(0);
-		if (messageCountOverTime.size() > server->getMessageCountingInterval())
-			messageCountOverTime.removeLast();
-	}
-	
 	if (timeRunning - lastDataReceived > server->getMaxPlayerInactivityTime())
 		prepareDestroy();
 	++timeRunning;
@@ -332,7 +449,7 @@ Response::ResponseCode Server_ProtocolHandler::cmdLogin(const Command_Login &cmd
 		return Response::RespContextError;
 	QString reasonStr;
 	int banSecondsLeft = 0;
-	AuthenticationResult res = server->loginUser(this, userName, QString::fromStdString(cmd.password()), reasonStr, banSecondsLeft);
+	AuthenticationResult res = server->loginUser(this, userName, QString::fromStdString(cmd.password()), reasonStr, banSecondsLeft, cmd.client_features());
 	switch (res) {
 		case UserIsBanned: {
 			Response_Login *re = new Response_Login;
@@ -476,7 +593,7 @@ Response::ResponseCode Server_ProtocolHandler::cmdJoinRoom(const Command_JoinRoo
 	if (!r)
 		return Response::RespNameNotFound;
 	
-	r->addClient(this);
+	r->addClient(this, cmd.has_game_filter() ? &cmd.game_filter() : 0);
 	rooms.insert(r->getId(), r);
 	
 	Event_RoomSay joinMessageEvent;
@@ -484,27 +601,51 @@ Response::ResponseCode Server_ProtocolHandler::cmdJoinRoom(const Command_JoinRoo
 	rc.enqueuePostResponseItem(ServerMessage::ROOM_EVENT, r->prepareRoomEvent(joinMessageEvent));
 	
 	Response_JoinRoom *re = new Response_JoinRoom;
-	r->getInfo(*re->mutable_room_info(), true);
+	if (cmd.has_game_filter()) {
+		ServerInfo_Room *roomInfo = re->mutable_room_info();
+		r->getInfo(*roomInfo, true, false, true, false);
+		QListIterator<ServerInfo_Game> gameIterator(r->getGameList(cmd.game_filter(), *userInfo));
+		while (gameIterator.hasNext())
+			roomInfo->add_game_list()->CopyFrom(gameIterator.next());
+	} else
+		r->getInfo(*re->mutable_room_info(), true);
 	
 	rc.setResponseExtension(re);
 	return Response::RespOk;
 }
 
-Response::ResponseCode Server_ProtocolHandler::cmdListUsers(const Command_ListUsers & /*cmd*/, ResponseContainer &rc)
+Response::ResponseCode Server_ProtocolHandler::cmdListUsers(const Command_ListUsers &cmd, ResponseContainer &rc)
 {
 	if (authState == NotLoggedIn)
 		return Response::RespLoginNeeded;
 	
+	QSet<QString> buddies;
+	if (cmd.buddies_only()) {
+		QMapIterator<QString, ServerInfo_User> buddyIterator(databaseInterface->getBuddyList(QString::fromStdString(userInfo->name())));
+		while (buddyIterator.hasNext())
+			buddies.insert(buddyIterator.next().key());
+	}
+	
 	Response_ListUsers *re = new Response_ListUsers;
 	server->clientsLock.lockForRead();
 	QMapIterator<QString, Server_ProtocolHandler *> userIterator = server->getUsers();
-	while (userIterator.hasNext())
-		re->add_user_list()->CopyFrom(userIterator.next().value()->copyUserInfo(false));
+	while (userIterator.hasNext()) {
+		userIterator.next();
+		if (!cmd.buddies_only() || buddies.contains(userIterator.key()))
+			re->add_user_list()->CopyFrom(userIterator.value()->copyUserInfo(false));
+	}
 	QMapIterator<QString, Server_AbstractUserInterface *> extIterator = server->getExternalUsers();
-	while (extIterator.hasNext())
-		re->add_user_list()->CopyFrom(extIterator.next().value()->copyUserInfo(false));
+	while (extIterator.hasNext()) {
+		extIterator.next();
+		if (!cmd.buddies_only() || buddies.contains(extIterator.key()))
+			re->add_user_list()->CopyFrom(extIterator.value()->copyUserInfo(false));
+	}
 	
-	acceptsUserListChanges = true;
+	// Subscribing before clientsLock is released makes sure no user joins or leaves unnoticed.
+	if (cmd.buddies_only())
+		server->subscribeBuddyPresence(this, buddies);
+	else
+		server->subscribeUserList(this);
 	server->clientsLock.unlock();
 	
 	rc.setResponseExtension(re);
@@ -521,24 +662,6 @@ Response::ResponseCode Server_ProtocolHandler::cmdLeaveRoom(const Command_LeaveR
 Response::ResponseCode Server_ProtocolHandler::cmdRoomSay(const Command_RoomSay &cmd, Server_Room *room, ResponseContainer & /*rc*/)
 {
 	QString msg = QString::fromStdString(cmd.message());
-	
-	if (server->getMessageCountingInterval() > 0) {
-		int totalSize = 0, totalCount = 0;
-		if (messageSizeOverTime.isEmpty())
-			messageSizeOverTime.prepend(0);
-		messageSizeOverTime[0] += msg.size();
-		for (int i = 0; i < messageSizeOverTime.size(); ++i)
-			totalSize += messageSizeOverTime[i];
-		
-		if (messageCountOverTime.isEmpty())
-			messageCountOverTime.prepend(0);
-		++messageCountOverTime[0];
-		for (int i = 0; i < messageCountOverTime.size(); ++i)
-			totalCount += messageCountOverTime[i];
-		
-		if ((totalSize > server->getMaxMessageSizePerInterval()) || (totalCount > server->getMaxMessageCountPerInterval()))
-			return Response::RespChatFlood;
-	}
 	msg.replace(QChar('\n'), QChar(' '));
 	
 	room->say(QString::fromStdString(userInfo->name()), msg);
@@ -579,3 +702,19 @@ Response::ResponseCode Server_ProtocolHandler::cmdJoinGame(const Command_JoinGam
 	
 	return room->processJoinGameCommand(cmd, rc, this);
 }
+
+Response::ResponseCode Server_ProtocolHandler::cmdSetGameFilter(const Command_SetGameFilter &cmd, Server_Room *room, ResponseContainer &rc)
+{
+	if (authState == NotLoggedIn)
+		return Response::RespLoginNeeded;
+	
+	room->setGameFilter(QString::fromStdString(userInfo->name()), cmd.has_game_filter() ? &cmd.game_filter() : 0);
+	
+	Response_SetGameFilter *re = new Response_SetGameFilter;
+	QListIterator<ServerInfo_Game> gameIterator(room->getGameList(cmd.game_filter(), *userInfo));
+	while (gameIterator.hasNext())
+		re->add_game_list()->CopyFrom(gameIterator.next());
+	
+	rc.setResponseExtension(re);
+	return Response::RespOk;
+}
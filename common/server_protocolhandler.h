@@ -5,6 +5,7 @@
 #include <QPair>
 #include "server.h"
 #include "server_abstractuserinterface.h"
+#include "server_ratelimiter.h"
 #include "pb/response.pb.h"
 #include "pb/server_message.pb.h"
 
@@ -38,6 +39,7 @@ class Command_LeaveRoom;
 class Command_RoomSay;
 class Command_CreateGame;
 class Command_JoinGame;
+class Command_SetGameFilter;
 
 class Server_ProtocolHandler : public QObject, public Server_AbstractUserInterface {
 	Q_OBJECT
@@ -47,15 +49,18 @@ protected:
 	bool deleted;
 	Server_DatabaseInterface *databaseInterface;
 	AuthenticationResult authState;
-	bool acceptsUserListChanges;
 	bool acceptsRoomListChanges;
 	virtual void logDebugMessage(const QString &message) { }
 private:
-	QList<int> messageSizeOverTime, messageCountOverTime;
+	Server_RateLimiter rateLimiter;
+	Server_AddressRateLimiter *addressRateLimiter;
+	QString addressRateLimiterAddress;
 	int timeRunning, lastDataReceived;
 	QTimer *pingClock;
 
 	virtual void transmitProtocolItem(const ServerMessage &item) = 0;
+	// Implementations that send the wire format anyway should not parse the message back.
+	virtual void transmitSerializedProtocolItem(const QByteArray &buf);
 	
 	Response::ResponseCode cmdPing(const Command_Ping &cmd, ResponseContainer &rc);
 	Response::ResponseCode cmdLogin(const Command_Login &cmd, ResponseContainer &rc);
@@ -69,7 +74,10 @@ private:
 	Response::ResponseCode cmdRoomSay(const Command_RoomSay &cmd, Server_Room *room, ResponseContainer &rc);
 	Response::ResponseCode cmdCreateGame(const Command_CreateGame &cmd, Server_Room *room, ResponseContainer &rc);
 	Response::ResponseCode cmdJoinGame(const Command_JoinGame &cmd, Server_Room *room, ResponseContainer &rc);
+	Response::ResponseCode cmdSetGameFilter(const Command_SetGameFilter &cmd, Server_Room *room, ResponseContainer &rc);
 	
+	Server_RateLimiter::Category consumeRateLimits(const double *costs, qint64 now);
+	Response::ResponseCode checkRateLimits(const CommandContainer &cont);
 	Response::ResponseCode processSessionCommandContainer(const CommandContainer &cont, ResponseContainer &rc);
 	virtual Response::ResponseCode processExtendedSessionCommand(int cmdType, const SessionCommand &cmd, ResponseContainer &rc) { return Response::RespFunctionNotAllowed; }
 	Response::ResponseCode processRoomCommandContainer(const CommandContainer &cont, ResponseContainer &rc);
@@ -86,7 +94,6 @@ public:
 	Server_ProtocolHandler(Server *_server, Server_DatabaseInterface *_databaseInterface, QObject *parent = 0);
 	~Server_ProtocolHandler();
 	
-	bool getAcceptsUserListChanges() const { return acceptsUserListChanges; }
 	bool getAcceptsRoomListChanges() const { return acceptsRoomListChanges; }
 	virtual QString getAddress() const = 0;
 	Server_DatabaseInterface *getDatabaseInterface() const { return databaseInterface; }
@@ -98,6 +105,12 @@ public:
 	void sendProtocolItem(const SessionEvent &item);
 	void sendProtocolItem(const GameEventContainer &item);
 	void sendProtocolItem(const RoomEvent &item);
+	// Messages sent to many users are serialized once, see serializeProtocolItem().
+	void sendSerializedProtocolItem(const QByteArray &buf) { transmitSerializedProtocolItem(buf); }
+	// The wire format of a message: its size as a big endian 32 bit integer, followed by the message.
+	static QByteArray serializeProtocolItem(const ServerMessage &item);
+	// The same for a ServerMessage that was put together from serialized parts.
+	static QByteArray serializeProtocolItem(const QByteArray &serializedItem);
 };
 
 #endif
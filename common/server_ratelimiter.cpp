@@ -0,0 +1,39 @@
+#include "server_ratelimiter.h"
+
+bool Server_TokenBucket::canConsume(const Server_RateLimit &limit, double cost, qint64 now)
+{
+	if (!limit.isActive())
+		return true;
+	
+	if (tokens < 0)
+		tokens = limit.burst;
+	else
+		tokens = qMin(limit.burst, tokens + (now - lastRefill) * limit.rate / 1000.0);
+	lastRefill = now;
+	
+	return tokens >= qMin(cost, limit.burst);
+}
+
+Server_RateLimiter::Category Server_RateLimiter::check(const double *costs, const Server_RateLimit *limits, qint64 now)
+{
+	for (int i = 0; i < CategoryCount; ++i)
+		if ((costs[i] > 0) && !buckets[i].canConsume(limits[i], costs[i], now))
+			return (Category) i;
+	return CategoryCount;
+}
+
+void Server_RateLimiter::take(const double *costs, const Server_RateLimit *limits)
+{
+	for (int i = 0; i < CategoryCount; ++i)
+		if (costs[i] > 0)
+			buckets[i].take(limits[i], costs[i]);
+}
+
+Server_RateLimiter::Category Server_AddressRateLimiter::consume(const double *costs, const Server_RateLimit *limits, qint64 now)
+{
+	QMutexLocker locker(&mutex);
+	const Server_RateLimiter::Category exceeded = limiter.check(costs, limits, now);
+	if (exceeded == Server_RateLimiter::CategoryCount)
+		limiter.take(costs, limits);
+	return exceeded;
+}
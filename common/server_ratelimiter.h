@@ -0,0 +1,53 @@
+#ifndef SERVER_RATELIMITER_H
+#define SERVER_RATELIMITER_H
+
+#include <QMutex>
+
+// Budget of one command category: 'rate' tokens per second, at most 'burst' at once.
+// A rate of 0 means no limit. A command costing more than the burst is charged the
+// burst, so it needs a full bucket and empties it, but is not refused forever.
+class Server_RateLimit {
+public:
+	double rate, burst;
+	Server_RateLimit(double _rate = 0, double _burst = 0) : rate(_rate), burst(_burst) { }
+	bool isActive() const { return rate > 0; }
+};
+
+// Token bucket with constant memory. It is refilled lazily whenever tokens are checked,
+// so idle buckets cost nothing.
+class Server_TokenBucket {
+private:
+	double tokens;
+	qint64 lastRefill;
+public:
+	Server_TokenBucket() : tokens(-1), lastRefill(0) { }
+	bool canConsume(const Server_RateLimit &limit, double cost, qint64 now);
+	void take(const Server_RateLimit &limit, double cost) { if (limit.isActive()) tokens -= qMin(cost, limit.burst); }
+};
+
+class Server_RateLimiter {
+public:
+	enum Category { GameCommands, RoomChat, RoomChatSize, PrivateMessages, DeckStorage, ReplayDownloads, CategoryCount };
+private:
+	Server_TokenBucket buckets[CategoryCount];
+public:
+	// costs and limits have one entry per category. check() returns the first category
+	// that cannot pay its cost, or CategoryCount if all of them can. Nothing is spent
+	// until take() is called, so a command is either paid in full or not at all.
+	Category check(const double *costs, const Server_RateLimit *limits, qint64 now);
+	void take(const double *costs, const Server_RateLimit *limits);
+};
+
+// Shared by all connections from one address, which may live in different threads.
+class Server_AddressRateLimiter {
+private:
+	QMutex mutex;
+	Server_RateLimiter limiter;
+public:
+	int refCount;
+	Server_AddressRateLimiter() : refCount(0) { }
+	// Checks and takes all costs at once, see Server_RateLimiter::check().
+	Server_RateLimiter::Category consume(const double *costs, const Server_RateLimit *limits, qint64 now);
+};
+
+#endif
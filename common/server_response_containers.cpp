@@ -1,66 +1,68 @@
 #include "server_response_containers.h"
-#include <google/protobuf/descriptor.h>
+#include "get_pb_extension.h"
 #include "server_game.h"
 
-GameEventStorageItem::GameEventStorageItem(const ::google::protobuf::Message &_event, int _playerId, EventRecipients _recipients)
-	: event(new GameEvent), recipients(_recipients)
-{
-	event->GetReflection()->MutableMessage(event, _event.GetDescriptor()->FindExtensionByName("ext"))->CopyFrom(_event);
-	event->set_player_id(_playerId);
-}
-
-GameEventStorageItem::~GameEventStorageItem()
+GameEventStorage::GameEventStorage()
+	: contPrivate(0), contOthers(0), privatePlayerId(-1)
 {
-	delete event;
 }
 
-GameEventStorage::GameEventStorage()
-	: gameEventContext(0)
+GameEventStorage::~GameEventStorage()
 {
+	delete contPrivate;
+	delete contOthers;
 }
 
-GameEventStorage::~GameEventStorage()
+void GameEventStorage::addEvent(GameEventContainer *cont, const ::google::protobuf::Message &event, int playerId)
 {
-	delete gameEventContext;
-	for (int i = 0; i < gameEventList.size(); ++i)
-		delete gameEventList[i];
+	GameEvent *gameEvent = cont->add_event_list();
+	setPbExtension(*gameEvent, event);
+	gameEvent->set_player_id(playerId);
 }
 
 void GameEventStorage::setGameEventContext(const ::google::protobuf::Message &_gameEventContext)
 {
-	delete gameEventContext;
-	gameEventContext = new GameEventContext;
-	gameEventContext->GetReflection()->MutableMessage(gameEventContext, _gameEventContext.GetDescriptor()->FindExtensionByName("ext"))->CopyFrom(_gameEventContext);
+	if (!contPrivate)
+		contPrivate = new GameEventContainer;
+	setPbExtension(*contPrivate->mutable_context(), _gameEventContext);
+	if (contOthers)
+		contOthers->mutable_context()->CopyFrom(contPrivate->context());
 }
 
 void GameEventStorage::enqueueGameEvent(const ::google::protobuf::Message &event, int playerId, GameEventStorageItem::EventRecipients recipients, int _privatePlayerId)
 {
-	gameEventList.append(new GameEventStorageItem(event, playerId, recipients));
+	if (!contPrivate)
+		contPrivate = new GameEventContainer;
+	
+	const GameEventStorageItem::EventRecipients both = GameEventStorageItem::SendToPrivate | GameEventStorageItem::SendToOthers;
+	if (!contOthers && (recipients != both))
+		contOthers = new GameEventContainer(*contPrivate);
+	
+	if (!contOthers)
+		addEvent(contPrivate, event, playerId);
+	else {
+		if (recipients.testFlag(GameEventStorageItem::SendToPrivate))
+			addEvent(contPrivate, event, playerId);
+		if (recipients.testFlag(GameEventStorageItem::SendToOthers))
+			addEvent(contOthers, event, playerId);
+	}
 	if (_privatePlayerId != -1)
 		privatePlayerId = _privatePlayerId;
 }
 
 void GameEventStorage::sendToGame(Server_Game *game)
 {
-	if (gameEventList.isEmpty())
+	if (!contPrivate || (!contPrivate->event_list_size() && (!contOthers || !contOthers->event_list_size())))
 		return;
 	
-	GameEventContainer *contPrivate = new GameEventContainer;
-	GameEventContainer *contOthers = new GameEventContainer;
-	for (int i = 0; i < gameEventList.size(); ++i) {
-		const GameEvent &event = gameEventList[i]->getGameEvent();
-		const GameEventStorageItem::EventRecipients recipients = gameEventList[i]->getRecipients();
-		if (recipients.testFlag(GameEventStorageItem::SendToPrivate))
-			contPrivate->add_event_list()->CopyFrom(event);
-		if (recipients.testFlag(GameEventStorageItem::SendToOthers))
-			contOthers->add_event_list()->CopyFrom(event);
-	}
-	if (gameEventContext) {
-		contPrivate->mutable_context()->CopyFrom(*gameEventContext);
-		contOthers->mutable_context()->CopyFrom(*gameEventContext);
-	}
-	game->sendGameEventContainer(contPrivate, GameEventStorageItem::SendToPrivate, privatePlayerId);
-	game->sendGameEventContainer(contOthers, GameEventStorageItem::SendToOthers, privatePlayerId);
+	// The game takes ownership of the containers.
+	if (contOthers) {
+		game->sendGameEventContainer(contPrivate, GameEventStorageItem::SendToPrivate, privatePlayerId);
+		game->sendGameEventContainer(contOthers, GameEventStorageItem::SendToOthers, privatePlayerId);
+	} else
+		game->sendGameEventContainer(contPrivate, GameEventStorageItem::SendToPrivate | GameEventStorageItem::SendToOthers, privatePlayerId);
+	contPrivate = 0;
+	contOthers = 0;
 }
 
 ResponseContainer::ResponseContainer(int _cmdId)
@@ -72,7 +74,7 @@ ResponseContainer::~ResponseContainer()
 {
 	delete responseExtension;
 	for (int i = 0; i < preResponseQueue.size(); ++i)
-		delete preResponseQueue[i].second;
+		delete preResponseQueue[i].message;
 	for (int i = 0; i < postResponseQueue.size(); ++i)
-		delete postResponseQueue[i].second;
+		delete postResponseQueue[i].message;
 }
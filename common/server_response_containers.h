@@ -2,6 +2,7 @@
 #define SERVER_RESPONSE_CONTAINERS_H
 
 #include <QPair>
+#include <QByteArray>
 #include "pb/server_message.pb.h"
 
 namespace google { namespace protobuf { class Message; } }
@@ -11,41 +12,44 @@ class GameEventStorageItem {
 public:
 	enum EventRecipient { SendToPrivate = 0x01, SendToOthers = 0x02};
 	Q_DECLARE_FLAGS(EventRecipients, EventRecipient)
-private:
-	GameEvent *event;
-	EventRecipients recipients;
-public:
-	GameEventStorageItem(const ::google::protobuf::Message &_event, int _playerId, EventRecipients _recipients);
-	~GameEventStorageItem();
-	
-	const GameEvent &getGameEvent() const { return *event; }
-	EventRecipients getRecipients() const { return recipients; }
 };
 Q_DECLARE_OPERATORS_FOR_FLAGS(GameEventStorageItem::EventRecipients)
 
 class GameEventStorage {
 private:
-	::google::protobuf::Message *gameEventContext;
-	QList<GameEventStorageItem *> gameEventList;
+	// Events are built directly in the containers that will be sent.
+	// As long as all events go to both sides, contPrivate serves both and contOthers is 0.
+	GameEventContainer *contPrivate;
+	GameEventContainer *contOthers;
 	int privatePlayerId;
+	void addEvent(GameEventContainer *cont, const ::google::protobuf::Message &event, int playerId);
 public:
 	GameEventStorage();
 	~GameEventStorage();
 	
 	void setGameEventContext(const ::google::protobuf::Message &_gameEventContext);
-	::google::protobuf::Message *getGameEventContext() const { return gameEventContext; }
-	const QList<GameEventStorageItem *> &getGameEventList() const { return gameEventList; }
 	int getPrivatePlayerId() const { return privatePlayerId; }
 	
 	void enqueueGameEvent(const ::google::protobuf::Message &event, int playerId, GameEventStorageItem::EventRecipients recipients = GameEventStorageItem::SendToPrivate | GameEventStorageItem::SendToOthers, int _privatePlayerId = -1);
 	void sendToGame(Server_Game *game);
 };
 
+// Something sent along with a response: a message of the given type or, if there is no message,
+// a ServerMessage already serialized by Server_ProtocolHandler::serializeProtocolItem().
+class ResponseContainerItem {
+public:
+	ServerMessage::MessageType type;
+	::google::protobuf::Message *message;
+	QByteArray serialized;
+	ResponseContainerItem(ServerMessage::MessageType _type, ::google::protobuf::Message *_message) : type(_type), message(_message) { }
+	ResponseContainerItem(const QByteArray &_serialized) : type(ServerMessage::GAME_EVENT_CONTAINER), message(0), serialized(_serialized) { }
+};
+
 class ResponseContainer {
 private:
 	int cmdId;
 	::google::protobuf::Message *responseExtension;
-	QList<QPair<ServerMessage::MessageType, ::google::protobuf::Message *> > preResponseQueue, postResponseQueue;
+	QList<ResponseContainerItem> preResponseQueue, postResponseQueue;
 public:
 	ResponseContainer(int _cmdId);
 	~ResponseContainer();
@@ -53,10 +57,11 @@ public:
 	int getCmdId() const { return cmdId; }
 	void setResponseExtension(::google::protobuf::Message *_responseExtension) { responseExtension = _responseExtension; }
 	::google::protobuf::Message *getResponseExtension() const { return responseExtension; }
-	void enqueuePreResponseItem(ServerMessage::MessageType type, ::google::protobuf::Message *item) { preResponseQueue.append(qMakePair(type, item)); }
-	void enqueuePostResponseItem(ServerMessage::MessageType type, ::google::protobuf::Message *item) { postResponseQueue.append(qMakePair(type, item)); }
-	const QList<QPair<ServerMessage::MessageType, ::google::protobuf::Message *> > &getPreResponseQueue() const { return preResponseQueue; }
-	const QList<QPair<ServerMessage::MessageType, ::google::protobuf::Message *> > &getPostResponseQueue() const { return postResponseQueue; }
+	void enqueuePreResponseItem(ServerMessage::MessageType type, ::google::protobuf::Message *item) { preResponseQueue.append(ResponseContainerItem(type, item)); }
+	void enqueuePostResponseItem(ServerMessage::MessageType type, ::google::protobuf::Message *item) { postResponseQueue.append(ResponseContainerItem(type, item)); }
+	void enqueuePostResponseItem(const QByteArray &serializedItem) { postResponseQueue.append(ResponseContainerItem(serializedItem)); }
+	const QList<ResponseContainerItem> &getPreResponseQueue() const { return preResponseQueue; }
+	const QList<ResponseContainerItem> &getPostResponseQueue() const { return postResponseQueue; }
 };
 
 #endif
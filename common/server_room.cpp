@@ -1,7 +1,14 @@
 #include "server_room.h"
 #include "server_protocolhandler.h"
 #include "server_game.h"
+#include "server_player.h"
+#include <QCoreApplication>
 #include <QDebug>
+#include <QSet>
+#include <QDir>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QTimer>
 
 #include "pb/commands.pb.h"
 #include "pb/room_commands.pb.h"
@@ -10,18 +17,31 @@
 #include "pb/event_list_games.pb.h"
 #include "pb/event_room_say.pb.h"
 #include "pb/serverinfo_room.pb.h"
-#include <google/protobuf/descriptor.h>
+#include "pb/game_snapshot.pb.h"
+#include "get_pb_extension.h"
 
 Server_Room::Server_Room(int _id, const QString &_name, const QString &_description, bool _autoJoin, const QString &_joinMessage, const QStringList &_gameTypes, Server *parent)
 	: QObject(parent), id(_id), name(_name), description(_description), autoJoin(_autoJoin), joinMessage(_joinMessage), gameTypes(_gameTypes), gamesLock(QReadWriteLock::Recursive)
 {
 	connect(this, SIGNAL(gameListChanged(ServerInfo_Game)), this, SLOT(broadcastGameListUpdate(ServerInfo_Game)), Qt::QueuedConnection);
+	
+	gameListUpdateTimer = new QTimer(this);
+	gameListUpdateTimer->setSingleShot(true);
+	connect(gameListUpdateTimer, SIGNAL(timeout()), this, SLOT(flushGameListUpdates()));
+	connect(parent, SIGNAL(pingClockTimeout()), this, SLOT(expireHibernatedGames()));
 }
 
 Server_Room::~Server_Room()
 {
 	qDebug("Server_Room destructor");
 	
+	// Bring hibernated games back so that they are closed and their replays stored like all others.
+	gamesLock.lockForRead();
+	const QList<int> hibernatedGameIds = hibernatedGames.keys();
+	gamesLock.unlock();
+	for (int i = 0; i < hibernatedGameIds.size(); ++i)
+		rehydrateGame(hibernatedGameIds[i]);
+	
 	gamesLock.lockForWrite();
 	const QList<Server_Game *> gameList = games.values();
 	for (int i = 0; i < gameList.size(); ++i)
@@ -39,7 +59,7 @@ Server *Server_Room::getServer() const
 	return static_cast<Server *>(parent());
 }
 
-const ServerInfo_Room &Server_Room::getInfo(ServerInfo_Room &result, bool complete, bool showGameTypes, bool includeExternalData) const
+const ServerInfo_Room &Server_Room::getInfo(ServerInfo_Room &result, bool complete, bool showGameTypes, bool includeExternalData, bool includeGames) const
 {
 	result.set_room_id(id);
 	
@@ -48,11 +68,14 @@ const ServerInfo_Room &Server_Room::getInfo(ServerInfo_Room &result, bool comple
 	result.set_auto_join(autoJoin);
 	
 	gamesLock.lockForRead();
-	result.set_game_count(games.size() + externalGames.size());
-	if (complete) {
+	result.set_game_count(games.size() + hibernatedGames.size() + externalGames.size());
+	if (complete && includeGames) {
 		QMapIterator<int, Server_Game *> gameIterator(games);
 		while (gameIterator.hasNext())
 			gameIterator.next().value()->getInfo(*result.add_game_list());
+		QMapIterator<int, Server_HibernatedGame> hibernatedGameIterator(hibernatedGames);
+		while (hibernatedGameIterator.hasNext())
+			result.add_game_list()->CopyFrom(hibernatedGameIterator.next().value().gameInfo);
 		if (includeExternalData) {
 			QMapIterator<int, ServerInfo_Game> externalGameIterator(externalGames);
 			while (externalGameIterator.hasNext())
@@ -89,11 +112,11 @@ RoomEvent *Server_Room::prepareRoomEvent(const ::google::protobuf::Message &room
 {
 	RoomEvent *event = new RoomEvent;
 	event->set_room_id(id);
-	event->GetReflection()->MutableMessage(event, roomEvent.GetDescriptor()->FindExtensionByName("ext"))->CopyFrom(roomEvent);
+	setPbExtension(*event, roomEvent);
 	return event;
 }
 
-void Server_Room::addClient(Server_ProtocolHandler *client)
+void Server_Room::addClient(Server_ProtocolHandler *client, const ServerInfo_GameFilter *gameFilter)
 {
 	Event_JoinRoom event;
 	event.mutable_user_info()->CopyFrom(client->copyUserInfo(false));
@@ -102,14 +125,17 @@ void Server_Room::addClient(Server_ProtocolHandler *client)
 	ServerInfo_Room roomInfo;
 	roomInfo.set_room_id(id);
 	
+	const QString userName = QString::fromStdString(client->getUserInfo()->name());
 	usersLock.lockForWrite();
-	users.insert(QString::fromStdString(client->getUserInfo()->name()), client);
+	users.insert(userName, client);
+	if (gameFilter)
+		gameFilters.insert(userName, *gameFilter);
 	roomInfo.set_player_count(users.size() + externalUsers.size());
 	usersLock.unlock();
 	
 	// XXX This can be removed during the next client update.
 	gamesLock.lockForRead();
-	roomInfo.set_game_count(games.size() + externalGames.size());
+	roomInfo.set_game_count(games.size() + hibernatedGames.size() + externalGames.size());
 	gamesLock.unlock();
 	// -----------
 	
@@ -120,6 +146,7 @@ void Server_Room::removeClient(Server_ProtocolHandler *client)
 {
 	usersLock.lockForWrite();
 	users.remove(QString::fromStdString(client->getUserInfo()->name()));
+	gameFilters.remove(QString::fromStdString(client->getUserInfo()->name()));
 	
 	ServerInfo_Room roomInfo;
 	roomInfo.set_room_id(id);
@@ -132,7 +159,7 @@ void Server_Room::removeClient(Server_ProtocolHandler *client)
 	
 	// XXX This can be removed during the next client update.
 	gamesLock.lockForRead();
-	roomInfo.set_game_count(games.size() + externalGames.size());
+	roomInfo.set_game_count(games.size() + hibernatedGames.size() + externalGames.size());
 	gamesLock.unlock();
 	// -----------
 	
@@ -142,6 +169,13 @@ void Server_Room::removeClient(Server_ProtocolHandler *client)
 void Server_Room::addExternalUser(const ServerInfo_User &userInfo)
 {
 	// This function is always called from the Server thread with server->roomsMutex locked.
+	// After an ISL resync, users may be announced twice.
+	usersLock.lockForRead();
+	const bool alreadyJoined = externalUsers.contains(QString::fromStdString(userInfo.name()));
+	usersLock.unlock();
+	if (alreadyJoined)
+		return;
+	
 	ServerInfo_User_Container userInfoContainer(userInfo);
 	Event_JoinRoom event;
 	event.mutable_user_info()->CopyFrom(userInfoContainer.copyUserInfo(false));
@@ -165,8 +199,10 @@ void Server_Room::removeExternalUser(const QString &name)
 	roomInfo.set_room_id(id);
 	
 	usersLock.lockForWrite();
-	if (externalUsers.contains(name))
-		externalUsers.remove(name);
+	if (!externalUsers.remove(name)) {
+		usersLock.unlock();
+		return;
+	}
 	roomInfo.set_player_count(users.size() + externalUsers.size());
 	usersLock.unlock();
 	
@@ -188,18 +224,57 @@ void Server_Room::updateExternalGameList(const ServerInfo_Game &gameInfo)
 		externalGames.remove(gameInfo.game_id());
 	else
 		externalGames.insert(gameInfo.game_id(), gameInfo);
-	roomInfo.set_game_count(games.size() + externalGames.size());
+	roomInfo.set_game_count(games.size() + hibernatedGames.size() + externalGames.size());
 	gamesLock.unlock();
 	
 	broadcastGameListUpdate(gameInfo, false);
 	emit roomInfoChanged(roomInfo);
 }
 
+void Server_Room::replaceExternalGameList(int serverId, const ServerInfo_Room &roomInfo)
+{
+	// This function is always called from the Server thread with server->roomsMutex locked.
+	QSet<int> gameIds;
+	for (int i = 0; i < roomInfo.game_list_size(); ++i)
+		gameIds.insert(roomInfo.game_list(i).game_id());
+	
+	QList<ServerInfo_Game> closedGames;
+	ServerInfo_Room newRoomInfo;
+	newRoomInfo.set_room_id(id);
+	
+	gamesLock.lockForWrite();
+	QMutableMapIterator<int, ServerInfo_Game> gameIterator(externalGames);
+	while (gameIterator.hasNext()) {
+		gameIterator.next();
+		if ((gameIterator.value().server_id() != serverId) || gameIds.contains(gameIterator.key()))
+			continue;
+		ServerInfo_Game closedGame;
+		closedGame.set_room_id(id);
+		closedGame.set_game_id(gameIterator.key());
+		closedGame.set_server_id(serverId);
+		closedGame.set_closed(true);
+		closedGames.append(closedGame);
+		gameIterator.remove();
+	}
+	newRoomInfo.set_game_count(games.size() + hibernatedGames.size() + externalGames.size());
+	gamesLock.unlock();
+	
+	for (int i = 0; i < closedGames.size(); ++i)
+		broadcastGameListUpdate(closedGames[i], false);
+	if (!closedGames.isEmpty())
+		emit roomInfoChanged(newRoomInfo);
+	
+	for (int i = 0; i < roomInfo.game_list_size(); ++i)
+		updateExternalGameList(roomInfo.game_list(i));
+}
+
 Response::ResponseCode Server_Room::processJoinGameCommand(const Command_JoinGame &cmd, ResponseContainer &rc, Server_AbstractUserInterface *userInterface)
 {
 	// This function is called from the Server thread and from the S_PH thread.
 	// server->roomsMutex is always locked.
 	
+	rehydrateGame(cmd.game_id());
+	
 	QReadLocker roomGamesLocker(&gamesLock);
 	Server_Game *g = games.value(cmd.game_id());
 	if (!g) {
@@ -207,7 +282,7 @@ Response::ResponseCode Server_Room::processJoinGameCommand(const Command_JoinGam
 			CommandContainer cont;
 			cont.set_cmd_id(rc.getCmdId());
 			RoomCommand *roomCommand = cont.add_room_command();
-			roomCommand->GetReflection()->MutableMessage(roomCommand, cmd.GetDescriptor()->FindExtensionByName("ext"))->CopyFrom(cmd);
+			setPbExtension(*roomCommand, cmd);
 			getServer()->sendIsl_RoomCommand(cont, externalGames.value(cmd.game_id()).server_id(), userInterface->getUserInfo()->session_id(), id);
 			
 			return Response::RespNothing;
@@ -249,11 +324,196 @@ void Server_Room::sendRoomEvent(RoomEvent *event, bool sendToIsl)
 	delete event;
 }
 
+void Server_Room::setGameFilter(const QString &userName, const ServerInfo_GameFilter *gameFilter)
+{
+	QWriteLocker locker(&usersLock);
+	if (gameFilter)
+		gameFilters.insert(userName, *gameFilter);
+	else
+		gameFilters.remove(userName);
+}
+
+bool Server_Room::gameMatchesFilter(const ServerInfo_Game &gameInfo, const ServerInfo_GameFilter &filter, const ServerInfo_User &user)
+{
+	if (gameInfo.closed())
+		return false;
+	if (filter.hide_unavailable()) {
+		if ((gameInfo.player_count() == gameInfo.max_players()) || gameInfo.started())
+			return false;
+		if (gameInfo.only_registered() && !(user.user_level() & ServerInfo_User::IsRegistered))
+			return false;
+	}
+	if (filter.hide_password_protected() && gameInfo.with_password())
+		return false;
+	if (filter.hide_buddies_only() && gameInfo.only_buddies() && (gameInfo.creator_info().name() != user.name()))
+		return false;
+	if (filter.game_types_size()) {
+		bool typeFound = false;
+		for (int i = 0; (i < filter.game_types_size()) && !typeFound; ++i)
+			for (int j = 0; (j < gameInfo.game_types_size()) && !typeFound; ++j)
+				typeFound = filter.game_types(i) == gameInfo.game_types(j);
+		if (!typeFound)
+			return false;
+	}
+	if ((filter.max_players_min() != -1) && ((int) gameInfo.max_players() < filter.max_players_min()))
+		return false;
+	if ((filter.max_players_max() != -1) && ((int) gameInfo.max_players() > filter.max_players_max()))
+		return false;
+	return true;
+}
+
+void Server_Room::indexListedGame(const ServerInfo_Game &gameInfo)
+{
+	for (int i = 0; i < gameInfo.game_types_size(); ++i)
+		listedGamesByType[gameInfo.game_types(i)].insert(gameInfo.game_id());
+	if ((gameInfo.player_count() != gameInfo.max_players()) && !gameInfo.started())
+		openListedGames.insert(gameInfo.game_id());
+}
+
+void Server_Room::unindexListedGame(const ServerInfo_Game &gameInfo)
+{
+	for (int i = 0; i < gameInfo.game_types_size(); ++i) {
+		QMap<int, QSet<int> >::iterator it = listedGamesByType.find(gameInfo.game_types(i));
+		if (it == listedGamesByType.end())
+			continue;
+		it.value().remove(gameInfo.game_id());
+		if (it.value().isEmpty())
+			listedGamesByType.erase(it);
+	}
+	openListedGames.remove(gameInfo.game_id());
+}
+
+QList<ServerInfo_Game> Server_Room::getGameList(const ServerInfo_GameFilter &filter, const ServerInfo_User &user) const
+{
+	QReadLocker locker(&listedGamesLock);
+	
+	// Narrow the games down with the indexes, then check the rest of the filter.
+	QList<int> candidates;
+	if (filter.game_types_size()) {
+		QSet<int> gameIds;
+		for (int i = 0; i < filter.game_types_size(); ++i)
+			gameIds.unite(listedGamesByType.value(filter.game_types(i)));
+		if (filter.hide_unavailable())
+			gameIds.intersect(openListedGames);
+		candidates = gameIds.toList();
+	} else if (filter.hide_unavailable())
+		candidates = openListedGames.toList();
+	else
+		candidates = listedGames.keys();
+	
+	QList<ServerInfo_Game> result;
+	for (int i = 0; i < candidates.size(); ++i) {
+		const ServerInfo_Game &gameInfo = listedGames.find(candidates[i]).value();
+		if (gameMatchesFilter(gameInfo, filter, user))
+			result.append(gameInfo);
+	}
+	return result;
+}
+
 void Server_Room::broadcastGameListUpdate(const ServerInfo_Game &gameInfo, bool sendToIsl)
 {
+	// This function is always called from the Server thread.
+	// A complete game info or a closed game replaces what is pending, other changes are merged into it.
+	QMap<int, ServerInfo_Game> &updates = sendToIsl ? pendingGameListUpdates : pendingExternalGameListUpdates;
+	QMap<int, ServerInfo_Game>::iterator it = updates.find(gameInfo.game_id());
+	if (it == updates.end())
+		updates.insert(gameInfo.game_id(), gameInfo);
+	else if (gameInfo.closed() || gameInfo.has_creator_info())
+		it.value().CopyFrom(gameInfo);
+	else
+		it.value().MergeFrom(gameInfo);
+	
+	const int interval = getServer()->getGameListUpdateInterval();
+	if (interval <= 0)
+		flushGameListUpdates();
+	else if (!gameListUpdateTimer->isActive())
+		gameListUpdateTimer->start(interval);
+}
+
+void Server_Room::flushGameListUpdates()
+{
+	QList<ServerInfo_Game> updates = pendingGameListUpdates.values();
+	const int islUpdateCount = updates.size();
+	updates.append(pendingExternalGameListUpdates.values());
+	pendingGameListUpdates.clear();
+	pendingExternalGameListUpdates.clear();
+	if (updates.isEmpty())
+		return;
+	
+	// Bring the listed games up to date. Users with a filter need to know which games
+	// they were shown before, previousGames holds an empty info for games that were not listed.
+	QList<ServerInfo_Game> previousGames, currentGames;
+	listedGamesLock.lockForWrite();
+	for (int i = 0; i < updates.size(); ++i) {
+		const ServerInfo_Game &update = updates[i];
+		QMap<int, ServerInfo_Game>::iterator it = listedGames.find(update.game_id());
+		const bool wasListed = it != listedGames.end();
+		previousGames.append(wasListed ? it.value() : ServerInfo_Game());
+		ServerInfo_Game currentGame(previousGames.last());
+		if (wasListed)
+			unindexListedGame(currentGame);
+		if (!wasListed || update.closed() || update.has_creator_info())
+			currentGame.CopyFrom(update);
+		else
+			currentGame.MergeFrom(update);
+		currentGames.append(currentGame);
+		
+		if (update.closed())
+			listedGames.remove(update.game_id());
+		else {
+			listedGames.insert(update.game_id(), currentGame);
+			indexListedGame(currentGame);
+		}
+	}
+	listedGamesLock.unlock();
+	
 	Event_ListGames event;
-	event.add_game_list()->CopyFrom(gameInfo);
-	sendRoomEvent(prepareRoomEvent(event), sendToIsl);
+	for (int i = 0; i < updates.size(); ++i)
+		event.add_game_list()->CopyFrom(updates[i]);
+	RoomEvent *roomEvent = prepareRoomEvent(event);
+	
+	usersLock.lockForRead();
+	QMapIterator<QString, Server_ProtocolHandler *> userIterator(users);
+	while (userIterator.hasNext()) {
+		userIterator.next();
+		QMap<QString, ServerInfo_GameFilter>::const_iterator filterIterator = gameFilters.constFind(userIterator.key());
+		if (filterIterator == gameFilters.constEnd()) {
+			userIterator.value()->sendProtocolItem(*roomEvent);
+			continue;
+		}
+		
+		// Games that start matching are sent complete, games that stop matching as closed.
+		const ServerInfo_User &user = *userIterator.value()->getUserInfo();
+		Event_ListGames filteredEvent;
+		for (int i = 0; i < updates.size(); ++i) {
+			const bool wasShown = previousGames[i].has_game_id() && gameMatchesFilter(previousGames[i], filterIterator.value(), user);
+			const bool isShown = gameMatchesFilter(currentGames[i], filterIterator.value(), user);
+			if (isShown)
+				filteredEvent.add_game_list()->CopyFrom(wasShown ? updates[i] : currentGames[i]);
+			else if (wasShown) {
+				ServerInfo_Game *closedGame = filteredEvent.add_game_list();
+				closedGame->set_room_id(id);
+				closedGame->set_game_id(updates[i].game_id());
+				closedGame->set_closed(true);
+			}
+		}
+		if (filteredEvent.game_list_size()) {
+			RoomEvent *filteredRoomEvent = prepareRoomEvent(filteredEvent);
+			userIterator.value()->sendProtocolItem(*filteredRoomEvent);
+			delete filteredRoomEvent;
+		}
+	}
+	usersLock.unlock();
+	delete roomEvent;
+	
+	if (islUpdateCount) {
+		Event_ListGames islEvent;
+		for (int i = 0; i < islUpdateCount; ++i)
+			islEvent.add_game_list()->CopyFrom(updates[i]);
+		RoomEvent *islRoomEvent = prepareRoomEvent(islEvent);
+		getServer()->sendIsl_RoomEvent(*islRoomEvent);
+		delete islRoomEvent;
+	}
 }
 
 void Server_Room::addGame(Server_Game *game)
@@ -266,9 +526,10 @@ void Server_Room::addGame(Server_Game *game)
 	
 	game->gameMutex.lock();
 	games.insert(game->getGameId(), game);
+	userGameIndex.addCreatedGame(QString::fromStdString(game->getCreatorInfo()->name()), game->getGameId());
 	ServerInfo_Game gameInfo;
 	game->getInfo(gameInfo);
-	roomInfo.set_game_count(games.size() + externalGames.size());
+	roomInfo.set_game_count(games.size() + hibernatedGames.size() + externalGames.size());
 	game->gameMutex.unlock();
 	gamesLock.unlock();
 	
@@ -294,10 +555,11 @@ void Server_Room::removeGame(Server_Game *game)
 	emit gameListChanged(gameInfo);
 	
 	games.remove(game->getGameId());
+	userGameIndex.removeGame(game->getGameId());
 	
 	ServerInfo_Room roomInfo;
 	roomInfo.set_room_id(id);
-	roomInfo.set_game_count(games.size() + externalGames.size());
+	roomInfo.set_game_count(games.size() + hibernatedGames.size() + externalGames.size());
 	
 	// XXX This can be removed during the next client update.
 	usersLock.lockForRead();
@@ -310,14 +572,7 @@ void Server_Room::removeGame(Server_Game *game)
 
 int Server_Room::getGamesCreatedByUser(const QString &userName) const
 {
-	QReadLocker locker(&gamesLock);
-	
-	QMapIterator<int, Server_Game *> gamesIterator(games);
-	int result = 0;
-	while (gamesIterator.hasNext())
-		if (gamesIterator.next().value()->getCreatorInfo()->name() == userName.toStdString())
-			++result;
-	return result;
+	return userGameIndex.getGamesCreatedByUser(userName);
 }
 
 QList<ServerInfo_Game> Server_Room::getGamesOfUser(const QString &userName) const
@@ -325,14 +580,269 @@ QList<ServerInfo_Game> Server_Room::getGamesOfUser(const QString &userName) cons
 	QReadLocker locker(&gamesLock);
 	
 	QList<ServerInfo_Game> result;
-	QMapIterator<int, Server_Game *> gamesIterator(games);
-	while (gamesIterator.hasNext()) {
-		Server_Game *game = gamesIterator.next().value();
-		if (game->containsUser(userName)) {
+	QListIterator<int> gameIdIterator(userGameIndex.getGamesOfUser(userName));
+	while (gameIdIterator.hasNext()) {
+		const int gameId = gameIdIterator.next();
+		Server_Game *game = games.value(gameId);
+		if (game) {
 			ServerInfo_Game gameInfo;
 			game->getInfo(gameInfo);
 			result.append(gameInfo);
-		}
+		} else if (hibernatedGames.contains(gameId))
+			result.append(hibernatedGames.value(gameId).gameInfo);
 	}
 	return result;
 }
+
+bool Server_Room::hibernateGame(Server_Game *game)
+{
+	Server *server = getServer();
+	QElapsedTimer timer;
+	timer.start();
+	const int gameId = game->getGameId();
+	
+	// The snapshot is built and written without gamesLock, so that the room is not held up by the disk.
+	// Nobody is connected to the game, so it does not change until it is swapped out below.
+	GameSnapshot snapshot;
+	game->gameMutex.lock();
+	const bool canHibernate = game->getCanHibernate();
+	if (canHibernate)
+		game->getSnapshot(snapshot);
+	game->gameMutex.unlock();
+	if (!canHibernate)
+		return false;
+	
+	QByteArray data(snapshot.ByteSize(), 0);
+	snapshot.SerializeToArray(data.data(), data.size());
+	
+	Server_HibernatedGame hibernatedGame;
+	// Several servers may share the hibernation path.
+	hibernatedGame.fileName = QDir(server->getGameHibernationPath()).filePath(QString("game_%1_%2_%3.snapshot").arg(server->getServerId()).arg(QCoreApplication::applicationPid()).arg(gameId));
+	QFile file(hibernatedGame.fileName);
+	if (!file.open(QIODevice::WriteOnly) || (file.write(qCompress(data)) == -1)) {
+		qDebug() << "Server_Room::hibernateGame: could not write" << hibernatedGame.fileName;
+		file.close();
+		file.remove();
+		return false;
+	}
+	file.close();
+	
+	hibernatedGame.gameInfo.CopyFrom(snapshot.game_info());
+	for (int i = 0; i < snapshot.player_list_size(); ++i) {
+		const ServerInfo_PlayerProperties &properties = snapshot.player_list(i).info().properties();
+		hibernatedGame.players.insert(QString::fromStdString(properties.user_info().name()), properties.player_id());
+	}
+	hibernatedGame.inactivity = snapshot.inactivity_counter();
+	hibernatedGame.hibernatedSince = server->getMsecsRunning();
+	
+	gamesLock.lockForWrite();
+	game->gameMutex.lock();
+	// Someone may have come back or taken the game elsewhere while it was written.
+	const bool swapped = (games.value(gameId) == game) && game->getCanHibernate();
+	if (swapped) {
+		disconnect(game, 0, this, 0);
+		games.remove(gameId);
+		hibernatedGames.insert(gameId, hibernatedGame);
+		game->setHibernated();
+	}
+	game->gameMutex.unlock();
+	gamesLock.unlock();
+	
+	if (!swapped) {
+		file.remove();
+		return false;
+	}
+	game->deleteLater();
+	
+	server->addGameHibernation(timer.nsecsElapsed());
+	qDebug() << "Server_Room::hibernateGame: gameId=" << gameId << "," << data.size() << "bytes";
+	return true;
+}
+
+Server_Game *Server_Room::rehydrateGame(int gameId)
+{
+	Server *server = getServer();
+	QElapsedTimer timer;
+	timer.start();
+	
+	gamesLock.lockForRead();
+	const bool hibernated = hibernatedGames.contains(gameId);
+	gamesLock.unlock();
+	if (!hibernated)
+		return 0;
+	
+	// The snapshot is read without gamesLock. The game stays listed as hibernated meanwhile,
+	// and as only rehydrations take games out of hibernatedGames, one at a time, nobody else
+	// can bring it back in between.
+	QMutexLocker rehydrationLocker(&rehydrationMutex);
+	gamesLock.lockForRead();
+	Server_Game *residentGame = games.value(gameId);
+	const bool stillHibernated = hibernatedGames.contains(gameId);
+	const Server_HibernatedGame hibernatedGame = hibernatedGames.value(gameId);
+	gamesLock.unlock();
+	if (residentGame || !stillHibernated)
+		return residentGame;
+	
+	QFile file(hibernatedGame.fileName);
+	GameSnapshot snapshot;
+	bool ok = file.open(QIODevice::ReadOnly);
+	if (ok) {
+		const QByteArray data = qUncompress(file.readAll());
+		ok = snapshot.ParseFromArray(data.constData(), data.size());
+	}
+	file.close();
+	file.remove();
+	
+	QWriteLocker locker(&gamesLock);
+	hibernatedGames.remove(gameId);
+	if (!ok) {
+		qDebug() << "Server_Room::rehydrateGame: could not read" << hibernatedGame.fileName;
+		QMapIterator<QString, int> playerIterator(hibernatedGame.players);
+		while (playerIterator.hasNext()) {
+			playerIterator.next();
+			server->removePersistentPlayer(playerIterator.key(), id, gameId, playerIterator.value());
+		}
+		userGameIndex.removeGame(gameId);
+		ServerInfo_Game gameInfo;
+		gameInfo.set_room_id(id);
+		gameInfo.set_game_id(gameId);
+		gameInfo.set_closed(true);
+		emit gameListChanged(gameInfo);
+		return 0;
+	}
+	
+	// The game was not active while on disk.
+	snapshot.set_inactivity_counter(hibernatedGame.inactivity + (server->getMsecsRunning() - hibernatedGame.hibernatedSince) / 1000);
+	Server_Game *game = new Server_Game(snapshot, this);
+	games.insert(gameId, game);
+	connect(game, SIGNAL(gameInfoChanged(ServerInfo_Game)), this, SLOT(broadcastGameListUpdate(ServerInfo_Game)));
+	
+	server->addGameRehydration(timer.nsecsElapsed());
+	qDebug() << "Server_Room::rehydrateGame: gameId=" << gameId;
+	return game;
+}
+
+bool Server_Room::migrateGame(int gameId, int serverId, GameSnapshot &snapshot)
+{
+	Server *server = getServer();
+	rehydrateGame(gameId);
+	
+	QWriteLocker locker(&gamesLock);
+	Server_Game *game = games.value(gameId);
+	if (!game)
+		return false;
+	QMutexLocker gameLocker(&game->gameMutex);
+	if (game->getGameClosed())
+		return false;
+	
+	game->getSnapshot(snapshot);
+	
+	// The other server takes over the persistent players. Until it announces the game,
+	// commands for it are already forwarded there.
+	QMapIterator<int, Server_Player *> playerIterator(game->getPlayers());
+	while (playerIterator.hasNext()) {
+		Server_Player *player = playerIterator.next().value();
+		server->removePersistentPlayer(QString::fromStdString(player->getUserInfo()->name()), id, gameId, player->getPlayerId());
+	}
+	ServerInfo_Game gameInfo;
+	game->getInfo(gameInfo);
+	gameInfo.set_server_id(serverId);
+	
+	disconnect(game, 0, this, 0);
+	games.remove(gameId);
+	userGameIndex.removeGame(gameId);
+	externalGames.insert(gameId, gameInfo);
+	game->setMigrated();
+	game->deleteLater();
+	
+	qDebug() << "Server_Room::migrateGame: gameId=" << gameId << "to server" << serverId;
+	return true;
+}
+
+bool Server_Room::adoptGame(const GameSnapshot &snapshot, const QMap<QString, Server_AbstractUserInterface *> &userInterfaces)
+{
+	Server *server = getServer();
+	const int gameId = snapshot.game_info().game_id();
+	ServerInfo_Room roomInfo;
+	roomInfo.set_room_id(id);
+	
+	gamesLock.lockForWrite();
+	if (games.contains(gameId) || hibernatedGames.contains(gameId)) {
+		gamesLock.unlock();
+		qDebug() << "Server_Room::adoptGame: gameId=" << gameId << "already exists";
+		return false;
+	}
+	externalGames.remove(gameId);
+	
+	Server_Game *game = new Server_Game(snapshot, this);
+	games.insert(gameId, game);
+	connect(game, SIGNAL(gameInfoChanged(ServerInfo_Game)), this, SLOT(broadcastGameListUpdate(ServerInfo_Game)));
+	
+	// Users that are still around continue where they were, the others are
+	// treated like disconnected ones.
+	game->gameMutex.lock();
+	userGameIndex.addCreatedGame(QString::fromStdString(game->getCreatorInfo()->name()), gameId);
+	QList<Server_Player *> playersToRemove;
+	QMapIterator<int, Server_Player *> playerIterator(game->getPlayers());
+	while (playerIterator.hasNext()) {
+		Server_Player *player = playerIterator.next().value();
+		const QString playerName = QString::fromStdString(player->getUserInfo()->name());
+		userGameIndex.addUser(playerName, gameId);
+		const bool registered = player->getUserInfo()->user_level() & ServerInfo_User::IsRegistered;
+		Server_AbstractUserInterface *userInterface = userInterfaces.value(playerName);
+		if (userInterface) {
+			player->setUserInterface(userInterface);
+			userInterface->playerAddedToGame(gameId, id, player->getPlayerId());
+		} else if (!registered || player->getSpectator()) {
+			playersToRemove.append(player);
+			continue;
+		}
+		if (registered && !player->getSpectator())
+			server->addPersistentPlayer(playerName, id, gameId, player->getPlayerId());
+	}
+	for (int i = 0; i < playersToRemove.size(); ++i)
+		game->removePlayer(playersToRemove[i]);
+	
+	ServerInfo_Game gameInfo;
+	game->getInfo(gameInfo);
+	game->gameMutex.unlock();
+	roomInfo.set_game_count(games.size() + hibernatedGames.size() + externalGames.size());
+	gamesLock.unlock();
+	
+	// XXX This can be removed during the next client update.
+	usersLock.lockForRead();
+	roomInfo.set_player_count(users.size() + externalUsers.size());
+	usersLock.unlock();
+	// -----------
+	
+	emit gameListChanged(gameInfo);
+	emit roomInfoChanged(roomInfo);
+	
+	qDebug() << "Server_Room::adoptGame: gameId=" << gameId;
+	return true;
+}
+
+void Server_Room::expireHibernatedGames()
+{
+	const int maxTime = getServer()->getMaxGameInactivityTime();
+	if (maxTime <= 0)
+		return;
+	const qint64 now = getServer()->getMsecsRunning();
+	
+	QList<int> expiredGameIds;
+	gamesLock.lockForRead();
+	QMapIterator<int, Server_HibernatedGame> hibernatedGameIterator(hibernatedGames);
+	while (hibernatedGameIterator.hasNext()) {
+		const Server_HibernatedGame &hibernatedGame = hibernatedGameIterator.next().value();
+		if (hibernatedGame.inactivity + (now - hibernatedGame.hibernatedSince) / 1000 >= maxTime)
+			expiredGameIds.append(hibernatedGameIterator.key());
+	}
+	gamesLock.unlock();
+	
+	// Expired games are closed the regular way, which also stores their replays.
+	for (int i = 0; i < expiredGameIds.size(); ++i) {
+		Server_Game *game = rehydrateGame(expiredGameIds[i]);
+		if (game)
+			game->deleteLater();
+	}
+}
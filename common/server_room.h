@@ -8,7 +8,10 @@
 #include <QMutex>
 #include <QReadWriteLock>
 #include "serverinfo_user_container.h"
+#include "server_user_game_index.h"
 #include "pb/response.pb.h"
+#include "pb/serverinfo_game.pb.h"
+#include "pb/serverinfo_game_filter.pb.h"
 
 class Server_DatabaseInterface;
 class Server_ProtocolHandler;
@@ -22,6 +25,17 @@ class Server;
 class Command_JoinGame;
 class ResponseContainer;
 class Server_AbstractUserInterface;
+class GameSnapshot;
+class QTimer;
+
+// A game that was written to disk while all of its players were away.
+struct Server_HibernatedGame {
+	ServerInfo_Game gameInfo;
+	QMap<QString, int> players; // user name -> player id
+	QString fileName;
+	int inactivity; // seconds, when hibernated
+	qint64 hibernatedSince; // see Server::getMsecsRunning()
+};
 
 class Server_Room : public QObject {
 	Q_OBJECT
@@ -37,10 +51,27 @@ private:
 	QStringList gameTypes;
 	QMap<int, Server_Game *> games;
 	QMap<int, ServerInfo_Game> externalGames;
+	QMap<int, Server_HibernatedGame> hibernatedGames;
 	QMap<QString, Server_ProtocolHandler *> users;
 	QMap<QString, ServerInfo_User_Container> externalUsers;
+	Server_UserGameIndex userGameIndex;
+	// Game list changes waiting to be sent, by game id. External ones are not sent to ISL.
+	QMap<int, ServerInfo_Game> pendingGameListUpdates, pendingExternalGameListUpdates;
+	QTimer *gameListUpdateTimer;
+	// The game list as last sent to the users, indexed for users with a game filter.
+	// Guarded by listedGamesLock, which is taken after every other lock.
+	QMap<int, ServerInfo_Game> listedGames;
+	QMap<int, QSet<int> > listedGamesByType;
+	QSet<int> openListedGames;
+	mutable QReadWriteLock listedGamesLock;
+	void indexListedGame(const ServerInfo_Game &gameInfo);
+	void unindexListedGame(const ServerInfo_Game &gameInfo);
+	QMap<QString, ServerInfo_GameFilter> gameFilters; // by user name, guarded by usersLock
+	QMutex rehydrationMutex; // taken before gamesLock
 private slots:
 	void broadcastGameListUpdate(const ServerInfo_Game &gameInfo, bool sendToIsl = true);
+	void flushGameListUpdates();
+	void expireHibernatedGames();
 public:
 	mutable QReadWriteLock usersLock;
 	mutable QReadWriteLock gamesLock;
@@ -54,18 +85,26 @@ public:
 	const QStringList &getGameTypes() const { return gameTypes; }
 	const QMap<int, Server_Game *> &getGames() const { return games; }
 	const QMap<int, ServerInfo_Game> &getExternalGames() const { return externalGames; }
+	const QMap<int, Server_HibernatedGame> &getHibernatedGames() const { return hibernatedGames; }
 	Server *getServer() const;
-	const ServerInfo_Room &getInfo(ServerInfo_Room &result, bool complete, bool showGameTypes = false, bool includeExternalData = true) const;
+	Server_UserGameIndex &getUserGameIndex() { return userGameIndex; }
+	const ServerInfo_Room &getInfo(ServerInfo_Room &result, bool complete, bool showGameTypes = false, bool includeExternalData = true, bool includeGames = true) const;
 	int getGamesCreatedByUser(const QString &name) const;
 	QList<ServerInfo_Game> getGamesOfUser(const QString &name) const;
 	
-	void addClient(Server_ProtocolHandler *client);
+	void addClient(Server_ProtocolHandler *client, const ServerInfo_GameFilter *gameFilter = 0);
 	void removeClient(Server_ProtocolHandler *client);
+	// Users with a game filter only get the games matching it, 0 removes the filter.
+	void setGameFilter(const QString &userName, const ServerInfo_GameFilter *gameFilter);
+	QList<ServerInfo_Game> getGameList(const ServerInfo_GameFilter &filter, const ServerInfo_User &user) const;
+	static bool gameMatchesFilter(const ServerInfo_Game &gameInfo, const ServerInfo_GameFilter &filter, const ServerInfo_User &user);
 	
 	void addExternalUser(const ServerInfo_User &userInfo);
 	void removeExternalUser(const QString &name);
 	const QMap<QString, ServerInfo_User_Container> &getExternalUsers() const { return externalUsers; }
 	void updateExternalGameList(const ServerInfo_Game &gameInfo);
+	void replaceExternalGameList(int serverId, const ServerInfo_Room &roomInfo);
+	int getLocalUserCount() const { QReadLocker locker(&usersLock); return users.size(); }
 	
 	Response::ResponseCode processJoinGameCommand(const Command_JoinGame &cmd, ResponseContainer &rc, Server_AbstractUserInterface *userInterface);
 	
@@ -73,6 +112,17 @@ public:
 	
 	void addGame(Server_Game *game);
 	void removeGame(Server_Game *game);
+	// Hibernation writes an idle game to disk and deletes it, rehydration brings it back.
+	// rehydrateGame() returns 0 if the game is not hibernated.
+	// Neither may be called with gamesLock or a gameMutex held.
+	bool hibernateGame(Server_Game *game);
+	Server_Game *rehydrateGame(int gameId);
+	// Migration hands a running game to another server: migrateGame() takes the game
+	// out of this room and lists it as an external game of serverId, adoptGame() brings
+	// a snapshot to life here. userInterfaces maps user names to the users that can be
+	// connected to their players again. Neither may be called with gamesLock or a gameMutex held.
+	bool migrateGame(int gameId, int serverId, GameSnapshot &snapshot);
+	bool adoptGame(const GameSnapshot &snapshot, const QMap<QString, Server_AbstractUserInterface *> &userInterfaces);
 	
 	void sendRoomEvent(RoomEvent *event, bool sendToIsl = true);
 	RoomEvent *prepareRoomEvent(const ::google::protobuf::Message &roomEvent);
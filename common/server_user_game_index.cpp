@@ -0,0 +1,66 @@
+#include "server_user_game_index.h"
+#include <QMutexLocker>
+
+void Server_UserGameIndex::removeFromSet(QHash<QString, QSet<int> > &hash, const QString &userName, int gameId)
+{
+	QHash<QString, QSet<int> >::iterator it = hash.find(userName);
+	if (it == hash.end())
+		return;
+	it.value().remove(gameId);
+	if (it.value().isEmpty())
+		hash.erase(it);
+}
+
+void Server_UserGameIndex::addCreatedGame(const QString &creatorName, int gameId)
+{
+	QMutexLocker locker(&mutex);
+	
+	gamesCreatedByUser[creatorName].insert(gameId);
+	creatorOfGame.insert(gameId, creatorName);
+}
+
+void Server_UserGameIndex::addUser(const QString &userName, int gameId)
+{
+	QMutexLocker locker(&mutex);
+	
+	gamesOfUser[userName].insert(gameId);
+	usersOfGame[gameId].insert(userName);
+}
+
+void Server_UserGameIndex::removeUser(const QString &userName, int gameId)
+{
+	QMutexLocker locker(&mutex);
+	
+	removeFromSet(gamesOfUser, userName, gameId);
+	QHash<int, QSet<QString> >::iterator it = usersOfGame.find(gameId);
+	if (it == usersOfGame.end())
+		return;
+	it.value().remove(userName);
+	if (it.value().isEmpty())
+		usersOfGame.erase(it);
+}
+
+void Server_UserGameIndex::removeGame(int gameId)
+{
+	QMutexLocker locker(&mutex);
+	
+	QSetIterator<QString> userIterator(usersOfGame.take(gameId));
+	while (userIterator.hasNext())
+		removeFromSet(gamesOfUser, userIterator.next(), gameId);
+	if (creatorOfGame.contains(gameId))
+		removeFromSet(gamesCreatedByUser, creatorOfGame.take(gameId), gameId);
+}
+
+int Server_UserGameIndex::getGamesCreatedByUser(const QString &userName) const
+{
+	QMutexLocker locker(&mutex);
+	
+	return gamesCreatedByUser.value(userName).size();
+}
+
+QList<int> Server_UserGameIndex::getGamesOfUser(const QString &userName) const
+{
+	QMutexLocker locker(&mutex);
+	
+	return gamesOfUser.value(userName).toList();
+}
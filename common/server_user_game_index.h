@@ -0,0 +1,32 @@
+#ifndef SERVER_USER_GAME_INDEX_H
+#define SERVER_USER_GAME_INDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+
+// Games of a room by user name, so that join limits and "games of user" do not
+// need to look at every game. Game ids stay indexed while a game is hibernated.
+// The index has its own mutex and may be used with gamesLock or a gameMutex held.
+class Server_UserGameIndex {
+private:
+	mutable QMutex mutex;
+	QHash<QString, QSet<int> > gamesOfUser, gamesCreatedByUser;
+	QHash<int, QSet<QString> > usersOfGame;
+	QHash<int, QString> creatorOfGame;
+	
+	static void removeFromSet(QHash<QString, QSet<int> > &hash, const QString &userName, int gameId);
+public:
+	void addCreatedGame(const QString &creatorName, int gameId);
+	void addUser(const QString &userName, int gameId);
+	void removeUser(const QString &userName, int gameId);
+	// Drops every entry of a game that left the room.
+	void removeGame(int gameId);
+	
+	int getGamesCreatedByUser(const QString &userName) const;
+	QList<int> getGamesOfUser(const QString &userName) const;
+};
+
+#endif
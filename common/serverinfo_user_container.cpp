@@ -37,8 +37,10 @@ ServerInfo_User &ServerInfo_User_Container::copyUserInfo(ServerInfo_User &result
 			result.clear_session_id();
 			result.clear_address();
 		}
-		if (!internalInfo)
+		if (!internalInfo) {
 			result.clear_id();
+			result.clear_client_features();
+		}
 		if (!complete)
 			result.clear_avatar_bmp();
 	}
@@ -0,0 +1,31 @@
+#include <QDataStream>
+#include "traffic_capture.h"
+
+void TrafficCaptureRecord::writeHeader(QDataStream &stream)
+{
+	stream << fileMagic << fileVersion;
+}
+
+bool TrafficCaptureRecord::readHeader(QDataStream &stream)
+{
+	quint32 magic, version;
+	stream >> magic >> version;
+	return (stream.status() == QDataStream::Ok) && (magic == fileMagic) && (version == fileVersion);
+}
+
+void TrafficCaptureRecord::write(QDataStream &stream) const
+{
+	stream << (quint8) type << connectionId << timestamp << data;
+}
+
+bool TrafficCaptureRecord::read(QDataStream &stream)
+{
+	quint8 _type;
+	stream >> _type >> connectionId >> timestamp >> data;
+	if (stream.status() != QDataStream::Ok)
+		return false;
+	if ((_type < ConnectionOpened) || (_type > ConnectionClosed))
+		return false;
+	type = (RecordType) _type;
+	return true;
+}
@@ -0,0 +1,31 @@
+#ifndef TRAFFIC_CAPTURE_H
+#define TRAFFIC_CAPTURE_H
+
+#include <QByteArray>
+
+class QDataStream;
+
+// One entry of a servatrice traffic capture file. A capture file starts with
+// a header and is followed by records in the order they were received.
+// Command frames hold the serialized CommandContainer without length prefix.
+class TrafficCaptureRecord {
+public:
+	enum RecordType { ConnectionOpened = 1, CommandFrame = 2, ConnectionClosed = 3 };
+	static const quint32 fileMagic = 0x43544346;
+	static const quint32 fileVersion = 1;
+
+	RecordType type;
+	quint32 connectionId;
+	qint64 timestamp; // milliseconds since the epoch
+	QByteArray data; // peer address for ConnectionOpened, the frame for CommandFrame
+
+	TrafficCaptureRecord(RecordType _type = CommandFrame, quint32 _connectionId = 0, qint64 _timestamp = 0, const QByteArray &_data = QByteArray())
+		: type(_type), connectionId(_connectionId), timestamp(_timestamp), data(_data) { }
+
+	static void writeHeader(QDataStream &stream);
+	static bool readHeader(QDataStream &stream);
+	void write(QDataStream &stream) const;
+	bool read(QDataStream &stream);
+};
+
+#endif
@@ -0,0 +1,561 @@
+#include <QTimer>
+#include <QDateTime>
+#include <iostream>
+#include "loadgen_client.h"
+#include "loadgen_settings.h"
+#include "loadgen_statistics.h"
+#include "loadgen_matchmaker.h"
+#include "decklist.h"
+#include "get_pb_extension.h"
+#include <google/protobuf/descriptor.h>
+#include "pb/commands.pb.h"
+#include "pb/server_message.pb.h"
+#include "pb/session_commands.pb.h"
+#include "pb/room_commands.pb.h"
+#include "pb/command_deck_select.pb.h"
+#include "pb/command_ready_start.pb.h"
+#include "pb/command_draw_cards.pb.h"
+#include "pb/command_move_card.pb.h"
+#include "pb/command_set_card_attr.pb.h"
+#include "pb/command_inc_counter.pb.h"
+#include "pb/command_game_say.pb.h"
+#include "pb/command_next_turn.pb.h"
+#include "pb/command_leave_game.pb.h"
+#include "pb/event_server_identification.pb.h"
+#include "pb/event_connection_closed.pb.h"
+#include "pb/event_game_joined.pb.h"
+#include "pb/event_game_state_changed.pb.h"
+#include "pb/event_draw_cards.pb.h"
+#include "pb/event_move_card.pb.h"
+#include "pb/serverinfo_game.pb.h"
+
+static const unsigned int protocolVersion = 14;
+
+LoadGen_Client::LoadGen_Client(int _clientIndex, const LoadGen_Settings &_settings, LoadGen_Statistics *_statistics, LoadGen_Matchmaker *_matchmaker)
+	: QObject(), settings(_settings), statistics(_statistics), matchmaker(_matchmaker), clientIndex(_clientIndex), messageInProgress(false), handshakeStarted(false), messageLength(0), state(StateDisconnected), nextCmdId(0), lastCommandSent(0), gameId(-1), playerId(-1), actionsLeft(0)
+{
+	userName = QString("%1%2").arg(settings.userNamePrefix).arg(clientIndex);
+	host = (clientIndex % settings.playersPerGame) == 0;
+	deckString = generateDeck(settings.deckSize, clientIndex);
+
+	socket = new QTcpSocket(this);
+	socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+	connect(socket, SIGNAL(connected()), this, SLOT(slotConnected()));
+	connect(socket, SIGNAL(readyRead()), this, SLOT(readData()));
+	connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(slotSocketError(QAbstractSocket::SocketError)));
+
+	actionTimer = new QTimer(this);
+	actionTimer->setSingleShot(true);
+	connect(actionTimer, SIGNAL(timeout()), this, SLOT(performAction()));
+
+	maintenanceTimer = new QTimer(this);
+	maintenanceTimer->setInterval(1000);
+	connect(maintenanceTimer, SIGNAL(timeout()), this, SLOT(maintenanceTimeout()));
+}
+
+LoadGen_Client::~LoadGen_Client()
+{
+	disconnectFromServer();
+}
+
+QString LoadGen_Client::generateDeck(int size, int variant)
+{
+	DeckList deck;
+	deck.setName(QString("Load test deck %1").arg(variant));
+
+	// Four copies of each card, like a constructed deck; the card pool shifts with the variant
+	// so that not every client plays the very same list.
+	const int copies = 4;
+	for (int i = 0; i * copies < size; ++i) {
+		DecklistCardNode *card = deck.addCard(QString("Load Test Card %1").arg(variant % 7 + i), "main");
+		card->setNumber(qMin(copies, size - i * copies));
+	}
+	for (int i = 0; i < 15; i += 3) {
+		DecklistCardNode *card = deck.addCard(QString("Load Test Sideboard Card %1").arg(i), "side");
+		card->setNumber(3);
+	}
+
+	return deck.writeToString_Native();
+}
+
+void LoadGen_Client::setState(ClientState _state)
+{
+	state = _state;
+}
+
+void LoadGen_Client::connectToServer()
+{
+	if (state != StateDisconnected)
+		return;
+
+	qsrand(QDateTime::currentDateTime().toTime_t() ^ (clientIndex << 8));
+	setState(StateConnecting);
+	socket->connectToHost(settings.host, settings.port);
+}
+
+void LoadGen_Client::disconnectFromServer()
+{
+	closeConnection(false);
+}
+
+void LoadGen_Client::closeConnection(bool error)
+{
+	if (state == StateDisconnected)
+		return;
+
+	actionTimer->stop();
+	maintenanceTimer->stop();
+
+	// Everything still in flight is lost.
+	if (error) {
+		QMapIterator<int, PendingCommand> i(pendingCommands);
+		while (i.hasNext())
+			statistics->commandTimedOut(i.next().value().name);
+	}
+	pendingCommands.clear();
+
+	if (state == StatePlaying)
+		statistics->gameFinished();
+	if (host && (gameId != -1))
+		matchmaker->withdrawGame(gameId);
+	if (state >= StateAwaitingIdentification)
+		statistics->connectionClosed(state > StateLoggingIn, error);
+	else if (error)
+		statistics->connectionFailed();
+
+	inputBuffer.clear();
+	messageInProgress = false;
+	handshakeStarted = false;
+	messageLength = 0;
+	gameId = -1;
+
+	setState(StateDisconnected);
+	socket->abort();
+}
+
+void LoadGen_Client::slotConnected()
+{
+	statistics->connectionOpened();
+	maintenanceTimer->start();
+
+	// The server only identifies itself after receiving a command container without a command id,
+	// which serializes to an empty message.
+	socket->write(QByteArray(4, 0));
+
+	setState(StateAwaitingIdentification);
+}
+
+void LoadGen_Client::slotSocketError(QAbstractSocket::SocketError /*error*/)
+{
+	if (state == StateDisconnected)
+		return;
+
+	std::cerr << userName.toStdString() << ": socket error: " << socket->errorString().toStdString() << std::endl;
+	closeConnection(true);
+}
+
+void LoadGen_Client::readData()
+{
+	QByteArray data = socket->readAll();
+	inputBuffer.append(data);
+
+	do {
+		if (!messageInProgress) {
+			if (inputBuffer.size() >= 4) {
+				// The server greets every connection with 60 bytes of XML for the benefit of old clients.
+				if (!handshakeStarted) {
+					handshakeStarted = true;
+					if (inputBuffer.startsWith("<?xm")) {
+						messageInProgress = true;
+						messageLength = 60;
+					}
+				} else {
+					messageLength =   (((quint32) (unsigned char) inputBuffer[0]) << 24)
+					                + (((quint32) (unsigned char) inputBuffer[1]) << 16)
+					                + (((quint32) (unsigned char) inputBuffer[2]) << 8)
+					                + ((quint32) (unsigned char) inputBuffer[3]);
+					inputBuffer.remove(0, 4);
+					messageInProgress = true;
+				}
+			} else
+				return;
+		}
+		if (inputBuffer.size() < messageLength)
+			return;
+
+		ServerMessage newServerMessage;
+		newServerMessage.ParseFromArray(inputBuffer.data(), messageLength);
+		inputBuffer.remove(0, messageLength);
+		messageInProgress = false;
+
+		processServerMessage(newServerMessage);
+		if (state == StateDisconnected)
+			return;
+	} while (!inputBuffer.isEmpty());
+}
+
+void LoadGen_Client::sendCommandContainer(CommandContainer &cont, const QString &commandName)
+{
+	if (state < StateAwaitingIdentification)
+		return;
+
+	const qint64 now = statistics->usecsElapsed();
+	const int cmdId = nextCmdId++;
+	cont.set_cmd_id(cmdId);
+
+	PendingCommand pend;
+	pend.name = commandName;
+	pend.timeSent = now;
+	pendingCommands.insert(cmdId, pend);
+	lastCommandSent = now;
+
+	QByteArray buf;
+	unsigned int size = cont.ByteSize();
+	buf.resize(size + 4);
+	cont.SerializeToArray(buf.data() + 4, size);
+	buf.data()[3] = (unsigned char) size;
+	buf.data()[2] = (unsigned char) (size >> 8);
+	buf.data()[1] = (unsigned char) (size >> 16);
+	buf.data()[0] = (unsigned char) (size >> 24);
+
+	socket->write(buf);
+	statistics->commandSent(commandName, buf.size());
+}
+
+void LoadGen_Client::sendSessionCommand(const ::google::protobuf::Message &cmd)
+{
+	CommandContainer cont;
+	SessionCommand *c = cont.add_session_command();
+	setPbExtension(*c, cmd);
+	sendCommandContainer(cont, QString::fromStdString(cmd.GetDescriptor()->name()));
+}
+
+void LoadGen_Client::sendRoomCommand(const ::google::protobuf::Message &cmd)
+{
+	CommandContainer cont;
+	cont.set_room_id(settings.roomId);
+	RoomCommand *c = cont.add_room_command();
+	setPbExtension(*c, cmd);
+	sendCommandContainer(cont, QString::fromStdString(cmd.GetDescriptor()->name()));
+}
+
+void LoadGen_Client::sendGameCommand(const ::google::protobuf::Message &cmd)
+{
+	CommandContainer cont;
+	cont.set_game_id(gameId);
+	GameCommand *c = cont.add_game_command();
+	setPbExtension(*c, cmd);
+	sendCommandContainer(cont, QString::fromStdString(cmd.GetDescriptor()->name()));
+}
+
+void LoadGen_Client::processServerMessage(const ServerMessage &item)
+{
+	switch (item.message_type()) {
+		case ServerMessage::RESPONSE:
+			statistics->messageReceived(item.ByteSize() + 4, 0);
+			processResponse(item.response());
+			break;
+		case ServerMessage::SESSION_EVENT:
+			statistics->messageReceived(item.ByteSize() + 4, 1);
+			processSessionEvent(item.session_event());
+			break;
+		case ServerMessage::GAME_EVENT_CONTAINER:
+			statistics->messageReceived(item.ByteSize() + 4, item.game_event_container().event_list_size());
+			processGameEventContainer(item.game_event_container());
+			break;
+		case ServerMessage::ROOM_EVENT:
+			statistics->messageReceived(item.ByteSize() + 4, 1);
+			break;
+	}
+}
+
+void LoadGen_Client::processResponse(const Response &response)
+{
+	QMap<int, PendingCommand>::iterator i = pendingCommands.find(response.cmd_id());
+	if (i == pendingCommands.end())
+		return;
+	const PendingCommand pend = i.value();
+	pendingCommands.erase(i);
+
+	const Response::ResponseCode responseCode = response.response_code();
+	statistics->responseReceived(pend.name, statistics->usecsElapsed() - pend.timeSent, responseCode == Response::RespOk);
+	commandFinished(pend.name, responseCode);
+}
+
+void LoadGen_Client::commandFinished(const QString &commandName, Response::ResponseCode responseCode)
+{
+	const bool ok = responseCode == Response::RespOk;
+
+	if (commandName == "Command_Login") {
+		statistics->loginFinished(ok);
+		if (!ok) {
+			std::cerr << userName.toStdString() << ": login failed (" << responseCode << ")" << std::endl;
+			disconnectFromServer();
+			return;
+		}
+		setState(StateJoiningRoom);
+		Command_JoinRoom cmd;
+		cmd.set_room_id(settings.roomId);
+		sendSessionCommand(cmd);
+	} else if (commandName == "Command_JoinRoom") {
+		if (!ok) {
+			std::cerr << userName.toStdString() << ": could not join room " << settings.roomId << " (" << responseCode << ")" << std::endl;
+			disconnectFromServer();
+			return;
+		}
+		setState(StateInLobby);
+		enterGame();
+	} else if ((commandName == "Command_CreateGame") || (commandName == "Command_JoinGame")) {
+		// Retry later, the game may have filled up or been closed in the meantime.
+		if (!ok && (state == StateJoiningGame)) {
+			setState(StateInLobby);
+			QTimer::singleShot(settings.thinkTime, this, SLOT(enterGame()));
+		}
+	} else if (commandName == "Command_LeaveGame") {
+		if (state == StateLeavingGame) {
+			gameId = -1;
+			setState(StateInLobby);
+			QTimer::singleShot(settings.thinkTime, this, SLOT(enterGame()));
+		}
+	}
+}
+
+void LoadGen_Client::processSessionEvent(const SessionEvent &event)
+{
+	switch ((SessionEvent::SessionEventType) getPbExtension(event)) {
+		case SessionEvent::SERVER_IDENTIFICATION: {
+			const Event_ServerIdentification &identEvent = event.GetExtension(Event_ServerIdentification::ext);
+			if (identEvent.protocol_version() != protocolVersion) {
+				std::cerr << userName.toStdString() << ": protocol version mismatch (server: " << identEvent.protocol_version() << ")" << std::endl;
+				disconnectFromServer();
+				return;
+			}
+			setState(StateLoggingIn);
+
+			Command_Login cmd;
+			cmd.set_user_name(userName.toStdString());
+			cmd.set_password(std::string());
+			sendSessionCommand(cmd);
+			break;
+		}
+		case SessionEvent::CONNECTION_CLOSED: {
+			std::cerr << userName.toStdString() << ": connection closed by server (reason " << event.GetExtension(Event_ConnectionClosed::ext).reason() << ")" << std::endl;
+			closeConnection(true);
+			break;
+		}
+		case SessionEvent::GAME_JOINED: {
+			const Event_GameJoined &joinedEvent = event.GetExtension(Event_GameJoined::ext);
+			gameId = joinedEvent.game_info().game_id();
+			playerId = joinedEvent.player_id();
+			handCards.clear();
+			tableCards.clear();
+			tappedCards.clear();
+			setState(StateWaitingForStart);
+
+			if (host)
+				matchmaker->offerGame(gameId, settings.playersPerGame - 1);
+
+			Command_DeckSelect deckSelect;
+			deckSelect.set_deck(deckString.toStdString());
+			sendGameCommand(deckSelect);
+
+			Command_ReadyStart readyStart;
+			readyStart.set_ready(true);
+			sendGameCommand(readyStart);
+			break;
+		}
+		default: break;
+	}
+}
+
+void LoadGen_Client::processGameEventContainer(const GameEventContainer &cont)
+{
+	if ((int) cont.game_id() != gameId)
+		return;
+
+	for (int i = 0; i < cont.event_list_size(); ++i) {
+		const GameEvent &event = cont.event_list(i);
+		switch ((GameEvent::GameEventType) getPbExtension(event)) {
+			case GameEvent::GAME_STATE_CHANGED: {
+				const Event_GameStateChanged &stateEvent = event.GetExtension(Event_GameStateChanged::ext);
+				if ((state != StateWaitingForStart) || !stateEvent.game_started())
+					break;
+
+				setState(StatePlaying);
+				statistics->gameStarted();
+				if (host)
+					matchmaker->withdrawGame(gameId);
+				actionsLeft = settings.actionsPerGame;
+
+				Command_DrawCards cmd;
+				cmd.set_number(7);
+				sendGameCommand(cmd);
+
+				actionTimer->start(settings.thinkTime / 2 + qrand() % settings.thinkTime);
+				break;
+			}
+			case GameEvent::DRAW_CARDS: {
+				if (event.player_id() != playerId)
+					break;
+				const Event_DrawCards &drawEvent = event.GetExtension(Event_DrawCards::ext);
+				for (int j = 0; j < drawEvent.cards_size(); ++j)
+					handCards.append(drawEvent.cards(j).id());
+				break;
+			}
+			case GameEvent::MOVE_CARD: {
+				if (event.player_id() != playerId)
+					break;
+				const Event_MoveCard &moveEvent = event.GetExtension(Event_MoveCard::ext);
+				if ((moveEvent.start_zone() == "hand") && (moveEvent.target_zone() == "table")) {
+					handCards.removeAll(moveEvent.card_id());
+					tableCards.append(moveEvent.new_card_id());
+				}
+				break;
+			}
+			case GameEvent::GAME_CLOSED:
+			case GameEvent::KICKED: {
+				if (state == StatePlaying)
+					statistics->gameFinished();
+				actionTimer->stop();
+				gameId = -1;
+				setState(StateInLobby);
+				QTimer::singleShot(settings.thinkTime, this, SLOT(enterGame()));
+				return;
+			}
+			default: break;
+		}
+	}
+}
+
+void LoadGen_Client::enterGame()
+{
+	if (state != StateInLobby)
+		return;
+
+	if (host) {
+		setState(StateJoiningGame);
+
+		Command_CreateGame cmd;
+		cmd.set_description(QString("Load test game of %1").arg(userName).toStdString());
+		cmd.set_max_players(settings.playersPerGame);
+		cmd.set_spectators_allowed(true);
+		sendRoomCommand(cmd);
+	} else {
+		const int openGameId = matchmaker->takeSeat();
+		if (openGameId == -1) {
+			QTimer::singleShot(250, this, SLOT(enterGame()));
+			return;
+		}
+		setState(StateJoiningGame);
+
+		Command_JoinGame cmd;
+		cmd.set_game_id(openGameId);
+		sendRoomCommand(cmd);
+	}
+}
+
+void LoadGen_Client::leaveGame()
+{
+	actionTimer->stop();
+	statistics->gameFinished();
+	setState(StateLeavingGame);
+	sendGameCommand(Command_LeaveGame());
+}
+
+void LoadGen_Client::performAction()
+{
+	if (state != StatePlaying)
+		return;
+	if (actionsLeft-- <= 0) {
+		leaveGame();
+		return;
+	}
+
+	LoadGen_Settings::Action action = settings.pickAction();
+	if ((action == LoadGen_Settings::ActionTap) && tableCards.isEmpty())
+		action = LoadGen_Settings::ActionMove;
+	if ((action == LoadGen_Settings::ActionMove) && handCards.isEmpty())
+		action = LoadGen_Settings::ActionDraw;
+
+	switch (action) {
+		case LoadGen_Settings::ActionDraw: {
+			Command_DrawCards cmd;
+			cmd.set_number(1);
+			sendGameCommand(cmd);
+			break;
+		}
+		case LoadGen_Settings::ActionMove: {
+			Command_MoveCard cmd;
+			cmd.set_start_player_id(playerId);
+			cmd.set_start_zone("hand");
+			cmd.set_target_player_id(playerId);
+			cmd.set_target_zone("table");
+			cmd.set_x(0);
+			cmd.set_y(qrand() % 3);
+			cmd.mutable_cards_to_move()->add_card()->set_card_id(handCards.takeAt(qrand() % handCards.size()));
+			sendGameCommand(cmd);
+			break;
+		}
+		case LoadGen_Settings::ActionTap: {
+			const int cardId = tableCards[qrand() % tableCards.size()];
+			const bool tapped = !tappedCards.contains(cardId);
+			if (tapped)
+				tappedCards.insert(cardId);
+			else
+				tappedCards.remove(cardId);
+
+			Command_SetCardAttr cmd;
+			cmd.set_zone("table");
+			cmd.set_card_id(cardId);
+			cmd.set_attribute(AttrTapped);
+			cmd.set_attr_value(tapped ? "1" : "0");
+			sendGameCommand(cmd);
+			break;
+		}
+		case LoadGen_Settings::ActionCounter: {
+			Command_IncCounter cmd;
+			cmd.set_counter_id(0);
+			cmd.set_delta(qrand() % 2 ? 1 : -1);
+			sendGameCommand(cmd);
+			break;
+		}
+		case LoadGen_Settings::ActionGameChat: {
+			Command_GameSay cmd;
+			cmd.set_message(QString("%1 says hello (%2 actions left)").arg(userName).arg(actionsLeft).toStdString());
+			sendGameCommand(cmd);
+			break;
+		}
+		case LoadGen_Settings::ActionRoomChat: {
+			Command_RoomSay cmd;
+			cmd.set_message(QString("%1 is still playing").arg(userName).toStdString());
+			sendRoomCommand(cmd);
+			break;
+		}
+		case LoadGen_Settings::ActionNextTurn: {
+			sendGameCommand(Command_NextTurn());
+			break;
+		}
+		default: break;
+	}
+
+	actionTimer->start(settings.thinkTime / 2 + qrand() % settings.thinkTime);
+}
+
+void LoadGen_Client::maintenanceTimeout()
+{
+	const qint64 now = statistics->usecsElapsed();
+	const qint64 timeout = (qint64) settings.commandTimeout * 1000000;
+
+	QMutableMapIterator<int, PendingCommand> i(pendingCommands);
+	while (i.hasNext()) {
+		i.next();
+		if (now - i.value().timeSent > timeout) {
+			statistics->commandTimedOut(i.value().name);
+			i.remove();
+		}
+	}
+
+	// Keep idle sessions (e.g. waiting for an opponent) from being dropped for inactivity.
+	if ((state >= StateLoggingIn) && (now - lastCommandSent > 5000000))
+		sendSessionCommand(Command_Ping());
+}
@@ -0,0 +1,92 @@
+#ifndef LOADGEN_CLIENT_H
+#define LOADGEN_CLIENT_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QMap>
+#include <QList>
+#include <QSet>
+#include "pb/response.pb.h"
+
+class QTimer;
+class LoadGen_Settings;
+class LoadGen_Statistics;
+class LoadGen_Matchmaker;
+class CommandContainer;
+class ServerMessage;
+class SessionEvent;
+class GameEventContainer;
+
+namespace google { namespace protobuf { class Message; } }
+
+// One simulated user. Speaks the native protocol over its own TCP connection
+// and plays through login, room join, game setup and scripted turns.
+class LoadGen_Client : public QObject {
+	Q_OBJECT
+public:
+	enum ClientState { StateDisconnected, StateConnecting, StateAwaitingIdentification, StateLoggingIn, StateJoiningRoom, StateInLobby, StateJoiningGame, StateWaitingForStart, StatePlaying, StateLeavingGame };
+private slots:
+	void slotConnected();
+	void slotSocketError(QAbstractSocket::SocketError error);
+	void readData();
+	void maintenanceTimeout();
+	void performAction();
+	void enterGame();
+public slots:
+	void connectToServer();
+	void disconnectFromServer();
+private:
+	struct PendingCommand {
+		QString name;
+		qint64 timeSent;
+	};
+	const LoadGen_Settings &settings;
+	LoadGen_Statistics *statistics;
+	LoadGen_Matchmaker *matchmaker;
+	int clientIndex;
+	QString userName;
+	QString deckString;
+	bool host;
+
+	QTcpSocket *socket;
+	QTimer *actionTimer;
+	QTimer *maintenanceTimer;
+	QByteArray inputBuffer;
+	bool messageInProgress;
+	bool handshakeStarted;
+	int messageLength;
+
+	ClientState state;
+	int nextCmdId;
+	QMap<int, PendingCommand> pendingCommands;
+	qint64 lastCommandSent;
+
+	int gameId;
+	int playerId;
+	int actionsLeft;
+	QList<int> handCards;
+	QList<int> tableCards;
+	QSet<int> tappedCards;
+
+	static QString generateDeck(int size, int variant);
+
+	void setState(ClientState _state);
+	void closeConnection(bool error);
+	void sendCommandContainer(CommandContainer &cont, const QString &commandName);
+	void sendSessionCommand(const ::google::protobuf::Message &cmd);
+	void sendRoomCommand(const ::google::protobuf::Message &cmd);
+	void sendGameCommand(const ::google::protobuf::Message &cmd);
+
+	void processServerMessage(const ServerMessage &item);
+	void processResponse(const Response &response);
+	void processSessionEvent(const SessionEvent &event);
+	void processGameEventContainer(const GameEventContainer &cont);
+	void commandFinished(const QString &commandName, Response::ResponseCode responseCode);
+	void leaveGame();
+public:
+	LoadGen_Client(int _clientIndex, const LoadGen_Settings &_settings, LoadGen_Statistics *_statistics, LoadGen_Matchmaker *_matchmaker);
+	~LoadGen_Client();
+	ClientState getState() const { return state; }
+};
+
+#endif
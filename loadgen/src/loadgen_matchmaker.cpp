@@ -0,0 +1,30 @@
+#include <QMutexLocker>
+#include "loadgen_matchmaker.h"
+
+void LoadGen_Matchmaker::offerGame(int gameId, int seats)
+{
+	if (seats <= 0)
+		return;
+
+	QMutexLocker locker(&mutex);
+	openSeats.insert(gameId, seats);
+}
+
+void LoadGen_Matchmaker::withdrawGame(int gameId)
+{
+	QMutexLocker locker(&mutex);
+	openSeats.remove(gameId);
+}
+
+int LoadGen_Matchmaker::takeSeat()
+{
+	QMutexLocker locker(&mutex);
+	if (openSeats.isEmpty())
+		return -1;
+
+	QMap<int, int>::iterator i = openSeats.begin();
+	const int gameId = i.key();
+	if (--i.value() <= 0)
+		openSeats.erase(i);
+	return gameId;
+}
@@ -0,0 +1,19 @@
+#ifndef LOADGEN_MATCHMAKER_H
+#define LOADGEN_MATCHMAKER_H
+
+#include <QMap>
+#include <QMutex>
+
+// Hands out the seats of games opened by hosting clients to the clients
+// that want to join one. Shared between all client threads.
+class LoadGen_Matchmaker {
+private:
+	QMutex mutex;
+	QMap<int, int> openSeats;
+public:
+	void offerGame(int gameId, int seats);
+	void withdrawGame(int gameId);
+	int takeSeat();
+};
+
+#endif
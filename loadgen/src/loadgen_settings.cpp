@@ -0,0 +1,70 @@
+#include <QSettings>
+#include "loadgen_settings.h"
+
+LoadGen_Settings::LoadGen_Settings(QSettings *settings)
+	: actionWeights(ActionCount)
+{
+	host = settings->value("server/host", "localhost").toString();
+	port = settings->value("server/port", 4747).toInt();
+
+	clients = settings->value("load/clients", 100).toInt();
+	threads = qMax(1, settings->value("load/threads", 4).toInt());
+	rampUpTime = settings->value("load/ramp_up_time", 10).toInt();
+	duration = settings->value("load/duration", 60).toInt();
+	reportInterval = qMax(1, settings->value("load/report_interval", 5).toInt());
+	commandTimeout = settings->value("load/command_timeout", 30).toInt();
+	userNamePrefix = settings->value("load/user_name_prefix", "loadgen").toString();
+
+	roomId = settings->value("game/room_id", 0).toInt();
+	playersPerGame = qMax(1, settings->value("game/players_per_game", 2).toInt());
+	actionsPerGame = settings->value("game/actions_per_game", 100).toInt();
+	thinkTime = qMax(1, settings->value("game/think_time", 1000).toInt());
+	deckSize = qMax(1, settings->value("game/deck_size", 60).toInt());
+
+	for (int i = 0; i < ActionCount; ++i)
+		actionWeights[i] = qMax(0, settings->value("actions/" + getActionName((Action) i), 0).toInt());
+
+	// Fall back to a plausible mix if the config does not define any weights.
+	bool anyWeight = false;
+	for (int i = 0; i < ActionCount; ++i)
+		if (actionWeights[i])
+			anyWeight = true;
+	if (!anyWeight) {
+		actionWeights[ActionDraw] = 20;
+		actionWeights[ActionMove] = 25;
+		actionWeights[ActionTap] = 25;
+		actionWeights[ActionCounter] = 10;
+		actionWeights[ActionGameChat] = 10;
+		actionWeights[ActionRoomChat] = 5;
+		actionWeights[ActionNextTurn] = 5;
+	}
+}
+
+LoadGen_Settings::Action LoadGen_Settings::pickAction() const
+{
+	int total = 0;
+	for (int i = 0; i < ActionCount; ++i)
+		total += actionWeights[i];
+
+	int r = qrand() % total;
+	for (int i = 0; i < ActionCount; ++i) {
+		if (r < actionWeights[i])
+			return (Action) i;
+		r -= actionWeights[i];
+	}
+	return ActionDraw;
+}
+
+QString LoadGen_Settings::getActionName(Action action)
+{
+	switch (action) {
+		case ActionDraw: return "draw";
+		case ActionMove: return "move";
+		case ActionTap: return "tap";
+		case ActionCounter: return "counter";
+		case ActionGameChat: return "game_chat";
+		case ActionRoomChat: return "room_chat";
+		case ActionNextTurn: return "next_turn";
+		default: return QString();
+	}
+}
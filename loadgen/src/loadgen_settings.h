@@ -0,0 +1,34 @@
+#ifndef LOADGEN_SETTINGS_H
+#define LOADGEN_SETTINGS_H
+
+#include <QString>
+#include <QVector>
+
+class QSettings;
+
+class LoadGen_Settings {
+public:
+	enum Action { ActionDraw, ActionMove, ActionTap, ActionCounter, ActionGameChat, ActionRoomChat, ActionNextTurn, ActionCount };
+
+	QString host;
+	int port;
+	int clients;
+	int threads;
+	int rampUpTime;
+	int duration;
+	int reportInterval;
+	int roomId;
+	int playersPerGame;
+	int actionsPerGame;
+	int thinkTime;
+	int commandTimeout;
+	int deckSize;
+	QString userNamePrefix;
+	QVector<int> actionWeights;
+
+	LoadGen_Settings(QSettings *settings);
+	Action pickAction() const;
+	static QString getActionName(Action action);
+};
+
+#endif
@@ -0,0 +1,167 @@
+#include <QMutexLocker>
+#include <iostream>
+#include <algorithm>
+#include "loadgen_statistics.h"
+
+LoadGen_Statistics::LoadGen_Statistics(QObject *parent)
+	: QObject(parent), intervalResponses(0), intervalErrors(0), intervalEvents(0), intervalStart(0), eventsReceived(0), bytesSent(0), bytesReceived(0), connectionsOpen(0), usersLoggedIn(0), connectionErrors(0), loginErrors(0), gamesRunning(0), gamesStarted(0), gamesFinished(0)
+{
+	clock.start();
+}
+
+quint32 LoadGen_Statistics::percentile(QVector<quint32> &sortedValues, double p)
+{
+	if (sortedValues.isEmpty())
+		return 0;
+	return sortedValues[(int) (p * (sortedValues.size() - 1) + 0.5)];
+}
+
+void LoadGen_Statistics::commandSent(const QString &commandName, int bytes)
+{
+	QMutexLocker locker(&mutex);
+	++commandStatistics[commandName].sent;
+	bytesSent += bytes;
+}
+
+void LoadGen_Statistics::responseReceived(const QString &commandName, qint64 latency, bool success)
+{
+	QMutexLocker locker(&mutex);
+	CommandStatistics &s = commandStatistics[commandName];
+	++s.responses;
+	s.latencies.append(latency);
+	intervalLatencies.append(latency);
+	++intervalResponses;
+	if (!success) {
+		++s.errors;
+		++intervalErrors;
+	}
+}
+
+void LoadGen_Statistics::commandTimedOut(const QString &commandName)
+{
+	QMutexLocker locker(&mutex);
+	++commandStatistics[commandName].timeouts;
+	++intervalErrors;
+}
+
+void LoadGen_Statistics::messageReceived(int bytes, int events)
+{
+	QMutexLocker locker(&mutex);
+	bytesReceived += bytes;
+	eventsReceived += events;
+	intervalEvents += events;
+}
+
+void LoadGen_Statistics::connectionOpened()
+{
+	QMutexLocker locker(&mutex);
+	++connectionsOpen;
+}
+
+void LoadGen_Statistics::connectionClosed(bool loggedIn, bool error)
+{
+	QMutexLocker locker(&mutex);
+	--connectionsOpen;
+	if (loggedIn)
+		--usersLoggedIn;
+	if (error)
+		++connectionErrors;
+}
+
+void LoadGen_Statistics::connectionFailed()
+{
+	QMutexLocker locker(&mutex);
+	++connectionErrors;
+}
+
+void LoadGen_Statistics::loginFinished(bool success)
+{
+	QMutexLocker locker(&mutex);
+	if (success)
+		++usersLoggedIn;
+	else
+		++loginErrors;
+}
+
+void LoadGen_Statistics::gameStarted()
+{
+	QMutexLocker locker(&mutex);
+	++gamesRunning;
+	++gamesStarted;
+}
+
+void LoadGen_Statistics::gameFinished()
+{
+	QMutexLocker locker(&mutex);
+	--gamesRunning;
+	++gamesFinished;
+}
+
+void LoadGen_Statistics::printIntervalReport()
+{
+	QMutexLocker locker(&mutex);
+	const qint64 now = usecsElapsed();
+	const double seconds = (now - intervalStart) / 1000000.0;
+	std::sort(intervalLatencies.begin(), intervalLatencies.end());
+
+	std::cerr << "[" << QString::number(now / 1000000.0, 'f', 1).toStdString() << "s]"
+	          << " conn=" << connectionsOpen
+	          << " users=" << usersLoggedIn
+	          << " games=" << gamesRunning
+	          << " resp/s=" << QString::number(intervalResponses / seconds, 'f', 1).toStdString()
+	          << " events/s=" << QString::number(intervalEvents / seconds, 'f', 1).toStdString()
+	          << " p50=" << QString::number(percentile(intervalLatencies, 0.5) / 1000.0, 'f', 2).toStdString() << "ms"
+	          << " p99=" << QString::number(percentile(intervalLatencies, 0.99) / 1000.0, 'f', 2).toStdString() << "ms"
+	          << " errors=" << intervalErrors
+	          << std::endl;
+
+	intervalLatencies.clear();
+	intervalResponses = intervalErrors = intervalEvents = 0;
+	intervalStart = now;
+}
+
+void LoadGen_Statistics::printSummary()
+{
+	QMutexLocker locker(&mutex);
+	const double seconds = usecsElapsed() / 1000000.0;
+
+	quint64 totalSent = 0, totalResponses = 0, totalErrors = 0, totalTimeouts = 0;
+	QVector<quint32> allLatencies;
+
+	std::cerr << "-------------------------" << std::endl;
+	std::cerr << "command\tsent\tresponses\terrors\ttimeouts\tp50_ms\tp99_ms" << std::endl;
+	QMutableMapIterator<QString, CommandStatistics> i(commandStatistics);
+	while (i.hasNext()) {
+		CommandStatistics &s = i.next().value();
+		std::sort(s.latencies.begin(), s.latencies.end());
+		std::cerr << i.key().toStdString()
+		          << "\t" << s.sent
+		          << "\t" << s.responses
+		          << "\t" << s.errors
+		          << "\t" << s.timeouts
+		          << "\t" << QString::number(percentile(s.latencies, 0.5) / 1000.0, 'f', 2).toStdString()
+		          << "\t" << QString::number(percentile(s.latencies, 0.99) / 1000.0, 'f', 2).toStdString()
+		          << std::endl;
+
+		totalSent += s.sent;
+		totalResponses += s.responses;
+		totalErrors += s.errors;
+		totalTimeouts += s.timeouts;
+		allLatencies += s.latencies;
+	}
+	std::sort(allLatencies.begin(), allLatencies.end());
+
+	std::cerr << "-------------------------" << std::endl;
+	std::cerr << "Duration: " << QString::number(seconds, 'f', 1).toStdString() << "s" << std::endl;
+	std::cerr << "Commands sent: " << totalSent << ", responses: " << totalResponses
+	          << " (" << QString::number(totalResponses / seconds, 'f', 1).toStdString() << "/s)" << std::endl;
+	std::cerr << "Events received: " << eventsReceived
+	          << " (" << QString::number(eventsReceived / seconds, 'f', 1).toStdString() << "/s)" << std::endl;
+	std::cerr << "Bytes sent: " << bytesSent << ", received: " << bytesReceived << std::endl;
+	std::cerr << "Latency p50: " << QString::number(percentile(allLatencies, 0.5) / 1000.0, 'f', 2).toStdString()
+	          << "ms, p99: " << QString::number(percentile(allLatencies, 0.99) / 1000.0, 'f', 2).toStdString() << "ms" << std::endl;
+	std::cerr << "Error responses: " << totalErrors << ", timeouts: " << totalTimeouts
+	          << ", error rate: " << QString::number(totalSent ? 100.0 * (totalErrors + totalTimeouts) / totalSent : 0, 'f', 3).toStdString() << "%" << std::endl;
+	std::cerr << "Connection errors: " << connectionErrors << ", login errors: " << loginErrors << std::endl;
+	std::cerr << "Games started: " << gamesStarted << ", finished: " << gamesFinished << std::endl;
+}
@@ -0,0 +1,47 @@
+#ifndef LOADGEN_STATISTICS_H
+#define LOADGEN_STATISTICS_H
+
+#include <QObject>
+#include <QMap>
+#include <QVector>
+#include <QMutex>
+#include <QElapsedTimer>
+
+class LoadGen_Statistics : public QObject {
+	Q_OBJECT
+private:
+	struct CommandStatistics {
+		quint64 sent, responses, errors, timeouts;
+		QVector<quint32> latencies;
+		CommandStatistics() : sent(0), responses(0), errors(0), timeouts(0) { }
+	};
+	mutable QMutex mutex;
+	QElapsedTimer clock;
+	QMap<QString, CommandStatistics> commandStatistics;
+	QVector<quint32> intervalLatencies;
+	quint64 intervalResponses, intervalErrors, intervalEvents;
+	qint64 intervalStart;
+	quint64 eventsReceived, bytesSent, bytesReceived;
+	int connectionsOpen, usersLoggedIn, connectionErrors, loginErrors, gamesRunning, gamesStarted, gamesFinished;
+
+	static quint32 percentile(QVector<quint32> &sortedValues, double p);
+public:
+	LoadGen_Statistics(QObject *parent = 0);
+	qint64 usecsElapsed() const { return clock.nsecsElapsed() / 1000; }
+
+	void commandSent(const QString &commandName, int bytes);
+	void responseReceived(const QString &commandName, qint64 latency, bool success);
+	void commandTimedOut(const QString &commandName);
+	void messageReceived(int bytes, int events);
+	void connectionOpened();
+	void connectionClosed(bool loggedIn, bool error);
+	void connectionFailed();
+	void loginFinished(bool success);
+	void gameStarted();
+	void gameFinished();
+public slots:
+	void printIntervalReport();
+	void printSummary();
+};
+
+#endif
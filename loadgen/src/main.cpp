@@ -0,0 +1,106 @@
+#include <QCoreApplication>
+#include <QTextCodec>
+#include <QSettings>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+#include <QFile>
+#include <iostream>
+#include "loadgen_settings.h"
+#include "loadgen_statistics.h"
+#include "loadgen_matchmaker.h"
+#include "loadgen_client.h"
+#ifdef Q_OS_UNIX
+#include <signal.h>
+#endif
+
+#ifdef Q_OS_UNIX
+void sigIntHandler(int /*sig*/)
+{
+	QMetaObject::invokeMethod(QCoreApplication::instance(), "quit", Qt::QueuedConnection);
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	app.setOrganizationName("Cockatrice");
+	app.setApplicationName("servatrice_loadgen");
+
+	QTextCodec::setCodecForCStrings(QTextCodec::codecForName("UTF-8"));
+
+	QStringList args = app.arguments();
+	QString configFile = "loadgen.ini";
+	int configIndex = args.indexOf("--config");
+	if ((configIndex != -1) && (configIndex + 1 < args.size()))
+		configFile = args[configIndex + 1];
+	if (!QFile::exists(configFile)) {
+		std::cerr << "Config file " << configFile.toStdString() << " not found, see loadgen.ini.example." << std::endl;
+		return 1;
+	}
+
+	QSettings *settingsFile = new QSettings(configFile, QSettings::IniFormat);
+	LoadGen_Settings settings(settingsFile);
+	delete settingsFile;
+
+#ifdef Q_OS_UNIX
+	struct sigaction sigint;
+	sigint.sa_handler = sigIntHandler;
+	sigemptyset(&sigint.sa_mask);
+	sigint.sa_flags = 0;
+	sigaction(SIGINT, &sigint, 0);
+	sigaction(SIGTERM, &sigint, 0);
+
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	std::cerr << "servatrice_loadgen: " << settings.clients << " clients on " << settings.threads << " threads against "
+	          << settings.host.toStdString() << ":" << settings.port << std::endl;
+	std::cerr << "-------------------------" << std::endl;
+
+	LoadGen_Statistics statistics;
+	LoadGen_Matchmaker matchmaker;
+
+	QList<QThread *> threads;
+	for (int i = 0; i < settings.threads; ++i) {
+		QThread *thread = new QThread;
+		thread->setObjectName(QString("loadgen_%1").arg(i));
+		thread->start();
+		threads.append(thread);
+	}
+
+	// Open the connections evenly spread over the ramp-up time.
+	QList<LoadGen_Client *> clients;
+	for (int i = 0; i < settings.clients; ++i) {
+		LoadGen_Client *client = new LoadGen_Client(i, settings, &statistics, &matchmaker);
+		client->moveToThread(threads[i % threads.size()]);
+		clients.append(client);
+
+		const int delay = settings.clients > 1 ? (qint64) settings.rampUpTime * 1000 * i / settings.clients : 0;
+		QTimer::singleShot(delay, client, SLOT(connectToServer()));
+	}
+
+	QTimer reportTimer;
+	QObject::connect(&reportTimer, SIGNAL(timeout()), &statistics, SLOT(printIntervalReport()));
+	reportTimer.start(settings.reportInterval * 1000);
+
+	if (settings.duration > 0)
+		QTimer::singleShot(settings.duration * 1000, &app, SLOT(quit()));
+
+	app.exec();
+
+	reportTimer.stop();
+	for (int i = 0; i < clients.size(); ++i) {
+		QMetaObject::invokeMethod(clients[i], "disconnectFromServer", Qt::BlockingQueuedConnection);
+		clients[i]->deleteLater();
+	}
+	for (int i = 0; i < threads.size(); ++i) {
+		threads[i]->quit();
+		threads[i]->wait();
+		delete threads[i];
+	}
+
+	statistics.printSummary();
+
+	return 0;
+}
@@ -0,0 +1,120 @@
+#include <QFile>
+#include <QDataStream>
+#include <QMap>
+#include <QSet>
+#include <iostream>
+#include "replay_capture.h"
+#include "traffic_capture.h"
+#include "pb/commands.pb.h"
+#include "pb/room_commands.pb.h"
+
+static bool connectionOpenedBefore(const Replay_Capture::Connection *a, const Replay_Capture::Connection *b)
+{
+	return a->opened < b->opened;
+}
+
+Replay_Capture::Replay_Capture()
+	: startTime(0), endTime(0), frameCount(0), skippedFrames(0)
+{
+}
+
+Replay_Capture::~Replay_Capture()
+{
+	qDeleteAll(connections);
+}
+
+bool Replay_Capture::load(const QStringList &fileNames)
+{
+	// Connection ids are only unique within one server run, so they are resolved
+	// against the connections currently open in the capture.
+	QMap<quint32, Connection *> openConnections;
+	for (int i = 0; i < fileNames.size(); ++i) {
+		QFile file(fileNames[i]);
+		if (!file.open(QIODevice::ReadOnly)) {
+			std::cerr << "Could not open " << fileNames[i].toStdString() << "." << std::endl;
+			return false;
+		}
+		QDataStream stream(&file);
+		if (!TrafficCaptureRecord::readHeader(stream)) {
+			std::cerr << fileNames[i].toStdString() << " is not a traffic capture." << std::endl;
+			return false;
+		}
+
+		TrafficCaptureRecord record;
+		while (!stream.atEnd()) {
+			if (!record.read(stream)) {
+				std::cerr << fileNames[i].toStdString() << " is truncated, ignoring the rest of it." << std::endl;
+				break;
+			}
+			switch (record.type) {
+				case TrafficCaptureRecord::ConnectionOpened: {
+					Connection *connection = new Connection;
+					connection->opened = record.timestamp;
+					connection->closed = -1;
+					connections.append(connection);
+					openConnections.insert(record.connectionId, connection);
+					break;
+				}
+				case TrafficCaptureRecord::CommandFrame: {
+					Connection *connection = openConnections.value(record.connectionId);
+					if (!connection) {
+						++skippedFrames;
+						break;
+					}
+					Frame frame;
+					frame.timestamp = record.timestamp;
+					frame.data = record.data;
+					frame.createdGameId = -1;
+					connection->frames.append(frame);
+					++frameCount;
+					break;
+				}
+				case TrafficCaptureRecord::ConnectionClosed: {
+					Connection *connection = openConnections.take(record.connectionId);
+					if (connection)
+						connection->closed = record.timestamp;
+					break;
+				}
+			}
+		}
+	}
+
+	qSort(connections.begin(), connections.end(), connectionOpenedBefore);
+	for (int i = 0; i < connections.size(); ++i) {
+		Connection *connection = connections[i];
+		findCreatedGames(connection);
+
+		if (i == 0)
+			startTime = endTime = connection->opened;
+		endTime = qMax(endTime, connection->closed);
+		if (!connection->frames.isEmpty())
+			endTime = qMax(endTime, connection->frames.last().timestamp);
+	}
+	return true;
+}
+
+void Replay_Capture::findCreatedGames(Connection *connection)
+{
+	// Only client frames are captured, so the id the server gave to a new game is
+	// recovered from the first unknown game id the creator sends commands to afterwards.
+	QList<int> pendingCreates;
+	QSet<int> knownGameIds;
+	for (int i = 0; i < connection->frames.size(); ++i) {
+		CommandContainer cont;
+		if (!cont.ParseFromArray(connection->frames[i].data.data(), connection->frames[i].data.size()))
+			continue;
+
+		for (int j = 0; j < cont.room_command_size(); ++j) {
+			const RoomCommand &roomCommand = cont.room_command(j);
+			if (roomCommand.HasExtension(Command_CreateGame::ext))
+				pendingCreates.append(i);
+			else if (roomCommand.HasExtension(Command_JoinGame::ext))
+				knownGameIds.insert(roomCommand.GetExtension(Command_JoinGame::ext).game_id());
+		}
+		if (cont.has_game_id() && !knownGameIds.contains(cont.game_id())) {
+			knownGameIds.insert(cont.game_id());
+			if (!pendingCreates.isEmpty())
+				connection->frames[pendingCreates.takeFirst()].createdGameId = cont.game_id();
+		}
+	}
+}
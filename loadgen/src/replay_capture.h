@@ -0,0 +1,40 @@
+#ifndef REPLAY_CAPTURE_H
+#define REPLAY_CAPTURE_H
+
+#include <QList>
+#include <QByteArray>
+#include <QStringList>
+
+// A traffic capture written by servatrice, split up into its connections.
+// Connections whose start is not part of the capture cannot be replayed
+// (they lack the login) and are skipped.
+class Replay_Capture {
+public:
+	struct Frame {
+		qint64 timestamp;
+		QByteArray data;
+		// Game id the frame's Command_CreateGame was answered with in the capture, -1 if none.
+		int createdGameId;
+	};
+	struct Connection {
+		qint64 opened, closed;
+		QList<Frame> frames;
+	};
+private:
+	QList<Connection *> connections;
+	qint64 startTime, endTime;
+	int frameCount, skippedFrames;
+
+	static void findCreatedGames(Connection *connection);
+public:
+	Replay_Capture();
+	~Replay_Capture();
+	bool load(const QStringList &fileNames);
+	const QList<Connection *> &getConnections() const { return connections; }
+	qint64 getStartTime() const { return startTime; }
+	qint64 getDuration() const { return endTime - startTime; }
+	int getFrameCount() const { return frameCount; }
+	int getSkippedFrames() const { return skippedFrames; }
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include "replay_coordinator.h"
+
+Replay_Coordinator::Replay_Coordinator(const QString &_userNamePrefix, int _sessions, QObject *parent)
+	: QObject(parent), userNamePrefix(_userNamePrefix), sessionsRunning(_sessions)
+{
+}
+
+QString Replay_Coordinator::mapUserName(const QString &userName)
+{
+	if (userName.isEmpty())
+		return userName;
+
+	QMutexLocker locker(&mutex);
+	QMap<QString, QString>::const_iterator i = userNames.constFind(userName);
+	if (i != userNames.constEnd())
+		return i.value();
+
+	const QString newUserName = userNamePrefix + QString::number(userNames.size());
+	userNames.insert(userName, newUserName);
+	return newUserName;
+}
+
+void Replay_Coordinator::expectGame(int capturedGameId)
+{
+	QMutexLocker locker(&mutex);
+	expectedGameIds.insert(capturedGameId);
+}
+
+void Replay_Coordinator::gameCreated(int capturedGameId, int gameId)
+{
+	QMutexLocker locker(&mutex);
+	expectedGameIds.remove(capturedGameId);
+	gameIds.insert(capturedGameId, gameId);
+}
+
+void Replay_Coordinator::gameCreationFailed(int capturedGameId)
+{
+	QMutexLocker locker(&mutex);
+	expectedGameIds.remove(capturedGameId);
+}
+
+bool Replay_Coordinator::mapGameId(int capturedGameId, int &gameId)
+{
+	// Games that were not created within the capture keep their id. Returns false
+	// while the game is still to be created by another session.
+	QMutexLocker locker(&mutex);
+	QMap<int, int>::const_iterator i = gameIds.constFind(capturedGameId);
+	if (i != gameIds.constEnd()) {
+		gameId = i.value();
+		return true;
+	}
+	gameId = capturedGameId;
+	return !expectedGameIds.contains(capturedGameId);
+}
+
+void Replay_Coordinator::sessionFinished()
+{
+	mutex.lock();
+	const bool finished = --sessionsRunning == 0;
+	mutex.unlock();
+
+	if (finished)
+		emit allSessionsFinished();
+}
@@ -0,0 +1,32 @@
+#ifndef REPLAY_COORDINATOR_H
+#define REPLAY_COORDINATOR_H
+
+#include <QObject>
+#include <QMap>
+#include <QSet>
+#include <QMutex>
+
+// State shared by all replayed sessions: the mapping of captured user names
+// and game ids to the ones used against the test server.
+class Replay_Coordinator : public QObject {
+	Q_OBJECT
+signals:
+	void allSessionsFinished();
+private:
+	QMutex mutex;
+	QString userNamePrefix;
+	QMap<QString, QString> userNames;
+	QMap<int, int> gameIds;
+	QSet<int> expectedGameIds;
+	int sessionsRunning;
+public:
+	Replay_Coordinator(const QString &_userNamePrefix, int _sessions, QObject *parent = 0);
+	QString mapUserName(const QString &userName);
+	void expectGame(int capturedGameId);
+	void gameCreated(int capturedGameId, int gameId);
+	void gameCreationFailed(int capturedGameId);
+	bool mapGameId(int capturedGameId, int &gameId);
+	void sessionFinished();
+};
+
+#endif
@@ -0,0 +1,153 @@
+#include <QCoreApplication>
+#include <QTextCodec>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+#include <iostream>
+#include "replay_capture.h"
+#include "replay_coordinator.h"
+#include "replay_session.h"
+#include "loadgen_statistics.h"
+#ifdef Q_OS_UNIX
+#include <signal.h>
+#endif
+
+#ifdef Q_OS_UNIX
+void sigIntHandler(int /*sig*/)
+{
+	QMetaObject::invokeMethod(QCoreApplication::instance(), "quit", Qt::QueuedConnection);
+}
+#endif
+
+static void printUsage()
+{
+	std::cerr << "Usage: servatrice_replay [options] capture_file..." << std::endl;
+	std::cerr << "Rotated capture files are given oldest first, e.g. capture.bin.2 capture.bin.1 capture.bin" << std::endl;
+	std::cerr << "  --host <host>              server to replay against (default localhost)" << std::endl;
+	std::cerr << "  --port <port>              (default 4747)" << std::endl;
+	std::cerr << "  --speed <factor>|max       time scale relative to the capture (default 1)" << std::endl;
+	std::cerr << "  --threads <n>              client threads (default 4)" << std::endl;
+	std::cerr << "  --user-name-prefix <name>  captured user names become <name>0, <name>1, ... (default replay)" << std::endl;
+	std::cerr << "  --password <password>      password used for all logins (default empty)" << std::endl;
+	std::cerr << "  --command-timeout <secs>   (default 30)" << std::endl;
+	std::cerr << "  --report-interval <secs>   (default 5)" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	app.setOrganizationName("Cockatrice");
+	app.setApplicationName("servatrice_replay");
+
+	QTextCodec::setCodecForCStrings(QTextCodec::codecForName("UTF-8"));
+
+	QStringList args = app.arguments();
+	Replay_Settings settings;
+	QStringList captureFiles;
+	for (int i = 1; i < args.size(); ++i) {
+		const bool hasValue = i + 1 < args.size();
+		if ((args[i] == "--host") && hasValue)
+			settings.host = args[++i];
+		else if ((args[i] == "--port") && hasValue)
+			settings.port = args[++i].toInt();
+		else if ((args[i] == "--speed") && hasValue) {
+			++i;
+			settings.speed = args[i] == "max" ? 0 : args[i].toDouble();
+		} else if ((args[i] == "--threads") && hasValue)
+			settings.threads = qMax(1, args[++i].toInt());
+		else if ((args[i] == "--user-name-prefix") && hasValue)
+			settings.userNamePrefix = args[++i];
+		else if ((args[i] == "--password") && hasValue)
+			settings.password = args[++i];
+		else if ((args[i] == "--command-timeout") && hasValue)
+			settings.commandTimeout = qMax(1, args[++i].toInt());
+		else if ((args[i] == "--report-interval") && hasValue)
+			settings.reportInterval = qMax(1, args[++i].toInt());
+		else if (args[i].startsWith("--")) {
+			printUsage();
+			return 1;
+		} else
+			captureFiles.append(args[i]);
+	}
+	if (captureFiles.isEmpty()) {
+		printUsage();
+		return 1;
+	}
+
+	Replay_Capture capture;
+	if (!capture.load(captureFiles))
+		return 1;
+	const QList<Replay_Capture::Connection *> &connections = capture.getConnections();
+	if (connections.isEmpty()) {
+		std::cerr << "The capture does not contain any complete connection." << std::endl;
+		return 1;
+	}
+
+#ifdef Q_OS_UNIX
+	struct sigaction sigint;
+	sigint.sa_handler = sigIntHandler;
+	sigemptyset(&sigint.sa_mask);
+	sigint.sa_flags = 0;
+	sigaction(SIGINT, &sigint, 0);
+	sigaction(SIGTERM, &sigint, 0);
+
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	std::cerr << "servatrice_replay: " << connections.size() << " connections, " << capture.getFrameCount() << " frames, "
+	          << capture.getDuration() / 1000 << " s captured";
+	if (capture.getSkippedFrames())
+		std::cerr << " (" << capture.getSkippedFrames() << " frames of incomplete connections skipped)";
+	std::cerr << std::endl;
+	std::cerr << "Replaying against " << settings.host.toStdString() << ":" << settings.port << " at "
+	          << (settings.speed > 0 ? QString("%1x").arg(settings.speed) : QString("maximum")).toStdString() << " speed on "
+	          << settings.threads << " threads" << std::endl;
+	std::cerr << "-------------------------" << std::endl;
+
+	LoadGen_Statistics statistics;
+	Replay_Coordinator coordinator(settings.userNamePrefix, connections.size());
+	QObject::connect(&coordinator, SIGNAL(allSessionsFinished()), &app, SLOT(quit()), Qt::QueuedConnection);
+	for (int i = 0; i < connections.size(); ++i)
+		for (int j = 0; j < connections[i]->frames.size(); ++j)
+			if (connections[i]->frames[j].createdGameId != -1)
+				coordinator.expectGame(connections[i]->frames[j].createdGameId);
+
+	QList<QThread *> threads;
+	for (int i = 0; i < settings.threads; ++i) {
+		QThread *thread = new QThread;
+		thread->setObjectName(QString("replay_%1").arg(i));
+		thread->start();
+		threads.append(thread);
+	}
+
+	QList<Replay_Session *> sessions;
+	for (int i = 0; i < connections.size(); ++i) {
+		Replay_Session *session = new Replay_Session(settings, *connections[i], capture.getStartTime(), &statistics, &coordinator);
+		session->moveToThread(threads[i % threads.size()]);
+		sessions.append(session);
+	}
+	const qint64 replayStartTime = statistics.usecsElapsed();
+	for (int i = 0; i < sessions.size(); ++i)
+		QMetaObject::invokeMethod(sessions[i], "start", Qt::QueuedConnection, Q_ARG(qint64, replayStartTime));
+
+	QTimer reportTimer;
+	QObject::connect(&reportTimer, SIGNAL(timeout()), &statistics, SLOT(printIntervalReport()));
+	reportTimer.start(settings.reportInterval * 1000);
+
+	app.exec();
+
+	reportTimer.stop();
+	for (int i = 0; i < sessions.size(); ++i) {
+		QMetaObject::invokeMethod(sessions[i], "stop", Qt::BlockingQueuedConnection);
+		sessions[i]->deleteLater();
+	}
+	for (int i = 0; i < threads.size(); ++i) {
+		threads[i]->quit();
+		threads[i]->wait();
+		delete threads[i];
+	}
+
+	statistics.printSummary();
+
+	return 0;
+}
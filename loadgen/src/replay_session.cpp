@@ -0,0 +1,397 @@
+#include <QTimer>
+#include <iostream>
+#include "replay_session.h"
+#include "replay_coordinator.h"
+#include "loadgen_statistics.h"
+#include "get_pb_extension.h"
+#include <google/protobuf/descriptor.h>
+#include "pb/commands.pb.h"
+#include "pb/server_message.pb.h"
+#include "pb/session_commands.pb.h"
+#include "pb/room_commands.pb.h"
+#include "pb/event_connection_closed.pb.h"
+#include "pb/event_game_joined.pb.h"
+#include "pb/serverinfo_game.pb.h"
+
+// Frames that refer to a game another session has yet to create are retried at this interval.
+static const int deferInterval = 50;
+
+template<class T>
+static void remapUserName(SessionCommand *sc, Replay_Coordinator *coordinator)
+{
+	if (!sc->HasExtension(T::ext))
+		return;
+	T *cmd = sc->MutableExtension(T::ext);
+	cmd->set_user_name(coordinator->mapUserName(QString::fromStdString(cmd->user_name())).toStdString());
+}
+
+Replay_Session::Replay_Session(const Replay_Settings &_settings, const Replay_Capture::Connection &_connection, qint64 _captureStartTime, LoadGen_Statistics *_statistics, Replay_Coordinator *_coordinator)
+	: QObject(), settings(_settings), connection(_connection), captureStartTime(_captureStartTime), replayStartTime(0), statistics(_statistics), coordinator(_coordinator), messageInProgress(false), handshakeStarted(false), messageLength(0), connected(false), finished(false), loggedIn(false), nextFrame(0), frameDeferredSince(0), awaitedCmdId(-1)
+{
+	socket = new QTcpSocket(this);
+	socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+	connect(socket, SIGNAL(connected()), this, SLOT(slotConnected()));
+	connect(socket, SIGNAL(readyRead()), this, SLOT(readData()));
+	connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(slotSocketError(QAbstractSocket::SocketError)));
+
+	frameTimer = new QTimer(this);
+	frameTimer->setSingleShot(true);
+	connect(frameTimer, SIGNAL(timeout()), this, SLOT(sendNextFrame()));
+
+	maintenanceTimer = new QTimer(this);
+	maintenanceTimer->setInterval(1000);
+	connect(maintenanceTimer, SIGNAL(timeout()), this, SLOT(maintenanceTimeout()));
+}
+
+Replay_Session::~Replay_Session()
+{
+	stop();
+}
+
+qint64 Replay_Session::scheduledTime(qint64 captureTime) const
+{
+	if (settings.speed <= 0)
+		return 0;
+	return replayStartTime + (qint64) ((captureTime - captureStartTime) * 1000 / settings.speed);
+}
+
+void Replay_Session::start(qint64 _replayStartTime)
+{
+	replayStartTime = _replayStartTime;
+	const qint64 delay = (scheduledTime(connection.opened) - statistics->usecsElapsed()) / 1000;
+	QTimer::singleShot((int) qMax((qint64) 0, delay), this, SLOT(connectToServer()));
+}
+
+void Replay_Session::stop()
+{
+	finish(false);
+}
+
+void Replay_Session::connectToServer()
+{
+	if (finished)
+		return;
+	socket->connectToHost(settings.host, settings.port);
+}
+
+void Replay_Session::slotConnected()
+{
+	connected = true;
+	statistics->connectionOpened();
+	maintenanceTimer->start();
+	scheduleNextFrame();
+}
+
+void Replay_Session::slotSocketError(QAbstractSocket::SocketError /*error*/)
+{
+	if (finished)
+		return;
+
+	// Captured sessions often end with the server closing the connection, e.g. after a kick.
+	const bool expected = (nextFrame >= connection.frames.size()) && (socket->error() == QAbstractSocket::RemoteHostClosedError);
+	if (!expected)
+		std::cerr << "replay session: socket error: " << socket->errorString().toStdString() << std::endl;
+	finish(!expected);
+}
+
+void Replay_Session::finish(bool error)
+{
+	if (finished)
+		return;
+	finished = true;
+
+	frameTimer->stop();
+	maintenanceTimer->stop();
+
+	if (error) {
+		QMapIterator<int, PendingCommand> i(pendingCommands);
+		while (i.hasNext())
+			statistics->commandTimedOut(i.next().value().name);
+	}
+	pendingCommands.clear();
+
+	if (connected)
+		statistics->connectionClosed(loggedIn, error);
+	else if (error)
+		statistics->connectionFailed();
+
+	socket->abort();
+	coordinator->sessionFinished();
+}
+
+void Replay_Session::scheduleNextFrame()
+{
+	if (finished)
+		return;
+
+	qint64 captureTime;
+	if (nextFrame < connection.frames.size())
+		captureTime = connection.frames[nextFrame].timestamp;
+	else if ((settings.speed > 0) && (connection.closed != -1))
+		captureTime = connection.closed;
+	else if (pendingCommands.isEmpty())
+		captureTime = 0;
+	else
+		// Wait for the outstanding responses, processResponse() comes back here.
+		return;
+
+	if (settings.speed <= 0)
+		frameTimer->start(0);
+	else
+		frameTimer->start((int) qMax((qint64) 0, (scheduledTime(captureTime) - statistics->usecsElapsed()) / 1000));
+}
+
+void Replay_Session::sendNextFrame()
+{
+	if (nextFrame >= connection.frames.size()) {
+		finish(false);
+		return;
+	}
+
+	const Replay_Capture::Frame &frame = connection.frames[nextFrame];
+	CommandContainer cont;
+	cont.ParseFromArray(frame.data.data(), frame.data.size());
+
+	const qint64 now = statistics->usecsElapsed();
+	if (!rewriteFrame(cont)) {
+		if (frameDeferredSince == 0)
+			frameDeferredSince = now;
+		if (now - frameDeferredSince < (qint64) settings.commandTimeout * 1000000) {
+			frameTimer->start(deferInterval);
+			return;
+		}
+		// Give up waiting and let the server reject the captured game id.
+	}
+	frameDeferredSince = 0;
+	++nextFrame;
+
+	QByteArray buf;
+	unsigned int size = cont.ByteSize();
+	buf.resize(size + 4);
+	cont.SerializeToArray(buf.data() + 4, size);
+	buf.data()[3] = (unsigned char) size;
+	buf.data()[2] = (unsigned char) (size >> 8);
+	buf.data()[1] = (unsigned char) (size >> 16);
+	buf.data()[0] = (unsigned char) (size >> 24);
+	socket->write(buf);
+
+	// The empty handshake frame has no command id and gets no response.
+	if (cont.has_cmd_id()) {
+		const QString commandName = getCommandName(cont);
+		PendingCommand pend;
+		pend.name = commandName;
+		pend.timeSent = now;
+		pendingCommands.insert(cont.cmd_id(), pend);
+		statistics->commandSent(commandName, buf.size());
+
+		for (int i = 0; i < cont.room_command_size(); ++i) {
+			if (cont.room_command(i).HasExtension(Command_CreateGame::ext))
+				pendingJoins.append(qMakePair((int) cont.cmd_id(), frame.createdGameId));
+			else if (cont.room_command(i).HasExtension(Command_JoinGame::ext))
+				pendingJoins.append(qMakePair((int) cont.cmd_id(), -1));
+		}
+
+		if (settings.speed <= 0) {
+			awaitedCmdId = cont.cmd_id();
+			return;
+		}
+	}
+	scheduleNextFrame();
+}
+
+bool Replay_Session::rewriteFrame(CommandContainer &cont)
+{
+	bool complete = true;
+	int gameId;
+	if (cont.has_game_id()) {
+		complete &= coordinator->mapGameId(cont.game_id(), gameId);
+		cont.set_game_id(gameId);
+	}
+
+	for (int i = 0; i < cont.session_command_size(); ++i) {
+		SessionCommand *sc = cont.mutable_session_command(i);
+		if (sc->HasExtension(Command_Login::ext)) {
+			Command_Login *cmd = sc->MutableExtension(Command_Login::ext);
+			cmd->set_user_name(coordinator->mapUserName(QString::fromStdString(cmd->user_name())).toStdString());
+			cmd->set_password(settings.password.toStdString());
+		}
+		remapUserName<Command_Message>(sc, coordinator);
+		remapUserName<Command_GetGamesOfUser>(sc, coordinator);
+		remapUserName<Command_GetUserInfo>(sc, coordinator);
+		remapUserName<Command_AddToList>(sc, coordinator);
+		remapUserName<Command_RemoveFromList>(sc, coordinator);
+	}
+
+	for (int i = 0; i < cont.room_command_size(); ++i) {
+		RoomCommand *rc = cont.mutable_room_command(i);
+		if (rc->HasExtension(Command_JoinGame::ext)) {
+			Command_JoinGame *cmd = rc->MutableExtension(Command_JoinGame::ext);
+			complete &= coordinator->mapGameId(cmd->game_id(), gameId);
+			cmd->set_game_id(gameId);
+		}
+	}
+
+	return complete;
+}
+
+QString Replay_Session::getCommandName(const CommandContainer &cont)
+{
+	const ::google::protobuf::Message *cmd = 0;
+	if (cont.session_command_size())
+		cmd = &cont.session_command(0);
+	else if (cont.game_command_size())
+		cmd = &cont.game_command(0);
+	else if (cont.room_command_size())
+		cmd = &cont.room_command(0);
+	else if (cont.moderator_command_size())
+		cmd = &cont.moderator_command(0);
+	else if (cont.admin_command_size())
+		cmd = &cont.admin_command(0);
+	if (!cmd)
+		return "CommandContainer";
+
+	std::vector< const ::google::protobuf::FieldDescriptor * > fieldList;
+	cmd->GetReflection()->ListFields(*cmd, &fieldList);
+	for (unsigned int j = 0; j < fieldList.size(); ++j)
+		if (fieldList[j]->is_extension())
+			return QString::fromStdString(fieldList[j]->message_type()->name());
+	return QString::fromStdString(cmd->GetDescriptor()->name());
+}
+
+void Replay_Session::readData()
+{
+	QByteArray data = socket->readAll();
+	inputBuffer.append(data);
+
+	do {
+		if (!messageInProgress) {
+			if (inputBuffer.size() >= 4) {
+				// The server greets every connection with 60 bytes of XML for the benefit of old clients.
+				if (!handshakeStarted) {
+					handshakeStarted = true;
+					if (inputBuffer.startsWith("<?xm")) {
+						messageInProgress = true;
+						messageLength = 60;
+					}
+				} else {
+					messageLength =   (((quint32) (unsigned char) inputBuffer[0]) << 24)
+					                + (((quint32) (unsigned char) inputBuffer[1]) << 16)
+					                + (((quint32) (unsigned char) inputBuffer[2]) << 8)
+					                + ((quint32) (unsigned char) inputBuffer[3]);
+					inputBuffer.remove(0, 4);
+					messageInProgress = true;
+				}
+			} else
+				return;
+		}
+		if (inputBuffer.size() < messageLength)
+			return;
+
+		ServerMessage newServerMessage;
+		newServerMessage.ParseFromArray(inputBuffer.data(), messageLength);
+		inputBuffer.remove(0, messageLength);
+		messageInProgress = false;
+
+		processServerMessage(newServerMessage);
+		if (finished)
+			return;
+	} while (!inputBuffer.isEmpty());
+}
+
+void Replay_Session::processServerMessage(const ServerMessage &item)
+{
+	switch (item.message_type()) {
+		case ServerMessage::RESPONSE:
+			statistics->messageReceived(item.ByteSize() + 4, 0);
+			processResponse(item.response());
+			break;
+		case ServerMessage::SESSION_EVENT:
+			statistics->messageReceived(item.ByteSize() + 4, 1);
+			processSessionEvent(item.session_event());
+			break;
+		case ServerMessage::GAME_EVENT_CONTAINER:
+			statistics->messageReceived(item.ByteSize() + 4, item.game_event_container().event_list_size());
+			break;
+		case ServerMessage::ROOM_EVENT:
+			statistics->messageReceived(item.ByteSize() + 4, 1);
+			break;
+	}
+}
+
+void Replay_Session::processResponse(const Response &response)
+{
+	const int cmdId = response.cmd_id();
+	QMap<int, PendingCommand>::iterator i = pendingCommands.find(cmdId);
+	if (i == pendingCommands.end())
+		return;
+	const PendingCommand pend = i.value();
+	pendingCommands.erase(i);
+
+	const bool ok = response.response_code() == Response::RespOk;
+	statistics->responseReceived(pend.name, statistics->usecsElapsed() - pend.timeSent, ok);
+	if (pend.name == "Command_Login") {
+		statistics->loginFinished(ok);
+		loggedIn = ok;
+	}
+
+	// A join that was answered without Event_GameJoined has failed.
+	for (int j = 0; j < pendingJoins.size(); ++j)
+		if (pendingJoins[j].first == cmdId) {
+			if (pendingJoins[j].second != -1)
+				coordinator->gameCreationFailed(pendingJoins[j].second);
+			pendingJoins.removeAt(j);
+			break;
+		}
+
+	if (cmdId == awaitedCmdId) {
+		awaitedCmdId = -1;
+		scheduleNextFrame();
+	} else if ((nextFrame >= connection.frames.size()) && pendingCommands.isEmpty())
+		scheduleNextFrame();
+}
+
+void Replay_Session::processSessionEvent(const SessionEvent &event)
+{
+	switch ((SessionEvent::SessionEventType) getPbExtension(event)) {
+		case SessionEvent::CONNECTION_CLOSED: {
+			// Expected when the capture ends with the session being replaced by a new login.
+			finish(nextFrame < connection.frames.size());
+			break;
+		}
+		case SessionEvent::GAME_JOINED: {
+			// The server handles the commands of a connection in order, so the events
+			// arrive in the order the joins were sent.
+			if (pendingJoins.isEmpty())
+				break;
+			const int capturedGameId = pendingJoins.takeFirst().second;
+			if (capturedGameId != -1)
+				coordinator->gameCreated(capturedGameId, event.GetExtension(Event_GameJoined::ext).game_info().game_id());
+			break;
+		}
+		default: break;
+	}
+}
+
+void Replay_Session::maintenanceTimeout()
+{
+	const qint64 now = statistics->usecsElapsed();
+	const qint64 timeout = (qint64) settings.commandTimeout * 1000000;
+
+	bool awaitedTimedOut = false;
+	QMutableMapIterator<int, PendingCommand> i(pendingCommands);
+	while (i.hasNext()) {
+		i.next();
+		if (now - i.value().timeSent > timeout) {
+			statistics->commandTimedOut(i.value().name);
+			if (i.key() == awaitedCmdId)
+				awaitedTimedOut = true;
+			i.remove();
+		}
+	}
+
+	if (awaitedTimedOut) {
+		awaitedCmdId = -1;
+		scheduleNextFrame();
+	} else if ((nextFrame >= connection.frames.size()) && pendingCommands.isEmpty() && !frameTimer->isActive())
+		scheduleNextFrame();
+}
@@ -0,0 +1,90 @@
+#ifndef REPLAY_SESSION_H
+#define REPLAY_SESSION_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QMap>
+#include <QList>
+#include <QPair>
+#include "replay_capture.h"
+
+class QTimer;
+class LoadGen_Statistics;
+class Replay_Coordinator;
+class CommandContainer;
+class ServerMessage;
+class Response;
+class SessionEvent;
+
+class Replay_Settings {
+public:
+	QString host;
+	int port;
+	// Replay speed relative to the capture, 0 sends every frame as soon as the previous one was answered.
+	double speed;
+	int threads;
+	int commandTimeout;
+	int reportInterval;
+	QString userNamePrefix;
+	QString password;
+
+	Replay_Settings()
+		: host("localhost"), port(4747), speed(1), threads(4), commandTimeout(30), reportInterval(5), userNamePrefix("replay") { }
+};
+
+// Plays back the frames of one captured connection over its own TCP
+// connection, keeping the captured timing scaled by the replay speed.
+class Replay_Session : public QObject {
+	Q_OBJECT
+private slots:
+	void connectToServer();
+	void slotConnected();
+	void slotSocketError(QAbstractSocket::SocketError error);
+	void readData();
+	void sendNextFrame();
+	void maintenanceTimeout();
+public slots:
+	void start(qint64 _replayStartTime);
+	void stop();
+private:
+	struct PendingCommand {
+		QString name;
+		qint64 timeSent;
+	};
+	const Replay_Settings &settings;
+	const Replay_Capture::Connection &connection;
+	qint64 captureStartTime, replayStartTime;
+	LoadGen_Statistics *statistics;
+	Replay_Coordinator *coordinator;
+
+	QTcpSocket *socket;
+	QTimer *frameTimer;
+	QTimer *maintenanceTimer;
+	QByteArray inputBuffer;
+	bool messageInProgress;
+	bool handshakeStarted;
+	int messageLength;
+
+	bool connected, finished, loggedIn;
+	int nextFrame;
+	qint64 frameDeferredSince;
+	int awaitedCmdId;
+	QMap<int, PendingCommand> pendingCommands;
+	// Command id and captured game id of CreateGame/JoinGame commands waiting for their Event_GameJoined.
+	QList<QPair<int, int> > pendingJoins;
+
+	qint64 scheduledTime(qint64 captureTime) const;
+	void scheduleNextFrame();
+	bool rewriteFrame(CommandContainer &cont);
+	void finish(bool error);
+	static QString getCommandName(const CommandContainer &cont);
+
+	void processServerMessage(const ServerMessage &item);
+	void processResponse(const Response &response);
+	void processSessionEvent(const SessionEvent &event);
+public:
+	Replay_Session(const Replay_Settings &_settings, const Replay_Capture::Connection &_connection, qint64 _captureStartTime, LoadGen_Statistics *_statistics, Replay_Coordinator *_coordinator);
+	~Replay_Session();
+};
+
+#endif
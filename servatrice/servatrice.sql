@@ -128,6 +128,11 @@ CREATE TABLE `cockatrice_uptime` (
   `uptime` int(11) NOT NULL,
   `users_count` int(11) NOT NULL,
   `games_count` int(11) NOT NULL,
+  `hibernated_games_count` int(11) NOT NULL DEFAULT '0',
+  `hibernations` int(11) NOT NULL DEFAULT '0',
+  `hibernation_usecs` int(11) NOT NULL DEFAULT '0',
+  `rehydrations` int(11) NOT NULL DEFAULT '0',
+  `rehydration_usecs` int(11) NOT NULL DEFAULT '0',
   `rx_bytes` int(11) NOT NULL,
   `tx_bytes` int(11) NOT NULL,
   PRIMARY KEY (`timest`)
@@ -1,9 +1,11 @@
 #include "isl_interface.h"
 #include <QSslSocket>
+#include <QTimer>
 #include "server_logger.h"
 #include "main.h"
 #include "server_protocolhandler.h"
 #include "server_room.h"
+#include "server_game.h"
 
 #include "get_pb_extension.h"
 #include "pb/isl_message.pb.h"
@@ -16,7 +18,10 @@
 #include "pb/event_leave_room.pb.h"
 #include "pb/event_room_say.pb.h"
 #include "pb/event_list_games.pb.h"
-#include <google/protobuf/descriptor.h>
+
+// Milliseconds to wait for the SYNC_REQUEST of a peer before it is taken for
+// an older version, which expects the complete server list right away.
+static const int legacySyncTimeout = 5000;
 
 void IslInterface::sharedCtor(const QSslCertificate &cert, const QSslKey &privateKey)
 {
@@ -27,6 +32,19 @@ void IslInterface::sharedCtor(const QSslCertificate &cert, const QSslKey &privat
 	connect(socket, SIGNAL(readyRead()), this, SLOT(readClient()), Qt::QueuedConnection);
 	connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(catchSocketError(QAbstractSocket::SocketError)));
 	connect(this, SIGNAL(outputBufferChanged()), this, SLOT(flushOutputBuffer()), Qt::QueuedConnection);
+	// Lanes limited per flush continue once the socket has written what it had.
+	connect(socket, SIGNAL(bytesWritten(qint64)), this, SLOT(flushOutputBuffer()), Qt::QueuedConnection);
+	
+	peerRoomInterestKnown = false;
+	registered = false;
+	peerSynced = false;
+	syncRequestReceived = false;
+	txMessages = txBytes = rxMessages = rxBytes = suppressedMessages = 0;
+	
+	flushPending = false;
+	outputOverflow = false;
+	for (int i = 0; i < OutputLaneCount; ++i)
+		outputLanes[i].queueLimit = server->getIslQueueLimit(i);
 }
 
 IslInterface::IslInterface(int _socketDescriptor, const QSslCertificate &cert, const QSslKey &privateKey, Servatrice *_server)
@@ -43,36 +61,14 @@ IslInterface::IslInterface(int _serverId, const QString &_peerHostName, const QS
 
 IslInterface::~IslInterface()
 {
-	logger->logMessage("[ISL] session ended", this);
+	logger->logMessage("[ISL] session ended: " + getStatistics(), this);
 	
 	flushOutputBuffer();
 	
-	// As these signals are connected with Qt::QueuedConnection implicitly,
-	// we don't need to worry about them modifying the lists while we're iterating.
-	
-	server->roomsLock.lockForRead();
-	QMapIterator<int, Server_Room *> roomIterator(server->getRooms());
-	while (roomIterator.hasNext()) {
-		Server_Room *room = roomIterator.next().value();
-		room->usersLock.lockForRead();
-		QMapIterator<QString, ServerInfo_User_Container> roomUsers(room->getExternalUsers());
-		while (roomUsers.hasNext()) {
-			roomUsers.next();
-			if (roomUsers.value().getUserInfo()->server_id() == serverId)
-				emit externalRoomUserLeft(room->getId(), roomUsers.key());
-		}
-		room->usersLock.unlock();
-	}
-	server->roomsLock.unlock();
-	
-	server->clientsLock.lockForRead();
-	QMapIterator<QString, Server_AbstractUserInterface *> extUsers(server->getExternalUsers());
-	while (extUsers.hasNext()) {
-		extUsers.next();
-		if (extUsers.value()->getUserInfo()->server_id() == serverId)
-			emit externalUserLeft(extUsers.key());
-	}
-	server->clientsLock.unlock();
+	// The users of the peer are kept for a while, so that a quick reconnection
+	// only needs the changes since now. See Servatrice::purgeDisconnectedIslPeers().
+	if (registered)
+		server->storeIslPeerState(serverId, peerState);
 }
 
 void IslInterface::initServer()
@@ -114,46 +110,15 @@ void IslInterface::initServer()
 	}
 	serverId = serverList[listIndex].id;
 	
-	Event_ServerCompleteList event;
-	event.set_server_id(server->getServerId());
-	
-	server->clientsLock.lockForRead();
-	QMapIterator<QString, Server_ProtocolHandler *> userIterator(server->getUsers());
-	while (userIterator.hasNext())
-		event.add_user_list()->CopyFrom(userIterator.next().value()->copyUserInfo(true, true));
-	server->clientsLock.unlock();
-	
-	server->roomsLock.lockForRead();
-	QMapIterator<int, Server_Room *> roomIterator(server->getRooms());
-	while (roomIterator.hasNext()) {
-		Server_Room *room = roomIterator.next().value();
-		room->usersLock.lockForRead();
-		room->gamesLock.lockForRead();
-		room->getInfo(*event.add_room_list(), true, true, false);
-	}
-	
-	IslMessage message;
-	message.set_message_type(IslMessage::SESSION_EVENT);
-	SessionEvent *sessionEvent = message.mutable_session_event();
-	sessionEvent->GetReflection()->MutableMessage(sessionEvent, event.GetDescriptor()->FindExtensionByName("ext"))->CopyFrom(event);
-	
+	// Both sides ask for what they are missing once the connection is registered,
+	// see sendSyncRequest().
 	server->islLock.lockForWrite();
 	if (server->islConnectionExists(serverId)) {
 		qDebug() << "[ISL] Duplicate connection to #" << serverId << "terminating connection";
 		deleteLater();
-	} else {
-		transmitMessage(message);
+	} else
 		server->addIslInterface(serverId, this);
-	}
 	server->islLock.unlock();
-	
-	roomIterator.toFront();
-	while (roomIterator.hasNext()) {
-		roomIterator.next();
-		roomIterator.value()->gamesLock.unlock();
-		roomIterator.value()->usersLock.unlock();
-	}
-	server->roomsLock.unlock();
 }
 
 void IslInterface::initClient()
@@ -183,6 +148,7 @@ void IslInterface::initClient()
 	server->islLock.lockForWrite();
 	if (server->islConnectionExists(serverId)) {
 		qDebug() << "[ISL] Duplicate connection to #" << serverId << "terminating connection";
+		server->islLock.unlock();
 		deleteLater();
 		return;
 	}
@@ -194,12 +160,67 @@ void IslInterface::initClient()
 void IslInterface::flushOutputBuffer()
 {
 	QMutexLocker locker(&outputBufferMutex);
-	if (outputBuffer.isEmpty())
-		return;
-	server->incTxBytes(outputBuffer.size());
-	socket->write(outputBuffer);
-	socket->flush();
-	outputBuffer.clear();
+	flushPending = false;
+	
+	bool written = false;
+	for (int i = 0; i < OutputLaneCount; ++i) {
+		OutputLane &lane = outputLanes[i];
+		if (lane.buffer.isEmpty())
+			continue;
+		
+		// Lobby updates and chat must not crowd out game traffic: they only get a share
+		// of each flush, and none while the socket still has plenty to write.
+		int size = lane.buffer.size();
+		if ((i == LobbyLane) || (i == ChatLane)) {
+			if (socket->bytesToWrite() >= lowPriorityBytesPerFlush)
+				continue;
+			size = getMessageBoundary(lane.buffer, lowPriorityBytesPerFlush);
+		}
+		
+		server->incTxBytes(size);
+		if (size == lane.buffer.size()) {
+			socket->write(lane.buffer);
+			lane.buffer.clear();
+			lane.exemptBytes = 0;
+		} else {
+			socket->write(lane.buffer.constData(), size);
+			lane.buffer.remove(0, size);
+			// Where the exempt messages were is not known, so they count as written first.
+			lane.exemptBytes = qMax(0, lane.exemptBytes - size);
+		}
+		++lane.batches;
+		written = true;
+	}
+	if (written)
+		socket->flush();
+}
+
+int IslInterface::getMessageBoundary(const QByteArray &buffer, int maxBytes)
+{
+	// Every message is preceded by its size, see transmitMessage(). At least one
+	// message is taken, however large.
+	int boundary = 0;
+	while (boundary + 4 <= buffer.size()) {
+		const int next = boundary + 4 + (int) ((((quint32) (unsigned char) buffer[boundary]) << 24)
+		                                     + (((quint32) (unsigned char) buffer[boundary + 1]) << 16)
+		                                     + (((quint32) (unsigned char) buffer[boundary + 2]) << 8)
+		                                     + ((quint32) (unsigned char) buffer[boundary + 3]));
+		if ((boundary > 0) && (next > maxBytes))
+			break;
+		boundary = next;
+	}
+	return boundary;
+}
+
+void IslInterface::closeOverflowedConnection()
+{
+	logger->logMessage(QString("[ISL] output queue limit exceeded for #%1, terminating connection").arg(serverId), this);
+	
+	server->islLock.lockForWrite();
+	server->removeIslInterface(serverId);
+	server->islLock.unlock();
+	
+	deleteLater();
 }
 
 void IslInterface::readClient()
@@ -228,6 +249,11 @@ void IslInterface::readClient()
 		inputBuffer.remove(0, messageLength);
 		messageInProgress = false;
 		
+		statisticsMutex.lock();
+		++rxMessages;
+		rxBytes += messageLength + 4;
+		statisticsMutex.unlock();
+		
 		processMessage(newMessage);
 	} while (!inputBuffer.isEmpty());
 }
@@ -243,7 +269,55 @@ void IslInterface::catchSocketError(QAbstractSocket::SocketError socketError)
 	deleteLater();
 }
 
-void IslInterface::transmitMessage(const IslMessage &item)
+int IslInterface::getOutputLane(const IslMessage &item)
+{
+	switch (item.message_type()) {
+		case IslMessage::SESSION_EVENT: {
+			if (item.has_sync_state())
+				return MembershipLane;
+			switch (getPbExtension(item.session_event())) {
+				case SessionEvent::USER_MESSAGE: return ChatLane;
+				case SessionEvent::GAME_JOINED: return InteractiveLane;
+				case SessionEvent::SERVER_COMPLETE_LIST:
+				case SessionEvent::USER_JOINED:
+				case SessionEvent::USER_LEFT: return MembershipLane;
+				default: return LobbyLane;
+			}
+		}
+		case IslMessage::ROOM_EVENT:
+			switch (getPbExtension(item.room_event())) {
+				case RoomEvent::ROOM_SAY: return ChatLane;
+				case RoomEvent::JOIN_ROOM:
+				case RoomEvent::LEAVE_ROOM: return MembershipLane;
+				default: return LobbyLane;
+			}
+		case IslMessage::ROOM_GAME_LIST:
+			return LobbyLane;
+		default:
+			// Commands, responses, game events and the small control messages
+			return InteractiveLane;
+	}
+}
+
+bool IslInterface::isExemptFromQueueLimit(const IslMessage &item)
+{
+	// Snapshots and control messages may be larger than a lane's limit on their own.
+	// Refusing them would close the connection, and the peer would ask for the same
+	// snapshot again right after reconnecting.
+	switch (item.message_type()) {
+		case IslMessage::SESSION_EVENT:
+			return item.has_sync_state() || (getPbExtension(item.session_event()) == SessionEvent::SERVER_COMPLETE_LIST);
+		case IslMessage::ROOM_INTEREST:
+		case IslMessage::ROOM_GAME_LIST:
+		case IslMessage::SYNC_REQUEST:
+		case IslMessage::GAME_MIGRATION:
+			return true;
+		default:
+			return false;
+	}
+}
+
+bool IslInterface::transmitMessage(const IslMessage &item)
 {
 	QByteArray buf;
 	unsigned int size = item.ByteSize();
@@ -254,10 +328,230 @@ void IslInterface::transmitMessage(const IslMessage &item)
 	buf.data()[1] = (unsigned char) (size >> 16);
 	buf.data()[0] = (unsigned char) (size >> 24);
 	
+	const int laneType = getOutputLane(item);
+	outputBufferMutex.lock();
+	OutputLane &lane = outputLanes[laneType];
+	if (outputOverflow) {
+		// The connection is about to be closed.
+		++lane.dropped;
+		outputBufferMutex.unlock();
+		return false;
+	}
+	const bool exempt = isExemptFromQueueLimit(item);
+	if (lane.queueLimit && !exempt && (lane.buffer.size() > lane.exemptBytes) && (lane.buffer.size() - lane.exemptBytes + buf.size() > lane.queueLimit)) {
+		// Chat can be lost; for everything else the peer has to resynchronize.
+		++lane.dropped;
+		const bool closeConnection = (laneType != ChatLane) && !outputOverflow;
+		if (closeConnection)
+			outputOverflow = true;
+		outputBufferMutex.unlock();
+		if (closeConnection)
+			QMetaObject::invokeMethod(this, "closeOverflowedConnection", Qt::QueuedConnection);
+		return false;
+	}
+	lane.buffer.append(buf);
+	if (exempt)
+		lane.exemptBytes += buf.size();
+	lane.maxQueued = qMax(lane.maxQueued, lane.buffer.size());
+	++lane.messages;
+	const bool emitChanged = !flushPending;
+	flushPending = true;
+	outputBufferMutex.unlock();
+	if (emitChanged)
+		emit outputBufferChanged();
+	
+	statisticsMutex.lock();
+	++txMessages;
+	txBytes += buf.size();
+	statisticsMutex.unlock();
+	return true;
+}
+
+void IslInterface::transmitLoggedMessage(const IslMessage &item)
+{
+	// Messages skipped here are sent by processSyncRequest(), or are already
+	// contained in the snapshot it sends.
+	QMutexLocker locker(&syncMutex);
+	if (peerSynced)
+		transmitMessage(item);
+}
+
+void IslInterface::sendSyncRequest()
+{
+	// Only call with server->islLock locked for writing, when the connection is registered.
+	registered = true;
+	peerState = server->takeIslPeerState(serverId);
+	
+	IslMessage message;
+	message.set_message_type(IslMessage::SYNC_REQUEST);
+	IslSyncState *syncState = message.mutable_sync_state();
+	syncState->set_epoch(peerState.epoch);
+	syncState->set_user_sequence(peerState.userSequence);
+	QMapIterator<int, quint64> roomIterator(peerState.roomSequences);
+	while (roomIterator.hasNext()) {
+		roomIterator.next();
+		IslSyncState::RoomSequence *roomSequence = syncState->add_room_sequence();
+		roomSequence->set_room_id(roomIterator.key());
+		roomSequence->set_sequence(roomIterator.value());
+	}
+	transmitMessage(message);
+	
+	QTimer::singleShot(legacySyncTimeout, this, SLOT(sendLegacyServerList()));
+}
+
+void IslInterface::getServerList(Event_ServerCompleteList &event) const
+{
+	event.set_server_id(server->getServerId());
+	
+	server->clientsLock.lockForRead();
+	QMapIterator<QString, Server_ProtocolHandler *> userIterator(server->getUsers());
+	while (userIterator.hasNext())
+		event.add_user_list()->CopyFrom(userIterator.next().value()->copyUserInfo(true, true));
+	server->clientsLock.unlock();
+	
+	server->roomsLock.lockForRead();
+	QMapIterator<int, Server_Room *> roomIterator(server->getRooms());
+	while (roomIterator.hasNext())
+		roomIterator.next().value()->getInfo(*event.add_room_list(), true, true, false);
+	server->roomsLock.unlock();
+}
+
+void IslInterface::sendLegacyServerList()
+{
+	// Peers without SYNC_REQUEST support get the plain server list they expect,
+	// followed by every change from now on.
+	QMutexLocker locker(&syncMutex);
+	if (syncRequestReceived)
+		return;
+	syncRequestReceived = true;
+	
+	Event_ServerCompleteList event;
+	getServerList(event);
+	IslMessage message;
+	message.set_message_type(IslMessage::SESSION_EVENT);
+	setPbExtension(*message.mutable_session_event(), event);
+	transmitMessage(message);
+	peerSynced = true;
+	
+	logger->logMessage(QString("[ISL] no sync request from #%1, sent the complete server list: %2 users and %3 rooms").arg(serverId).arg(event.user_list_size()).arg(event.room_list_size()), this);
+}
+
+void IslInterface::processSyncRequest(const IslSyncState &request)
+{
+	IslStateLog *stateLog = server->getIslStateLog();
+	const bool sameEpoch = request.epoch() == stateLog->getEpoch();
+	QMap<int, quint64> peerRoomSequences;
+	for (int i = 0; i < request.room_sequence_size(); ++i)
+		peerRoomSequences.insert(request.room_sequence(i).room_id(), request.room_sequence(i).sequence());
+	
+	QMutexLocker locker(&syncMutex);
+	syncRequestReceived = true;
+	
+	// Every stream the log cannot bring up to date is sent as a snapshot. Sequence
+	// numbers are taken before the state is read, so the state is never older than
+	// the sequence number; changes applied twice don't hurt.
+	QList<IslMessage> deltas;
+	QList<int> gameListRooms;
+	Event_ServerCompleteList snapshot;
+	snapshot.set_server_id(server->getServerId());
+	IslMessage snapshotMessage;
+	snapshotMessage.set_message_type(IslMessage::SESSION_EVENT);
+	IslSyncState *syncState = snapshotMessage.mutable_sync_state();
+	syncState->set_epoch(stateLog->getEpoch());
+	bool snapshotNeeded = false;
+	
+	if (!sameEpoch || !stateLog->getEntriesSince(IslStateLog::userDirectoryStream, request.user_sequence(), deltas)) {
+		snapshotNeeded = true;
+		syncState->set_has_user_list(true);
+		syncState->set_user_sequence(stateLog->getSequence(IslStateLog::userDirectoryStream));
+		
+		server->clientsLock.lockForRead();
+		QMapIterator<QString, Server_ProtocolHandler *> userIterator(server->getUsers());
+		while (userIterator.hasNext())
+			snapshot.add_user_list()->CopyFrom(userIterator.next().value()->copyUserInfo(true, true));
+		server->clientsLock.unlock();
+	}
+	
+	server->roomsLock.lockForRead();
+	QMapIterator<int, Server_Room *> roomIterator(server->getRooms());
+	while (roomIterator.hasNext()) {
+		Server_Room *room = roomIterator.next().value();
+		QList<IslMessage> roomDeltas;
+		if (sameEpoch && stateLog->getEntriesSince(room->getId(), peerRoomSequences.value(room->getId()), roomDeltas)) {
+			// Game list changes travel on another lane than the room members, so they
+			// are not replayed one by one: interested peers get the whole game list.
+			for (int i = 0; i < roomDeltas.size(); ++i)
+				if (getPbExtension(roomDeltas[i].room_event()) != RoomEvent::LIST_GAMES)
+					deltas.append(roomDeltas[i]);
+			if (isInterestedInRoom(room->getId()))
+				gameListRooms.append(room->getId());
+			continue;
+		}
+		snapshotNeeded = true;
+		IslSyncState::RoomSequence *roomSequence = syncState->add_room_sequence();
+		roomSequence->set_room_id(room->getId());
+		roomSequence->set_sequence(stateLog->getSequence(room->getId()));
+		room->getInfo(*snapshot.add_room_list(), true, true, false);
+	}
+	server->roomsLock.unlock();
+	
+	for (int i = 0; i < deltas.size(); ++i)
+		transmitMessage(deltas[i]);
+	if (snapshotNeeded) {
+		SessionEvent *sessionEvent = snapshotMessage.mutable_session_event();
+		setPbExtension(*sessionEvent, snapshot);
+		transmitMessage(snapshotMessage);
+	}
+	for (int i = 0; i < gameListRooms.size(); ++i)
+		sendRoomGameList(gameListRooms[i]);
+	peerSynced = true;
+	
+	logger->logMessage(QString("[ISL] synchronized #%1: %2 changes, %3 users and %4 rooms in snapshot").arg(serverId).arg(deltas.size()).arg(snapshot.user_list_size()).arg(snapshot.room_list_size()), this);
+}
+
+bool IslInterface::acceptSyncSequence(const IslMessage &item)
+{
+	// Changes that were sent both live and in the answer to a sync request are only applied once.
+	if (!item.has_sync_sequence())
+		return true;
+	// Game list changes may overtake or trail the room member changes they share
+	// the sequence with, see getOutputLane(). They are never replayed, so a game
+	// list change is applied as it comes and leaves the sequence alone.
+	if ((item.message_type() == IslMessage::ROOM_EVENT) && (getPbExtension(item.room_event()) == RoomEvent::LIST_GAMES))
+		return true;
+	
+	quint64 &sequence = (item.message_type() == IslMessage::ROOM_EVENT) ? peerState.roomSequences[item.room_event().room_id()] : peerState.userSequence;
+	if (item.sync_sequence() <= sequence)
+		return false;
+	sequence = item.sync_sequence();
+	return true;
+}
+
+bool IslInterface::isInterestedInRoom(int roomId) const
+{
+	QMutexLocker locker(&peerRoomInterestMutex);
+	return !peerRoomInterestKnown || peerRoomInterest.contains(roomId);
+}
+
+void IslInterface::messageSuppressed()
+{
+	QMutexLocker locker(&statisticsMutex);
+	++suppressedMessages;
+}
+
+QString IslInterface::getStatistics() const
+{
+	static const char *laneNames[OutputLaneCount] = { "membership", "interactive", "lobby", "chat" };
+	QStringList laneStatistics;
 	outputBufferMutex.lock();
-	outputBuffer.append(buf);
+	for (int i = 0; i < OutputLaneCount; ++i) {
+		const OutputLane &lane = outputLanes[i];
+		laneStatistics.append(QString("%1: %2 messages in %3 writes, max. %4 bytes queued, %5 dropped").arg(laneNames[i]).arg(lane.messages).arg(lane.batches).arg(lane.maxQueued).arg(lane.dropped));
+	}
 	outputBufferMutex.unlock();
-	emit outputBufferChanged();
+	
+	QMutexLocker locker(&statisticsMutex);
+	return QString("sent %1 messages (%2 bytes), received %3 messages (%4 bytes), suppressed %5 messages; %6").arg(txMessages).arg(txBytes).arg(rxMessages).arg(rxBytes).arg(suppressedMessages).arg(laneStatistics.join("; "));
 }
 
 void IslInterface::sessionEvent_ServerCompleteList(const Event_ServerCompleteList &event)
@@ -282,6 +576,22 @@ void IslInterface::sessionEvent_ServerCompleteList(const Event_ServerCompleteLis
 	}
 }
 
+void IslInterface::sessionEvent_ServerSnapshot(const Event_ServerCompleteList &event, const IslSyncState &syncState)
+{
+	// What we had from the peer for the streams in the snapshot is outdated.
+	peerState.epoch = syncState.epoch();
+	if (syncState.has_user_list()) {
+		emit externalServerUsersReset(serverId);
+		peerState.userSequence = syncState.user_sequence();
+	}
+	for (int i = 0; i < syncState.room_sequence_size(); ++i) {
+		emit externalServerRoomReset(serverId, syncState.room_sequence(i).room_id());
+		peerState.roomSequences.insert(syncState.room_sequence(i).room_id(), syncState.room_sequence(i).sequence());
+	}
+	
+	sessionEvent_ServerCompleteList(event);
+}
+
 void IslInterface::sessionEvent_UserJoined(const Event_UserJoined &event)
 {
 	ServerInfo_User userInfo(event.user_info());
@@ -381,6 +691,63 @@ void IslInterface::processRoomCommand(const CommandContainer &cont, qint64 sessi
 	}
 }
 
+void IslInterface::processRoomInterest(const IslMessage &item)
+{
+	QSet<int> newInterest;
+	for (int i = 0; i < item.room_interest_size(); ++i)
+		newInterest.insert(item.room_interest(i));
+	
+	peerRoomInterestMutex.lock();
+	// The peer did not get any game list updates for rooms it was not interested in,
+	// so it needs to be brought up to date. Before it first told us, it got everything.
+	const QSet<int> addedRooms = peerRoomInterestKnown ? newInterest - peerRoomInterest : QSet<int>();
+	peerRoomInterest = newInterest;
+	peerRoomInterestKnown = true;
+	peerRoomInterestMutex.unlock();
+	
+	QSetIterator<int> roomIterator(addedRooms);
+	while (roomIterator.hasNext())
+		sendRoomGameList(roomIterator.next());
+}
+
+void IslInterface::sendRoomGameList(int roomId)
+{
+	Event_ListGames event;
+	
+	server->roomsLock.lockForRead();
+	Server_Room *room = server->getRooms().value(roomId);
+	if (room) {
+		room->gamesLock.lockForRead();
+		QMapIterator<int, Server_Game *> gameIterator(room->getGames());
+		while (gameIterator.hasNext())
+			gameIterator.next().value()->getInfo(*event.add_game_list());
+		room->gamesLock.unlock();
+	}
+	server->roomsLock.unlock();
+	if (!room)
+		return;
+	
+	IslMessage message;
+	message.set_message_type(IslMessage::ROOM_GAME_LIST);
+	RoomEvent *roomEvent = message.mutable_room_event();
+	roomEvent->set_room_id(roomId);
+	setPbExtension(*roomEvent, event);
+	transmitMessage(message);
+}
+
+void IslInterface::processRoomGameList(const RoomEvent &event)
+{
+	const Event_ListGames &listGames = event.GetExtension(Event_ListGames::ext);
+	ServerInfo_Room roomInfo;
+	roomInfo.set_room_id(event.room_id());
+	for (int i = 0; i < listGames.game_list_size(); ++i) {
+		ServerInfo_Game *gameInfo = roomInfo.add_game_list();
+		gameInfo->CopyFrom(listGames.game_list(i));
+		gameInfo->set_server_id(serverId);
+	}
+	emit externalRoomGameListReplaced(serverId, roomInfo);
+}
+
 void IslInterface::processMessage(const IslMessage &item)
 {
 	qDebug() << QString::fromStdString(item.DebugString());
@@ -395,7 +762,10 @@ void IslInterface::processMessage(const IslMessage &item)
 			break;
 		}
 		case IslMessage::SESSION_EVENT: {
-			processSessionEvent(item.session_event(), item.session_id());
+			if (item.has_sync_state())
+				sessionEvent_ServerSnapshot(item.session_event().GetExtension(Event_ServerCompleteList::ext), item.sync_state());
+			else if (acceptSyncSequence(item))
+				processSessionEvent(item.session_event(), item.session_id());
 			break;
 		}
 		case IslMessage::RESPONSE: {
@@ -407,7 +777,28 @@ void IslInterface::processMessage(const IslMessage &item)
 			break;
 		}
 		case IslMessage::ROOM_EVENT: {
-			processRoomEvent(item.room_event()); break;
+			if (acceptSyncSequence(item))
+				processRoomEvent(item.room_event());
+			break;
+		}
+		case IslMessage::ROOM_INTEREST: {
+			processRoomInterest(item);
+			break;
+		}
+		case IslMessage::ROOM_GAME_LIST: {
+			processRoomGameList(item.room_event());
+			break;
+		}
+		case IslMessage::SYNC_REQUEST: {
+			processSyncRequest(item.sync_state());
+			break;
+		}
+		case IslMessage::GAME_MIGRATION: {
+			emit gameMigrationReceived(item.game_snapshot(), serverId);
+			break;
+		}
+		case IslMessage::GAME_MIGRATION_RESULT: {
+			emit gameMigrationResultReceived(item.migrated_game_id(), item.migration_adopted(), serverId);
 			break;
 		}
 		default: ;
@@ -2,8 +2,10 @@
 #define ISL_INTERFACE_H
 
 #include "servatrice.h"
+#include "isl_state_log.h"
 #include <QSslCertificate>
 #include <QWaitCondition>
+#include <QSet>
 #include "pb/serverinfo_user.pb.h"
 #include "pb/serverinfo_room.pb.h"
 #include "pb/serverinfo_game.pb.h"
@@ -12,6 +14,8 @@ class Servatrice;
 class QSslSocket;
 class QSslKey;
 class IslMessage;
+class IslSyncState;
+class GameSnapshot;
 
 class Event_ServerCompleteList;
 class Event_UserMessage;
@@ -25,10 +29,19 @@ class Command_JoinGame;
 
 class IslInterface : public QObject {
 	Q_OBJECT
+public:
+	// In the order they are written: users and room members first, because commands
+	// and chat refer to them, then game traffic, then the lanes limited per flush.
+	enum OutputLaneType { MembershipLane, InteractiveLane, LobbyLane, ChatLane, OutputLaneCount };
+	// Bytes the lobby and chat lanes may each write per flush, and the socket backlog
+	// above which they wait for the socket to catch up.
+	static const int lowPriorityBytesPerFlush = 65536;
 private slots:
 	void readClient();
 	void catchSocketError(QAbstractSocket::SocketError socketError);
 	void flushOutputBuffer();
+	void closeOverflowedConnection();
+	void sendLegacyServerList();
 signals:
 	void outputBufferChanged();
 	
@@ -38,10 +51,15 @@ signals:
 	void externalRoomUserLeft(int roomId, QString userName);
 	void externalRoomSay(int roomId, QString userName, QString message);
 	void externalRoomGameListChanged(int roomId, ServerInfo_Game gameInfo);
+	void externalRoomGameListReplaced(int serverId, ServerInfo_Room roomInfo);
+	void externalServerUsersReset(int serverId);
+	void externalServerRoomReset(int serverId, int roomId);
 	void joinGameCommandReceived(const Command_JoinGame &cmd, int cmdId, int roomId, int serverId, qint64 sessionId);
 	void gameCommandContainerReceived(const CommandContainer &cont, int playerId, int serverId, qint64 sessionId);
 	void responseReceived(const Response &resp, qint64 sessionId);
 	void gameEventContainerReceived(const GameEventContainer &cont, qint64 sessionId);
+	void gameMigrationReceived(const GameSnapshot &snapshot, int serverId);
+	void gameMigrationResultReceived(int gameId, bool adopted, int serverId);
 private:
 	int serverId;
 	int socketDescriptor;
@@ -49,15 +67,47 @@ private:
 	int peerPort;
 	QSslCertificate peerCert;
 	
-	QMutex outputBufferMutex;
 	Servatrice *server;
 	QSslSocket *socket;
 	
-	QByteArray inputBuffer, outputBuffer;
+	// Outgoing messages wait in one queue per lane; a flush writes each lane
+	// as a single block, the most urgent one first. See OutputLaneType.
+	class OutputLane {
+	public:
+		QByteArray buffer;
+		int queueLimit;
+		int exemptBytes; // queued bytes that don't count against queueLimit
+		int maxQueued;
+		quint64 messages, batches, dropped;
+		OutputLane() : queueLimit(0), exemptBytes(0), maxQueued(0), messages(0), batches(0), dropped(0) { }
+	};
+	mutable QMutex outputBufferMutex;
+	OutputLane outputLanes[OutputLaneCount];
+	bool flushPending;
+	bool outputOverflow;
+	
+	QByteArray inputBuffer;
 	bool messageInProgress;
 	int messageLength;
 	
+	// Rooms the peer has users in. Until the peer tells us, it gets all room events.
+	mutable QMutex peerRoomInterestMutex;
+	QSet<int> peerRoomInterest;
+	bool peerRoomInterestKnown;
+	
+	// State received from the peer; see IslStateLog.
+	IslPeerState peerState;
+	bool registered;
+	// Logged messages are held back until the peer has been brought up to date.
+	QMutex syncMutex;
+	bool peerSynced;
+	bool syncRequestReceived;
+	
+	mutable QMutex statisticsMutex;
+	quint64 txMessages, txBytes, rxMessages, rxBytes, suppressedMessages;
+	
 	void sessionEvent_ServerCompleteList(const Event_ServerCompleteList &event);
+	void sessionEvent_ServerSnapshot(const Event_ServerCompleteList &event, const IslSyncState &syncState);
 	void sessionEvent_UserJoined(const Event_UserJoined &event);
 	void sessionEvent_UserLeft(const Event_UserLeft &event);
 	
@@ -71,7 +121,17 @@ private:
 	void processSessionEvent(const SessionEvent &event, qint64 sessionId);
 	void processRoomEvent(const RoomEvent &event);
 	void processRoomCommand(const CommandContainer &cont, qint64 sessionId);
+	void processRoomInterest(const IslMessage &item);
+	void processSyncRequest(const IslSyncState &request);
+	void getServerList(Event_ServerCompleteList &event) const;
+	bool acceptSyncSequence(const IslMessage &item);
+	void processRoomGameList(const RoomEvent &event);
+	void sendRoomGameList(int roomId);
 	
+	static int getOutputLane(const IslMessage &item);
+	// Size of the whole messages at the start of buffer that fit into maxBytes.
+	static int getMessageBoundary(const QByteArray &buffer, int maxBytes);
+	static bool isExemptFromQueueLimit(const IslMessage &item);
 	void processMessage(const IslMessage &item);
 	void sharedCtor(const QSslCertificate &cert, const QSslKey &privateKey);
 public slots:
@@ -82,7 +142,13 @@ public:
 	IslInterface(int _serverId, const QString &peerHostName, const QString &peerAddress, int peerPort, const QSslCertificate &peerCert, const QSslCertificate &cert, const QSslKey &privateKey, Servatrice *_server);
 	~IslInterface();
 	
-	void transmitMessage(const IslMessage &item);
+	// Returns false if the message was dropped because the connection is overloaded.
+	bool transmitMessage(const IslMessage &item);
+	void transmitLoggedMessage(const IslMessage &item);
+	void sendSyncRequest();
+	bool isInterestedInRoom(int roomId) const;
+	void messageSuppressed();
+	QString getStatistics() const;
 };
 
 #endif
@@ -0,0 +1,47 @@
+#include "isl_state_log.h"
+
+IslStateLog::IslStateLog()
+	: epoch(QDateTime::currentMSecsSinceEpoch()), maxEntries(1000)
+{
+}
+
+void IslStateLog::setMaxEntries(int _maxEntries)
+{
+	QMutexLocker locker(&mutex);
+	maxEntries = _maxEntries;
+}
+
+void IslStateLog::append(int stream, IslMessage &message)
+{
+	QMutexLocker locker(&mutex);
+	Stream &s = streams[stream];
+	message.set_sync_sequence(++s.sequence);
+	
+	s.entries.append(message);
+	while (s.entries.size() > maxEntries)
+		s.entries.removeFirst();
+}
+
+quint64 IslStateLog::getSequence(int stream) const
+{
+	QMutexLocker locker(&mutex);
+	return streams.value(stream).sequence;
+}
+
+bool IslStateLog::getEntriesSince(int stream, quint64 sequence, QList<IslMessage> &result) const
+{
+	QMutexLocker locker(&mutex);
+	QMap<int, Stream>::const_iterator it = streams.find(stream);
+	if (it == streams.end())
+		return sequence == 0;
+	
+	const Stream &s = it.value();
+	if (sequence > s.sequence)
+		return false;
+	const quint64 firstSequence = s.sequence - s.entries.size() + 1;
+	if (sequence + 1 < firstSequence)
+		return false;
+	for (int i = sequence + 1 - firstSequence; i < s.entries.size(); ++i)
+		result.append(s.entries[i]);
+	return true;
+}
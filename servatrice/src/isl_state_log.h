@@ -0,0 +1,47 @@
+#ifndef ISL_STATE_LOG_H
+#define ISL_STATE_LOG_H
+
+#include <QMap>
+#include <QList>
+#include <QMutex>
+#include <QDateTime>
+#include "pb/isl_message.pb.h"
+
+// Recent changes of the local user directory and of every room, as they were
+// sent to the ISL peers. Each of these streams has its own sequence numbers, so a
+// peer that lost its connection only needs the changes after the last sequence
+// number it has seen. The epoch changes with every server start.
+class IslStateLog {
+public:
+	static const int userDirectoryStream = -1;
+private:
+	class Stream {
+	public:
+		quint64 sequence;
+		QList<IslMessage> entries;
+		Stream() : sequence(0) { }
+	};
+	mutable QMutex mutex;
+	quint64 epoch;
+	int maxEntries;
+	QMap<int, Stream> streams;
+public:
+	IslStateLog();
+	quint64 getEpoch() const { return epoch; }
+	void setMaxEntries(int _maxEntries);
+	void append(int stream, IslMessage &message);
+	quint64 getSequence(int stream) const;
+	bool getEntriesSince(int stream, quint64 sequence, QList<IslMessage> &result) const;
+};
+
+// What we have received from a peer, kept while it is disconnected.
+class IslPeerState {
+public:
+	quint64 epoch;
+	quint64 userSequence;
+	QMap<int, quint64> roomSequences;
+	QDateTime disconnectTime;
+	IslPeerState() : epoch(0), userSequence(0) { }
+};
+
+#endif
@@ -24,9 +24,11 @@
 #include <QMetaType>
 #include <QSettings>
 #include <QDateTime>
+#include <QThread>
 #include "passwordhasher.h"
 #include "servatrice.h"
 #include "server_logger.h"
+#include "server_traffic_capture.h"
 #include "rng_sfmt.h"
 #include "version_string.h"
 #ifdef Q_OS_UNIX
@@ -36,22 +38,52 @@
 RNG_Abstract *rng;
 ServerLogger *logger;
 QThread *loggerThread;
+ServerTrafficCapture *trafficCapture;
+QThread *trafficCaptureThread;
 
-void testRNG()
+// Critical values of the chi-squared distribution for p = 0.001 and 1 to 9 degrees of freedom.
+static const double chisqCritical[] = { 10.828, 13.816, 16.266, 18.467, 20.515, 22.458, 24.322, 26.124, 27.877 };
+
+// Draws numbers from the calling thread's stream of the RNG.
+class RNGTestThread : public QThread {
+private:
+	int n, min, minMax, maxMax;
+public:
+	QVector<QVector<int> > numbers;
+	QVector<double> chisq;
+	QList<unsigned int> firstNumbers;
+	RNGTestThread(int _n, int _min, int _minMax, int _maxMax)
+		: n(_n), min(_min), minMax(_minMax), maxMax(_maxMax), numbers(_maxMax - _minMax + 1), chisq(_maxMax - _minMax + 1) { }
+protected:
+	void run()
+	{
+		for (int i = 0; i < 8; ++i)
+			firstNumbers.append(rng->rand(0, 1000000000));
+		for (int max = minMax; max <= maxMax; ++max) {
+			numbers[max - minMax] = rng->makeNumbersVector(n * (max - min + 1), min, max);
+			chisq[max - minMax] = rng->testRandom(numbers[max - minMax]);
+		}
+	}
+};
+
+void testRNG(int threadCount)
 {
 	const int n = 500000;
-	std::cerr << "Testing random number generator (n = " << n << " * bins)..." << std::endl;
+	std::cerr << "Testing random number generator (n = " << n << " * bins) on " << threadCount << " threads..." << std::endl;
 	
 	const int min = 1;
 	const int minMax = 2;
 	const int maxMax = 10;
 	
-	QVector<QVector<int> > numbers(maxMax - minMax + 1);
-	QVector<double> chisq(maxMax - minMax + 1);
-	for (int max = minMax; max <= maxMax; ++max) {
-		numbers[max - minMax] = rng->makeNumbersVector(n * (max - min + 1), min, max);
-		chisq[max - minMax] = rng->testRandom(numbers[max - minMax]);
+	QList<RNGTestThread *> threads;
+	for (int i = 0; i < threadCount; ++i) {
+		threads.append(new RNGTestThread(n, min, minMax, maxMax));
+		threads.last()->start();
 	}
+	for (int i = 0; i < threadCount; ++i)
+		threads[i]->wait();
+	
+	const QVector<QVector<int> > &numbers = threads.first()->numbers;
 	for (int i = 0; i <= maxMax - min; ++i) {
 		std::cerr << (min + i);
 		for (int j = 0; j < numbers.size(); ++j) {
@@ -62,13 +94,31 @@ void testRNG()
 		}
 		std::cerr << std::endl;
 	}
-	std::cerr << std::endl << "Chi^2 =";
-	for (int j = 0; j < chisq.size(); ++j)
-		std::cerr << "\t" << QString::number(chisq[j], 'f', 3).toStdString();
 	std::cerr << std::endl << "k =";
-	for (int j = 0; j < chisq.size(); ++j)
+	for (int j = 0; j < numbers.size(); ++j)
 		std::cerr << "\t" << (j - min + minMax);
-	std::cerr << std::endl << std::endl;
+	std::cerr << std::endl;
+	
+	int failures = 0;
+	for (int i = 0; i < threadCount; ++i) {
+		const QVector<double> &chisq = threads[i]->chisq;
+		std::cerr << "Chi^2 #" << i;
+		for (int j = 0; j < chisq.size(); ++j) {
+			const bool failed = chisq[j] > chisqCritical[j + minMax - min - 1];
+			if (failed)
+				++failures;
+			std::cerr << "\t" << QString::number(chisq[j], 'f', 3).toStdString() << (failed ? "!" : "");
+		}
+		std::cerr << std::endl;
+		
+		for (int j = 0; j < i; ++j)
+			if (threads[j]->firstNumbers == threads[i]->firstNumbers) {
+				std::cerr << "Threads " << j << " and " << i << " use the same random stream" << std::endl;
+				++failures;
+			}
+	}
+	std::cerr << std::endl << failures << " of " << threadCount * numbers.size() << " tests failed (p = 0.001, marked with !)" << std::endl << std::endl;
+	qDeleteAll(threads);
 }
 
 void testHash()
@@ -134,6 +184,18 @@ int main(int argc, char *argv[])
 	loggerThread->start();
 	QMetaObject::invokeMethod(logger, "startLog", Qt::BlockingQueuedConnection, Q_ARG(QString, settings->value("server/logfile").toString()));
 	
+	trafficCaptureThread = new QThread;
+	trafficCaptureThread->setObjectName("traffic_capture");
+	trafficCapture = new ServerTrafficCapture;
+	trafficCapture->moveToThread(trafficCaptureThread);
+	
+	trafficCaptureThread->start();
+	if (settings->value("capture/active", 0).toInt())
+		QMetaObject::invokeMethod(trafficCapture, "startCapture", Qt::BlockingQueuedConnection,
+		                          Q_ARG(QString, settings->value("capture/file", "capture.bin").toString()),
+		                          Q_ARG(qint64, (qint64) settings->value("capture/max_file_size", 100).toInt() * 1024 * 1024),
+		                          Q_ARG(int, settings->value("capture/max_files", 5).toInt()));
+	
 	if (logToConsole)
 		qInstallMsgHandler(myMessageOutput);
 	else
@@ -163,7 +225,7 @@ int main(int argc, char *argv[])
 	PasswordHasher::initialize();
 	
 	if (testRandom)
-		testRNG();
+		testRNG(qMax(settings->value("server/number_pools", 1).toInt() + 1, QThread::idealThreadCount()));
 	if (testHashFunction)
 		testHash();
 	
@@ -184,6 +246,10 @@ int main(int argc, char *argv[])
 	delete rng;
 	delete settings;
 	
+	trafficCapture->deleteLater();
+	trafficCaptureThread->wait();
+	delete trafficCaptureThread;
+	
 	logger->deleteLater();
 	loggerThread->wait();
 	delete loggerThread;
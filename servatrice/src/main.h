@@ -3,5 +3,7 @@
 
 class ServerLogger;
 extern ServerLogger *logger;
+class ServerTrafficCapture;
+extern ServerTrafficCapture *trafficCapture;
 
 #endif
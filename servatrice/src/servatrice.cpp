@@ -18,8 +18,10 @@
  *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
  ***************************************************************************/
 #include <QSqlQuery>
+#include <QSqlRecord>
 #include <QSettings>
 #include <QFile>
+#include <QDir>
 #include <QTimer>
 #include <QDateTime>
 #include <QDebug>
@@ -33,9 +35,14 @@
 #include "server_logger.h"
 #include "main.h"
 #include "decklist.h"
+#include "get_pb_extension.h"
 #include "pb/event_server_message.pb.h"
 #include "pb/event_server_shutdown.pb.h"
+#include "pb/event_game_migrated.pb.h"
+#include "pb/game_snapshot.pb.h"
 #include "pb/event_connection_closed.pb.h"
+#include "pb/isl_message.pb.h"
+#include "pb/serverinfo_room.pb.h"
 
 Servatrice_GameServer::Servatrice_GameServer(Servatrice *_server, int _numberPools, const QSqlDatabase &_sqlDatabase, QObject *parent)
 	: QTcpServer(parent),
@@ -117,7 +124,7 @@ void Servatrice_IslServer::incomingConnection(int socketDescriptor)
 }
 
 Servatrice::Servatrice(QSettings *_settings, QObject *parent)
-	: Server(true, parent), settings(_settings), uptime(0), shutdownTimer(0)
+	: Server(true, parent), settings(_settings), uptime(0), uptimeHasHibernationColumns(-1), logDeckCacheStatistics(false), shutdownTimer(0), islPurgeClock(0), islResyncGracePeriod(0), islMigrateGamesOnShutdown(false)
 {
 	qRegisterMetaType<QSqlDatabase>("QSqlDatabase");
 }
@@ -216,14 +223,59 @@ bool Servatrice::initServer()
 	
 	updateLoginMessage();
 	
+	// Peers only get chat and game list updates of rooms they have users in.
+	QMapIterator<int, Server_Room *> roomIterator(rooms);
+	while (roomIterator.hasNext())
+		connect(roomIterator.next().value(), SIGNAL(roomInfoChanged(ServerInfo_Room)), this, SLOT(updateIslRoomInterest()), Qt::QueuedConnection);
+	
 	maxGameInactivityTime = settings->value("game/max_game_inactivity_time").toInt();
 	maxPlayerInactivityTime = settings->value("game/max_player_inactivity_time").toInt();
+	gameHibernationTime = settings->value("game/hibernation_time", 0).toInt();
+	gameHibernationPath = settings->value("game/hibernation_path", "hibernated_games").toString();
+	if (gameHibernationTime > 0) {
+		if (QDir().mkpath(gameHibernationPath))
+			qDebug() << "Hibernating idle games after" << gameHibernationTime << "seconds in" << gameHibernationPath;
+		else {
+			qDebug() << "Could not create hibernation path" << gameHibernationPath << "- hibernation disabled";
+			gameHibernationTime = 0;
+		}
+	}
+	getDeckCache()->setCapacity(settings->value("game/deck_cache_size", 1000).toInt());
+	getDeckCache()->setMaxMemoryUsage(settings->value("game/deck_cache_memory", 64).toLongLong() * 1048576);
+	logDeckCacheStatistics = settings->value("game/deck_cache_statistics", 0).toInt();
+	gameListUpdateInterval = qBound(0, settings->value("game/game_list_update_interval", 200).toInt(), 1000);
 	
 	maxUsersPerAddress = settings->value("security/max_users_per_address").toInt();
-	messageCountingInterval = settings->value("security/message_counting_interval").toInt();
-	maxMessageCountPerInterval = settings->value("security/max_message_count_per_interval").toInt();
-	maxMessageSizePerInterval = settings->value("security/max_message_size_per_interval").toInt();
 	maxGamesPerUser = settings->value("security/max_games_per_user").toInt();
+	
+	static const char *rateLimitNames[Server_RateLimiter::CategoryCount] = { "game_command", "room_chat", "room_chat_size", "private_message", "deck_storage", "replay_download" };
+	for (int i = 0; i < Server_RateLimiter::CategoryCount; ++i) {
+		// Without a burst of at least one second's worth, a bucket would never hold enough tokens.
+		const double rate = settings->value(QString("security/%1_rate").arg(rateLimitNames[i])).toDouble();
+		const double burst = settings->value(QString("security/%1_burst").arg(rateLimitNames[i]), rate).toDouble();
+		rateLimits[i] = Server_RateLimit(rate, qMax(burst, qMax(rate, 1.0)));
+	}
+	
+	// Configurations from before the token buckets limit chat with a message count and size
+	// per counting interval. They keep their flood protection until they set the new keys.
+	const int messageCountingInterval = settings->value("security/message_counting_interval").toInt();
+	if (messageCountingInterval > 0) {
+		const double maxMessageCount = settings->value("security/max_message_count_per_interval").toDouble();
+		const double maxMessageSize = settings->value("security/max_message_size_per_interval").toDouble();
+		if (!settings->contains("security/room_chat_rate") && (maxMessageCount > 0)) {
+			rateLimits[Server_RateLimiter::RoomChat] = Server_RateLimit(maxMessageCount / messageCountingInterval, maxMessageCount);
+			qDebug() << "security/room_chat_rate not set, using max_message_count_per_interval";
+		}
+		if (!settings->contains("security/private_message_rate") && (maxMessageCount > 0)) {
+			rateLimits[Server_RateLimiter::PrivateMessages] = Server_RateLimit(maxMessageCount / messageCountingInterval, maxMessageCount);
+			qDebug() << "security/private_message_rate not set, using max_message_count_per_interval";
+		}
+		if (!settings->contains("security/room_chat_size_rate") && (maxMessageSize > 0)) {
+			rateLimits[Server_RateLimiter::RoomChatSize] = Server_RateLimit(maxMessageSize / messageCountingInterval, maxMessageSize);
+			qDebug() << "security/room_chat_size_rate not set, using max_message_size_per_interval";
+		}
+	}
+	addressRateLimitFactor = settings->value("security/address_rate_limit_factor").toInt();
 
 	try { if (settings->value("servernetwork/active", 0).toInt()) {
 		qDebug() << "Connecting to ISL network.";
@@ -244,6 +296,18 @@ bool Servatrice::initServer()
 		if (key.isNull())
 			throw QString("Invalid private key.");
 		
+		islResyncGracePeriod = settings->value("servernetwork/resync_grace_period", 60).toInt();
+		islStateLog.setMaxEntries(settings->value("servernetwork/resync_log_size", 1000).toInt());
+		// In the order of IslInterface::OutputLaneType
+		islQueueLimits.append(settings->value("servernetwork/membership_queue_limit", 0).toInt());
+		islQueueLimits.append(settings->value("servernetwork/interactive_queue_limit", 0).toInt());
+		islQueueLimits.append(settings->value("servernetwork/lobby_queue_limit", 16777216).toInt());
+		islQueueLimits.append(settings->value("servernetwork/chat_queue_limit", 1048576).toInt());
+		islMigrateGamesOnShutdown = settings->value("servernetwork/migrate_games_on_shutdown", 0).toInt();
+		islPurgeClock = new QTimer(this);
+		connect(islPurgeClock, SIGNAL(timeout()), this, SLOT(purgeDisconnectedIslPeers()));
+		islPurgeClock->start(5000);
+		
 		QMutableListIterator<ServerProperties> serverIterator(serverList);
 		while (serverIterator.hasNext()) {
 			const ServerProperties &prop = serverIterator.next();
@@ -279,6 +343,7 @@ bool Servatrice::initServer()
 	
 	pingClock = new QTimer(this);
 	connect(pingClock, SIGNAL(timeout()), this, SIGNAL(pingClockTimeout()));
+	connect(pingClock, SIGNAL(timeout()), this, SLOT(expireGameMigrations()));
 	pingClock->start(1000);
 	
 	int statusUpdateTime = settings->value("server/statusupdate").toInt();
@@ -384,11 +449,35 @@ void Servatrice::updateLoginMessage()
 
 void Servatrice::statusUpdate()
 {
+	islLock.lockForRead();
+	QMapIterator<int, IslInterface *> islIterator(islInterfaces);
+	while (islIterator.hasNext()) {
+		islIterator.next();
+		logger->logMessage(QString("[ISL] peer #%1: %2").arg(islIterator.key()).arg(islIterator.value()->getStatistics()));
+	}
+	islLock.unlock();
+	
+	const int gc = getGamesCount(); // resident games
+	const int hgc = getHibernatedGamesCount();
+	const GameHibernationStatistics hibernationStatistics = takeGameHibernationStatistics();
+	if (gameHibernationTime > 0)
+		logger->logMessage(QString("[Games] %1 resident, %2 hibernated; %3 hibernations (avg. %4 ms), %5 rehydrations (avg. %6 ms)")
+			.arg(gc)
+			.arg(hgc)
+			.arg(hibernationStatistics.hibernations)
+			.arg(hibernationStatistics.getAverageHibernationUsecs() / 1000.0, 0, 'f', 1)
+			.arg(hibernationStatistics.rehydrations)
+			.arg(hibernationStatistics.getAverageRehydrationUsecs() / 1000.0, 0, 'f', 1));
+	
+	if (logDeckCacheStatistics) {
+		Server_DeckCache *deckCache = getDeckCache();
+		logger->logMessage(QString("[Decks] cache: %1 decks, %2 kB, %3 hits, %4 misses").arg(deckCache->getSize()).arg(deckCache->getMemoryUsage() / 1024).arg(deckCache->getHits()).arg(deckCache->getMisses()));
+	}
+	
 	if (!servatriceDatabaseInterface->checkSql())
 		return;
 	
 	const int uc = getUsersCount(); // for correct mutex locking order
-	const int gc = getGamesCount();
 	
 	uptime += statusUpdateClock->interval() / 1000;
 	
@@ -401,8 +490,23 @@ void Servatrice::statusUpdate()
 	rxBytes = 0;
 	rxBytesMutex.unlock();
 	
+	// Databases set up before the hibernation columns were added to servatrice.sql keep working without them.
+	if (uptimeHasHibernationColumns == -1) {
+		uptimeHasHibernationColumns = servatriceDatabaseInterface->getDatabase().record(dbPrefix + "_uptime").contains("hibernations");
+		if (!uptimeHasHibernationColumns)
+			qDebug() << "Table" << dbPrefix + "_uptime" << "has no hibernation columns, see servatrice.sql; hibernation statistics are not stored";
+	}
+	
 	QSqlQuery query(servatriceDatabaseInterface->getDatabase());
-	query.prepare("insert into " + dbPrefix + "_uptime (id_server, timest, uptime, users_count, games_count, tx_bytes, rx_bytes) values(:id, NOW(), :uptime, :users_count, :games_count, :tx, :rx)");
+	if (uptimeHasHibernationColumns) {
+		query.prepare("insert into " + dbPrefix + "_uptime (id_server, timest, uptime, users_count, games_count, hibernated_games_count, hibernations, hibernation_usecs, rehydrations, rehydration_usecs, tx_bytes, rx_bytes) values(:id, NOW(), :uptime, :users_count, :games_count, :hibernated_games_count, :hibernations, :hibernation_usecs, :rehydrations, :rehydration_usecs, :tx, :rx)");
+		query.bindValue(":hibernated_games_count", hgc);
+		query.bindValue(":hibernations", hibernationStatistics.hibernations);
+		query.bindValue(":hibernation_usecs", hibernationStatistics.getAverageHibernationUsecs());
+		query.bindValue(":rehydrations", hibernationStatistics.rehydrations);
+		query.bindValue(":rehydration_usecs", hibernationStatistics.getAverageRehydrationUsecs());
+	} else
+		query.prepare("insert into " + dbPrefix + "_uptime (id_server, timest, uptime, users_count, games_count, tx_bytes, rx_bytes) values(:id, NOW(), :uptime, :users_count, :games_count, :tx, :rx)");
 	query.bindValue(":id", serverId);
 	query.bindValue(":uptime", uptime);
 	query.bindValue(":users_count", uc);
@@ -424,6 +528,95 @@ void Servatrice::scheduleShutdown(const QString &reason, int minutes)
 	shutdownTimeout();
 }
 
+void Servatrice::migrateGames()
+{
+	QMap<int, int> peerGameCounts;
+	islLock.lockForRead();
+	QMapIterator<int, IslInterface *> islIterator(islInterfaces);
+	while (islIterator.hasNext())
+		peerGameCounts.insert(islIterator.next().key(), 0);
+	islLock.unlock();
+	
+	QList<QPair<int, int> > localGames; // (roomId, gameId)
+	roomsLock.lockForRead();
+	QMapIterator<int, Server_Room *> roomIterator(rooms);
+	while (roomIterator.hasNext()) {
+		Server_Room *room = roomIterator.next().value();
+		QReadLocker roomGamesLocker(&room->gamesLock);
+		QMapIterator<int, ServerInfo_Game> externalGameIterator(room->getExternalGames());
+		while (externalGameIterator.hasNext()) {
+			const int peerId = externalGameIterator.next().value().server_id();
+			if (peerGameCounts.contains(peerId))
+				++peerGameCounts[peerId];
+		}
+		QList<int> gameIds = room->getGames().keys() + room->getHibernatedGames().keys();
+		for (int i = 0; i < gameIds.size(); ++i)
+			localGames.append(QPair<int, int>(room->getId(), gameIds[i]));
+	}
+	roomsLock.unlock();
+	if (localGames.isEmpty())
+		return;
+	if (peerGameCounts.isEmpty()) {
+		logger->logMessage(QString("[ISL] no peers to migrate %1 games to").arg(localGames.size()));
+		return;
+	}
+	
+	int migrated = 0;
+	for (int i = 0; i < localGames.size(); ++i) {
+		QMapIterator<int, int> peerIterator(peerGameCounts);
+		int peerId = peerIterator.peekNext().key();
+		while (peerIterator.hasNext())
+			if (peerIterator.next().value() < peerGameCounts.value(peerId))
+				peerId = peerIterator.key();
+		
+		if (migrateGame(localGames[i].first, localGames[i].second, peerId)) {
+			++peerGameCounts[peerId];
+			++migrated;
+		}
+	}
+	logger->logMessage(QString("[ISL] sent %1 of %2 games to peers").arg(migrated).arg(localGames.size()));
+}
+
+bool Servatrice::migrateGame(int roomId, int gameId, int serverId)
+{
+	IslMessage msg;
+	msg.set_message_type(IslMessage::GAME_MIGRATION);
+	GameSnapshot *snapshot = msg.mutable_game_snapshot();
+	
+	roomsLock.lockForRead();
+	Server_Room *room = rooms.value(roomId);
+	bool sent = room && room->migrateGame(gameId, serverId, *snapshot);
+	if (sent) {
+		islLock.lockForRead();
+		IslInterface *interface = islInterfaces.value(serverId);
+		sent = interface && interface->transmitMessage(msg);
+		islLock.unlock();
+		if (!sent)
+			logger->logMessage(QString("[ISL] could not migrate game %1 to #%2").arg(gameId).arg(serverId));
+	}
+	roomsLock.unlock();
+	if (!sent) {
+		// A game that was taken out of its room already comes back.
+		if (snapshot->has_game_info())
+			adoptGame(*snapshot);
+		return false;
+	}
+	
+	addPendingGameMigration(*snapshot, serverId);
+	return true;
+}
+
+void Servatrice::getGameMigrationTarget(int serverId, Event_GameMigrated &event) const
+{
+	const QList<ServerProperties> peers = getServerList();
+	for (int i = 0; i < peers.size(); ++i)
+		if (peers[i].id == serverId) {
+			event.set_server_name(peers[i].hostname.toStdString());
+			event.set_host(peers[i].address.toString().toStdString());
+			event.set_port(peers[i].gamePort);
+		}
+}
+
 void Servatrice::incTxBytes(quint64 num)
 {
 	txBytesMutex.lock();
@@ -442,6 +635,10 @@ void Servatrice::shutdownTimeout()
 {
 	--shutdownMinutes;
 	
+	// Games created since the last round are moved as well.
+	if (islMigrateGamesOnShutdown)
+		migrateGames();
+	
 	SessionEvent *se;
 	if (shutdownMinutes) {
 		Event_ServerShutdown event;
@@ -482,10 +679,18 @@ void Servatrice::addIslInterface(int serverId, IslInterface *interface)
 	connect(interface, SIGNAL(externalRoomUserLeft(int, QString)), this, SLOT(externalRoomUserLeft(int, QString)));
 	connect(interface, SIGNAL(externalRoomSay(int, QString, QString)), this, SLOT(externalRoomSay(int, QString, QString)));
 	connect(interface, SIGNAL(externalRoomGameListChanged(int, ServerInfo_Game)), this, SLOT(externalRoomGameListChanged(int, ServerInfo_Game)));
+	connect(interface, SIGNAL(externalRoomGameListReplaced(int, ServerInfo_Room)), this, SLOT(externalRoomGameListReplaced(int, ServerInfo_Room)));
 	connect(interface, SIGNAL(joinGameCommandReceived(Command_JoinGame, int, int, int, qint64)), this, SLOT(externalJoinGameCommandReceived(Command_JoinGame, int, int, int, qint64)));
 	connect(interface, SIGNAL(gameCommandContainerReceived(CommandContainer, int, int, qint64)), this, SLOT(externalGameCommandContainerReceived(CommandContainer, int, int, qint64)));
 	connect(interface, SIGNAL(responseReceived(Response, qint64)), this, SLOT(externalResponseReceived(Response, qint64)));
 	connect(interface, SIGNAL(gameEventContainerReceived(GameEventContainer, qint64)), this, SLOT(externalGameEventContainerReceived(GameEventContainer, qint64)));
+	connect(interface, SIGNAL(gameMigrationReceived(GameSnapshot, int)), this, SLOT(externalGameMigrationReceived(GameSnapshot, int)));
+	connect(interface, SIGNAL(gameMigrationResultReceived(int, bool, int)), this, SLOT(gameMigrationResultReceived(int, bool, int)));
+	connect(interface, SIGNAL(externalServerUsersReset(int)), this, SLOT(purgeIslUsers(int)));
+	connect(interface, SIGNAL(externalServerRoomReset(int, int)), this, SLOT(purgeIslRoom(int, int)));
+	
+	sendIslRoomInterest(interface);
+	interface->sendSyncRequest();
 }
 
 void Servatrice::removeIslInterface(int serverId)
@@ -496,14 +701,171 @@ void Servatrice::removeIslInterface(int serverId)
 	islInterfaces.remove(serverId);
 }
 
+void Servatrice::sendIslRoomInterest(IslInterface *interface)
+{
+	// Only call with islLock locked
+	
+	IslMessage msg;
+	msg.set_message_type(IslMessage::ROOM_INTEREST);
+	QSetIterator<int> roomIterator(islRoomInterest);
+	while (roomIterator.hasNext())
+		msg.add_room_interest(roomIterator.next());
+	
+	if (interface)
+		interface->transmitMessage(msg);
+	else {
+		QMapIterator<int, IslInterface *> islIterator(islInterfaces);
+		while (islIterator.hasNext())
+			islIterator.next().value()->transmitMessage(msg);
+	}
+}
+
+void Servatrice::updateIslRoomInterest()
+{
+	QSet<int> newInterest;
+	roomsLock.lockForRead();
+	QMapIterator<int, Server_Room *> roomIterator(rooms);
+	while (roomIterator.hasNext()) {
+		Server_Room *room = roomIterator.next().value();
+		if (room->getLocalUserCount())
+			newInterest.insert(room->getId());
+	}
+	roomsLock.unlock();
+	
+	QWriteLocker locker(&islLock);
+	if (newInterest == islRoomInterest)
+		return;
+	islRoomInterest = newInterest;
+	sendIslRoomInterest(0);
+}
+
+IslPeerState Servatrice::takeIslPeerState(int serverId)
+{
+	QMutexLocker locker(&islPeerStatesMutex);
+	return islPeerStates.take(serverId);
+}
+
+void Servatrice::storeIslPeerState(int serverId, const IslPeerState &peerState)
+{
+	QMutexLocker locker(&islPeerStatesMutex);
+	IslPeerState &stored = islPeerStates[serverId];
+	stored = peerState;
+	stored.disconnectTime = QDateTime::currentDateTime();
+}
+
+void Servatrice::purgeDisconnectedIslPeers()
+{
+	// Users of peers that did not come back in time are removed.
+	QList<int> expiredServerIds;
+	const QDateTime now = QDateTime::currentDateTime();
+	islPeerStatesMutex.lock();
+	QMutableMapIterator<int, IslPeerState> peerStateIterator(islPeerStates);
+	while (peerStateIterator.hasNext()) {
+		peerStateIterator.next();
+		if (peerStateIterator.value().disconnectTime.secsTo(now) >= islResyncGracePeriod) {
+			expiredServerIds.append(peerStateIterator.key());
+			peerStateIterator.remove();
+		}
+	}
+	islPeerStatesMutex.unlock();
+	
+	for (int i = 0; i < expiredServerIds.size(); ++i) {
+		logger->logMessage(QString("[ISL] peer #%1 did not reconnect, removing its users").arg(expiredServerIds[i]));
+		
+		roomsLock.lockForRead();
+		const QList<int> roomIds = rooms.keys();
+		roomsLock.unlock();
+		for (int j = 0; j < roomIds.size(); ++j)
+			purgeIslRoom(expiredServerIds[i], roomIds[j]);
+		purgeIslUsers(expiredServerIds[i]);
+	}
+}
+
+void Servatrice::purgeIslUsers(int serverId)
+{
+	// This function is always called from the main thread via signal/slot.
+	QStringList userNames;
+	clientsLock.lockForRead();
+	QMapIterator<QString, Server_AbstractUserInterface *> extUsers(externalUsers);
+	while (extUsers.hasNext()) {
+		extUsers.next();
+		if (extUsers.value()->getUserInfo()->server_id() == serverId)
+			userNames.append(extUsers.key());
+	}
+	clientsLock.unlock();
+	
+	for (int i = 0; i < userNames.size(); ++i)
+		externalUserLeft(userNames[i]);
+}
+
+void Servatrice::purgeIslRoom(int serverId, int roomId)
+{
+	// This function is always called from the main thread via signal/slot.
+	QStringList userNames;
+	roomsLock.lockForRead();
+	Server_Room *room = rooms.value(roomId);
+	if (room) {
+		room->usersLock.lockForRead();
+		QMapIterator<QString, ServerInfo_User_Container> roomUsers(room->getExternalUsers());
+		while (roomUsers.hasNext()) {
+			roomUsers.next();
+			if (roomUsers.value().getUserInfo()->server_id() == serverId)
+				userNames.append(roomUsers.key());
+		}
+		room->usersLock.unlock();
+	}
+	roomsLock.unlock();
+	
+	for (int i = 0; i < userNames.size(); ++i)
+		externalRoomUserLeft(roomId, userNames[i]);
+	
+	ServerInfo_Room emptyRoom;
+	emptyRoom.set_room_id(roomId);
+	externalRoomGameListReplaced(serverId, emptyRoom);
+}
+
 void Servatrice::doSendIslMessage(const IslMessage &msg, int serverId)
 {
 	QReadLocker locker(&islLock);
 	
 	if (serverId == -1) {
+		// Room chat and game list updates only go to peers with users in that room.
+		// Game events are not broadcast at all, they go to the servers of the participants.
+		int roomId = -1;
+		// Changes of the user directory and of the rooms are logged, so that peers
+		// can catch up after a reconnection.
+		int logStream = -2;
+		if (msg.message_type() == IslMessage::ROOM_EVENT) {
+			const int eventType = getPbExtension(msg.room_event());
+			if ((eventType == RoomEvent::ROOM_SAY) || (eventType == RoomEvent::LIST_GAMES))
+				roomId = msg.room_event().room_id();
+			if ((eventType == RoomEvent::JOIN_ROOM) || (eventType == RoomEvent::LEAVE_ROOM) || (eventType == RoomEvent::LIST_GAMES))
+				logStream = msg.room_event().room_id();
+		} else if (msg.message_type() == IslMessage::SESSION_EVENT) {
+			const int eventType = getPbExtension(msg.session_event());
+			if ((eventType == SessionEvent::USER_JOINED) || (eventType == SessionEvent::USER_LEFT))
+				logStream = IslStateLog::userDirectoryStream;
+		}
+		
+		// A peer drops logged messages that are not newer than the last one it has seen,
+		// so each one must be queued on every connection before the next is numbered.
+		QMutexLocker islLogLocker(logStream != -2 ? &islLogMutex : 0);
+		IslMessage loggedMsg;
+		if (logStream != -2) {
+			loggedMsg.CopyFrom(msg);
+			islStateLog.append(logStream, loggedMsg);
+		}
+		
 		QMapIterator<int, IslInterface *> islIterator(islInterfaces);
-		while (islIterator.hasNext())
-			islIterator.next().value()->transmitMessage(msg);
+		while (islIterator.hasNext()) {
+			IslInterface *interface = islIterator.next().value();
+			if ((roomId != -1) && !interface->isInterestedInRoom(roomId))
+				interface->messageSuppressed();
+			else if (logStream != -2)
+				interface->transmitLoggedMessage(loggedMsg);
+			else
+				interface->transmitMessage(msg);
+		}
 	} else {
 		IslInterface *interface = islInterfaces.value(serverId);
 		if (interface)
@@ -26,9 +26,11 @@
 #include <QSslKey>
 #include <QHostAddress>
 #include <QReadWriteLock>
+#include <QSet>
 #include <QSqlDatabase>
 #include <QMetaType>
 #include "server.h"
+#include "isl_state_log.h"
 
 Q_DECLARE_METATYPE(QSqlDatabase)
 
@@ -37,6 +39,7 @@ class QSqlQuery;
 class QTimer;
 
 class GameReplay;
+class GameSnapshot;
 class Servatrice;
 class Servatrice_ConnectionPool;
 class Servatrice_DatabaseInterface;
@@ -89,13 +92,18 @@ public:
 private slots:
 	void statusUpdate();
 	void shutdownTimeout();
+	void updateIslRoomInterest();
+	void purgeIslUsers(int serverId);
+	void purgeIslRoom(int serverId, int roomId);
+	void purgeDisconnectedIslPeers();
 protected:
 	void doSendIslMessage(const IslMessage &msg, int serverId);
+	void getGameMigrationTarget(int serverId, Event_GameMigrated &event) const;
 private:
 	enum DatabaseType { DatabaseNone, DatabaseMySql };
 	AuthenticationMethod authenticationMethod;
 	DatabaseType databaseType;
-	QTimer *pingClock, *statusUpdateClock;
+	QTimer *pingClock, *statusUpdateClock, *islPurgeClock;
 	Servatrice_GameServer *gameServer;
 	Servatrice_IslServer *islServer;
 	QString serverName;
@@ -106,10 +114,17 @@ private:
 	Servatrice_DatabaseInterface *servatriceDatabaseInterface;
 	int serverId;
 	int uptime;
+	int uptimeHasHibernationColumns; // -1 until the _uptime table was looked at
 	QMutex txBytesMutex, rxBytesMutex;
 	quint64 txBytes, rxBytes;
 	int maxGameInactivityTime, maxPlayerInactivityTime;
-	int maxUsersPerAddress, messageCountingInterval, maxMessageCountPerInterval, maxMessageSizePerInterval, maxGamesPerUser;
+	int gameHibernationTime;
+	QString gameHibernationPath;
+	bool logDeckCacheStatistics;
+	int gameListUpdateInterval;
+	int maxUsersPerAddress, maxGamesPerUser;
+	Server_RateLimit rateLimits[Server_RateLimiter::CategoryCount];
+	int addressRateLimitFactor;
 	
 	QString shutdownReason;
 	int shutdownMinutes;
@@ -120,8 +135,21 @@ private:
 	void updateServerList();
 	
 	QMap<int, IslInterface *> islInterfaces;
+	QSet<int> islRoomInterest;
+	void sendIslRoomInterest(IslInterface *interface);
+	
+	IslStateLog islStateLog;
+	QMutex islLogMutex; // held from numbering a logged message until it is queued, after islLock
+	QMap<int, IslPeerState> islPeerStates;
+	QMutex islPeerStatesMutex;
+	int islResyncGracePeriod;
+	QList<int> islQueueLimits;
+	bool islMigrateGamesOnShutdown;
+	bool migrateGame(int roomId, int gameId, int serverId);
 public slots:
 	void scheduleShutdown(const QString &reason, int minutes);
+	// Hands all local games to the connected peers, spreading them evenly.
+	void migrateGames();
 	void updateLoginMessage();
 public:
 	Servatrice(QSettings *_settings, QObject *parent = 0);
@@ -132,10 +160,12 @@ public:
 	bool getGameShouldPing() const { return true; }
 	int getMaxGameInactivityTime() const { return maxGameInactivityTime; }
 	int getMaxPlayerInactivityTime() const { return maxPlayerInactivityTime; }
+	int getGameHibernationTime() const { return gameHibernationTime; }
+	QString getGameHibernationPath() const { return gameHibernationPath; }
+	int getGameListUpdateInterval() const { return gameListUpdateInterval; }
 	int getMaxUsersPerAddress() const { return maxUsersPerAddress; }
-	int getMessageCountingInterval() const { return messageCountingInterval; }
-	int getMaxMessageCountPerInterval() const { return maxMessageCountPerInterval; }
-	int getMaxMessageSizePerInterval() const { return maxMessageSizePerInterval; }
+	const Server_RateLimit &getRateLimit(Server_RateLimiter::Category category) const { return rateLimits[category]; }
+	int getAddressRateLimitFactor() const { return addressRateLimitFactor; }
 	int getMaxGamesPerUser() const { return maxGamesPerUser; }
 	AuthenticationMethod getAuthenticationMethod() const { return authenticationMethod; }
 	QString getDbPrefix() const { return dbPrefix; }
@@ -150,6 +180,10 @@ public:
 	void addIslInterface(int serverId, IslInterface *interface);
 	void removeIslInterface(int serverId);
 	QReadWriteLock islLock;
+	IslStateLog *getIslStateLog() { return &islStateLog; }
+	int getIslQueueLimit(int lane) const { return islQueueLimits.value(lane); }
+	IslPeerState takeIslPeerState(int serverId);
+	void storeIslPeerState(int serverId, const IslPeerState &peerState);
 
 	QList<ServerProperties> getServerList() const;
 };
@@ -508,6 +508,15 @@ void Servatrice_DatabaseInterface::storeGameInformation(const QString &roomName,
 }
 
 DeckList *Servatrice_DatabaseInterface::getDeckFromDatabase(int deckId, int userId)
+{
+	const QString content = getDeckContentFromDatabase(deckId, userId);
+	DeckList *deck = new DeckList;
+	deck->loadFromString_Native(content);
+	
+	return deck;
+}
+
+QString Servatrice_DatabaseInterface::getDeckContentFromDatabase(int deckId, int userId)
 {
 	checkSql();
 	
@@ -520,8 +529,5 @@ DeckList *Servatrice_DatabaseInterface::getDeckFromDatabase(int deckId, int user
 	if (!query.next())
 		throw Response::RespNameNotFound;
 	
-	DeckList *deck = new DeckList;
-	deck->loadFromString_Native(query.value(0).toString());
-	
-	return deck;
+	return query.value(0).toString();
 }
@@ -39,6 +39,7 @@ public:
 	ServerInfo_User getUserData(const QString &name, bool withId = false);
 	void storeGameInformation(const QString &roomName, const QStringList &roomGameTypes, const ServerInfo_Game &gameInfo, const QSet<QString> &allPlayersEver, const QSet<QString> &allSpectatorsEver, const QList<GameReplay *> &replayList);
 	DeckList *getDeckFromDatabase(int deckId, int userId);
+	QString getDeckContentFromDatabase(int deckId, int userId);
 	
 	int getNextGameId();
 	int getNextReplayId();
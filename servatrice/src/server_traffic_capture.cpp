@@ -0,0 +1,157 @@
+#include "server_traffic_capture.h"
+#include "server_logger.h"
+#include "main.h"
+#include "pb/commands.pb.h"
+#include "pb/session_commands.pb.h"
+#include <QFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QThread>
+
+ServerTrafficCapture::ServerTrafficCapture(QObject *parent)
+	: QObject(parent), maxFileSize(0), maxFiles(0), captureFile(0), captureStream(0), flushRunning(false), droppedRecords(0), nextConnectionId(1)
+{
+}
+
+ServerTrafficCapture::~ServerTrafficCapture()
+{
+	if (captureFile) {
+		flushBuffer();
+		delete captureStream;
+		captureFile->close();
+	}
+	thread()->quit();
+}
+
+void ServerTrafficCapture::startCapture(const QString &_fileName, qint64 _maxFileSize, int _maxFiles)
+{
+	if (_fileName.isEmpty())
+		return;
+
+	fileName = _fileName;
+	maxFileSize = _maxFileSize;
+	maxFiles = _maxFiles;
+
+	// Every file starts with its own header, so an old capture is moved aside instead of appended to.
+	if (QFile::exists(fileName))
+		rotateFiles();
+	openFile();
+
+	connect(this, SIGNAL(sigFlushBuffer()), this, SLOT(flushBuffer()), Qt::QueuedConnection);
+}
+
+void ServerTrafficCapture::openFile()
+{
+	if (!captureFile)
+		captureFile = new QFile(fileName, this);
+	else
+		captureFile->setFileName(fileName);
+	if (!captureFile->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		logger->logMessage(QString("Could not open traffic capture file %1").arg(fileName));
+		return;
+	}
+	if (!captureStream)
+		captureStream = new QDataStream;
+	captureStream->setDevice(captureFile);
+	TrafficCaptureRecord::writeHeader(*captureStream);
+}
+
+void ServerTrafficCapture::rotateFiles()
+{
+	if (maxFiles > 0) {
+		QFile::remove(QString("%1.%2").arg(fileName).arg(maxFiles));
+		for (int i = maxFiles - 1; i > 0; --i)
+			QFile::rename(QString("%1.%2").arg(fileName).arg(i), QString("%1.%2").arg(fileName).arg(i + 1));
+		QFile::rename(fileName, fileName + ".1");
+	} else
+		QFile::remove(fileName);
+}
+
+quint32 ServerTrafficCapture::connectionOpened(const QString &address)
+{
+	bufferMutex.lock();
+	const quint32 connectionId = nextConnectionId++;
+	bufferMutex.unlock();
+
+	appendRecord(TrafficCaptureRecord(TrafficCaptureRecord::ConnectionOpened, connectionId, QDateTime::currentMSecsSinceEpoch(), address.toUtf8()));
+	return connectionId;
+}
+
+void ServerTrafficCapture::commandFrame(quint32 connectionId, const CommandContainer &cont, const QByteArray &frame)
+{
+	const qint64 timestamp = QDateTime::currentMSecsSinceEpoch();
+
+	// Passwords do not belong in a capture file; the replay tool logs in with its own.
+	bool containsPassword = false;
+	for (int i = 0; i < cont.session_command_size(); ++i)
+		if (cont.session_command(i).HasExtension(Command_Login::ext) && cont.session_command(i).GetExtension(Command_Login::ext).has_password())
+			containsPassword = true;
+	if (!containsPassword) {
+		appendRecord(TrafficCaptureRecord(TrafficCaptureRecord::CommandFrame, connectionId, timestamp, frame));
+		return;
+	}
+
+	CommandContainer strippedCont(cont);
+	for (int i = 0; i < strippedCont.session_command_size(); ++i)
+		if (strippedCont.session_command(i).HasExtension(Command_Login::ext))
+			strippedCont.mutable_session_command(i)->MutableExtension(Command_Login::ext)->clear_password();
+	QByteArray strippedFrame;
+	strippedFrame.resize(strippedCont.ByteSize());
+	strippedCont.SerializeToArray(strippedFrame.data(), strippedFrame.size());
+	appendRecord(TrafficCaptureRecord(TrafficCaptureRecord::CommandFrame, connectionId, timestamp, strippedFrame));
+}
+
+void ServerTrafficCapture::connectionClosed(quint32 connectionId)
+{
+	appendRecord(TrafficCaptureRecord(TrafficCaptureRecord::ConnectionClosed, connectionId, QDateTime::currentMSecsSinceEpoch()));
+}
+
+void ServerTrafficCapture::appendRecord(const TrafficCaptureRecord &record)
+{
+	bufferMutex.lock();
+	// Losing part of the capture is better than running out of memory when the disk cannot keep up.
+	if (buffer.size() >= maxBufferSize) {
+		++droppedRecords;
+		bufferMutex.unlock();
+		return;
+	}
+	buffer.append(record);
+	bufferMutex.unlock();
+	emit sigFlushBuffer();
+}
+
+void ServerTrafficCapture::flushBuffer()
+{
+	if (flushRunning || !captureFile->isOpen())
+		return;
+
+	flushRunning = true;
+	forever {
+		bufferMutex.lock();
+		if (buffer.isEmpty()) {
+			bufferMutex.unlock();
+			break;
+		}
+		QList<TrafficCaptureRecord> records;
+		records.swap(buffer);
+		const int dropped = droppedRecords;
+		droppedRecords = 0;
+		bufferMutex.unlock();
+
+		if (dropped)
+			logger->logMessage(QString("Traffic capture buffer full, dropped %1 records").arg(dropped));
+
+		for (int i = 0; i < records.size(); ++i)
+			records[i].write(*captureStream);
+		captureFile->flush();
+
+		if ((maxFileSize > 0) && (captureFile->size() >= maxFileSize)) {
+			captureFile->close();
+			rotateFiles();
+			openFile();
+			if (!captureFile->isOpen())
+				break;
+		}
+	}
+	flushRunning = false;
+}
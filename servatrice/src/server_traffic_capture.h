@@ -0,0 +1,49 @@
+#ifndef SERVER_TRAFFIC_CAPTURE_H
+#define SERVER_TRAFFIC_CAPTURE_H
+
+#include <QObject>
+#include <QMutex>
+#include <QList>
+#include "traffic_capture.h"
+
+class QFile;
+class QDataStream;
+class CommandContainer;
+
+// Records the inbound command frames of all client connections for later
+// replay with servatrice_replay. Like the logger, it lives in its own thread;
+// the connection threads only append to a buffer.
+class ServerTrafficCapture : public QObject {
+	Q_OBJECT
+public:
+	ServerTrafficCapture(QObject *parent = 0);
+	~ServerTrafficCapture();
+	bool isActive() const { return captureFile; }
+	quint32 connectionOpened(const QString &address);
+	void commandFrame(quint32 connectionId, const CommandContainer &cont, const QByteArray &frame);
+	void connectionClosed(quint32 connectionId);
+public slots:
+	void startCapture(const QString &_fileName, qint64 _maxFileSize, int _maxFiles);
+private slots:
+	void flushBuffer();
+signals:
+	void sigFlushBuffer();
+private:
+	static const int maxBufferSize = 100000;
+	QString fileName;
+	qint64 maxFileSize;
+	int maxFiles;
+	QFile *captureFile;
+	QDataStream *captureStream;
+	bool flushRunning;
+	QList<TrafficCaptureRecord> buffer;
+	int droppedRecords;
+	quint32 nextConnectionId;
+	QMutex bufferMutex;
+
+	void appendRecord(const TrafficCaptureRecord &record);
+	void openFile();
+	void rotateFiles();
+};
+
+#endif
@@ -29,6 +29,7 @@
 #include "server_player.h"
 #include "main.h"
 #include "server_logger.h"
+#include "server_traffic_capture.h"
 #include "server_response_containers.h"
 #include "pb/commands.pb.h"
 #include "pb/command_deck_list.pb.h"
@@ -66,7 +67,8 @@ ServerSocketInterface::ServerSocketInterface(Servatrice *_server, Servatrice_Dat
 	  servatrice(_server),
 	  sqlInterface(reinterpret_cast<Servatrice_DatabaseInterface *>(databaseInterface)),
 	  messageInProgress(false),
-	  handshakeStarted(false)
+	  handshakeStarted(false),
+	  captureConnectionId(0)
 {
 	socket = new QTcpSocket(this);
 	socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
@@ -83,6 +85,9 @@ ServerSocketInterface::~ServerSocketInterface()
 	logger->logMessage("ServerSocketInterface destructor", this);
 	
 	flushOutputQueue();
+	
+	if (captureConnectionId)
+		trafficCapture->connectionClosed(captureConnectionId);
 }
 
 void ServerSocketInterface::initConnection(int socketDescriptor)
@@ -93,6 +98,8 @@ void ServerSocketInterface::initConnection(int socketDescriptor)
 	
 	socket->setSocketDescriptor(socketDescriptor);
 	logger->logMessage(QString("Incoming connection: %1").arg(socket->peerAddress().toString()), this);
+	if (trafficCapture->isActive())
+		captureConnectionId = trafficCapture->connectionOpened(socket->peerAddress().toString());
 	initSessionDeprecated();
 }
 
@@ -112,6 +119,7 @@ bool ServerSocketInterface::initSession()
 	identEvent.set_server_name(servatrice->getServerName().toStdString());
 	identEvent.set_server_version(VERSION_STRING);
 	identEvent.set_protocol_version(protocolVersion);
+	identEvent.set_server_features(Server::getProtocolFeatures());
 	SessionEvent *identSe = prepareSessionEvent(identEvent);
 	sendProtocolItem(*identSe);
 	delete identSe;
@@ -153,6 +161,8 @@ void ServerSocketInterface::readClient()
 		
 		CommandContainer newCommandContainer;
 		newCommandContainer.ParseFromArray(inputBuffer.data(), messageLength);
+		if (captureConnectionId)
+			trafficCapture->commandFrame(captureConnectionId, newCommandContainer, inputBuffer.left(messageLength));
 		inputBuffer.remove(0, messageLength);
 		messageInProgress = false;
 		
@@ -176,9 +186,14 @@ void ServerSocketInterface::catchSocketError(QAbstractSocket::SocketError socket
 }
 
 void ServerSocketInterface::transmitProtocolItem(const ServerMessage &item)
+{
+	transmitSerializedProtocolItem(serializeProtocolItem(item));
+}
+
+void ServerSocketInterface::transmitSerializedProtocolItem(const QByteArray &buf)
 {
 	outputQueueMutex.lock();
-	outputQueue.append(item);
+	outputQueue.append(buf);
 	outputQueueMutex.unlock();
 	
 	emit outputQueueChanged();
@@ -192,21 +207,13 @@ void ServerSocketInterface::flushOutputQueue()
 	
 	int totalBytes = 0;
 	while (!outputQueue.isEmpty()) {
-		ServerMessage item = outputQueue.takeFirst();
+		QByteArray buf = outputQueue.takeFirst();
 		locker.unlock();
 		
-		QByteArray buf;
-		unsigned int size = item.ByteSize();
-		buf.resize(size + 4);
-		item.SerializeToArray(buf.data() + 4, size);
-		buf.data()[3] = (unsigned char) size;
-		buf.data()[2] = (unsigned char) (size >> 8);
-		buf.data()[1] = (unsigned char) (size >> 16);
-		buf.data()[0] = (unsigned char) (size >> 24);
 		// In case socket->write() calls catchSocketError(), the mutex must not be locked during this call.
 		socket->write(buf);
 		
-		totalBytes += size + 4;
+		totalBytes += buf.size();
 		locker.relock();
 	}
 	locker.unlock();
@@ -291,6 +298,8 @@ Response::ResponseCode ServerSocketInterface::cmdAddToList(const Command_AddToLi
 	Event_AddToList event;
 	event.set_list_name(cmd.list());
 	event.mutable_user_info()->CopyFrom(databaseInterface->getUserData(user));
+	if (list == "buddy")
+		server->addBuddyPresence(this, QString::fromStdString(event.user_info().name()));
 	rc.enqueuePreResponseItem(ServerMessage::SESSION_EVENT, prepareSessionEvent(event));
 	
 	return Response::RespOk;
@@ -326,6 +335,9 @@ Response::ResponseCode ServerSocketInterface::cmdRemoveFromList(const Command_Re
 	if (!sqlInterface->execSqlQuery(query))
 		return Response::RespInternalError;
 	
+	if (list == "buddy")
+		server->removeBuddyPresence(this, QString::fromStdString(databaseInterface->getUserData(user).name()));
+	
 	Event_RemoveFromList event;
 	event.set_list_name(cmd.list());
 	event.set_user_name(cmd.user_name());
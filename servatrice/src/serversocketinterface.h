@@ -66,10 +66,11 @@ private:
 	QTcpSocket *socket;
 	
 	QByteArray inputBuffer;
-	QList<ServerMessage> outputQueue;
+	QList<QByteArray> outputQueue; // serialized messages
 	bool messageInProgress;
 	bool handshakeStarted;
 	int messageLength;
+	quint32 captureConnectionId;
 	
 	Response::ResponseCode cmdAddToList(const Command_AddToList &cmd, ResponseContainer &rc);
 	Response::ResponseCode cmdRemoveFromList(const Command_RemoveFromList &cmd, ResponseContainer &rc);
@@ -104,6 +105,7 @@ public:
 	QString getAddress() const { return socket->peerAddress().toString(); }
 
 	void transmitProtocolItem(const ServerMessage &item);
+	void transmitSerializedProtocolItem(const QByteArray &buf);
 public slots:
 	void initConnection(int socketDescriptor);
 };